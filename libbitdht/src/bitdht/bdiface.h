@@ -30,6 +30,7 @@
 #include <map>
 #include <string>
 #include <list>
+#include <vector>
 #include <inttypes.h>
 
 #include "util/bdnet.h"
@@ -260,8 +261,10 @@ class bdBucket
 	public:
 	
 	bdBucket();
-	/* list so we can queue properly */
-	std::list<bdPeer> entries;
+	/* contiguous, as buckets are small and scanned for every query.
+	 * queued by last receive time: oldest first.
+	 */
+	std::vector<bdPeer> entries;
 };
 
 class bdQueryStatus
@@ -36,6 +36,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 /**
  * #define BITDHT_DEBUG 1
@@ -220,13 +221,35 @@ int     bdSpace::setAttachedFlag(uint32_t withflags, int count)
 	return 1;
 }
 
+/* Buckets are searched closest first, and the search stops once enough peers are found.
+ *
+ * With the XOR metric, the distance from target T to a peer P in bucket j is:
+ *	d(T,P) = d(T,own) ^ d(own,P)
+ * and the highest bit of d(own,P) is j. So above bit j, d(T,P) is the same as d(T,own),
+ * and bit j is the opposite of bit j of d(T,own). Each bucket therefore covers its own
+ * range of distances to T, and the buckets come in this order:
+ *	- the buckets j which bit j of d(T,own) is set, from the highest down.
+ *	- bucket 0.
+ *	- the buckets j which bit j of d(T,own) is clear, from the lowest up.
+ *
+ * Only the peers of the last bucket searched need to be sorted.
+ */
+
+static bool bdBitSet(const bdMetric *m, int bit)
+{
+	int byte = BITDHT_KEY_LEN - 1 - bit / 8;
+	return (m->data[byte] & (1 << (bit % 8))) != 0;
+}
+
+static bool bdCompareDistance(const std::pair<bdMetric, bdId> &a, const std::pair<bdMetric, bdId> &b)
+{
+	return a.first < b.first;
+}
+
 int bdSpace::find_nearest_nodes_with_flags(const bdNodeId *id, int number, 
 		std::list<bdId> /* excluding */, 
 		std::multimap<bdMetric, bdId> &nearest, uint32_t with_flags)
 {
-	std::multimap<bdMetric, bdId> closest;
-	std::multimap<bdMetric, bdId>::iterator mit;
-
 	bdMetric dist;
 	mFns->bdDistance(id, &(mOwnId), &dist);
 
@@ -241,77 +264,62 @@ int bdSpace::find_nearest_nodes_with_flags(const bdNodeId *id, int number,
 	std::cerr << std::endl;
 #endif
 
-	std::vector<bdBucket>::iterator it;
-	std::list<bdPeer>::iterator eit;
-	/* iterate through the buckets, and sort by distance */
-	for(it = buckets.begin(); it != buckets.end(); it++)
-	{
-		for(eit = it->entries.begin(); eit != it->entries.end(); eit++) 
-		{
-			if ((!with_flags) || ((with_flags & eit->mPeerFlags) == with_flags))
-			{
-			  mFns->bdDistance(id, &(eit->mPeerId.id), &dist);
-			  closest.insert(std::pair<bdMetric, bdId>(dist, eit->mPeerId));
+	int nBuckets = buckets.size();
+	int found = 0;
+	int searched = 0;
 
-#if 0
-			  std::cerr << "Added NodeId: ";
-			  bdPrintNodeId(std::cerr, &(eit->mPeerId.id));
-			  std::cerr << " Metric: ";
-			  bdPrintNodeId(std::cerr, &(dist));
-			  std::cerr << std::endl;
-#endif
-			}
-		}
-	}
+	std::vector<std::pair<bdMetric, bdId> > candidates;
+	candidates.reserve(mFns->bdNodesPerBucket());
 
-	/* take the first number of nodes */
-	int i = 0;
-	for(mit = closest.begin(); (mit != closest.end()) && (i < number); mit++, i++)
+	/* pass 0: set bits, down to bucket 0. pass 1: clear bits, upwards */
+	for(int pass = 0; (pass < 2) && (found < number); pass++)
 	{
-		mFns->bdDistance(&(mOwnId), &(mit->second.id), &dist);
-
-#ifdef DEBUG_BD_SPACE
-		int iBucket = mFns->bdBucketDistance(&(mit->first));
-
-		std::cerr << "Closest " << i << ": ";
-		mFns->bdPrintNodeId(std::cerr, &(mit->second.id));
-		std::cerr << " Bucket:        " << iBucket;
-		std::cerr << std::endl;
-#endif
-
+		for(int i = 0; (i < nBuckets) && (found < number); i++)
+		{
+			int buckno = (pass == 0) ? nBuckets - 1 - i : i;
 
-#if 0
-		std::cerr << "\tNodeId: ";
-		mFns->bdPrintNodeId(std::cerr, &(mit->second.id));
-		std::cerr << std::endl;
+			if (buckno == 0)
+			{
+				if (pass == 1)
+					continue;
+			}
+			else if (bdBitSet(&dist, buckno) != (pass == 0))
+			{
+				continue;
+			}
 
-		std::cerr << "\tOwn Id: ";
-		mFns->bdPrintNodeId(std::cerr, &(mOwnId));
-		std::cerr << std::endl;
+			candidates.clear();
 
-		std::cerr << "     Us Metric: ";
-		mFns->bdPrintNodeId(std::cerr, &dist);
-		std::cerr << " Bucket:        " << oBucket;
-		std::cerr << std::endl;
-
-		std::cerr << "\tFindId: ";
-		mFns->bdPrintNodeId(std::cerr, id);
-		std::cerr << std::endl;
+			std::vector<bdPeer>::iterator eit;
+			for(eit = buckets[buckno].entries.begin(); eit != buckets[buckno].entries.end(); eit++) 
+			{
+				if ((!with_flags) || ((with_flags & eit->mPeerFlags) == with_flags))
+				{
+					candidates.push_back(std::pair<bdMetric, bdId>(bdMetric(), eit->mPeerId));
+					mFns->bdDistance(id, &(eit->mPeerId.id), &(candidates.back().first));
+				}
+			}
+			searched++;
 
-		std::cerr << "     Id Metric: ";
-		mFns->bdPrintNodeId(std::cerr, &(mit->first));
-		std::cerr << " Bucket:        " << iBucket;
-		std::cerr << std::endl;
-#endif
+			/* only the bucket filling the last places needs sorting */
+			if (found + (int) candidates.size() > number)
+			{
+				std::sort(candidates.begin(), candidates.end(), bdCompareDistance);
+				candidates.resize(number - found);
+			}
 
-		nearest.insert(*mit);
+			nearest.insert(candidates.begin(), candidates.end());
+			found += candidates.size();
+		}
 	}
 
 #ifdef DEBUG_BD_SPACE
 	std::cerr << "#Nearest: " << (int) nearest.size();
-	std::cerr << " #Closest: " << (int) closest.size();
+	std::cerr << " #Buckets searched: " << searched;
 	std::cerr << " #Requested: " << number;
 	std::cerr << std::endl << std::endl;
+#else
+	(void) searched;
 #endif
 
 	return 1;
@@ -350,7 +358,7 @@ int bdSpace::find_node(const bdNodeId *id, int number, std::list<bdId> &matchIds
 
 	bdBucket &buck = buckets[buckno];
 
-	std::list<bdPeer>::iterator eit;
+	std::vector<bdPeer>::iterator eit;
 	int matchCount = 0;
 	for(eit = buck.entries.begin(); eit != buck.entries.end(); eit++) 
 	{
@@ -419,7 +427,7 @@ int bdSpace::find_exactnode(const bdId *id, bdPeer &peer)
 
 	bdBucket &buck = buckets[buckno];
 
-	std::list<bdPeer>::iterator eit;
+	std::vector<bdPeer>::iterator eit;
 	for(eit = buck.entries.begin(); eit != buck.entries.end(); eit++) 
 	{
 		if (*id == eit->mPeerId)
@@ -454,7 +462,7 @@ int bdSpace::clean_node_flags(uint32_t flags)
 	std::vector<bdBucket>::iterator bit;
 	for(bit = buckets.begin(); bit != buckets.end(); bit++)
 	{
-		std::list<bdPeer>::iterator eit;
+		std::vector<bdPeer>::iterator eit;
 		for(eit = bit->entries.begin(); eit != bit->entries.end(); eit++) 
 		{
 			if (flags & eit->mPeerFlags)
@@ -495,7 +503,7 @@ int	bdSpace::scanOutOfDatePeers(std::list<bdId> &peerIds)
 	std::map<bdMetric, bdId>::iterator mit;
 
 	std::vector<bdBucket>::iterator it;
-	std::list<bdPeer>::iterator eit;
+	std::vector<bdPeer>::iterator eit;
 	time_t ts = time(NULL);
 
 	/* iterate through the buckets, and sort by distance */
@@ -611,7 +619,7 @@ int	bdSpace::updateAttachedPeers()
 	std::map<bdMetric, bdId>::iterator mit;
 
 	std::vector<bdBucket>::iterator it;
-	std::list<bdPeer>::reverse_iterator eit;
+	std::vector<bdPeer>::reverse_iterator eit;
 
 
 	/* skip the first bucket, as we don't want to ping ourselves! */	
@@ -702,7 +710,7 @@ int     bdSpace::add_peer(const bdId *id, uint32_t peerflags)
 	bdBucket &buck =  buckets[bucket];
 
 
-	std::list<bdPeer>::iterator it;
+	std::vector<bdPeer>::iterator it;
 
 	/* calculate the score for this new peer */
 	uint32_t minScore = peerflags;
@@ -760,7 +768,7 @@ int     bdSpace::add_peer(const bdId *id, uint32_t peerflags)
 #ifdef DEBUG_BD_SPACE
 			std::cerr << "Dropping Out-of-Date peer in bucket" << std::endl;
 #endif
-			buck.entries.pop_front();
+			buck.entries.erase(buck.entries.begin());
 			add = true;
 		}
 		else if (peerflags > minScore)
@@ -831,7 +839,7 @@ bool    bdSpace::flagpeer(const bdId *id, uint32_t flags, uint32_t ex_flags)
 	bdBucket &buck =  buckets[bucket];
 
 	/* loop through ids, to find it */
-	std::list<bdPeer>::iterator it;
+	std::vector<bdPeer>::iterator it;
 	for(it = buck.entries.begin(); it != buck.entries.end(); it++)
 	{
                 /* similar id check */
@@ -866,7 +874,7 @@ int     bdSpace::printDHT()
 	std::map<bdMetric, bdId>::iterator mit;
 
 	std::vector<bdBucket>::iterator it;
-	std::list<bdPeer>::iterator eit;
+	std::vector<bdPeer>::iterator eit;
 
 	/* iterate through the buckets, and sort by distance */
 	int i = 0;
@@ -1116,7 +1124,7 @@ uint32_t  bdSpace::calcNetworkSizeWithFlag(uint32_t withFlag)
 	for(it = buckets.begin(); it != buckets.end(); it++, i++)
 	{
 		int size = 0;
-		std::list<bdPeer>::iterator lit;
+		std::vector<bdPeer>::iterator lit;
 		for(lit = it->entries.begin(); lit != it->entries.end(); lit++)
 		{
 			if (withFlag & lit->mPeerFlags)
@@ -1219,7 +1227,7 @@ uint32_t  bdSpace::calcSpaceSizeWithFlag(uint32_t withFlag)
 	for(; it != buckets.end(); it++)
 	{
 		int size = 0;
-		std::list<bdPeer>::iterator lit;
+		std::vector<bdPeer>::iterator lit;
 		for(lit = it->entries.begin(); lit != it->entries.end(); lit++)
 		{
 			if (withFlag & lit->mPeerFlags)
@@ -1256,7 +1264,7 @@ bool bdSpace::findRandomPeerWithFlag(bdId &id, uint32_t withFlag)
 	}
 	for(; it != buckets.end(); it++, buck++)
 	{
-		std::list<bdPeer>::iterator lit;
+		std::vector<bdPeer>::iterator lit;
 		for(lit = it->entries.begin(); lit != it->entries.end(); lit++)
 		{
 			if (withFlag & lit->mPeerFlags)
@@ -144,8 +144,8 @@ class bdBucket
 
 	bdBucket();
 
-	// list so we can queue properly 
-	std::list<bdPeer> entries;
+	// contiguous, oldest first
+	std::vector<bdPeer> entries;
 };
  *
  *
@@ -0,0 +1,193 @@
+/*
+ * bitdht/bdspace_bench.cc
+ *
+ * BitDHT: An Flexible DHT library.
+ *
+ * Copyright 2018 by Retroshare Team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 3 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "bitdht@lunamutt.com".
+ *
+ */
+
+
+#include "bitdht/bdpeer.h"
+#include "bitdht/bdstddht.h"
+#include <iostream>
+#include <stdio.h>
+#include <time.h>
+
+#include "utest.h"
+
+/* Replays find_node queries against a populated space, and checks that
+ * find_nearest_nodes_with_flags() gives the same peers as sorting the whole
+ * space by distance, which is what it used to do.
+ */
+
+#define N_PEERS_TO_ADD 10000
+#define N_QUERIES 20000
+#define N_PEERS_TO_FIND 8	/* BITDHT_QUERY_NEIGHBOUR_PEERS */
+
+#define TEST_FLAG_A	0x0001
+#define TEST_FLAG_B	0x0002
+
+INITTEST();
+
+static void full_scan_nearest(std::vector<bdBucket> &buckets, bdDhtFunctions *fns, const bdNodeId *id,
+		int number, std::multimap<bdMetric, bdId> &nearest, uint32_t with_flags)
+{
+	std::multimap<bdMetric, bdId> closest;
+
+	std::vector<bdBucket>::iterator it;
+	for(it = buckets.begin(); it != buckets.end(); it++)
+	{
+		std::vector<bdPeer>::iterator eit;
+		for(eit = it->entries.begin(); eit != it->entries.end(); eit++)
+		{
+			if ((!with_flags) || ((with_flags & eit->mPeerFlags) == with_flags))
+			{
+				bdMetric dist;
+				fns->bdDistance(id, &(eit->mPeerId.id), &dist);
+				closest.insert(std::pair<bdMetric, bdId>(dist, eit->mPeerId));
+			}
+		}
+	}
+
+	std::multimap<bdMetric, bdId>::iterator mit;
+	int i = 0;
+	for(mit = closest.begin(); (mit != closest.end()) && (i < number); mit++, i++)
+	{
+		nearest.insert(*mit);
+	}
+}
+
+static bool same_distances(const std::multimap<bdMetric, bdId> &a, const std::multimap<bdMetric, bdId> &b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	std::multimap<bdMetric, bdId>::const_iterator ait, bit;
+	for(ait = a.begin(), bit = b.begin(); ait != a.end(); ait++, bit++)
+	{
+		if (!(ait->first == bit->first))
+			return false;
+	}
+	return true;
+}
+
+/* half of the queries are random, the others are close to our own id, as for
+ * the nodes asking us about our neighbourhood.
+ */
+static void make_query(const bdNodeId *ownId, int i, bdNodeId *target)
+{
+	bdStdRandomNodeId(target);
+
+	if (i % 2)
+	{
+		int keep = (i / 2) % BITDHT_KEY_LEN;
+		for(int j = 0; j < keep; j++)
+		{
+			target->data[j] = ownId->data[j];
+		}
+	}
+}
+
+int main(int /*argc*/, char **argv)
+{
+	std::cerr << "libbitdht: " << argv[0] << std::endl;
+
+	bdNodeId ownId;
+	bdStdRandomNodeId(&ownId);
+	bdDhtFunctions *fns = new bdStdDht();
+
+	bdSpace space(&ownId, fns);
+	for (int i = 0; i < N_PEERS_TO_ADD; i++)
+	{
+		bdId tmpId;
+		bdStdRandomId(&tmpId);
+		space.add_peer(&tmpId, (i % 3) ? TEST_FLAG_A : TEST_FLAG_A | TEST_FLAG_B);
+	}
+
+	/* a few peers next to us, for the close queries */
+	for (int i = 0; i < N_PEERS_TO_ADD / 10; i++)
+	{
+		bdId tmpId;
+		bdStdRandomId(&tmpId);
+		make_query(&ownId, 2 * i + 1, &(tmpId.id));
+		space.add_peer(&tmpId, TEST_FLAG_A);
+	}
+
+	std::cerr << "Space size: " << space.calcSpaceSize() << " peers" << std::endl;
+
+	std::vector<bdBucket> buckets(fns->bdNumBuckets());
+	for (int i = 0; i < fns->bdNumBuckets(); i++)
+	{
+		space.getDhtBucket(i, buckets[i]);
+	}
+
+	/* same results as the full scan */
+	for (int i = 0; i < 1000; i++)
+	{
+		bdNodeId target;
+		make_query(&ownId, i, &target);
+
+		if (i == 0)
+			target = ownId;
+
+		uint32_t flags = (i % 4 == 3) ? TEST_FLAG_B : 0;
+		int number = 1 + i % 20;
+
+		std::multimap<bdMetric, bdId> nearest, expected;
+		space.find_nearest_nodes_with_flags(&target, number, std::list<bdId>(), nearest, flags);
+		full_scan_nearest(buckets, fns, &target, number, expected, flags);
+
+		CHECK(same_distances(nearest, expected));
+	}
+	REPORT("find_nearest_nodes_with_flags() against full scan");
+
+	/* replay queries */
+	std::vector<bdNodeId> queries(N_QUERIES);
+	for (int i = 0; i < N_QUERIES; i++)
+	{
+		make_query(&ownId, i, &(queries[i]));
+	}
+
+	clock_t start = clock();
+	for (int i = 0; i < N_QUERIES; i++)
+	{
+		std::multimap<bdMetric, bdId> nearest;
+		space.find_nearest_nodes(&(queries[i]), N_PEERS_TO_FIND, nearest);
+	}
+	double bucket_time = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+	start = clock();
+	for (int i = 0; i < N_QUERIES; i++)
+	{
+		std::multimap<bdMetric, bdId> nearest;
+		full_scan_nearest(buckets, fns, &(queries[i]), N_PEERS_TO_FIND, nearest, 0);
+	}
+	double scan_time = (clock() - start) / (double) CLOCKS_PER_SEC;
+
+	std::cerr << N_QUERIES << " queries for " << N_PEERS_TO_FIND << " peers: ";
+	std::cerr << N_QUERIES / (bucket_time > 0 ? bucket_time : 1e-6) << " queries/s searching by bucket, ";
+	std::cerr << N_QUERIES / (scan_time > 0 ? scan_time : 1e-6) << " queries/s with a full scan";
+	std::cerr << std::endl;
+
+	FINALREPORT("libbitdht: Space Bench");
+	return TESTRESULT();
+}
+
+
@@ -297,6 +297,8 @@ public:
         MHDFilestreamerHandler* handler = (MHDFilestreamerHandler*)cls;
         if(pos >= handler->mSize)
             return MHD_CONTENT_READER_END_OF_STREAM;
+        // tell the download where the player reads, so that the streaming strategies fetch the next chunks first
+        rsFiles->setPlaybackCursor(handler->mHash, pos);
         uint32_t size_to_send = max;
         if(!rsFiles->getFileData(handler->mHash, pos, size_to_send, (uint8_t*)buf))
             return 0;
@@ -2,6 +2,7 @@
 
 #include <retroshare/rsgxsforums.h>
 #include <time.h>
+#include <algorithm>
 
 #include "Operators.h"
 #include "ApiTypes.h"
@@ -32,9 +33,20 @@ void ForumHandler::handleWildcard(Request &req, Response &resp)
             std::list<RsGxsGroupId> groupIds;
             groupIds.push_back(grpId);
 
+            // optional paging, newest messages first. Without limit all messages are returned.
+            int offset = 0;
+            int limit = 0;
+            req.mStream << makeKeyValueReference("offset", offset)
+                        << makeKeyValueReference("limit", limit);
+
             uint32_t token;
             RsTokReqOptions opts;
             opts.mReqType = GXS_REQUEST_TYPE_MSG_DATA;
+            if(limit > 0)
+            {
+                opts.mPageOffset = std::max(offset, 0);
+                opts.mPageSize = limit;
+            }
             mRsGxsForums->getTokenService()->requestMsgInfo(token, RS_TOKREQ_ANSTYPE_DATA, opts, groupIds);
 
             time_t start = time(NULL);
@@ -33,6 +33,7 @@
 #include <openssl/hmac.h>
 
 #include <iostream>
+#include <vector>
 #include <stdlib.h>
 
 #include "crypto/chacha20.h"
@@ -42,6 +43,25 @@
 
 #define rotl(x,n) { x = (x << n) | (x >> (-n & 31)) ;}
 
+// Multi-block ChaCha20 kernels, for x86 compilers that know about the target attribute. SSE2 is always there on
+// x86_64. AVX2 is used when the CPU has it.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__)))
+    #define CHACHA20_SSE2
+    #include <emmintrin.h>
+
+    #if defined(__clang__) || __GNUC__ >= 5
+        #define CHACHA20_AVX2
+        #include <immintrin.h>
+    #endif
+#endif
+
+// 64 bits limbs Poly1305 needs 128 bits products.
+
+#ifdef __SIZEOF_INT128__
+    #define POLY1305_64BITS
+#endif
+
 //#define DEBUG_CHACHA20
 
 #if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
@@ -363,11 +383,199 @@ static void print(const chacha20_state& s)
 }
 #endif
 
-void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+// Multi-block kernels. Each of them xors the cipher stream of as many whole groups of blocks as fit into size (4
+// blocks for SSE2, 8 for AVX2), starting at block s.c[12], and returns the number of bytes done. The rest is done
+// one block at a time. Blocks are computed side by side: vector i holds word i of all the blocks.
+//
+typedef uint32_t (*chacha20_blocks_kernel)(const chacha20_state& s,uint8_t *data,uint32_t size) ;
+
+static uint32_t chacha20_blocks_none(const chacha20_state& /*s*/,uint8_t * /*data*/,uint32_t /*size*/) { return 0 ; }
+
+#ifdef CHACHA20_SSE2
+
+#define CHACHA20_SSE2_ROTL(x,n) _mm_or_si128(_mm_slli_epi32(x,n),_mm_srli_epi32(x,32-n))
+#define CHACHA20_SSE2_ROTL16(x) _mm_shufflehi_epi16(_mm_shufflelo_epi16(x,0xb1),0xb1)
+
+#define CHACHA20_SSE2_QUARTER_ROUND(a,b,c,d) \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_SSE2_ROTL16(d) ;   \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_SSE2_ROTL(b,12) ;  \
+    a = _mm_add_epi32(a,b) ; d = _mm_xor_si128(d,a) ; d = CHACHA20_SSE2_ROTL(d,8) ;   \
+    c = _mm_add_epi32(c,d) ; b = _mm_xor_si128(b,c) ; b = CHACHA20_SSE2_ROTL(b,7) ;
+
+static uint32_t chacha20_blocks_sse2(const chacha20_state& s,uint8_t *data,uint32_t size)
 {
-    for(uint32_t i=0;i<size/64 + 1;++i)
+    uint32_t done = 0 ;
+    uint32_t counter = s.c[12] ;
+
+    for(;done + 4*64 <= size;done += 4*64,counter += 4)
     {
-        chacha20_state s(key,block_counter+i,nonce) ;
+        __m128i in[16] ;
+        __m128i x[16] ;
+
+        for(uint32_t i=0;i<16;++i)
+            in[i] = _mm_set1_epi32(s.c[i]) ;
+
+        in[12] = _mm_add_epi32(_mm_set1_epi32(counter),_mm_set_epi32(3,2,1,0)) ;
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = in[i] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_SSE2_QUARTER_ROUND(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        // words 4g..4g+3 of the 4 blocks are transposed into 16 consecutive bytes of each block.
+
+        for(uint32_t g=0;g<4;++g)
+        {
+            __m128i a = _mm_add_epi32(x[4*g+0],in[4*g+0]) ;
+            __m128i b = _mm_add_epi32(x[4*g+1],in[4*g+1]) ;
+            __m128i c = _mm_add_epi32(x[4*g+2],in[4*g+2]) ;
+            __m128i d = _mm_add_epi32(x[4*g+3],in[4*g+3]) ;
+
+            __m128i t0 = _mm_unpacklo_epi32(a,b) ;
+            __m128i t1 = _mm_unpacklo_epi32(c,d) ;
+            __m128i t2 = _mm_unpackhi_epi32(a,b) ;
+            __m128i t3 = _mm_unpackhi_epi32(c,d) ;
+
+            __m128i blk[4] = { _mm_unpacklo_epi64(t0,t1), _mm_unpackhi_epi64(t0,t1), _mm_unpacklo_epi64(t2,t3), _mm_unpackhi_epi64(t2,t3) } ;
+
+            for(uint32_t b=0;b<4;++b)
+            {
+                __m128i *p = (__m128i*)(data + done + 64*b + 16*g) ;
+                _mm_storeu_si128(p,_mm_xor_si128(_mm_loadu_si128(p),blk[b])) ;
+            }
+        }
+    }
+    return done ;
+}
+#endif
+
+#ifdef CHACHA20_AVX2
+
+#define CHACHA20_AVX2_ROTL(x,n) _mm256_or_si256(_mm256_slli_epi32(x,n),_mm256_srli_epi32(x,32-n))
+
+#define CHACHA20_AVX2_QUARTER_ROUND(a,b,c,d) \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = _mm256_shuffle_epi8(d,rot16) ;  \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_AVX2_ROTL(b,12) ;      \
+    a = _mm256_add_epi32(a,b) ; d = _mm256_xor_si256(d,a) ; d = _mm256_shuffle_epi8(d,rot8) ;   \
+    c = _mm256_add_epi32(c,d) ; b = _mm256_xor_si256(b,c) ; b = CHACHA20_AVX2_ROTL(b,7) ;
+
+__attribute__((target("avx2")))
+static uint32_t chacha20_blocks_avx2(const chacha20_state& s,uint8_t *data,uint32_t size)
+{
+    uint32_t done = 0 ;
+    uint32_t counter = s.c[12] ;
+
+    // rotations by 16 and 8 bits are byte shuffles
+    const __m256i rot16 = _mm256_set_epi8(13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2, 13,12,15,14, 9,8,11,10, 5,4,7,6, 1,0,3,2) ;
+    const __m256i rot8  = _mm256_set_epi8(14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3, 14,13,12,15, 10,9,8,11, 6,5,4,7, 2,1,0,3) ;
+
+    for(;done + 8*64 <= size;done += 8*64,counter += 8)
+    {
+        __m256i in[16] ;
+        __m256i x[16] ;
+
+        for(uint32_t i=0;i<16;++i)
+            in[i] = _mm256_set1_epi32(s.c[i]) ;
+
+        in[12] = _mm256_add_epi32(_mm256_set1_epi32(counter),_mm256_set_epi32(7,6,5,4,3,2,1,0)) ;
+
+        for(uint32_t i=0;i<16;++i)
+            x[i] = in[i] ;
+
+        for(uint32_t i=0;i<10;++i)
+        {
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 0],x[ 4],x[ 8],x[12]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 1],x[ 5],x[ 9],x[13]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 2],x[ 6],x[10],x[14]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 3],x[ 7],x[11],x[15]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 0],x[ 5],x[10],x[15]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 1],x[ 6],x[11],x[12]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 2],x[ 7],x[ 8],x[13]) ;
+            CHACHA20_AVX2_QUARTER_ROUND(x[ 3],x[ 4],x[ 9],x[14]) ;
+        }
+
+        // same transposition as SSE2, in each 128 bits lane: the low lane has blocks 0-3, the high lane blocks 4-7.
+
+        for(uint32_t g=0;g<4;++g)
+        {
+            __m256i a = _mm256_add_epi32(x[4*g+0],in[4*g+0]) ;
+            __m256i b = _mm256_add_epi32(x[4*g+1],in[4*g+1]) ;
+            __m256i c = _mm256_add_epi32(x[4*g+2],in[4*g+2]) ;
+            __m256i d = _mm256_add_epi32(x[4*g+3],in[4*g+3]) ;
+
+            __m256i t0 = _mm256_unpacklo_epi32(a,b) ;
+            __m256i t1 = _mm256_unpacklo_epi32(c,d) ;
+            __m256i t2 = _mm256_unpackhi_epi32(a,b) ;
+            __m256i t3 = _mm256_unpackhi_epi32(c,d) ;
+
+            __m256i blk[4] = { _mm256_unpacklo_epi64(t0,t1), _mm256_unpackhi_epi64(t0,t1), _mm256_unpacklo_epi64(t2,t3), _mm256_unpackhi_epi64(t2,t3) } ;
+
+            for(uint32_t b=0;b<4;++b)
+            {
+                __m128i *p0 = (__m128i*)(data + done + 64*b + 16*g) ;
+                __m128i *p1 = (__m128i*)(data + done + 64*(b+4) + 16*g) ;
+
+                _mm_storeu_si128(p0,_mm_xor_si128(_mm_loadu_si128(p0),_mm256_castsi256_si128(blk[b]))) ;
+                _mm_storeu_si128(p1,_mm_xor_si128(_mm_loadu_si128(p1),_mm256_extracti128_si256(blk[b],1))) ;
+            }
+        }
+    }
+    return done ;
+}
+#endif
+
+static chacha20_blocks_kernel select_chacha20_kernel()
+{
+#ifdef CHACHA20_AVX2
+    __builtin_cpu_init() ;
+
+    if(__builtin_cpu_supports("avx2"))
+        return chacha20_blocks_avx2 ;
+#endif
+#ifdef CHACHA20_SSE2
+    return chacha20_blocks_sse2 ;
+#else
+    return chacha20_blocks_none ;
+#endif
+}
+
+// all kernels the CPU can run, for tests.
+static void list_chacha20_kernels(std::vector<chacha20_blocks_kernel>& kernels,std::vector<std::string>& names)
+{
+    kernels.push_back(chacha20_blocks_none) ; names.push_back("scalar") ;
+#ifdef CHACHA20_SSE2
+    kernels.push_back(chacha20_blocks_sse2) ; names.push_back("SSE2  ") ;
+#endif
+#ifdef CHACHA20_AVX2
+    __builtin_cpu_init() ;
+
+    if(__builtin_cpu_supports("avx2"))
+    {
+        kernels.push_back(chacha20_blocks_avx2) ; names.push_back("AVX2  ") ;
+    }
+#endif
+}
+
+static void chacha20_encrypt_with_kernel(chacha20_blocks_kernel kernel,uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    chacha20_state s0(key,block_counter,nonce) ;
+
+    uint32_t done = kernel(s0,data,size) ;
+
+    for(uint32_t i=done/64;i<(size+63)/64;++i)
+    {
+        chacha20_state s(s0) ;
+        s.c[12] = block_counter + i ;
 
 #ifdef DEBUG_CHACHA20
         fprintf(stdout,"Block %d:\n",i) ;
@@ -386,6 +594,14 @@ void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[
     }
 }
 
+void chacha20_encrypt_rs(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
+{
+    // chosen once, from what the CPU supports
+    static const chacha20_blocks_kernel kernel = select_chacha20_kernel() ;
+
+    chacha20_encrypt_with_kernel(kernel,key,block_counter,nonce,data,size) ;
+}
+
 #if OPENSSL_VERSION_NUMBER >= 0x010100000L && !defined(LIBRESSL_VERSION_NUMBER)
 void chacha20_encrypt_openssl(uint8_t key[32], uint32_t block_counter, uint8_t nonce[12], uint8_t *data, uint32_t size)
 {
@@ -500,9 +716,149 @@ static void poly1305_finish(poly1305_state& s,uint8_t tag[16])
     tag[12] = (s.a.b[3] >> 0) & 0xff ; tag[13] = (s.a.b[3] >> 8) & 0xff ; tag[14] = (s.a.b[3] >>16) & 0xff ; tag[15] = (s.a.b[3] >>24) & 0xff ;
 }
 
+#ifdef POLY1305_64BITS
+// Same as above, with numbers held in three limbs of 44, 44 and 42 bits, so that products fit into 128 bits and
+// the reduction modulo 2^130-5 only takes a few shifts. See poly1305-donna.
+
+struct poly1305_state64
+{
+    uint64_t r[3] ;
+    uint64_t h[3] ;
+    uint64_t pad[2] ;
+};
+
+static uint64_t read_le64(const uint8_t *p)
+{
+    uint64_t v = 0 ;
+    for(uint32_t i=0;i<8;++i)
+        v |= ((uint64_t)p[i]) << (8*i) ;
+    return v ;
+}
+
+static void poly1305_init(poly1305_state64& s,uint8_t key[32])
+{
+    uint64_t t0 = read_le64(key) ;
+    uint64_t t1 = read_le64(key+8) ;
+
+    // clamped r
+    s.r[0] = ( t0                     ) & 0xffc0fffffffULL ;
+    s.r[1] = ((t0 >> 44) | (t1 << 20) ) & 0xfffffc0ffffULL ;
+    s.r[2] = ((t1 >> 24)              ) & 0x00ffffffc0fULL ;
+
+    s.h[0] = s.h[1] = s.h[2] = 0 ;
+
+    s.pad[0] = read_le64(key+16) ;
+    s.pad[1] = read_le64(key+24) ;
+}
+
+static void poly1305_block(poly1305_state64& s,const uint8_t m[16],uint64_t hibit)
+{
+    typedef unsigned __int128 uint128_t ;
+
+    const uint64_t s1 = s.r[1] * (5 << 2) ;
+    const uint64_t s2 = s.r[2] * (5 << 2) ;
+
+    uint64_t t0 = read_le64(m) ;
+    uint64_t t1 = read_le64(m+8) ;
+
+    uint64_t h0 = s.h[0] + (( t0                    ) & 0xfffffffffffULL) ;
+    uint64_t h1 = s.h[1] + (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) ;
+    uint64_t h2 = s.h[2] + (((t1 >> 24)             ) & 0x3ffffffffffULL) + hibit ;
+
+    uint128_t d0 = (uint128_t)h0 * s.r[0] + (uint128_t)h1 * s2     + (uint128_t)h2 * s1 ;
+    uint128_t d1 = (uint128_t)h0 * s.r[1] + (uint128_t)h1 * s.r[0] + (uint128_t)h2 * s2 ;
+    uint128_t d2 = (uint128_t)h0 * s.r[2] + (uint128_t)h1 * s.r[1] + (uint128_t)h2 * s.r[0] ;
+
+    uint64_t c ;
+                     c = (uint64_t)(d0 >> 44) ; h0 = (uint64_t)d0 & 0xfffffffffffULL ;
+    d1 += c ;        c = (uint64_t)(d1 >> 44) ; h1 = (uint64_t)d1 & 0xfffffffffffULL ;
+    d2 += c ;        c = (uint64_t)(d2 >> 42) ; h2 = (uint64_t)d2 & 0x3ffffffffffULL ;
+    h0 += c * 5 ;    c = h0 >> 44 ;             h0 &= 0xfffffffffffULL ;
+    h1 += c ;
+
+    s.h[0] = h0 ; s.h[1] = h1 ; s.h[2] = h2 ;
+}
+
+// Warning: each call will automatically *pad* the data to a multiple of 16 bytes.
+//
+static void poly1305_add(poly1305_state64& s,uint8_t *message,uint32_t size,bool pad_to_16_bytes=false)
+{
+    uint32_t i = 0 ;
+
+    for(;i+16 <= size;i += 16)
+        poly1305_block(s,message+i,1ULL << 40) ;	// 2^128
+
+    if(i < size)
+    {
+        uint8_t last[16] ;
+        memset(last,0,16) ;
+        memcpy(last,message+i,size-i) ;
+
+        if(pad_to_16_bytes)
+            poly1305_block(s,last,1ULL << 40) ;
+        else
+        {
+            last[size-i] = 0x01 ;
+            poly1305_block(s,last,0) ;
+        }
+    }
+}
+
+static void poly1305_finish(poly1305_state64& s,uint8_t tag[16])
+{
+    uint64_t h0 = s.h[0], h1 = s.h[1], h2 = s.h[2] ;
+    uint64_t c ;
+
+    // fully carry h
+
+                  c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += c ;     c = h2 >> 42 ; h2 &= 0x3ffffffffffULL ;
+    h0 += c * 5 ; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += c ;     c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += c ;     c = h2 >> 42 ; h2 &= 0x3ffffffffffULL ;
+    h0 += c * 5 ; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += c ;
+
+    // g = h - p. Select h if h < p, g otherwise, in constant time.
+
+    uint64_t g0 = h0 + 5 ; c = g0 >> 44 ; g0 &= 0xfffffffffffULL ;
+    uint64_t g1 = h1 + c ; c = g1 >> 44 ; g1 &= 0xfffffffffffULL ;
+    uint64_t g2 = h2 + c - (1ULL << 42) ;
+
+    c = (g2 >> 63) - 1 ;
+    g0 &= c ; g1 &= c ; g2 &= c ;
+    c = ~c ;
+    h0 = (h0 & c) | g0 ;
+    h1 = (h1 & c) | g1 ;
+    h2 = (h2 & c) | g2 ;
+
+    // tag = (h + pad) mod 2^128
+
+    uint64_t t0 = s.pad[0] ;
+    uint64_t t1 = s.pad[1] ;
+
+    h0 += (( t0                    ) & 0xfffffffffffULL)     ; c = h0 >> 44 ; h0 &= 0xfffffffffffULL ;
+    h1 += (((t0 >> 44) | (t1 << 20)) & 0xfffffffffffULL) + c ; c = h1 >> 44 ; h1 &= 0xfffffffffffULL ;
+    h2 += (((t1 >> 24)             ) & 0x3ffffffffffULL) + c ;                h2 &= 0x3ffffffffffULL ;
+
+    h0 = ((h0      ) | (h1 << 44)) ;
+    h1 = ((h1 >> 20) | (h2 << 24)) ;
+
+    for(uint32_t i=0;i<8;++i)
+    {
+        tag[i  ] = (h0 >> (8*i)) & 0xff ;
+        tag[i+8] = (h1 >> (8*i)) & 0xff ;
+    }
+}
+
+typedef poly1305_state64 poly1305_fast_state ;
+#else
+typedef poly1305_state   poly1305_fast_state ;
+#endif
+
 void poly1305_tag(uint8_t key[32],uint8_t *message,uint32_t size,uint8_t tag[16])
 {
-    poly1305_state s;
+    poly1305_fast_state s;
 
     poly1305_init  (s,key);
     poly1305_add(s,message,size) ;
@@ -545,7 +901,7 @@ bool AEAD_chacha20_poly1305_rs(uint8_t key[32], uint8_t nonce[12],uint8_t *data,
     {
        chacha20_encrypt_rs(key,1,nonce,data,data_size);
 
-       poly1305_state pls ;
+       poly1305_fast_state pls ;
 
        poly1305_init(pls,session_key);
 
@@ -558,7 +914,7 @@ bool AEAD_chacha20_poly1305_rs(uint8_t key[32], uint8_t nonce[12],uint8_t *data,
     }
     else
     {
-       poly1305_state pls ;
+       poly1305_fast_state pls ;
        uint8_t computed_tag[16];
 
        poly1305_init(pls,session_key);
@@ -849,6 +1205,41 @@ bool perform_tests()
 
     std::cerr << " OK" << std::endl;
 
+    // Multi-block kernels must give the same cipher stream as the block function checked above, whatever the size
+    // and the block counter, including when the counter wraps around.
+
+    std::cerr << "  ChaCha20 multi-block kernels         " ;
+
+    {
+        std::vector<chacha20_blocks_kernel> kernels ;
+        std::vector<std::string> names ;
+        list_chacha20_kernels(kernels,names) ;
+
+        static const uint32_t sizes[] = { 0,1,63,64,65,255,256,257,511,512,513,1000,4096+7 } ;
+        static const uint32_t counters[] = { 0,1,0xfffffffd } ;
+
+        for(uint32_t i=0;i<sizeof(sizes)/sizeof(uint32_t);++i)
+            for(uint32_t j=0;j<sizeof(counters)/sizeof(uint32_t);++j)
+            {
+                std::vector<uint8_t> clear(sizes[i]+1) ;
+                RSRandom::random_bytes(&clear[0],sizes[i]+1) ;
+
+                std::vector<uint8_t> ref(clear) ;
+                chacha20_encrypt_with_kernel(chacha20_blocks_none,key,counters[j],nounce,&ref[0],sizes[i]) ;
+
+                for(uint32_t k=1;k<kernels.size();++k)
+                {
+                    std::vector<uint8_t> cipher(clear) ;
+                    chacha20_encrypt_with_kernel(kernels[k],key,counters[j],nounce,&cipher[0],sizes[i]) ;
+
+                    if(cipher != ref)
+                        return false ;
+                }
+            }
+    }
+
+    std::cerr << " OK" << std::endl;
+
     // operators
 
     { uint256_32 uu(0,0,0,0,0,0,0,0         ) ; ++uu ;  if(!(uu == uint256_32(0,0,0,0,0,0,0,1))) return false ; }
@@ -1195,6 +1586,48 @@ bool perform_tests()
     }
     std::cerr << "  RFC7539 poly1305 test vector #011     OK" << std::endl;
 
+#ifdef POLY1305_64BITS
+    // 64 bits limbs Poly1305 against the one on 256 bits numbers. The first keys and messages are all 0xff, to check
+    // the carries.
+
+    for(uint32_t i=0;i<200;++i)
+    {
+        uint8_t key[32] ;
+        uint32_t size = (i < 8)? 16*i+(i&1) : RSRandom::random_u32() % 300 ;
+        std::vector<uint8_t> msg(size+1) ;
+
+        if(i < 8)
+        {
+            memset(key,0xff,32) ;
+            memset(&msg[0],0xff,size+1) ;
+        }
+        else
+        {
+            RSRandom::random_bytes(key,32) ;
+            RSRandom::random_bytes(&msg[0],size+1) ;
+        }
+
+        poly1305_state s1 ;
+        poly1305_state64 s2 ;
+        uint8_t tag1[16], tag2[16] ;
+
+        poly1305_init(s1,key) ;
+        poly1305_init(s2,key) ;
+
+        poly1305_add(s1,&msg[0],size/2,i & 2) ;
+        poly1305_add(s2,&msg[0],size/2,i & 2) ;
+        poly1305_add(s1,&msg[size/2],size - size/2,i & 1) ;
+        poly1305_add(s2,&msg[size/2],size - size/2,i & 1) ;
+
+        poly1305_finish(s1,tag1) ;
+        poly1305_finish(s2,tag2) ;
+
+        if(!constant_time_memory_compare(tag1,tag2,16)) return false ;
+    }
+
+    std::cerr << "  Poly1305 with 64 bits limbs           OK" << std::endl;
+#endif
+
     // RFC7539 - 2.6.2
     //
     {
@@ -1390,6 +1823,39 @@ bool perform_tests()
 
             std::cerr << "  Chacha20 encryption speed             : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
         }
+        {
+            std::vector<chacha20_blocks_kernel> kernels ;
+            std::vector<std::string> names ;
+            list_chacha20_kernels(kernels,names) ;
+
+            for(uint32_t k=0;k<kernels.size();++k)
+            {
+                RsScopeTimer s("CHACHA20") ;
+                chacha20_encrypt_with_kernel(kernels[k],key, 1, nonce, ten_megabyte_data,SIZE) ;
+
+                std::cerr << "  Chacha20 " << names[k] << " encryption speed      : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+            }
+        }
+        {
+            RsScopeTimer s("POLY1305") ;
+            poly1305_state pls ;
+            poly1305_init(pls,key) ;
+            poly1305_add(pls,ten_megabyte_data,SIZE) ;
+            poly1305_finish(pls,received_tag) ;
+
+            std::cerr << "  Poly1305 256 bits numbers speed       : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+#ifdef POLY1305_64BITS
+        {
+            RsScopeTimer s("POLY1305") ;
+            poly1305_state64 pls ;
+            poly1305_init(pls,key) ;
+            poly1305_add(pls,ten_megabyte_data,SIZE) ;
+            poly1305_finish(pls,received_tag) ;
+
+            std::cerr << "  Poly1305 64 bits limbs speed          : " << SIZE / (1024.0*1024.0) / s.duration() << " MB/s" << std::endl;
+        }
+#endif
         {
             RsScopeTimer s("AEAD2") ;
             AEAD_chacha20_poly1305_rs(key,nonce,ten_megabyte_data,SIZE,aad,12,received_tag,true) ;
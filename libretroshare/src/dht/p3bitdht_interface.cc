@@ -51,7 +51,7 @@ int      p3BitDht::getDhtPeers(int lvl, std::list<RsDhtPeer> &peers)
 {
 	/* this function we can actually implement! */
 	bdBucket int_peers;
-	std::list<bdPeer>::iterator it;
+	std::vector<bdPeer>::const_iterator it;
         mUdpBitDht->getDhtBucket(lvl, int_peers);
 
 	for(it = int_peers.entries.begin(); it != int_peers.entries.end(); ++it)
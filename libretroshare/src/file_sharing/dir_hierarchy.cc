@@ -24,10 +24,13 @@
  */
 #include <sstream>
 #include <algorithm>
+#include <limits.h>
+#include <limits>
 #include <time.h>
 #include "util/rsdir.h"
 #include "util/rsprint.h"
 #include "retroshare/rsexpr.h"
+#include "serialiser/rsbaseserial.h"
 
 #include "dir_hierarchy.h"
 #include "filelist_io.h"
@@ -49,24 +52,274 @@ template<class T> typename std::set<T>::iterator erase_from_set(typename std::se
     return tmp;
 }
 
+/******************************************************************************************************************/
+/*                                                  File name index                                               */
+/******************************************************************************************************************/
+
+void FileNameIndex::splitWords(const std::string& s,std::vector<std::string>& words)
+{
+    words.clear();
+    std::string w ;
+
+    for(uint32_t i=0;i<s.size();++i)
+    {
+        unsigned char c = tolower(static_cast<unsigned char>(s[i])) ;
+
+        if(isalnum(c) || c >= 0x80)	// keep UTF8 multi-byte chars inside words
+            w.push_back(c) ;
+        else if(!w.empty())
+        {
+            words.push_back(w) ;
+            w.clear();
+        }
+    }
+    if(!w.empty())
+        words.push_back(w) ;
+}
+
+uint32_t FileNameIndex::trigram(const std::string& s,uint32_t i)
+{
+    return (uint32_t(static_cast<unsigned char>(s[i])) << 16) | (uint32_t(static_cast<unsigned char>(s[i+1])) << 8) | static_cast<unsigned char>(s[i+2]) ;
+}
+
+void FileNameIndex::addTrigrams(WordMap::const_iterator wit)
+{
+    const std::string& w(wit->first) ;
+
+    for(uint32_t i=0;i+2<w.size();++i)
+    {
+        std::vector<WordMap::const_iterator>& v(mTrigrams[trigram(w,i)]) ;
+
+        if(v.empty() || v.back() != wit)	// the same trigram can appear several times in a word
+            v.push_back(wit) ;
+    }
+}
+
+void FileNameIndex::removeTrigrams(WordMap::const_iterator wit)
+{
+    const std::string& w(wit->first) ;
+
+    for(uint32_t i=0;i+2<w.size();++i)
+    {
+        std::map<uint32_t,std::vector<WordMap::const_iterator> >::iterator it = mTrigrams.find(trigram(w,i)) ;
+
+        if(it == mTrigrams.end())
+            continue ;
+
+        it->second.erase(std::remove(it->second.begin(),it->second.end(),wit),it->second.end()) ;
+
+        if(it->second.empty())
+            mTrigrams.erase(it) ;
+    }
+}
+
+void FileNameIndex::addFile(DirectoryStorage::EntryIndex indx,const std::string& file_name)
+{
+    std::vector<std::string> words ;
+    splitWords(file_name,words) ;
+
+    for(uint32_t i=0;i<words.size();++i)
+    {
+        std::pair<WordMap::iterator,bool> res = mWords.insert(std::make_pair(words[i],std::vector<DirectoryStorage::EntryIndex>())) ;
+
+        if(res.second)
+            addTrigrams(res.first) ;
+
+        std::vector<DirectoryStorage::EntryIndex>& v(res.first->second) ;
+
+        // new files are most of the time appended at the end of mNodes, so the lookup is usually trivial.
+
+        if(v.empty() || v.back() < indx)
+            v.push_back(indx) ;
+        else
+        {
+            std::vector<DirectoryStorage::EntryIndex>::iterator it = std::lower_bound(v.begin(),v.end(),indx) ;
+
+            if(*it != indx)
+                v.insert(it,indx) ;
+        }
+    }
+}
+
+void FileNameIndex::removeFile(DirectoryStorage::EntryIndex indx,const std::string& file_name)
+{
+    std::vector<std::string> words ;
+    splitWords(file_name,words) ;
+
+    for(uint32_t i=0;i<words.size();++i)
+    {
+        std::map<std::string,std::vector<DirectoryStorage::EntryIndex> >::iterator mit = mWords.find(words[i]) ;
+
+        if(mit == mWords.end())
+            continue ;
+
+        std::vector<DirectoryStorage::EntryIndex>::iterator it = std::lower_bound(mit->second.begin(),mit->second.end(),indx) ;
+
+        if(it != mit->second.end() && *it == indx)
+            mit->second.erase(it) ;
+
+        if(mit->second.empty())
+        {
+            removeTrigrams(mit) ;
+            mWords.erase(mit) ;
+        }
+    }
+}
+
+bool FileNameIndex::findCandidates(const std::string& term,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    candidates.clear();
+
+    std::vector<std::string> words ;
+    splitWords(term,words) ;
+
+    if(words.empty())
+        return false ;
+
+    // The term is matched anywhere in the file name, so its first word can be the end of a word of the name, its
+    // last word the beginning of one, and the words in between are whole words of the name:
+    //    - with more than two words, the longest middle word is looked up directly;
+    //    - with two words, the last one is a prefix, which is a range of the sorted map;
+    //    - a single word can be anywhere inside a word of the name. Only the words that have the least frequent
+    //      trigram of the term are checked, or all words when the term is too short to have a trigram.
+
+    typedef WordMap::const_iterator WordIterator ;
+
+    if(words.size() > 2)
+    {
+        uint32_t longest = 1 ;
+
+        for(uint32_t i=2;i+1<words.size();++i)
+            if(words[i].size() > words[longest].size())
+                longest = i ;
+
+        WordIterator it = mWords.find(words[longest]) ;
+
+        if(it != mWords.end())
+            candidates = it->second ;
+
+        return true ;
+    }
+
+    if(words.size() == 2)
+    {
+        const std::string& w(words[1]) ;
+
+        for(WordIterator it(mWords.lower_bound(w));it!=mWords.end() && it->first.compare(0,w.size(),w) == 0;++it)
+            candidates.insert(candidates.end(),it->second.begin(),it->second.end()) ;
+    }
+    else if(words[0].size() >= 3)
+    {
+        const std::string& w(words[0]) ;
+        const std::vector<WordIterator> *best = NULL ;
+
+        for(uint32_t i=0;i+2<w.size();++i)
+        {
+            std::map<uint32_t,std::vector<WordIterator> >::const_iterator it = mTrigrams.find(trigram(w,i)) ;
+
+            if(it == mTrigrams.end())
+                return true ;	// no word has this trigram, so no word contains the term
+
+            if(best == NULL || it->second.size() < best->size())
+                best = &it->second ;
+        }
+
+        for(uint32_t i=0;i<best->size();++i)
+            if((*best)[i]->first.find(w) != std::string::npos)
+                candidates.insert(candidates.end(),(*best)[i]->second.begin(),(*best)[i]->second.end()) ;
+    }
+    else
+        for(WordIterator it(mWords.begin());it!=mWords.end();++it)
+            if(it->first.find(words[0]) != std::string::npos)
+                candidates.insert(candidates.end(),it->second.begin(),it->second.end()) ;
+
+    std::sort(candidates.begin(),candidates.end()) ;
+    candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end()) ;
+
+    return true ;
+}
+
+bool FileNameIndex::serialise(unsigned char *& data,uint32_t& size) const
+{
+    size = 4 ;
+
+    for(std::map<std::string,std::vector<DirectoryStorage::EntryIndex> >::const_iterator it(mWords.begin());it!=mWords.end();++it)
+        size += getRawStringSize(it->first) + 4 + 4*it->second.size() ;
+
+    data = (unsigned char*)rs_malloc(size) ;
+
+    if(!data)
+        return false ;
+
+    uint32_t offset = 0 ;
+    bool ok = setRawUInt32(data,size,&offset,(uint32_t)mWords.size()) ;
+
+    for(std::map<std::string,std::vector<DirectoryStorage::EntryIndex> >::const_iterator it(mWords.begin());ok && it!=mWords.end();++it)
+    {
+        ok = ok && setRawString(data,size,&offset,it->first) ;
+        ok = ok && setRawUInt32(data,size,&offset,(uint32_t)it->second.size()) ;
+
+        for(uint32_t i=0;ok && i<it->second.size();++i)
+            ok = ok && setRawUInt32(data,size,&offset,(uint32_t)it->second[i]) ;
+    }
+
+    if(!ok)
+    {
+        free(data) ;
+        data = NULL ;
+    }
+    return ok ;
+}
+
+bool FileNameIndex::deserialise(const unsigned char *data,uint32_t size)
+{
+    clear();
+
+    uint32_t offset = 0 ;
+    uint32_t n_words = 0 ;
+    void *buf = const_cast<unsigned char*>(data) ;
+
+    if(!getRawUInt32(buf,size,&offset,&n_words))
+        return false ;
+
+    for(uint32_t i=0;i<n_words;++i)
+    {
+        std::string w ;
+        uint32_t n = 0 ;
+
+        if(!getRawString(buf,size,&offset,w) || !getRawUInt32(buf,size,&offset,&n) || n > (size - offset)/4)
+        {
+            clear();
+            return false ;
+        }
+
+        std::pair<WordMap::iterator,bool> res = mWords.insert(std::make_pair(w,std::vector<DirectoryStorage::EntryIndex>())) ;
+
+        if(res.second)
+            addTrigrams(res.first) ;
+
+        std::vector<DirectoryStorage::EntryIndex>& v(res.first->second) ;
+        v.resize(n) ;
+
+        for(uint32_t j=0;j<n;++j)
+        {
+            uint32_t indx = 0 ;
+            getRawUInt32(buf,size,&offset,&indx) ;
+            v[j] = indx ;
+        }
+    }
+    return true ;
+}
+
+/******************************************************************************************************************/
+
 // This class handles the file hierarchy
 // A Mutex is used to ensure total coherence at this level. So only abstracted operations are allowed,
 // so that the hierarchy stays completely coherent between calls.
 
 InternalFileHierarchyStorage::InternalFileHierarchyStorage() : mRoot(0)
 {
-    DirEntry *de = new DirEntry("") ;
-
-    de->row=0;
-    de->parent_index=0;
-    de->dir_modtime=0;
-    de->dir_hash=RsFileHash() ; // null hash is root by convention.
-
-    mNodes.push_back(de) ;
-    mDirHashes[de->dir_hash] = 0 ;
-
-    mTotalSize = 0 ;
-    mTotalFiles = 0 ;
+    clearNodes() ;
 }
 
 bool InternalFileHierarchyStorage::getDirHashFromIndex(const DirectoryStorage::EntryIndex& index,RsFileHash& hash) const
@@ -288,6 +541,8 @@ bool InternalFileHierarchyStorage::updateSubFilesList(const DirectoryStorage::En
     if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
         return false;
 
+    mSortedColumnsUpToDate = false ;
+
     DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
     new_files = subfiles ;
 
@@ -336,6 +591,8 @@ bool InternalFileHierarchyStorage::updateSubFilesList(const DirectoryStorage::En
         mNodes.back()->row = mNodes.size()-1;
         mNodes.back()->parent_index = indx;
 
+        mNameIndex.addFile(mNodes.size()-1,it->first) ;
+
         mTotalSize  += it->second.size;
         mTotalFiles += 1;
     }
@@ -376,6 +633,13 @@ bool InternalFileHierarchyStorage::updateFile(const DirectoryStorage::EntryIndex
 		mTotalSize -= fe.file_size;
 
 	mTotalSize += size ;
+    mSortedColumnsUpToDate = false ;
+
+    if(fe.file_name != fname)
+    {
+        mNameIndex.removeFile(file_index,fe.file_name) ;
+        mNameIndex.addFile(file_index,fname) ;
+    }
 
     fe.file_hash = hash;
     fe.file_size = size;
@@ -400,11 +664,39 @@ void InternalFileHierarchyStorage::deleteFileNode(uint32_t index)
         if(mTotalFiles > 0)
 			mTotalFiles -= 1;
 
+		mNameIndex.removeFile(index,fe.file_name) ;
+		mSortedColumnsUpToDate = false ;
+
 		delete mNodes[index] ;
 		mFreeNodes.push_back(index) ;
 		mNodes[index] = NULL ;
 	}
 }
+void InternalFileHierarchyStorage::clearNodes()
+{
+    for(uint32_t i=0;i<mNodes.size();++i)
+        delete mNodes[i] ;
+
+    mNodes.clear() ;
+    mFreeNodes.clear() ;
+    mFileHashes.clear() ;
+    mDirHashes.clear() ;
+    mNameIndex.clear() ;
+
+    DirEntry *de = new DirEntry("") ;
+
+    de->row=0;
+    de->parent_index=0;
+    de->dir_modtime=0;
+    de->dir_hash=RsFileHash() ; // null hash is root by convention.
+
+    mNodes.push_back(de) ;
+    mDirHashes[de->dir_hash] = 0 ;
+
+    mTotalSize = 0 ;
+    mTotalFiles = 0 ;
+    mSortedColumnsUpToDate = false ;
+}
 void InternalFileHierarchyStorage::deleteNode(uint32_t index)
 {
     if(mNodes[index] != NULL)
@@ -430,24 +722,10 @@ DirectoryStorage::EntryIndex InternalFileHierarchyStorage::allocateNewIndex()
 	return mNodes.size()-1 ;
 }
 
-bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryIndex& indx,const std::string& dir_name,time_t most_recent_time,time_t dir_modtime,const std::vector<RsFileHash>& subdirs_hash,const std::vector<FileEntry>& subfiles_array)
+void InternalFileHierarchyStorage::updateSubDirectories(const DirectoryStorage::EntryIndex& indx,const std::vector<RsFileHash>& subdirs_hash)
 {
-    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
-    {
-        std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
-        return false;
-    }
     DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
 
-#ifdef DEBUG_DIRECTORY_STORAGE
-    std::cerr << "Updating dir entry: name=\"" << dir_name << "\", most_recent_time=" << most_recent_time << ", modtime=" << dir_modtime << std::endl;
-#endif
-
-    d.dir_most_recent_time = most_recent_time;
-    d.dir_modtime      = dir_modtime;
-    d.dir_update_time  = time(NULL);
-    d.dir_name         = dir_name;
-
     std::map<RsFileHash,DirectoryStorage::EntryIndex> existing_subdirs ;
 
     for(uint32_t i=0;i<d.subdirs.size();++i)
@@ -483,7 +761,7 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 
             mNodes[dir_index] = de ;
 
-			de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, dir_name) ;
+			de->dir_parent_path = RsDirUtil::makePath(d.dir_parent_path, d.dir_name) ;
             de->dir_hash        = subdirs_hash[i];
 
             mDirHashes[subdirs_hash[i]] = dir_index ;
@@ -511,6 +789,27 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         }
         recursRemoveDirectory(it->second) ;
     }
+}
+
+bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryIndex& indx,const std::string& dir_name,time_t most_recent_time,time_t dir_modtime,const std::vector<RsFileHash>& subdirs_hash,const std::vector<FileEntry>& subfiles_array)
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
+    {
+        std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
+        return false;
+    }
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
+
+#ifdef DEBUG_DIRECTORY_STORAGE
+    std::cerr << "Updating dir entry: name=\"" << dir_name << "\", most_recent_time=" << most_recent_time << ", modtime=" << dir_modtime << std::endl;
+#endif
+
+    d.dir_most_recent_time = most_recent_time;
+    d.dir_modtime      = dir_modtime;
+    d.dir_update_time  = time(NULL);
+    d.dir_name         = dir_name;
+
+    updateSubDirectories(indx,subdirs_hash) ;
 
     // now update subfiles. This is more stricky because we need to not suppress hash duplicates
 
@@ -550,6 +849,8 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
 
             mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
             mFileHashes[f.file_hash] = file_index ;
+            mNameIndex.addFile(file_index,f.file_name) ;
+            mSortedColumnsUpToDate = false ;
             mTotalSize += f.file_size ;
             mTotalFiles++;
 
@@ -576,63 +877,201 @@ bool InternalFileHierarchyStorage::updateDirEntry(const DirectoryStorage::EntryI
         deleteFileNode(it->second) ;
     }
 
-    // now update row and parent index for all subnodes
-
-    uint32_t n=0;
     for(uint32_t i=0;i<d.subdirs.size();++i)
-    {
         static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_update_time = 0 ;	// force the update of the subdir.
 
-        mNodes[d.subdirs[i]]->parent_index = indx ;
-        mNodes[d.subdirs[i]]->row = n++ ;
-    }
-    for(uint32_t i=0;i<d.subfiles.size();++i)
-    {
-        mNodes[d.subfiles[i]]->parent_index = indx ;
-        mNodes[d.subfiles[i]]->row = n++ ;
-    }
-
+    updateSubNodeRows(indx) ;
 
     return true;
 }
 
-void InternalFileHierarchyStorage::getStatistics(SharedDirStats& stats) const
-{
-    stats.total_number_of_files = mTotalFiles ;
-    stats.total_shared_size = mTotalSize ;
-}
+// Streamed update of a directory. The directory info and its subdirs come first, then the subfiles by batches. Subfiles that
+// are created or updated are visible right away, while the ones that are not in the directory anymore are removed at the end.
+// Subfiles with a null hash are the ones the sender considers unchanged: we must already have them, with the same TS.
 
-bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& index,time_t& TS,time_t DirEntry::* m) const
+bool InternalFileHierarchyStorage::beginDirEntryUpdate(const DirectoryStorage::EntryIndex& indx,const std::string& dir_name,time_t most_recent_time,time_t dir_modtime,const std::vector<RsFileHash>& subdirs_hash,std::map<std::string,DirectoryStorage::EntryIndex>& subfiles,std::set<DirectoryStorage::EntryIndex>& received)
 {
-    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
+    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
     {
-        std::cerr << "[directory storage] (EE) cannot get TS for index " << index << ". Not a valid index or not a directory." << std::endl;
+        std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
         return false;
     }
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
+#ifdef DEBUG_DIRECTORY_STORAGE
+    std::cerr << "Starting update of dir entry: name=\"" << dir_name << "\", most_recent_time=" << most_recent_time << ", modtime=" << dir_modtime << std::endl;
+#endif
 
-    TS = d.*m ;
+    d.dir_most_recent_time = most_recent_time;
+    d.dir_modtime      = dir_modtime;
+    d.dir_update_time  = time(NULL);
+    d.dir_name         = dir_name;
+
+    updateSubDirectories(indx,subdirs_hash) ;
+
+    for(uint32_t i=0;i<d.subdirs.size();++i)
+        static_cast<DirEntry*>(mNodes[d.subdirs[i]])->dir_update_time = 0 ;	// force the update of the subdir.
+
+    updateSubNodeRows(indx) ;
+
+    subfiles.clear() ;
+    received.clear() ;
+
+    for(uint32_t i=0;i<d.subfiles.size();++i)
+        subfiles[static_cast<FileEntry*>(mNodes[d.subfiles[i]])->file_name] = d.subfiles[i] ;
 
     return true;
 }
 
-bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& index,time_t& TS,time_t DirEntry::* m)
+bool InternalFileHierarchyStorage::addDirEntryFiles(const DirectoryStorage::EntryIndex& indx,const std::vector<FileEntry>& subfiles_array,std::map<std::string,DirectoryStorage::EntryIndex>& subfiles,std::set<DirectoryStorage::EntryIndex>& received)
 {
-    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
+    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
     {
-        std::cerr << "[directory storage] (EE) cannot get TS for index " << index << ". Not a valid index or not a directory." << std::endl;
+        std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
         return false;
     }
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
 
-    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
-
-    d.*m = TS;
+    for(uint32_t i=0;i<subfiles_array.size();++i)
+    {
+        const FileEntry& f(subfiles_array[i]) ;
+        std::map<std::string,DirectoryStorage::EntryIndex>::iterator it = subfiles.find(f.file_name) ;
 
-    return true;
-}
+        bool known = it != subfiles.end() && checkIndex(it->second,FileStorageNode::TYPE_FILE) && mNodes[it->second]->parent_index == indx ;
 
-// Do a complete recursive sweep over sub-directories and files, and update the lst modf TS. This could be also performed by a cleanup method.
+        if(f.file_hash.isNull())
+        {
+            if(!known || static_cast<FileEntry*>(mNodes[it->second])->file_modtime != f.file_modtime)
+            {
+                std::cerr << "[directory storage] (WW) file \"" << f.file_name << "\" is supposed to be unchanged, but it is unknown or has a different TS." << std::endl;
+                return false ;
+            }
+            received.insert(it->second) ;
+        }
+        else if(known)
+        {
+            if(!updateFile(it->second,f.file_hash,f.file_name,f.file_size,f.file_modtime))
+                return false ;
+
+            received.insert(it->second) ;
+        }
+        else
+        {
+            DirectoryStorage::EntryIndex file_index = allocateNewIndex() ;
+
+            mNodes[file_index] = new FileEntry(f.file_name,f.file_size,f.file_modtime,f.file_hash) ;
+            mFileHashes[f.file_hash] = file_index ;
+            mNameIndex.addFile(file_index,f.file_name) ;
+            mSortedColumnsUpToDate = false ;
+            mTotalSize += f.file_size ;
+            mTotalFiles++;
+
+            mNodes[file_index]->parent_index = indx ;
+            mNodes[file_index]->row = d.subdirs.size() + d.subfiles.size() ;
+
+            d.subfiles.push_back(file_index) ;
+            subfiles[f.file_name] = file_index ;
+            received.insert(file_index) ;
+
+#ifdef DEBUG_DIRECTORY_STORAGE
+            std::cerr << "  subfile name = " << f.file_name << ": created, at new index " << file_index << std::endl;
+#endif
+        }
+    }
+    return true ;
+}
+
+bool InternalFileHierarchyStorage::endDirEntryUpdate(const DirectoryStorage::EntryIndex& indx,std::map<std::string,DirectoryStorage::EntryIndex>& subfiles,std::set<DirectoryStorage::EntryIndex>& received)
+{
+    if(!checkIndex(indx,FileStorageNode::TYPE_DIR))
+    {
+        std::cerr << "[directory storage] (EE) cannot update dir at index " << indx << ". Not a valid index, or not an existing dir." << std::endl;
+        return false;
+    }
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
+
+    // remove subfiles that do not exist anymore
+
+    std::vector<DirectoryStorage::EntryIndex> kept_subfiles ;
+
+    for(uint32_t i=0;i<d.subfiles.size();++i)
+        if(received.find(d.subfiles[i]) != received.end())
+            kept_subfiles.push_back(d.subfiles[i]) ;
+        else
+        {
+#ifdef DEBUG_DIRECTORY_STORAGE
+            std::cerr << "  removing existing subfile that is not in the dirctory anymore: index=" << d.subfiles[i] << std::endl;
+#endif
+            deleteFileNode(d.subfiles[i]) ;
+        }
+
+    d.subfiles.swap(kept_subfiles) ;
+    d.dir_update_time = time(NULL);
+
+    updateSubNodeRows(indx) ;
+
+    subfiles.clear() ;
+    received.clear() ;
+
+    return true;
+}
+
+void InternalFileHierarchyStorage::updateSubNodeRows(const DirectoryStorage::EntryIndex& indx)
+{
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[indx])) ;
+
+    // update row and parent index for all subnodes
+
+    uint32_t n=0;
+    for(uint32_t i=0;i<d.subdirs.size();++i)
+    {
+        mNodes[d.subdirs[i]]->parent_index = indx ;
+        mNodes[d.subdirs[i]]->row = n++ ;
+    }
+    for(uint32_t i=0;i<d.subfiles.size();++i)
+    {
+        mNodes[d.subfiles[i]]->parent_index = indx ;
+        mNodes[d.subfiles[i]]->row = n++ ;
+    }
+}
+
+void InternalFileHierarchyStorage::getStatistics(SharedDirStats& stats) const
+{
+    stats.total_number_of_files = mTotalFiles ;
+    stats.total_shared_size = mTotalSize ;
+}
+
+bool InternalFileHierarchyStorage::getTS(const DirectoryStorage::EntryIndex& index,time_t& TS,time_t DirEntry::* m) const
+{
+    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
+    {
+        std::cerr << "[directory storage] (EE) cannot get TS for index " << index << ". Not a valid index or not a directory." << std::endl;
+        return false;
+    }
+
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
+
+    TS = d.*m ;
+
+    return true;
+}
+
+bool InternalFileHierarchyStorage::setTS(const DirectoryStorage::EntryIndex& index,time_t& TS,time_t DirEntry::* m)
+{
+    if(!checkIndex(index,FileStorageNode::TYPE_DIR))
+    {
+        std::cerr << "[directory storage] (EE) cannot get TS for index " << index << ". Not a valid index or not a directory." << std::endl;
+        return false;
+    }
+
+    DirEntry& d(*static_cast<DirEntry*>(mNodes[index])) ;
+
+    d.*m = TS;
+
+    return true;
+}
+
+// Do a complete recursive sweep over sub-directories and files, and update the lst modf TS. This could be also performed by a cleanup method.
 
 time_t InternalFileHierarchyStorage::recursUpdateLastModfTime(const DirectoryStorage::EntryIndex& dir_index,bool& unfinished_files_present)
 {
@@ -744,8 +1183,271 @@ private:
     const InternalFileHierarchyStorage::DirEntry& mDe ;
 };
 
+// Only one file per hash is reported, which is the one referenced in mFileHashes.
+
+bool InternalFileHierarchyStorage::isSearchable(DirectoryStorage::EntryIndex indx) const
+{
+    if(indx >= mNodes.size() || mNodes[indx] == NULL || mNodes[indx]->type() != FileStorageNode::TYPE_FILE)
+        return false ;
+
+    std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it = mFileHashes.find(static_cast<const FileEntry*>(mNodes[indx])->file_hash) ;
+
+    return it != mFileHashes.end() && it->second == indx ;
+}
+
+bool InternalFileHierarchyStorage::findTermsCandidates(const std::list<std::string>& terms,bool all_terms,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    bool restricted = false ;
+    candidates.clear();
+
+    for(std::list<std::string>::const_iterator it(terms.begin());it!=terms.end();++it)
+    {
+        std::vector<DirectoryStorage::EntryIndex> c ;
+
+        if(!mNameIndex.findCandidates(*it,c))
+        {
+            if(all_terms)
+                continue ;	// this term does not restrict anything, but the others do.
+            else
+                return false ;
+        }
+
+        if(!restricted)
+            candidates.swap(c) ;
+        else
+        {
+            std::vector<DirectoryStorage::EntryIndex> tmp ;
+
+            if(all_terms)
+                std::set_intersection(candidates.begin(),candidates.end(),c.begin(),c.end(),std::back_inserter(tmp)) ;
+            else
+                std::set_union(candidates.begin(),candidates.end(),c.begin(),c.end(),std::back_inserter(tmp)) ;
+
+            candidates.swap(tmp) ;
+        }
+        restricted = true ;
+    }
+    return restricted ;
+}
+
+void InternalFileHierarchyStorage::updateSortedColumns() const
+{
+    if(mSortedColumnsUpToDate)
+        return ;
+
+    mSizeColumn.clear();
+    mModTimeColumn.clear();
+
+    for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
+        if(isSearchable(it->second))
+        {
+            const FileEntry *fe = static_cast<const FileEntry*>(mNodes[it->second]) ;
+
+            mSizeColumn.push_back(std::make_pair(fe->file_size,it->second)) ;
+            mModTimeColumn.push_back(std::make_pair((int64_t)fe->file_modtime,it->second)) ;
+        }
+
+    std::sort(mSizeColumn.begin(),mSizeColumn.end()) ;
+    std::sort(mModTimeColumn.begin(),mModTimeColumn.end()) ;
+
+    mSortedColumnsUpToDate = true ;
+}
+
+static const uint32_t SMALL_CANDIDATE_SET_SIZE = 64 ;
+
+// Appends to candidates the files whose key is in [min_key,max_key].
+
+template<class T> static void selectColumnRange(const std::vector<std::pair<T,DirectoryStorage::EntryIndex> >& column,T min_key,T max_key,std::vector<DirectoryStorage::EntryIndex>& candidates)
+{
+    if(min_key > max_key)
+        return ;
+
+    typename std::vector<std::pair<T,DirectoryStorage::EntryIndex> >::const_iterator it = std::lower_bound(column.begin(),column.end(),std::make_pair(min_key,DirectoryStorage::EntryIndex(0))) ;
+
+    for(;it!=column.end() && it->first <= max_key;++it)
+        candidates.push_back(it->second) ;
+}
+
+// Size and date expressions compare an int with the file attribute truncated to an int. Files whose attribute does
+// not fit in an int are therefore always added to the candidates, since the planner cannot predict the result.
+
+void InternalFileHierarchyStorage::findSizeCandidates(int64_t min_size,int64_t max_size,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    if(max_size >= 0)
+        selectColumnRange<uint64_t>(mSizeColumn,std::max(min_size,(int64_t)0),max_size,candidates) ;
+
+    selectColumnRange<uint64_t>(mSizeColumn,(uint64_t)INT_MAX+1,std::numeric_limits<uint64_t>::max(),candidates) ;
+}
+
+void InternalFileHierarchyStorage::findModTimeCandidates(int64_t min_time,int64_t max_time,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    selectColumnRange<int64_t>(mModTimeColumn,min_time,max_time,candidates) ;
+    selectColumnRange<int64_t>(mModTimeColumn,std::numeric_limits<int64_t>::min(),(int64_t)INT_MIN-1,candidates) ;
+    selectColumnRange<int64_t>(mModTimeColumn,(int64_t)INT_MAX+1,std::numeric_limits<int64_t>::max(),candidates) ;
+}
+
+// Converts a relational expression into the range of values it accepts. Note that RelExpression::evalRel() compares
+// the reference value to the file value, so that e.g. "Greater" means file value < reference value.
+
+static void relExpressionRange(const RsRegularExpression::RelExpression<int> *exp,int64_t& min_value,int64_t& max_value)
+{
+    min_value = INT_MIN ;
+    max_value = INT_MAX ;
+
+    switch(exp->relOperator())
+    {
+    case RsRegularExpression::Equals:        min_value = max_value = exp->lowerValue() ; break ;
+    case RsRegularExpression::GreaterEquals: max_value = exp->lowerValue() ; break ;
+    case RsRegularExpression::Greater:       max_value = (int64_t)exp->lowerValue() - 1 ; break ;
+    case RsRegularExpression::SmallerEquals: min_value = exp->lowerValue() ; break ;
+    case RsRegularExpression::Smaller:       min_value = (int64_t)exp->lowerValue() + 1 ; break ;
+    case RsRegularExpression::InRange:       min_value = exp->lowerValue() ;
+                                             max_value = exp->higherValue() ; break ;
+    default:
+        min_value = 1 ;	// unknown operators never match
+        max_value = 0 ;
+    }
+}
+
+bool InternalFileHierarchyStorage::findExpressionCandidates(const RsRegularExpression::Expression *exp,std::vector<DirectoryStorage::EntryIndex>& candidates) const
+{
+    // Name and extension clauses are restricted using the name index: the extension is a part of the name, so a
+    // name that contains the extension terms is a super-set of the result.
+
+    if(dynamic_cast<const RsRegularExpression::NameExpression*>(exp) != NULL || dynamic_cast<const RsRegularExpression::ExtExpression*>(exp) != NULL)
+    {
+        const RsRegularExpression::StringExpression *sexp = static_cast<const RsRegularExpression::StringExpression*>(exp) ;
+
+        return findTermsCandidates(sexp->stringTerms(),sexp->stringOperator() == RsRegularExpression::ContainsAllStrings,candidates) ;
+    }
+
+    // Hash equality is a direct lookup. Hash sub-strings cannot be restricted.
+
+    const RsRegularExpression::HashExpression *hexp = dynamic_cast<const RsRegularExpression::HashExpression*>(exp) ;
+
+    if(hexp != NULL)
+    {
+        if(hexp->stringOperator() != RsRegularExpression::EqualsString)
+            return false ;
+
+        candidates.clear();
+
+        for(std::list<std::string>::const_iterator it(hexp->stringTerms().begin());it!=hexp->stringTerms().end();++it)
+        {
+            std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator hit = mFileHashes.find(RsFileHash(*it)) ;
+
+            if(hit != mFileHashes.end())
+                candidates.push_back(hit->second) ;
+        }
+        std::sort(candidates.begin(),candidates.end()) ;
+        candidates.erase(std::unique(candidates.begin(),candidates.end()),candidates.end()) ;
+        return true ;
+    }
+
+    // Size and date clauses select a range in the sorted columns.
+
+    const RsRegularExpression::SizeExpression *szexp = dynamic_cast<const RsRegularExpression::SizeExpression*>(exp) ;
+    const RsRegularExpression::SizeExpressionMB *mbexp = dynamic_cast<const RsRegularExpression::SizeExpressionMB*>(exp) ;
+    const RsRegularExpression::DateExpression *dtexp = dynamic_cast<const RsRegularExpression::DateExpression*>(exp) ;
+
+    if(szexp != NULL || mbexp != NULL || dtexp != NULL)
+    {
+        static const int64_t MB = 1024*1024 ;
+        int64_t min_value,max_value ;
+
+        updateSortedColumns() ;
+        candidates.clear();
+
+        if(szexp != NULL)
+        {
+            relExpressionRange(szexp,min_value,max_value) ;
+            findSizeCandidates(min_value,max_value,candidates) ;
+        }
+        else if(mbexp != NULL)
+        {
+            relExpressionRange(mbexp,min_value,max_value) ;
+
+            if(max_value >= 0)
+                selectColumnRange<uint64_t>(mSizeColumn,std::max(min_value,(int64_t)0)*MB,(max_value+1)*MB-1,candidates) ;
+
+            selectColumnRange<uint64_t>(mSizeColumn,((uint64_t)INT_MAX+1)*MB,std::numeric_limits<uint64_t>::max(),candidates) ;
+        }
+        else
+        {
+            relExpressionRange(dtexp,min_value,max_value) ;
+            findModTimeCandidates(min_value,max_value,candidates) ;
+        }
+
+        std::sort(candidates.begin(),candidates.end()) ;
+        return true ;
+    }
+
+    const RsRegularExpression::CompoundExpression *cexp = dynamic_cast<const RsRegularExpression::CompoundExpression*>(exp) ;
+
+    if(cexp == NULL || cexp->leftExpression() == NULL || cexp->rightExpression() == NULL)
+        return false ;
+
+    std::vector<DirectoryStorage::EntryIndex> lc,rc ;
+
+    bool lres = findExpressionCandidates(cexp->leftExpression(),lc) ;
+
+    // When one side of an AND already leaves only a few files, checking them directly is cheaper than restricting the
+    // other side too.
+
+    if(cexp->logicalOperator() == RsRegularExpression::AndOp && lres && lc.size() <= SMALL_CANDIDATE_SET_SIZE)
+    {
+        candidates.swap(lc) ;
+        return true ;
+    }
+
+    bool rres = findExpressionCandidates(cexp->rightExpression(),rc) ;
+
+    candidates.clear();
+
+    switch(cexp->logicalOperator())
+    {
+    case RsRegularExpression::AndOp:
+        if(lres && rres)
+            std::set_intersection(lc.begin(),lc.end(),rc.begin(),rc.end(),std::back_inserter(candidates)) ;
+        else if(lres)
+            candidates.swap(lc) ;
+        else if(rres)
+            candidates.swap(rc) ;
+
+        return lres || rres ;
+
+    case RsRegularExpression::OrOp:
+    case RsRegularExpression::XorOp:
+        if(!lres || !rres)
+            return false ;
+
+        std::set_union(lc.begin(),lc.end(),rc.begin(),rc.end(),std::back_inserter(candidates)) ;
+        return true ;
+
+    default:
+        return false ;
+    }
+}
+
 int InternalFileHierarchyStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<DirectoryStorage::EntryIndex> &results) const
 {
+    std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+    if(findExpressionCandidates(exp,candidates))
+    {
+#ifdef DEBUG_DIRECTORY_STORAGE
+        std::cerr << "[directory storage] searchBoolExp(): name index gives " << candidates.size() << " candidates out of " << mTotalFiles << " files." << std::endl;
+#endif
+        for(uint32_t i=0;i<candidates.size();++i)
+            if(isSearchable(candidates[i]) && exp->eval(
+                        DirectoryStorageExprFileEntry(*static_cast<const FileEntry*>(mNodes[candidates[i]]),
+                                                      *static_cast<const DirEntry*>(mNodes[mNodes[candidates[i]]->parent_index])
+                                                      )))
+                results.push_back(candidates[i]);
+
+        return 0;
+    }
+
     for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
         if(mNodes[it->second] != NULL && exp->eval(
                     DirectoryStorageExprFileEntry(*static_cast<const FileEntry*>(mNodes[it->second]),
@@ -756,28 +1458,42 @@ int InternalFileHierarchyStorage::searchBoolExp(RsRegularExpression::Expression
     return 0;
 }
 
+static bool fileNameContainsAnyTerm(const std::string& str1,const std::list<std::string>& terms)
+{
+    for(std::list<std::string>::const_iterator iter(terms.begin()); iter != terms.end(); ++iter)
+    {
+        /* always ignore case */
+        const std::string &str2 = (*iter);
+
+        if(str1.end() != std::search( str1.begin(), str1.end(), str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
+            return true ;
+    }
+    return false ;
+}
+
 int InternalFileHierarchyStorage::searchTerms(const std::list<std::string>& terms, std::list<DirectoryStorage::EntryIndex> &results) const
 {
+    // Use the name index to only check files that have a word containing the terms. Terms that have no word at all
+    // (e.g. only made of separators) need a complete scan.
+
+    std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+    if(findTermsCandidates(terms,false,candidates))
+    {
+        for(uint32_t i=0;i<candidates.size();++i)
+            if(isSearchable(candidates[i]) && fileNameContainsAnyTerm(static_cast<const FileEntry*>(mNodes[candidates[i]])->file_name,terms))
+                results.push_back(candidates[i]);
+
+        return 0 ;
+    }
+
     // most entries are likely to be files, so we could do a linear search over the entries tab.
     // instead we go through the table of hashes.
 
     for(std::map<RsFileHash,DirectoryStorage::EntryIndex>::const_iterator it(mFileHashes.begin());it!=mFileHashes.end();++it)
-        if(mNodes[it->second] != NULL)
-        {
-            const std::string &str1 = static_cast<FileEntry*>(mNodes[it->second])->file_name;
-
-            for(std::list<std::string>::const_iterator iter(terms.begin()); iter != terms.end(); ++iter)
-            {
-                /* always ignore case */
-                const std::string &str2 = (*iter);
+        if(mNodes[it->second] != NULL && fileNameContainsAnyTerm(static_cast<FileEntry*>(mNodes[it->second])->file_name,terms))
+            results.push_back(it->second);
 
-                if(str1.end() != std::search( str1.begin(), str1.end(), str2.begin(), str2.end(), RsRegularExpression::CompareCharIC() ))
-                {
-                    results.push_back(it->second);
-                    break;
-                }
-            }
-        }
     return 0 ;
 }
 
@@ -954,78 +1670,361 @@ bool InternalFileHierarchyStorage::recursRemoveDirectory(DirectoryStorage::Entry
     return true ;
 }
 
-bool InternalFileHierarchyStorage::save(const std::string& fname)
+// Node columns. All integers are stored in network order:
+//
+//	n_nodes, n_strings, n_files, n_dirs		4 bytes each
+//	string sizes							4 bytes x n_strings, followed by the strings themselves
+//	node type								1 byte  x n_nodes (0 for empty slots)
+//	node parent index, row, name id			4 bytes x n_nodes each
+//	file size, modif time, hash				8, 4 and 20 bytes x n_files, in the order of the nodes
+//	dir parent path id, modif time, update time, recurs modif time, number of subdirs, number of subfiles
+//											4 bytes x n_dirs each
+//	dir hash								20 bytes x n_dirs
+//	dir children							4 bytes per subdir and subfile, for each dir in the order of the nodes
+//
+// File names, dir names and dir parent paths are stored once in the string table. All the parent paths of files in a
+// same directory are the same, for instance.
+
+static uint32_t internString(const std::string& s,std::map<std::string,uint32_t>& ids,std::vector<const std::string*>& strings,uint32_t& strings_size)
+{
+    std::map<std::string,uint32_t>::iterator it = ids.find(s) ;
+
+    if(it != ids.end())
+        return it->second ;
+
+    it = ids.insert(std::make_pair(s,(uint32_t)strings.size())).first ;
+    strings.push_back(&it->first) ;
+    strings_size += s.length() ;
+
+    return it->second ;
+}
+
+bool InternalFileHierarchyStorage::writeNodeColumns(unsigned char *& data,uint32_t& size) const
 {
+    std::map<std::string,uint32_t> string_ids ;
+    std::vector<const std::string*> strings ;
+    std::vector<uint32_t> name_ids(mNodes.size(),0) ;
+    std::vector<uint32_t> path_ids ;
+
+    uint32_t n_files = 0, n_dirs = 0, n_children = 0, strings_size = 0 ;
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+        {
+            name_ids[i] = internString(static_cast<const FileEntry*>(mNodes[i])->file_name,string_ids,strings,strings_size) ;
+            ++n_files ;
+        }
+        else if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+        {
+            const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
+
+            name_ids[i] = internString(de.dir_name,string_ids,strings,strings_size) ;
+            path_ids.push_back(internString(de.dir_parent_path,string_ids,strings,strings_size)) ;
+            n_children += de.subdirs.size() + de.subfiles.size() ;
+            ++n_dirs ;
+        }
+
+    size = 16 + 4*strings.size() + strings_size + 13*mNodes.size() + 32*n_files + 44*n_dirs + 4*n_children ;
+    data = (unsigned char*)rs_malloc(size) ;
+
+    if(!data)
+        return false ;
+
+    uint32_t offset = 0 ;
+
+    bool ok = setRawUInt32(data,size,&offset,(uint32_t)mNodes.size())
+           && setRawUInt32(data,size,&offset,(uint32_t)strings.size())
+           && setRawUInt32(data,size,&offset,n_files)
+           && setRawUInt32(data,size,&offset,n_dirs) ;
+
+    for(uint32_t i=0;ok && i<strings.size();++i)
+        ok = setRawUInt32(data,size,&offset,(uint32_t)strings[i]->length()) ;
+
+    for(uint32_t i=0;ok && i<strings.size();++i)
+    {
+        memcpy(&data[offset],strings[i]->c_str(),strings[i]->length()) ;
+        offset += strings[i]->length() ;
+    }
+
+    for(uint32_t i=0;ok && i<mNodes.size();++i) ok = setRawUInt8 (data,size,&offset,(uint8_t)(mNodes[i]?mNodes[i]->type():FileStorageNode::TYPE_UNKNOWN)) ;
+    for(uint32_t i=0;ok && i<mNodes.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)(mNodes[i]?mNodes[i]->parent_index:0)) ;
+    for(uint32_t i=0;ok && i<mNodes.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)(mNodes[i]?mNodes[i]->row:0)) ;
+    for(uint32_t i=0;ok && i<mNodes.size();++i) ok = setRawUInt32(data,size,&offset,name_ids[i]) ;
+
+    for(uint32_t i=0;ok && i<mNodes.size();++i) if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE) ok = setRawUInt64(data,size,&offset,static_cast<const FileEntry*>(mNodes[i])->file_size) ;
+    for(uint32_t i=0;ok && i<mNodes.size();++i) if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE) ok = setRawUInt32(data,size,&offset,(uint32_t)static_cast<const FileEntry*>(mNodes[i])->file_modtime) ;
+    for(uint32_t i=0;ok && i<mNodes.size();++i) if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE) ok = static_cast<const FileEntry*>(mNodes[i])->file_hash.serialise(data,size,offset) ;
+
+    std::vector<const DirEntry*> dirs ;
+
+    for(uint32_t i=0;i<mNodes.size();++i)
+        if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
+            dirs.push_back(static_cast<const DirEntry*>(mNodes[i])) ;
+
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,path_ids[i]) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->dir_modtime) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->dir_update_time) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->dir_most_recent_time) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->subdirs.size()) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->subfiles.size()) ;
+    for(uint32_t i=0;ok && i<dirs.size();++i) ok = dirs[i]->dir_hash.serialise(data,size,offset) ;
+
+    for(uint32_t i=0;ok && i<dirs.size();++i)
+    {
+        for(uint32_t j=0;ok && j<dirs[i]->subdirs.size();++j)  ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->subdirs[j]) ;
+        for(uint32_t j=0;ok && j<dirs[i]->subfiles.size();++j) ok = setRawUInt32(data,size,&offset,(uint32_t)dirs[i]->subfiles[j]) ;
+    }
+
+    if(!ok || offset != size)
+    {
+        std::cerr << "(EE) InternalFileHierarchyStorage: cannot write node columns. Size=" << size << ", written=" << offset << std::endl;
+        free(data) ;
+        data = NULL ;
+        return false ;
+    }
+    return true ;
+}
+
+bool InternalFileHierarchyStorage::readNodeColumns(const unsigned char *data,uint32_t size)
+{
+    void *buf = const_cast<unsigned char*>(data) ;
+    uint32_t offset = 0 ;
+    uint32_t n_nodes = 0, n_strings = 0, n_files = 0, n_dirs = 0 ;
+
+    if(!getRawUInt32(buf,size,&offset,&n_nodes) || !getRawUInt32(buf,size,&offset,&n_strings) || !getRawUInt32(buf,size,&offset,&n_files) || !getRawUInt32(buf,size,&offset,&n_dirs))
+        return false ;
+
+    // check the sizes of the fixed size columns, so that nothing is allocated from wrong counts.
+
+    if((uint64_t)4*n_strings + (uint64_t)13*n_nodes + (uint64_t)32*n_files + (uint64_t)44*n_dirs > size - offset || n_files + (uint64_t)n_dirs > n_nodes || n_nodes == 0)
+        return false ;
+
+    std::vector<uint32_t> string_sizes(n_strings) ;
+    std::vector<std::string> strings(n_strings) ;
+
+    for(uint32_t i=0;i<n_strings;++i)
+        getRawUInt32(buf,size,&offset,&string_sizes[i]) ;
+
+    for(uint32_t i=0;i<n_strings;++i)
+    {
+        if(string_sizes[i] > size - offset)
+            return false ;
+
+        strings[i].assign((const char*)&data[offset],string_sizes[i]) ;
+        offset += string_sizes[i] ;
+    }
+
+    std::vector<uint8_t> types(n_nodes) ;
+    std::vector<uint32_t> parents(n_nodes), rows(n_nodes), name_ids(n_nodes) ;
+
+    bool ok = true ;
+
+    for(uint32_t i=0;ok && i<n_nodes;++i) ok = getRawUInt8 (buf,size,&offset,&types[i]) ;
+    for(uint32_t i=0;ok && i<n_nodes;++i) ok = getRawUInt32(buf,size,&offset,&parents[i]) ;
+    for(uint32_t i=0;ok && i<n_nodes;++i) ok = getRawUInt32(buf,size,&offset,&rows[i]) ;
+    for(uint32_t i=0;ok && i<n_nodes;++i) ok = getRawUInt32(buf,size,&offset,&name_ids[i]) && name_ids[i] < n_strings ;
+
+    // Indices are used without further check once loaded, e.g. in parentRow(), so a file with an index out of range is
+    // rejected. The parent of a node must be a directory, and so must be the subdirs of a directory, below.
+
+    std::vector<uint32_t> file_indices, dir_indices ;
+
+    for(uint32_t i=0;ok && i<n_nodes;++i)
+        if(types[i] == FileStorageNode::TYPE_FILE || types[i] == FileStorageNode::TYPE_DIR)
+        {
+            ok = parents[i] < n_nodes && types[parents[i]] == FileStorageNode::TYPE_DIR && rows[i] < n_nodes ;
+
+            if(types[i] == FileStorageNode::TYPE_FILE)
+                file_indices.push_back(i) ;
+            else
+                dir_indices.push_back(i) ;
+        }
+
+    if(!ok || file_indices.size() != n_files || dir_indices.size() != n_dirs || types[0] != FileStorageNode::TYPE_DIR)
+        return false ;
+
+    mNodes.clear() ;
+    mNodes.resize(n_nodes,NULL) ;
+
+    for(uint32_t i=0;i<n_files;++i)
+    {
+        FileEntry *fe = new FileEntry(strings[name_ids[file_indices[i]]],0,0) ;
+
+        fe->parent_index = parents[file_indices[i]] ;
+        fe->row = rows[file_indices[i]] ;
+
+        mNodes[file_indices[i]] = fe ;
+    }
+    for(uint32_t i=0;ok && i<n_files;++i) ok = getRawUInt64(buf,size,&offset,&static_cast<FileEntry*>(mNodes[file_indices[i]])->file_size) ;
+
+    for(uint32_t i=0;ok && i<n_files;++i)
+    {
+        uint32_t t = 0 ;
+        ok = getRawUInt32(buf,size,&offset,&t) ;
+        static_cast<FileEntry*>(mNodes[file_indices[i]])->file_modtime = t ;
+    }
+    for(uint32_t i=0;ok && i<n_files;++i)
+    {
+        FileEntry& fe(*static_cast<FileEntry*>(mNodes[file_indices[i]])) ;
+
+        ok = fe.file_hash.deserialise(buf,size,offset) ;
+
+        mFileHashes[fe.file_hash] = file_indices[i] ;
+        mTotalFiles++ ;
+        mTotalSize += fe.file_size ;
+    }
+
+    std::vector<uint32_t> path_ids(n_dirs), n_subdirs(n_dirs), n_subfiles(n_dirs) ;
+    std::vector<DirEntry*> dirs(n_dirs,(DirEntry*)NULL) ;
+
+    for(uint32_t i=0;i<n_dirs;++i)
+    {
+        dirs[i] = new DirEntry(strings[name_ids[dir_indices[i]]]) ;
+
+        dirs[i]->parent_index = parents[dir_indices[i]] ;
+        dirs[i]->row = rows[dir_indices[i]] ;
+
+        mNodes[dir_indices[i]] = dirs[i] ;
+    }
+    uint32_t t = 0 ;
+
+    for(uint32_t i=0;ok && i<n_dirs;++i) ok = getRawUInt32(buf,size,&offset,&path_ids[i]) && path_ids[i] < n_strings ;
+    for(uint32_t i=0;ok && i<n_dirs;++i) { ok = getRawUInt32(buf,size,&offset,&t) ; dirs[i]->dir_modtime = t ; }
+    for(uint32_t i=0;ok && i<n_dirs;++i) { ok = getRawUInt32(buf,size,&offset,&t) ; dirs[i]->dir_update_time = t ; }
+    for(uint32_t i=0;ok && i<n_dirs;++i) { ok = getRawUInt32(buf,size,&offset,&t) ; dirs[i]->dir_most_recent_time = t ; }
+    for(uint32_t i=0;ok && i<n_dirs;++i) ok = getRawUInt32(buf,size,&offset,&n_subdirs[i]) ;
+    for(uint32_t i=0;ok && i<n_dirs;++i) ok = getRawUInt32(buf,size,&offset,&n_subfiles[i]) ;
+    for(uint32_t i=0;ok && i<n_dirs;++i) ok = dirs[i]->dir_hash.deserialise(buf,size,offset) ;
+
+    for(uint32_t i=0;ok && i<n_dirs;++i)
+    {
+        dirs[i]->dir_parent_path = strings[path_ids[i]] ;
+        mDirHashes[dirs[i]->dir_hash] = dir_indices[i] ;
+
+        ok = (uint64_t)4*n_subdirs[i] + (uint64_t)4*n_subfiles[i] <= size - offset ;
+
+        if(ok)
+        {
+            dirs[i]->subdirs.resize(n_subdirs[i]) ;
+            dirs[i]->subfiles.resize(n_subfiles[i]) ;
+        }
+
+        for(uint32_t j=0;ok && j<n_subdirs[i];++j)  ok = getRawUInt32(buf,size,&offset,&dirs[i]->subdirs[j])  && dirs[i]->subdirs[j]  < n_nodes && types[dirs[i]->subdirs[j]]  == FileStorageNode::TYPE_DIR ;
+        for(uint32_t j=0;ok && j<n_subfiles[i];++j) ok = getRawUInt32(buf,size,&offset,&dirs[i]->subfiles[j]) && dirs[i]->subfiles[j] < n_nodes && types[dirs[i]->subfiles[j]] == FileStorageNode::TYPE_FILE ;
+    }
+    return ok ;
+}
+
+// The summary is saved in its own small file, so that reading it does not need to decrypt the whole hierarchy. It holds
+// the size of the hierarchy file it was written for, so that a summary that does not match the hierarchy is not used.
+
+std::string InternalFileHierarchyStorage::summaryFilename(const std::string& fname)
+{
+    return fname + ".summary" ;
+}
+
+bool InternalFileHierarchyStorage::saveSummary(const std::string& fname) const
+{
+    uint64_t file_size = 0 ;
+
+    if(!RsDirUtil::checkFile(fname,file_size))
+        return false ;
+
     unsigned char *buffer = NULL ;
     uint32_t buffer_size = 0 ;
     uint32_t buffer_offset = 0 ;
 
-    unsigned char *tmp_section_data = (unsigned char*)rs_malloc(FL_BASE_TMP_SECTION_SIZE) ;
+    bool ok = FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003)
+           && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,(uint64_t) file_size)
+           && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t) static_cast<DirEntry*>(mNodes[mRoot])->dir_most_recent_time)
+           && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,(uint32_t) mTotalFiles)
+           && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,(uint64_t) mTotalSize)
+           && FileListIO::saveEncryptedDataToFile(summaryFilename(fname),buffer,buffer_offset) ;
 
-    if(!tmp_section_data)
-        return false;
+    free(buffer) ;
+    return ok ;
+}
+
+bool InternalFileHierarchyStorage::loadSummary(const std::string& fname,time_t& root_most_recent_time,SharedDirStats& stats)
+{
+    unsigned char *buffer = NULL ;
+    uint32_t buffer_size = 0 ;
+    uint32_t buffer_offset = 0 ;
+
+    if(!FileListIO::loadEncryptedDataFromFile(summaryFilename(fname),buffer,buffer_size) )
+        return false ;
+
+    uint32_t version = 0, root_TS = 0, total_files = 0 ;
+    uint64_t saved_file_size = 0, file_size = 0, total_size = 0 ;
+
+    bool ok = FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)
+           && version == (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003
+           && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,saved_file_size)
+           && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,root_TS        )
+           && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,total_files    )
+           && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,total_size     )
+           && RsDirUtil::checkFile(fname,file_size)
+           && file_size == saved_file_size ;
+
+    free(buffer) ;
 
-    uint32_t tmp_section_size = FL_BASE_TMP_SECTION_SIZE ;
+    if(ok)
+    {
+        root_most_recent_time = root_TS ;
+        stats.total_number_of_files = total_files ;
+        stats.total_shared_size = total_size ;
+    }
+    return ok ;
+}
+
+bool InternalFileHierarchyStorage::save(const std::string& fname)
+{
+    unsigned char *buffer = NULL ;
+    uint32_t buffer_size = 0 ;
+    uint32_t buffer_offset = 0 ;
 
     try
     {
         // Write some header
 
-        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001)) throw std::runtime_error("Write error") ;
+        if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003)) throw std::runtime_error("Write error") ;
         if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) mNodes.size())) throw std::runtime_error("Write error") ;
 
-        // Write all file/dir entries
+        // Write the file name index, so that it does not need to be re-computed at load time
 
-        for(uint32_t i=0;i<mNodes.size();++i)
-            if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
-            {
-                const FileEntry& fe(*static_cast<const FileEntry*>(mNodes[i])) ;
+        unsigned char *index_data = NULL ;
+        uint32_t index_size = 0 ;
 
-                uint32_t file_section_offset = 0 ;
+        if(!mNameIndex.serialise(index_data,index_size)) throw std::runtime_error("Write error") ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX  ,(uint32_t)fe.parent_index)) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ROW           ,(uint32_t)fe.row         )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX   ,(uint32_t)i              )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,fe.file_name             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,fe.file_size             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,fe.file_hash             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)fe.file_modtime)) throw std::runtime_error("Write error") ;
+        bool index_written = FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX,index_data,index_size) ;
+        free(index_data) ;
 
-                if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,tmp_section_data,file_section_offset)) throw std::runtime_error("Write error") ;
-            }
-            else if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_DIR)
-            {
-                const DirEntry& de(*static_cast<const DirEntry*>(mNodes[i])) ;
+        if(!index_written) throw std::runtime_error("Write error") ;
 
-                uint32_t dir_section_offset = 0 ;
+        // Write all file/dir entries
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_PARENT_INDEX   ,(uint32_t)de.parent_index      )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ROW            ,(uint32_t)de.row               )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,(uint32_t)i                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,de.dir_name                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_DIR_HASH       ,de.dir_hash                    )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,de.dir_parent_path             )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)de.dir_modtime       )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de.dir_update_time   )) throw std::runtime_error("Write error") ;
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de.dir_most_recent_time  )) throw std::runtime_error("Write error") ;
+        unsigned char *columns_data = NULL ;
+        uint32_t columns_size = 0 ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs.size())) throw std::runtime_error("Write error") ;
+        if(!writeNodeColumns(columns_data,columns_size)) throw std::runtime_error("Write error") ;
 
-                for(uint32_t j=0;j<de.subdirs.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subdirs[j])) throw std::runtime_error("Write error") ;
+        bool columns_written = FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_NODE_COLUMNS,columns_data,columns_size) ;
+        free(columns_data) ;
 
-                if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles.size())) throw std::runtime_error("Write error") ;
+        if(!columns_written) throw std::runtime_error("Write error") ;
 
-                for(uint32_t j=0;j<de.subfiles.size();++j)
-                    if(!FileListIO::writeField(tmp_section_data,tmp_section_size,dir_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de.subfiles[j])) throw std::runtime_error("Write error") ;
+        // The old summary goes first, so that it is never taken for the summary of the new file. See loadSummary().
 
-                if(!FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,tmp_section_data,dir_section_offset)) throw std::runtime_error("Write error") ;
-            }
+        if(RsDirUtil::fileExists(summaryFilename(fname)))
+            RsDirUtil::removeFile(summaryFilename(fname)) ;
 
         bool res = FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
 
         free(buffer) ;
-        free(tmp_section_data) ;
+
+        if(res && !saveSummary(fname))
+            std::cerr << "(WW) Cannot save the summary of " << fname << ". The whole file list will be read at next start." << std::endl;
 
         return res ;
     }
@@ -1036,9 +2035,6 @@ bool InternalFileHierarchyStorage::save(const std::string& fname)
         if(buffer != NULL)
             free(buffer) ;
 
-        if(tmp_section_data != NULL)
-			free(tmp_section_data) ;
-
         return false;
     }
 }
@@ -1050,6 +2046,8 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
     uint32_t buffer_offset = 0 ;
 
     mFreeNodes.clear();
+    mNameIndex.clear();
+    mSortedColumnsUpToDate = false ;
     mTotalFiles = 0;
     mTotalSize = 0;
 
@@ -1063,10 +2061,28 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
         uint32_t version, n_nodes ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION) ;
-        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001) throw std::runtime_error("Wrong version number") ;
+        if(version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001 && version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002 && version != (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003) throw read_error("Wrong version number") ;
 
         if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_nodes)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER) ;
 
+        // Read the file name index. Old files do not have it, in which case it is re-computed from the file entries.
+
+        bool name_index_loaded = false ;
+
+        if(version == (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002 || version == (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003)
+        {
+            unsigned char *index_data = NULL ;
+            uint32_t index_size = 0 ;
+
+            if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX,index_data,index_size)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX) ;
+
+            name_index_loaded = mNameIndex.deserialise(index_data,index_size) ;
+            free(index_data) ;
+
+            if(!name_index_loaded)
+                std::cerr << "(WW) Cannot read file name index from " << fname << ". It will be re-computed." << std::endl;
+        }
+
         // Write all file/dir entries
 
         for(uint32_t i=0;i<mNodes.size();++i)
@@ -1075,6 +2091,23 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
         mNodes.clear();
         mNodes.resize(n_nodes,NULL) ;
+        mFileHashes.clear() ;
+        mDirHashes.clear() ;
+
+        // Since version 0003, all nodes are in a single section. Older versions have one section per node, read below.
+
+        if(version == (uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003)
+        {
+            unsigned char *columns_data = NULL ;
+            uint32_t columns_size = 0 ;
+
+            if(!FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_NODE_COLUMNS,columns_data,columns_size)) throw read_error(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_NODE_COLUMNS) ;
+
+            bool columns_read = readNodeColumns(columns_data,columns_size) ;
+            free(columns_data) ;
+
+            if(!columns_read) throw read_error("Cannot read node columns") ;
+        }
 
         for(uint32_t i=0;i<mNodes.size() && buffer_offset < buffer_size;++i)	// only the 2nd condition really is needed. The first one ensures that the loop wont go forever.
         {
@@ -1183,6 +2216,11 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
         }
         free(buffer) ;
 
+        if(!name_index_loaded)
+            for(uint32_t i=0;i<mNodes.size();++i)
+                if(mNodes[i] != NULL && mNodes[i]->type() == FileStorageNode::TYPE_FILE)
+                    mNameIndex.addFile(i,static_cast<FileEntry*>(mNodes[i])->file_name) ;
+
         return true ;
     }
     catch(read_error& e)
@@ -1193,6 +2231,10 @@ bool InternalFileHierarchyStorage::load(const std::string& fname)
 
         if(buffer != NULL)
             free(buffer) ;
+
+        // Do not keep a partly read hierarchy, whose indices may be wrong.
+
+        clearNodes() ;
         return false;
     }
 }
@@ -29,9 +29,59 @@
 #include <stdint.h>
 #include <string.h>
 #include <stdlib.h>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "directory_storage.h"
 
+// Inverted index of the words found in file names. Words are maximal runs of alphanumeric (or non-ASCII) characters,
+// lower-cased. Any name that contains a search term as a sub-string has the middle words of the term as words, and
+// a word that starts with its last word, so the index produces a super-set of the matching files, that is then checked
+// against the actual search criteria. This avoids going through all files in the hierarchy for each search.
+//
+// Terms of a single word can be anywhere inside a word of the name. For these, the words are also indexed by the
+// trigrams (3 consecutive bytes) they contain, so that only the words that have all trigrams of the term are checked.
+// This costs one iterator per trigram of each distinct word, i.e. roughly 8 bytes per character of the distinct words.
+// Single word terms shorter than 3 bytes have no trigram, and still go through all the words.
+
+class FileNameIndex
+{
+public:
+    FileNameIndex() {}
+
+    void addFile(DirectoryStorage::EntryIndex indx,const std::string& file_name) ;
+    void removeFile(DirectoryStorage::EntryIndex indx,const std::string& file_name) ;
+    void clear() { mWords.clear(); mTrigrams.clear(); }
+
+    // Fills the sorted list of files that might contain the given term. Returns false when the term has no word
+    // at all (e.g. empty string, or only separators), in which case the index cannot help.
+
+    bool findCandidates(const std::string& term,std::vector<DirectoryStorage::EntryIndex>& candidates) const ;
+
+    // Serialisation into a binary chunk, stored along with the file hierarchy.
+
+    bool serialise(unsigned char *& data,uint32_t& size) const ;
+    bool deserialise(const unsigned char *data,uint32_t size) ;
+
+    static void splitWords(const std::string& s,std::vector<std::string>& words) ;
+
+private:
+    typedef std::map<std::string,std::vector<DirectoryStorage::EntryIndex> > WordMap ;
+
+    // mTrigrams points into mWords, so the index cannot be copied.
+
+    FileNameIndex(const FileNameIndex&) ;
+    FileNameIndex& operator=(const FileNameIndex&) ;
+
+    static uint32_t trigram(const std::string& s,uint32_t i) ;
+    void addTrigrams(WordMap::const_iterator wit) ;
+    void removeTrigrams(WordMap::const_iterator wit) ;
+
+    WordMap mWords ;	// word => sorted list of file indices
+    std::map<uint32_t,std::vector<WordMap::const_iterator> > mTrigrams ;	// trigram => words that contain it
+};
+
 class InternalFileHierarchyStorage
 {
 public:
@@ -92,6 +142,15 @@ public:
     bool load(const std::string& fname) ;
     bool save(const std::string& fname) ;
 
+    // Reads the root TS and statistics of a saved hierarchy from its summary file, without decrypting the hierarchy
+    // itself. Only works with hierarchies saved in version 0003 or later.
+
+    static bool loadSummary(const std::string& fname,time_t& root_most_recent_time,SharedDirStats& stats) ;
+
+    // Name of the summary file that save() writes next to the hierarchy saved in fname.
+
+    static std::string summaryFilename(const std::string& fname) ;
+
     int parentRow(DirectoryStorage::EntryIndex e);
     bool isIndexValid(DirectoryStorage::EntryIndex e) const;
     bool getChildIndex(DirectoryStorage::EntryIndex e,int row,DirectoryStorage::EntryIndex& c) const;
@@ -103,6 +162,12 @@ public:
     bool updateFile(const DirectoryStorage::EntryIndex& file_index,const RsFileHash& hash, const std::string& fname,uint64_t size, const time_t modf_time);
     bool updateDirEntry(const DirectoryStorage::EntryIndex& indx, const std::string& dir_name, time_t most_recent_time, time_t dir_modtime, const std::vector<RsFileHash> &subdirs_hash, const std::vector<FileEntry> &subfiles_array);
 
+    // Same as updateDirEntry, for directory content received in several parts. subfiles and received keep track of the
+    // update in between calls. Files with a null hash in subfiles_array are unchanged, and must already exist.
+    bool beginDirEntryUpdate(const DirectoryStorage::EntryIndex& indx, const std::string& dir_name, time_t most_recent_time, time_t dir_modtime, const std::vector<RsFileHash> &subdirs_hash, std::map<std::string,DirectoryStorage::EntryIndex>& subfiles, std::set<DirectoryStorage::EntryIndex>& received);
+    bool addDirEntryFiles(const DirectoryStorage::EntryIndex& indx, const std::vector<FileEntry> &subfiles_array, std::map<std::string,DirectoryStorage::EntryIndex>& subfiles, std::set<DirectoryStorage::EntryIndex>& received);
+    bool endDirEntryUpdate(const DirectoryStorage::EntryIndex& indx, std::map<std::string,DirectoryStorage::EntryIndex>& subfiles, std::set<DirectoryStorage::EntryIndex>& received);
+
     // TS get/set functions. Take one of the class members as argument.
 
     bool getTS(const DirectoryStorage::EntryIndex& index,time_t& TS,time_t DirEntry::* ) const;
@@ -165,6 +230,13 @@ private:
 
     DirectoryStorage::EntryIndex allocateNewIndex();
 
+    void updateSubDirectories(const DirectoryStorage::EntryIndex& indx,const std::vector<RsFileHash>& subdirs_hash) ;
+    void updateSubNodeRows(const DirectoryStorage::EntryIndex& indx) ;
+
+    // Deletes all entries, leaving an empty root directory.
+
+    void clearNodes();
+
     // Deletes an existing entry in mNodes, and keeps record of the indices that get freed.
 
     void deleteNode(DirectoryStorage::EntryIndex);
@@ -175,6 +247,24 @@ private:
 
     bool recursRemoveDirectory(DirectoryStorage::EntryIndex dir);
 
+    // Save/load all nodes as columns of fixed size fields, names and paths being stored once in a string table.
+
+    bool writeNodeColumns(unsigned char *& data,uint32_t& size) const ;
+    bool readNodeColumns(const unsigned char *data,uint32_t size) ;
+    bool saveSummary(const std::string& fname) const ;
+
+    // Computes a sorted super-set of the files that match the expression: name/extension clauses use mNameIndex,
+    // size and date clauses use the sorted columns below, and hash equality uses mFileHashes. Returns false when
+    // the expression cannot be restricted that way, and needs to be evaluated on all files.
+
+    bool findExpressionCandidates(const RsRegularExpression::Expression *exp,std::vector<DirectoryStorage::EntryIndex>& candidates) const ;
+    bool findTermsCandidates(const std::list<std::string>& terms,bool all_terms,std::vector<DirectoryStorage::EntryIndex>& candidates) const ;
+    bool isSearchable(DirectoryStorage::EntryIndex indx) const ;
+
+    void updateSortedColumns() const ;
+    void findSizeCandidates(int64_t min_size,int64_t max_size,std::vector<DirectoryStorage::EntryIndex>& candidates) const ;
+    void findModTimeCandidates(int64_t min_time,int64_t max_time,std::vector<DirectoryStorage::EntryIndex>& candidates) const ;
+
     // Map of the hash of all files. The file hashes are the sha1sum of the file data.
     // is used for fast search access for FT.
     // Note: We should try something faster than std::map. hash_map??
@@ -191,6 +281,18 @@ private:
     //
     std::map<RsFileHash,DirectoryStorage::EntryIndex> mDirHashes ;
 
+    // Word index of all file names, used by searchTerms() and searchBoolExp(). Kept up to date when files are added,
+    // renamed or deleted, and saved along with the hierarchy.
+
+    FileNameIndex mNameIndex ;
+
+    // All files sorted by size and by modification time, used to restrict size and date clauses of boolean searches
+    // to a range of files. These are rebuilt on the first search after any file has been added, changed or removed.
+
+    mutable std::vector<std::pair<uint64_t,DirectoryStorage::EntryIndex> > mSizeColumn ;
+    mutable std::vector<std::pair<int64_t,DirectoryStorage::EntryIndex> > mModTimeColumn ;
+    mutable bool mSortedColumnsUpToDate ;
+
     // high level statistics on the full hierarchy. Should be kept up to date.
 
     uint32_t mTotalFiles ;
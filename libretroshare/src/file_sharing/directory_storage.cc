@@ -82,14 +82,36 @@ std::string DirectoryStorage::DirIterator::name()      const { const InternalFil
 /*                                                 Directory Storage                                              */
 /******************************************************************************************************************/
 
-DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname)
-    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname)
+DirectoryStorage::DirectoryStorage(const RsPeerId &pid,const std::string& fname,bool load_on_demand)
+    : mPeerId(pid), mDirStorageMtx("Directory storage "+pid.toStdString()),mLastSavedTime(0),mChanged(false),mFileName(fname),mLoaded(false),mSummaryMostRecentTime(0)
 {
 	{
 		RS_STACK_MUTEX(mDirStorageMtx) ;
 		mFileHierarchy = new InternalFileHierarchyStorage();
 	}
-    load(fname) ;
+
+    // When loading on demand, only the summary is read now. Files saved in older versions have no summary, and are loaded right away.
+
+    if(!load_on_demand || !InternalFileHierarchyStorage::loadSummary(fname,mSummaryMostRecentTime,mSummaryStats))
+        load(fname) ;
+}
+
+std::string DirectoryStorage::summaryFilename() const
+{
+    return InternalFileHierarchyStorage::summaryFilename(mFileName) ;
+}
+
+InternalFileHierarchyStorage *DirectoryStorage::locked_fileHierarchy() const
+{
+    if(!mLoaded)
+    {
+#ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
+        std::cerr << "Loading file list of peer " << mPeerId << " from " << mFileName << ", on first use." << std::endl;
+#endif
+        mFileHierarchy->load(mFileName) ;
+        mLoaded = true ;
+    }
+    return mFileHierarchy ;
 }
 
 DirectoryStorage::EntryIndex DirectoryStorage::root() const
@@ -100,20 +122,20 @@ int DirectoryStorage::parentRow(EntryIndex e) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->parentRow(e) ;
+    return locked_fileHierarchy()->parentRow(e) ;
 }
 bool DirectoryStorage::getChildIndex(EntryIndex e,int row,EntryIndex& c) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->getChildIndex(e,row,c) ;
+    return locked_fileHierarchy()->getChildIndex(e,row,c) ;
 }
 
 uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    switch(mFileHierarchy->getType(indx))
+    switch(locked_fileHierarchy()->getType(indx))
     {
     case InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR:  return DIR_TYPE_DIR ;
     case InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE: return DIR_TYPE_FILE ;
@@ -122,32 +144,43 @@ uint32_t DirectoryStorage::getEntryType(const EntryIndex& indx)
     }
 }
 
-bool DirectoryStorage::getDirectoryUpdateTime   (EntryIndex index,time_t& update_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,time_t& rec_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,time_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+bool DirectoryStorage::getDirectoryUpdateTime   (EntryIndex index,time_t& update_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_fileHierarchy()->getTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
+bool DirectoryStorage::getDirectoryLocalModTime (EntryIndex index,time_t& loc_md_TS) const { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_fileHierarchy()->getTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+
+bool DirectoryStorage::getDirectoryRecursModTime(EntryIndex index,time_t& rec_md_TS) const
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    if(!mLoaded && index == root())	// known from the summary, no need to load the hierarchy.
+    {
+        rec_md_TS = mSummaryMostRecentTime ;
+        return true ;
+    }
+    return locked_fileHierarchy()->getTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time);
+}
 
-bool DirectoryStorage::setDirectoryUpdateTime   (EntryIndex index,time_t  update_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
-bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,time_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
-bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,time_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return mFileHierarchy->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
+bool DirectoryStorage::setDirectoryUpdateTime   (EntryIndex index,time_t  update_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_fileHierarchy()->setTS(index,update_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time     ); }
+bool DirectoryStorage::setDirectoryRecursModTime(EntryIndex index,time_t  rec_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_fileHierarchy()->setTS(index,rec_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time); }
+bool DirectoryStorage::setDirectoryLocalModTime (EntryIndex index,time_t  loc_md_TS) { RS_STACK_MUTEX(mDirStorageMtx) ; return locked_fileHierarchy()->setTS(index,loc_md_TS,&InternalFileHierarchyStorage::DirEntry::dir_modtime         ); }
 
 bool DirectoryStorage::updateSubDirectoryList(const EntryIndex& indx, const std::set<std::string> &subdirs, const RsFileHash& hash_salt)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->updateSubDirectoryList(indx,subdirs,hash_salt) ;
+    bool res = locked_fileHierarchy()->updateSubDirectoryList(indx,subdirs,hash_salt) ;
     mChanged = true ;
     return res ;
 }
 bool DirectoryStorage::updateSubFilesList(const EntryIndex& indx,const std::map<std::string,FileTS>& subfiles,std::map<std::string,FileTS>& new_files)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->updateSubFilesList(indx,subfiles,new_files) ;
+    bool res = locked_fileHierarchy()->updateSubFilesList(indx,subfiles,new_files) ;
     mChanged = true ;
     return res ;
 }
 bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    bool res = mFileHierarchy->removeDirectory(indx);
+    bool res = locked_fileHierarchy()->removeDirectory(indx);
     mChanged = true ;
 
     return res ;
@@ -156,42 +189,49 @@ bool DirectoryStorage::removeDirectory(const EntryIndex& indx)
 void DirectoryStorage::locked_check()
 {
     std::string error ;
-    if(!mFileHierarchy->check(error))
+    if(!locked_fileHierarchy()->check(error))
         std::cerr << "Check error: " << error << std::endl;
 }
 
 void DirectoryStorage::getStatistics(SharedDirStats& stats)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->getStatistics(stats);
+
+    if(!mLoaded)
+        stats = mSummaryStats ;
+    else
+        mFileHierarchy->getStatistics(stats);
 }
 
 bool DirectoryStorage::load(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
     mChanged = false ;
+    mLoaded = true ;
     return mFileHierarchy->load(local_file_name);
 }
 void DirectoryStorage::save(const std::string& local_file_name)
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->save(local_file_name);
+
+    if(mLoaded)		// otherwise there is nothing new to save
+        mFileHierarchy->save(local_file_name);
 }
 void DirectoryStorage::print()
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    mFileHierarchy->print();
+    locked_fileHierarchy()->print();
 }
 
 int DirectoryStorage::searchTerms(const std::list<std::string>& terms, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->searchTerms(terms,results);
+    return locked_fileHierarchy()->searchTerms(terms,results);
 }
 int DirectoryStorage::searchBoolExp(RsRegularExpression::Expression * exp, std::list<EntryIndex> &results) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->searchBoolExp(exp,results);
+    return locked_fileHierarchy()->searchBoolExp(exp,results);
 }
 
 bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
@@ -199,13 +239,13 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
     d.children.clear() ;
-    uint32_t type = mFileHierarchy->getType(indx) ;
+    uint32_t type = locked_fileHierarchy()->getType(indx) ;
 
     d.ref = (void*)(intptr_t)indx ;
 
     if (type == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR) /* has children --- fill */
     {
-        const InternalFileHierarchyStorage::DirEntry *dir_entry = mFileHierarchy->getDirEntry(indx) ;
+        const InternalFileHierarchyStorage::DirEntry *dir_entry = locked_fileHierarchy()->getDirEntry(indx) ;
 
         /* extract all the entries */
 
@@ -246,7 +286,7 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
     }
     else if(type == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
     {
-        const InternalFileHierarchyStorage::FileEntry *file_entry = mFileHierarchy->getFileEntry(indx) ;
+        const InternalFileHierarchyStorage::FileEntry *file_entry = locked_fileHierarchy()->getFileEntry(indx) ;
 
         d.type    = DIR_TYPE_FILE;
         d.count   = file_entry->file_size;
@@ -256,7 +296,7 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
         d.mtime     = file_entry->file_modtime;
         d.parent  = (void*)(intptr_t)file_entry->parent_index ;
 
-        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = mFileHierarchy->getDirEntry(file_entry->parent_index);
+        const InternalFileHierarchyStorage::DirEntry *parent_dir_entry = locked_fileHierarchy()->getDirEntry(file_entry->parent_index);
 
         if(parent_dir_entry != NULL)
 			d.path = RsDirUtil::makePath(parent_dir_entry->dir_parent_path, parent_dir_entry->dir_name) ;
@@ -274,12 +314,12 @@ bool DirectoryStorage::extractData(const EntryIndex& indx,DirDetails& d)
 bool DirectoryStorage::getDirHashFromIndex(const EntryIndex& index,RsFileHash& hash) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->getDirHashFromIndex(index,hash) ;
+    return locked_fileHierarchy()->getDirHashFromIndex(index,hash) ;
 }
 bool DirectoryStorage::getIndexFromDirHash(const RsFileHash& hash,EntryIndex& index) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
-    return mFileHierarchy->getIndexFromDirHash(hash,index) ;
+    return locked_fileHierarchy()->getIndexFromDirHash(hash,index) ;
 }
 
 void DirectoryStorage::checkSave()
@@ -678,23 +718,13 @@ std::string LocalDirectoryStorage::locked_getVirtualPath(EntryIndex indx) const
    return it->second.virtualname + "/" + res;
 }
 
-bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinaryData& bindata,const RsPeerId& client_id)
+bool LocalDirectoryStorage::locked_getAllowedSubDirs(const EntryIndex& indx,const RsPeerId& client_id,std::vector<RsFileHash>& allowed_subdirs)
 {
-    RS_STACK_MUTEX(mDirStorageMtx) ;
-
     const InternalFileHierarchyStorage::DirEntry *dir = mFileHierarchy->getDirEntry(indx);
 
-#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
-    std::cerr << "Serialising Dir entry " << std::hex << indx << " for client id " << client_id << std::endl;
-#endif
     if(dir == NULL)
-    {
-        std::cerr << "(EE) serialiseDirEntry: ERROR. Cannot find entry " << (void*)(intptr_t)indx << std::endl;
-        return false;
-    }
+        return false ;
 
-    // compute list of allowed subdirs
-    std::vector<RsFileHash> allowed_subdirs ;
     FileStorageFlags node_flags ;
     std::list<RsNodeGroupId> node_groups ;
 
@@ -719,6 +749,30 @@ bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinary
             std::cerr << "  not pushing subdir " << hash << ", array position=" << i << " indx=" << dir->subdirs[i] << ": permission denied for this peer." << std::endl;
 #endif
 
+    return true ;
+}
+
+bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinaryData& bindata,const RsPeerId& client_id)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    const InternalFileHierarchyStorage::DirEntry *dir = mFileHierarchy->getDirEntry(indx);
+
+#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
+    std::cerr << "Serialising Dir entry " << std::hex << indx << " for client id " << client_id << std::endl;
+#endif
+    if(dir == NULL)
+    {
+        std::cerr << "(EE) serialiseDirEntry: ERROR. Cannot find entry " << (void*)(intptr_t)indx << std::endl;
+        return false;
+    }
+
+    // compute list of allowed subdirs
+    std::vector<RsFileHash> allowed_subdirs ;
+
+    if(!locked_getAllowedSubDirs(indx,client_id,allowed_subdirs))
+        return false ;
+
     // now count the files that do not have a null hash (meaning the hash has indeed been computed)
 
     uint32_t allowed_subfiles = 0 ;
@@ -809,12 +863,189 @@ bool LocalDirectoryStorage::serialiseDirEntry(const EntryIndex& indx,RsTlvBinary
 }
 
 
+// Streamed directory content. The content is cut into parts of at most MAX_DIR_SYNC_RESPONSE_DATA_SIZE bytes, that can be
+// used by the client as soon as they arrive:
+//	- every part starts with its number. The first part also contains the directory info and the subdirs.
+//	- then come file entries, as long as there is room in the part. Files that have not changed since the TS known by the
+//	  client are grouped in runs, and only identified by their name and TS. File names are stored as a number of bytes in
+//	  common with the previous file name of the part, followed by the rest of the name.
+
+static uint32_t commonPrefixSize(const std::string& s1,const std::string& s2)
+{
+    uint32_t n = 0 ;
+
+    while(n < s1.length() && n < s2.length() && s1[n] == s2[n])
+        ++n ;
+
+    return n ;
+}
+
+static bool flushUnchangedFilesRun(unsigned char *& section_data,uint32_t& section_size,uint32_t& section_offset,const unsigned char *run_data,uint32_t& run_offset,uint32_t& run_count)
+{
+    if(run_count == 0)
+        return true ;
+
+    unsigned char *tmp_data = NULL ;
+    uint32_t tmp_size = 0 ;
+    uint32_t tmp_offset = 0 ;
+
+    bool ok = FileListIO::writeField(tmp_data,tmp_size,tmp_offset,FILE_LIST_IO_TAG_RAW_NUMBER,run_count) ;
+
+    if(ok && tmp_offset + run_offset > tmp_size)
+    {
+        unsigned char *new_data = (unsigned char*)realloc(tmp_data,tmp_offset + run_offset) ;
+
+        if(new_data == NULL)
+            ok = false ;
+        else
+        {
+            tmp_data = new_data ;
+            tmp_size = tmp_offset + run_offset ;
+        }
+    }
+
+    if(ok)
+    {
+        memcpy(&tmp_data[tmp_offset],run_data,run_offset) ;
+        tmp_offset += run_offset ;
+    }
+    ok = ok && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_UNCHANGED_FILES,tmp_data,tmp_offset) ;
+
+    free(tmp_data) ;
+
+    run_offset = 0 ;
+    run_count = 0 ;
+
+    return ok ;
+}
+
+bool LocalDirectoryStorage::serialiseDirEntryParts(const EntryIndex& indx,std::list<RsTlvBinaryData>& parts,const RsPeerId& client_id,time_t known_recurs_modf_TS)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    const InternalFileHierarchyStorage::DirEntry *dir = mFileHierarchy->getDirEntry(indx);
+
+#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
+    std::cerr << "Serialising Dir entry " << std::hex << indx << std::dec << " in parts for client id " << client_id << ", known TS=" << known_recurs_modf_TS << std::endl;
+#endif
+    if(dir == NULL)
+    {
+        std::cerr << "(EE) serialiseDirEntryParts: ERROR. Cannot find entry " << (void*)(intptr_t)indx << std::endl;
+        return false;
+    }
+
+    std::vector<RsFileHash> allowed_subdirs ;
+
+    if(!locked_getAllowedSubDirs(indx,client_id,allowed_subdirs))
+        return false ;
+
+    unsigned char *section_data = NULL ;
+    uint32_t section_size = 0 ;
+    uint32_t section_offset = 0 ;
+
+    unsigned char *run_data = NULL ;
+    uint32_t run_size = 0 ;
+    uint32_t run_offset = 0 ;
+    uint32_t run_count = 0 ;
+
+    unsigned char *file_section_data = NULL ;
+    uint32_t file_section_size = 0 ;
+
+    uint32_t part_number = 0 ;
+    uint32_t part_files = 0 ;
+    std::string previous_name ;
+
+    bool ok = FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER      ,part_number                        )
+           && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_DIR_NAME        ,locked_getVirtualDirName(indx)     )
+           && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)dir->dir_most_recent_time)
+           && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS        ,(uint32_t)dir->dir_modtime         )
+           && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER      ,(uint32_t)allowed_subdirs.size()  ) ;
+
+    for(uint32_t i=0;ok && i<allowed_subdirs.size();++i)
+        ok = FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX,allowed_subdirs[i]) ;
+
+    for(uint32_t i=0;ok && i<dir->subfiles.size();++i)
+    {
+        const InternalFileHierarchyStorage::FileEntry *file = mFileHierarchy->getFileEntry(dir->subfiles[i]) ;
+
+        if(file == NULL || file->file_hash.isNull())
+            continue ;
+
+        // Start a new part when this one is full. The margin accounts for the headers and fixed size fields of the entry.
+
+        if(part_files > 0 && section_offset + run_offset + file->file_name.length() + 128 > MAX_DIR_SYNC_RESPONSE_DATA_SIZE)
+        {
+            ok = flushUnchangedFilesRun(section_data,section_size,section_offset,run_data,run_offset,run_count) ;
+
+            parts.push_back(RsTlvBinaryData()) ;
+            parts.back().bin_data = realloc(section_data,section_offset) ;
+            parts.back().bin_len = section_offset ;
+
+            section_data = NULL ;
+            section_size = 0 ;
+            section_offset = 0 ;
+
+            part_files = 0 ;
+            previous_name.clear() ;
+
+            ok = ok && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,++part_number) ;
+        }
+
+        uint32_t prefix_size = commonPrefixSize(previous_name,file->file_name) ;
+        std::string suffix = file->file_name.substr(prefix_size) ;
+
+        previous_name = file->file_name ;
+        ++part_files ;
+
+        if(known_recurs_modf_TS != 0 && file->file_modtime <= known_recurs_modf_TS)
+        {
+            ok = ok && FileListIO::writeField(run_data,run_size,run_offset,FILE_LIST_IO_TAG_RAW_NUMBER,prefix_size                  )
+                    && FileListIO::writeField(run_data,run_size,run_offset,FILE_LIST_IO_TAG_FILE_NAME ,suffix                       )
+                    && FileListIO::writeField(run_data,run_size,run_offset,FILE_LIST_IO_TAG_MODIF_TS  ,(uint32_t)file->file_modtime) ;
+            ++run_count ;
+        }
+        else
+        {
+            uint32_t file_section_offset = 0 ;
+
+            ok = ok && flushUnchangedFilesRun(section_data,section_size,section_offset,run_data,run_offset,run_count)
+                    && FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,prefix_size                  )
+                    && FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,suffix                       )
+                    && FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,file->file_size              )
+                    && FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH ,file->file_hash              )
+                    && FileListIO::writeField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)file->file_modtime)
+                    && FileListIO::writeField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,file_section_data,file_section_offset) ;
+        }
+    }
+
+    ok = ok && flushUnchangedFilesRun(section_data,section_size,section_offset,run_data,run_offset,run_count) ;
+
+    free(run_data) ;
+    free(file_section_data) ;
+
+    if(!ok)
+    {
+        free(section_data) ;
+        parts.clear() ;
+        return false ;
+    }
+
+    parts.push_back(RsTlvBinaryData()) ;
+    parts.back().bin_data = realloc(section_data,section_offset) ;
+    parts.back().bin_len = section_offset ;
+
+#ifdef DEBUG_LOCAL_DIRECTORY_STORAGE
+    std::cerr << "Serialised dir entry to send for entry index " << (void*)(intptr_t)indx << " in " << parts.size() << " parts." << std::endl;
+#endif
+    return true ;
+}
+
 /******************************************************************************************************************/
 /*                                           Remote Directory Storage                                              */
 /******************************************************************************************************************/
 
 RemoteDirectoryStorage::RemoteDirectoryStorage(const RsPeerId& pid,const std::string& fname)
-    : DirectoryStorage(pid,fname)
+    : DirectoryStorage(pid,fname,true)
 {
     mLastSweepTime = time(NULL) - (RSRandom::random_u32() % DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP) ;
 
@@ -912,7 +1143,7 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
 #endif
 
     // First create the entries for each subdir and each subfile, if needed.
-    if(!mFileHierarchy->updateDirEntry(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,subfiles_array))
+    if(!locked_fileHierarchy()->updateDirEntry(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,subfiles_array))
     {
         std::cerr << "(EE) Cannot update dir entry with index " << indx << ": entry does not exist." << std::endl;
         return false ;
@@ -923,11 +1154,178 @@ bool RemoteDirectoryStorage::deserialiseUpdateDirEntry(const EntryIndex& indx,co
     return true ;
 }
 
+bool RemoteDirectoryStorage::deserialiseUpdateDirEntryPart(const EntryIndex& indx,const RsTlvBinaryData& bindata,bool last_part)
+{
+    const unsigned char *section_data = (unsigned char*)bindata.bin_data ;
+    uint32_t section_size = bindata.bin_len ;
+    uint32_t section_offset=0 ;
+
+    std::string dir_name ;
+    uint32_t part_number,most_recent_time=0,dir_modtime=0,n_subdirs=0 ;
+    std::vector<RsFileHash> subdirs_hashes ;
+    std::vector<InternalFileHierarchyStorage::FileEntry> subfiles_array ;
+
+    bool ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,part_number) ;
+
+    if(ok && part_number == 0)
+    {
+        ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_DIR_NAME       ,dir_name        )
+          && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,most_recent_time)
+          && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,dir_modtime     )
+          && FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,n_subdirs       ) ;
+
+        RsFileHash subdir_hash ;
+
+        for(uint32_t i=0;ok && i<n_subdirs;++i)
+            if( (ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX,subdir_hash)) )
+                subdirs_hashes.push_back(subdir_hash) ;
+    }
+
+#ifdef DEBUG_REMOTE_DIRECTORY_STORAGE
+    std::cerr << "RemoteDirectoryStorage: deserialising part " << part_number << " of directory " << indx << " for friend " << peerId() << std::endl;
+#endif
+
+    // read file entries until the end of the part
+
+    unsigned char *file_section_data = NULL ;
+    uint32_t file_section_size = 0 ;
+    std::string previous_name ;
+
+    while(ok && section_offset < section_size)
+    {
+        uint8_t tag = section_data[section_offset] ;
+        uint32_t file_section_offset = 0 ;
+        uint32_t prefix_size,modtime,n ;
+        std::string suffix ;
+
+        if(tag == FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY)
+        {
+            InternalFileHierarchyStorage::FileEntry f;
+
+            ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY,file_section_data,file_section_size)
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,prefix_size )
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,suffix      )
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,f.file_size )
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH ,f.file_hash )
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,modtime     )
+              && prefix_size <= previous_name.length() && !f.file_hash.isNull() ;
+
+            if(ok)
+            {
+                f.file_name = previous_name.substr(0,prefix_size) + suffix ;
+                f.file_modtime = modtime ;
+                previous_name = f.file_name ;
+
+                subfiles_array.push_back(f) ;
+            }
+        }
+        else if(tag == FILE_LIST_IO_TAG_UNCHANGED_FILES)
+        {
+            ok = FileListIO::readField(section_data,section_size,section_offset,FILE_LIST_IO_TAG_UNCHANGED_FILES,file_section_data,file_section_size)
+              && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n) ;
+
+            for(uint32_t i=0;ok && i<n;++i)
+            {
+                ok = FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,prefix_size)
+                  && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_FILE_NAME ,suffix     )
+                  && FileListIO::readField(file_section_data,file_section_size,file_section_offset,FILE_LIST_IO_TAG_MODIF_TS  ,modtime    )
+                  && prefix_size <= previous_name.length() ;
+
+                if(ok)
+                {
+                    // a null hash means that the file is unchanged.
+
+                    InternalFileHierarchyStorage::FileEntry f;
+
+                    f.file_name = previous_name.substr(0,prefix_size) + suffix ;
+                    f.file_modtime = modtime ;
+                    previous_name = f.file_name ;
+
+                    subfiles_array.push_back(f) ;
+                }
+            }
+        }
+        else
+            ok = false ;
+    }
+    free(file_section_data) ;
+
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    std::map<EntryIndex,DirUpdateState>::iterator it = mDirUpdates.find(indx) ;
+
+    if(ok && part_number == 0)
+    {
+        DirUpdateState& state(mDirUpdates[indx]) ;
+
+        state.next_part = 0 ;
+        ok = locked_fileHierarchy()->beginDirEntryUpdate(indx,dir_name,most_recent_time,dir_modtime,subdirs_hashes,state.subfiles,state.received) ;
+        it = mDirUpdates.find(indx) ;
+    }
+    else if(ok && (it == mDirUpdates.end() || it->second.next_part != part_number))
+    {
+        std::cerr << "(EE) RemoteDirectoryStorage: received part " << part_number << " of directory " << indx << ", which is not the expected one." << std::endl;
+        ok = false ;
+    }
+
+    ok = ok && locked_fileHierarchy()->addDirEntryFiles(indx,subfiles_array,it->second.subfiles,it->second.received) ;
+
+    if(ok)
+    {
+        it->second.next_part = part_number + 1 ;
+        it->second.last_recv_TS = time(NULL) ;
+
+        if(last_part)
+        {
+            ok = locked_fileHierarchy()->endDirEntryUpdate(indx,it->second.subfiles,it->second.received) ;
+            mDirUpdates.erase(it) ;
+        }
+        mChanged = true ;
+    }
+
+    if(!ok)
+    {
+        std::cerr << "(EE) RemoteDirectoryStorage: cannot use part " << part_number << " of directory " << indx << ". Asking the full directory again." << std::endl;
+        locked_abortDirUpdate(indx) ;
+    }
+    return ok ;
+}
+
+void RemoteDirectoryStorage::locked_abortDirUpdate(const EntryIndex& indx)
+{
+    // Files received so far are kept. Resetting the TS makes the next sync request ask for the full directory.
+
+    mDirUpdates.erase(indx) ;
+
+    time_t null_TS = 0 ;
+
+    locked_fileHierarchy()->setTS(indx,null_TS,&InternalFileHierarchyStorage::DirEntry::dir_most_recent_time) ;
+    locked_fileHierarchy()->setTS(indx,null_TS,&InternalFileHierarchyStorage::DirEntry::dir_update_time) ;
+}
+
+void RemoteDirectoryStorage::cleanupDirUpdates(time_t max_age)
+{
+    RS_STACK_MUTEX(mDirStorageMtx) ;
+
+    time_t now = time(NULL) ;
+    std::vector<EntryIndex> to_abort ;
+
+    for(std::map<EntryIndex,DirUpdateState>::const_iterator it(mDirUpdates.begin());it!=mDirUpdates.end();++it)
+        if(it->second.last_recv_TS + max_age < now)
+            to_abort.push_back(it->first) ;
+
+    for(uint32_t i=0;i<to_abort.size();++i)
+    {
+        std::cerr << "(WW) RemoteDirectoryStorage: update of directory " << to_abort[i] << " for friend " << peerId() << " was not completed." << std::endl;
+        locked_abortDirUpdate(to_abort[i]) ;
+    }
+}
+
 int RemoteDirectoryStorage::searchHash(const RsFileHash& hash, EntryIndex& result) const
 {
     RS_STACK_MUTEX(mDirStorageMtx) ;
 
-    return mFileHierarchy->searchHash(hash,result);
+    return locked_fileHierarchy()->searchHash(hash,result);
 }
 
 
@@ -28,6 +28,9 @@
 #include <string>
 #include <stdint.h>
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
 
 #include "retroshare/rsids.h"
 #include "retroshare/rsfiles.h"
@@ -41,7 +44,7 @@ class RsTlvBinaryData ;
 class DirectoryStorage
 {
 	public:
-        DirectoryStorage(const RsPeerId& pid, const std::string& fname) ;
+        DirectoryStorage(const RsPeerId& pid, const std::string& fname, bool load_on_demand = false) ;
         virtual ~DirectoryStorage() {}
 
         typedef uint32_t EntryIndex ;
@@ -69,7 +72,8 @@ class DirectoryStorage
 
 		// This class allows to abstractly browse the stored directory hierarchy in a depth-first manner.
         // It gives access to sub-files and sub-directories below. When using it, the client should make sure
-        // that the DirectoryStorage is properly locked, since the iterator cannot lock it.
+        // that the DirectoryStorage is properly locked, since the iterator cannot lock it. For the same reason, the iterator
+        // does not load the hierarchy of a remote directory: it must already be loaded by another call to the storage.
 		//
 		class DirIterator
 		{
@@ -156,6 +160,7 @@ class DirectoryStorage
 		void checkSave() ;
 
 		const std::string& filename() const { return mFileName ; }
+		std::string summaryFilename() const ;
 
     protected:
         bool load(const std::string& local_file_name) ;
@@ -175,9 +180,19 @@ class DirectoryStorage
 
         InternalFileHierarchyStorage *mFileHierarchy ;
 
+        // Returns mFileHierarchy, after loading it from mFileName if not done yet. Local directories are always loaded.
+
+        InternalFileHierarchyStorage *locked_fileHierarchy() const ;
+
 		time_t mLastSavedTime ;
 		bool mChanged ;
 		std::string mFileName;
+
+        // Summary of the saved hierarchy, used as long as it is not loaded.
+
+        mutable bool mLoaded ;
+        time_t mSummaryMostRecentTime ;
+        SharedDirStats mSummaryStats ;
 };
 
 class RemoteDirectoryStorage: public DirectoryStorage
@@ -197,6 +212,25 @@ public:
      */
     bool deserialiseUpdateDirEntry(const EntryIndex& indx,const RsTlvBinaryData& data) ;
 
+    /*!
+     * \brief deserialiseUpdateDirEntryPart
+     * 			Same as deserialiseUpdateDirEntry, for directory content sent in several parts. Files are added as soon as
+     * 			they are received, and files that are not in the directory anymore are removed with the last part.
+     * 			When a part cannot be used, the directory TS are reset so that the full content is asked again.
+     *
+     * \param indx		index of the directory to update
+     * \param bindata   binary data of the part to deserialise from
+     * \param last_part	true for the last part of the directory content
+     * \return 			false when the part cannot be used.
+     */
+    bool deserialiseUpdateDirEntryPart(const EntryIndex& indx,const RsTlvBinaryData& data,bool last_part) ;
+
+    /*!
+     * \brief cleanupDirUpdates
+     * 			Gives up directory updates that did not receive any part in the given time.
+     */
+    void cleanupDirUpdates(time_t max_age) ;
+
     /*!
      * \brief lastSweepTime
      * 			returns the last time a sweep has been done over the directory in order to check update TS.
@@ -216,7 +250,18 @@ public:
     virtual int searchHash(const RsFileHash& hash, EntryIndex& results) const ;
 
 private:
+    struct DirUpdateState
+    {
+        uint32_t next_part ;
+        time_t last_recv_TS ;
+        std::map<std::string,EntryIndex> subfiles ;	// subfiles of the directory by name
+        std::set<EntryIndex> received ;				// subfiles in the parts received so far
+    };
+
+    void locked_abortDirUpdate(const EntryIndex& indx) ;
+
     time_t mLastSweepTime ;
+    std::map<EntryIndex,DirUpdateState> mDirUpdates ;	// directories being updated from several parts
 };
 
 class LocalDirectoryStorage: public DirectoryStorage
@@ -294,7 +339,21 @@ public:
      */
     bool serialiseDirEntry(const EntryIndex& indx, RsTlvBinaryData& bindata, const RsPeerId &client_id) ;
 
+    /*!
+     * \brief serialiseDirEntryParts
+     * 			Same as serialiseDirEntry, but cuts the directory content into parts that the client can use separately, and
+     * 			only sends the name and TS of files that are not more recent than the TS known by the client.
+     *
+     * \param indx					index of the directory to serialise
+     * \param parts   				binary data of each part
+     * \param client_id      		Peer id to be serialised to. Depending on permissions, some subdirs can be removed.
+     * \param known_recurs_modf_TS	recursive modification TS of the directory known by the client. 0 sends all files.
+     * \return 						false when the directory cannot be found.
+     */
+    bool serialiseDirEntryParts(const EntryIndex& indx, std::list<RsTlvBinaryData>& parts, const RsPeerId &client_id, time_t known_recurs_modf_TS) ;
+
 private:
+	bool locked_getAllowedSubDirs(const EntryIndex& indx, const RsPeerId& client_id, std::vector<RsFileHash>& allowed_subdirs) ;
 	static RsFileHash makeEncryptedHash(const RsFileHash& hash);
 	bool locked_findRealHash(const RsFileHash& hash, RsFileHash& real_hash) const;
 	std::string locked_getVirtualPath(EntryIndex indx) const ;
@@ -44,6 +44,8 @@ static const std::string IGNORED_PREFIXES_SS    = "IGNORED_PREFIXES"; 	 	 // ign
 static const std::string IGNORED_SUFFIXES_SS    = "IGNORED_SUFFIXES"; 	 	 // ignore file suffixes
 static const std::string IGNORE_LIST_FLAGS_SS   = "IGNORED_FLAGS"; 	 	 	 // ignore file flags
 static const std::string MAX_SHARE_DEPTH        = "MAX_SHARE_DEPTH"; 	 	 // maximum depth of shared directories
+static const std::string HASHING_THREADS_SS     = "HASHING_THREADS"; 	 	 // size of the hashing thread pool
+static const std::string HASHING_THREADS_PER_DEVICE_SS = "HASHING_THREADS_PER_DEVICE"; // max files hashed at once on a single disk
 
 static const std::string FILE_SHARING_DIR_NAME       = "file_sharing" ;			 // hard-coded directory name to store friend file lists, hash cache, etc.
 static const std::string HASH_CACHE_FILE_NAME        = "hash_cache.bin" ;		 // hard-coded directory name to store encrypted hash cache.
@@ -54,6 +56,9 @@ static const uint32_t MIN_INTERVAL_BETWEEN_REMOTE_DIRECTORY_SAVE   = 23 ;    //
 
 static const uint32_t MAX_DIR_SYNC_RESPONSE_DATA_SIZE              = 20000 ; // Maximum RsItem data size in bytes for serialised directory transmission
 static const uint32_t DEFAULT_HASH_STORAGE_DURATION_DAYS           = 30 ;    // remember deleted/inaccessible files for 30 days
+static const uint32_t DEFAULT_MAX_HASHING_THREADS                  =  4 ;    // size of the pool of hashing threads
+static const uint32_t DEFAULT_MAX_HASHING_THREADS_PER_DEVICE       =  1 ;    // files hashed at the same time on one disk. More would thrash spinning disks.
+static const uint32_t HASH_STORAGE_READ_BUFFER_SIZE                = 1024*1024 ; // read buffer of each hashing thread
 
 static const uint32_t NB_FRIEND_INDEX_BITS_32BITS                    = 10 ;			// Do not change this!
 static const uint32_t NB_ENTRY_INDEX_BITS_32BITS                     = 22 ;			// Do not change this!
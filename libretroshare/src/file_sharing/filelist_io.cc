@@ -24,6 +24,13 @@
  */
 
 #include <sstream>
+
+#ifndef WINDOWS_SYS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
 #include "retroshare/rsids.h"
 #include "pqi/authssl.h"
 #include "util/rsdir.h"
@@ -206,6 +213,38 @@ bool FileListIO::loadEncryptedDataFromFile(const std::string& fname,unsigned cha
         return false;
     }
 
+    void *decrypted_data =NULL;
+    int decrypted_data_size =0;
+
+#ifndef WINDOWS_SYS
+    // Decrypt straight from the mapped file, which avoids copying the whole file into memory first. Falls back to
+    // reading the file when it cannot be mapped.
+
+    int fd = open(fname.c_str(),O_RDONLY) ;
+
+    if(fd >= 0)
+    {
+        void *map = mmap(NULL,file_size,PROT_READ,MAP_PRIVATE,fd,0) ;
+        close(fd) ;
+
+        if(map != MAP_FAILED)
+        {
+            bool ok = AuthSSL::getAuthSSL()->decrypt(decrypted_data, decrypted_data_size, map, file_size) ;
+            munmap(map,file_size) ;
+
+            if(!ok)
+            {
+                std::cerr << "Cannot decrypt encrypted file. Something's wrong." << std::endl;
+                return false;
+            }
+            data = (unsigned char*)decrypted_data ;
+            total_size = decrypted_data_size ;
+
+            return true;
+        }
+    }
+#endif
+
     // read the binary stream into memory.
     //
     RsTemporaryMemory buffer(file_size) ;
@@ -228,8 +267,6 @@ bool FileListIO::loadEncryptedDataFromFile(const std::string& fname,unsigned cha
     fclose(F) ;
 
     // now decrypt
-    void *decrypted_data =NULL;
-    int decrypted_data_size =0;
 
     if(!AuthSSL::getAuthSSL()->decrypt(decrypted_data, decrypted_data_size, buffer, file_size))
     {
@@ -36,6 +36,8 @@
 // WARNING: the encoding is system-dependent, so this should *not* be used to exchange data between computers.
 
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0001 =  0x00000001 ;
+static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002 =  0x00000002 ;	// adds the file name index
+static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003 =  0x00000003 ;	// stores nodes in columns with interned strings, and a summary in a separate file
 static const uint32_t FILE_LIST_IO_LOCAL_DIRECTORY_TREE_VERSION_0001    =  0x00010001 ;
 
 static const uint8_t FILE_LIST_IO_TAG_UNKNOWN                   =  0x00 ;
@@ -45,6 +47,9 @@ static const uint8_t FILE_LIST_IO_TAG_HASH_STORAGE_ENTRY        =  0x10 ;
 static const uint8_t FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY          =  0x11 ;
 static const uint8_t FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY           =  0x12 ;
 static const uint8_t FILE_LIST_IO_TAG_REMOTE_FILE_ENTRY         =  0x13 ;
+static const uint8_t FILE_LIST_IO_TAG_FILE_NAME_INDEX           =  0x14 ;
+static const uint8_t FILE_LIST_IO_TAG_UNCHANGED_FILES           =  0x15 ;
+static const uint8_t FILE_LIST_IO_TAG_NODE_COLUMNS              =  0x16 ;
 
 static const uint8_t FILE_LIST_IO_TAG_FILE_SHA1_HASH            =  0x20 ;
 static const uint8_t FILE_LIST_IO_TAG_FILE_NAME                 =  0x21 ;
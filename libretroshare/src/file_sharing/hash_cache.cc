@@ -22,6 +22,14 @@
  * Please report all bugs and problems to "retroshare.project@gmail.com".
  *
  */
+#ifdef WINDOWS_SYS
+#include "util/rswin.h"
+#include "util/rsstring.h"
+#endif
+
+#include <sys/stat.h>
+#include <openssl/sha.h>
+
 #include "util/rsdir.h"
 #include "util/rsprint.h"
 #include "rsserver/p3face.h"
@@ -34,6 +42,9 @@
 
 static const uint32_t DEFAULT_INACTIVITY_SLEEP_TIME = 50*1000;
 static const uint32_t     MAX_INACTIVITY_SLEEP_TIME = 2*1000*1000;
+static const uint32_t      WORKER_IDLE_SLEEP_TIME   = 50*1000;
+static const uint32_t    HASH_STORAGE_BUFFER_ALIGN  = 4096;      // buffers are aligned on pages
+static const uint64_t    HASH_STORAGE_REPORT_SIZE   = 8*1024*1024; // workers report progress every 8MB
 
 HashStorage::HashStorage(const std::string& save_file_name)
     : mFilePath(save_file_name), mHashMtx("Hash Storage mutex")
@@ -45,6 +56,11 @@ HashStorage::HashStorage(const std::string& save_file_name)
     mTotalFilesToHash = 0;
     mMaxStorageDurationDays = DEFAULT_HASH_STORAGE_DURATION_DAYS ;
 	mHashingProcessPaused = false;
+    mActiveJobs = 0 ;
+    mMaxHashingThreads = DEFAULT_MAX_HASHING_THREADS ;
+    mMaxHashingThreadsPerDevice = DEFAULT_MAX_HASHING_THREADS_PER_DEVICE ;
+    mHashingStartTime = 0 ;
+    mLastNotifyTime = 0 ;
 
     {
         RS_STACK_MUTEX(mHashMtx) ;
@@ -54,6 +70,11 @@ HashStorage::HashStorage(const std::string& save_file_name)
     }
 }
 
+HashStorage::~HashStorage()
+{
+    stopWorkers() ;
+}
+
 void HashStorage::togglePauseHashingProcess()
 {
 	RS_STACK_MUTEX(mHashMtx) ;
@@ -65,6 +86,27 @@ bool HashStorage::hashingProcessPaused()
 	return mHashingProcessPaused;
 }
 
+void HashStorage::setMaxHashingThreads(uint32_t n)
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+    mMaxHashingThreads = std::max(1u,n) ;
+}
+uint32_t HashStorage::maxHashingThreads()
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+    return mMaxHashingThreads ;
+}
+void HashStorage::setMaxHashingThreadsPerDevice(uint32_t n)
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+    mMaxHashingThreadsPerDevice = std::max(1u,n) ;
+}
+uint32_t HashStorage::maxHashingThreadsPerDevice()
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+    return mMaxHashingThreadsPerDevice ;
+}
+
 static std::string friendlyUnit(uint64_t val)
 {
     const std::string units[5] = {"B","KB","MB","GB","TB"};
@@ -85,45 +127,172 @@ static std::string friendlyUnit(uint64_t val)
     return  std::string(buf) + " TB";
 }
 
-void HashStorage::data_tick()
+// Returns an identifier of the storage device the file is on, so that we can limit the number of files hashed at the same
+// time on each disk.
+
+static uint64_t fileDeviceId(const std::string& full_path)
 {
-    FileHashJob job;
-    RsFileHash hash;
-    uint64_t size = 0;
+    struct stat64 buf;
+
+#ifdef WINDOWS_SYS
+    std::wstring wfullname;
+    librs::util::ConvertUtf8ToUtf16(full_path, wfullname);
+    if ( 0 == _wstati64(wfullname.c_str(), &buf))
+#else
+    if ( 0 == stat64(full_path.c_str(), &buf))
+#endif
+        return (uint64_t)buf.st_dev ;
 
+    return 0 ;
+}
 
+void HashStorage::locked_updateWorkers(std::vector<HashStorageWorker*>& to_stop)
+{
+    // Never run more threads than files that can be hashed at the same time.
+
+    uint32_t needed = std::min<uint32_t>(mMaxHashingThreads, mFilesToHash.size() * mMaxHashingThreadsPerDevice) ;
+    needed = std::max(needed, mActiveJobs) ;
+
+    while(mWorkers.size() < needed)
     {
-        bool empty ;
-        uint32_t st ;
+        HashStorageWorker *w = new HashStorageWorker(this) ;
+        mWorkers.push_back(w) ;
+        w->start("fs hash worker") ;
+    }
 
-        {
-            RS_STACK_MUTEX(mHashMtx) ;
+    // Idle workers are removed when the pool size has been reduced. They will not pick any new job.
 
-            if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
-            {
-                locked_save();
-                mLastSaveTime = time(NULL) ;
-                mChanged = false ;
-            }
-        }
+    while(mWorkers.size() > std::max(mMaxHashingThreads,mActiveJobs))
+    {
+        to_stop.push_back(mWorkers.back()) ;
+        mWorkers.pop_back() ;
+    }
+}
 
+void HashStorage::stopWorkers()
+{
+    std::vector<HashStorageWorker*> to_stop ;
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+        to_stop.swap(mWorkers) ;
+    }
+
+    // off mutex, since workers need it to finish their current job.
+
+    for(uint32_t i=0;i<to_stop.size();++i)
+    {
+        to_stop[i]->fullstop() ;
+        delete to_stop[i] ;
+    }
+}
+
+bool HashStorage::getNextJob(FileHashJob& job)
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+
+    if(mHashingProcessPaused)
+        return false ;
+
+    // Take the first file on a device that is not already busy with enough jobs.
+
+    for(std::map<uint64_t,std::map<std::string,FileHashJob> >::iterator it(mFilesToHash.begin());it!=mFilesToHash.end();++it)
+    {
+        uint32_t& active(mActiveJobsPerDevice[it->first]) ;
+
+        if(active >= mMaxHashingThreadsPerDevice)
+            continue ;
+
+        job = it->second.begin()->second ;
+        it->second.erase(it->second.begin()) ;
+
+        if(it->second.empty())
+            mFilesToHash.erase(it) ;
+
+        ++active ;
+        ++mActiveJobs ;
+        mLastStartedFile = job.full_path ;
+        return true ;
+    }
+    return false ;
+}
+
+void HashStorage::reportHashedBytes(uint64_t n)
+{
+    RS_STACK_MUTEX(mHashMtx) ;
+    mTotalHashedSize += n ;
+}
+
+void HashStorage::jobDone(const FileHashJob& job, bool hashed, const RsFileHash& hash, uint64_t size)
+{
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        std::map<uint64_t,uint32_t>::iterator it = mActiveJobsPerDevice.find(job.device) ;
+
+        if(it != mActiveJobsPerDevice.end() && --it->second == 0)
+            mActiveJobsPerDevice.erase(it) ;
+
+        --mActiveJobs ;
+        ++mHashCounter ;
+
+        if(hashed)
         {
-            RS_STACK_MUTEX(mHashMtx) ;
+            // store the result
+
+            HashStorageInfo& info(mFiles[job.real_path]);
+
+            info.filename = job.real_path ;
+            info.size = size ;
+            info.modf_stamp = job.ts ;
+            info.time_stamp = time(NULL);
+            info.hash = hash;
 
-            empty = mFilesToHash.empty();
-            st = mInactivitySleepTime ;
+            mChanged = true ;
         }
+    }
+
+    // call the client, off mutex
 
-        // sleep off mutex!
-        if(empty)
+    if(hashed)
+        job.client->hash_callback(job.client_param, job.full_path, hash, size);
+}
+
+void HashStorage::data_tick()
+{
+    std::vector<HashStorageWorker*> to_stop ;
+    bool empty ;
+    uint32_t st ;
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        if(mChanged && mLastSaveTime + MIN_INTERVAL_BETWEEN_HASH_CACHE_SAVE < time(NULL))
         {
+            locked_save();
+            mLastSaveTime = time(NULL) ;
+            mChanged = false ;
+        }
+    }
+
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        empty = mFilesToHash.empty() && mActiveJobs == 0 ;
+        st = mInactivitySleepTime ;
+    }
+
+    // sleep off mutex!
+    if(empty)
+    {
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
+        std::cerr << "nothing to hash. Sleeping for " << st << " us" << std::endl;
 #endif
 
-            usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
+        usleep(st);	// when no files to hash, just wait for 2 secs. This avoids a dramatic loop.
 
-            if(st > MAX_INACTIVITY_SLEEP_TIME)
+        if(st > MAX_INACTIVITY_SLEEP_TIME)
+        {
+            bool stop = false ;
             {
                 RS_STACK_MUTEX(mHashMtx) ;
 
@@ -136,82 +305,159 @@ void HashStorage::data_tick()
                     mRunning = false ;
                     mTotalSizeToHash = 0;
                     mTotalFilesToHash = 0;
-                    std::cerr << "done." << std::endl;
+                    stop = true ;
                 }
-
-                RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
             }
-            else
+            if(stop)
             {
-                RS_STACK_MUTEX(mHashMtx) ;
-                mInactivitySleepTime = 2*st ;
+                stopWorkers() ;
+                std::cerr << "done." << std::endl;
             }
 
-            return ;
+            RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_FINISH, "") ;
         }
-        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
-
-		bool paused = false ;
+        else
         {
             RS_STACK_MUTEX(mHashMtx) ;
-			paused = mHashingProcessPaused ;
-		}
-
-		if(paused)	// we need to wait off mutex!!
-		{
-			usleep(MAX_INACTIVITY_SLEEP_TIME) ;
-			std::cerr << "Hashing process currently paused." << std::endl;
-			return;
-		}
-		else
+            mInactivitySleepTime = 2*st ;
+        }
+
+        return ;
+    }
+
+    std::string tmpout;
+    {
+        RS_STACK_MUTEX(mHashMtx) ;
+
+        mInactivitySleepTime = DEFAULT_INACTIVITY_SLEEP_TIME;
+
+        locked_updateWorkers(to_stop) ;
+
+        // Report progress and throughput once per second. The actual hashing is done by the workers.
+
+        time_t now = time(NULL) ;
+
+        if(!mHashingProcessPaused && mLastNotifyTime != now)
         {
-            RS_STACK_MUTEX(mHashMtx) ;
+            mLastNotifyTime = now ;
 
-            job = mFilesToHash.begin()->second ;
-            mFilesToHash.erase(mFilesToHash.begin()) ;
+            uint64_t rate = (now > mHashingStartTime)? mTotalHashedSize / (now - mHashingStartTime) : 0 ;
+
+            rs_sprintf(tmpout, "%lu/%lu (%s - %d%% - %s/s - %u threads) : %s", (unsigned long int)std::min(mHashCounter+1,mTotalFilesToHash), (unsigned long int)mTotalFilesToHash,
+                       friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), friendlyUnit(rate).c_str(), mActiveJobs, mLastStartedFile.c_str()) ;
         }
+    }
 
-        if(job.client->hash_confirm(job.client_param))
-        {
+    for(uint32_t i=0;i<to_stop.size();++i)
+    {
+        to_stop[i]->fullstop() ;
+        delete to_stop[i] ;
+    }
+
+    if(!tmpout.empty())
+        RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_HASH_FILE, tmpout) ;
+
+    usleep(DEFAULT_INACTIVITY_SLEEP_TIME) ;
+}
+
+/***********************************************************
+*
+*	HashStorageWorker methods
+*
+***********************************************************/
+
+HashStorageWorker::HashStorageWorker(HashStorage *storage)
+    : mStorage(storage)
+{
+    mBufferMemory = new unsigned char[HASH_STORAGE_READ_BUFFER_SIZE + HASH_STORAGE_BUFFER_ALIGN] ;
+    mBuffer = mBufferMemory + (HASH_STORAGE_BUFFER_ALIGN - ((uintptr_t)mBufferMemory % HASH_STORAGE_BUFFER_ALIGN)) % HASH_STORAGE_BUFFER_ALIGN ;
+}
+
+HashStorageWorker::~HashStorageWorker()
+{
+    delete[] mBufferMemory ;
+}
+
+void HashStorageWorker::data_tick()
+{
+    HashStorage::FileHashJob job ;
+
+    if(!mStorage->getNextJob(job))
+    {
+        usleep(WORKER_IDLE_SLEEP_TIME) ;
+        return ;
+    }
+
+    RsFileHash hash ;
+    uint64_t size = 0 ;
+    bool hashed = false ;
+
+    if(job.client->hash_confirm(job.client_param))
+    {
 #ifdef HASHSTORAGE_DEBUG
-            std::cerr << "Hashing file " << job.full_path << "..." ; std::cerr.flush();
+        std::cerr << "Hashing file " << job.full_path << "..." << std::endl;
 #endif
+        hashed = hashFile(job.full_path, hash, size) ;
 
-            std::string tmpout;
-            rs_sprintf(tmpout, "%lu/%lu (%s - %d%%) : %s", (unsigned long int)mHashCounter+1, (unsigned long int)mTotalFilesToHash, friendlyUnit(mTotalHashedSize).c_str(), int(mTotalHashedSize/double(mTotalSizeToHash)*100.0), job.full_path.c_str()) ;
+        if(!hashed)
+            std::cerr << "ERROR: cannot hash file " << job.full_path << std::endl;
+    }
 
-            RsServer::notify()->notifyHashingInfo(NOTIFY_HASHTYPE_HASH_FILE, tmpout) ;
+    mStorage->jobDone(job, hashed, hash, size) ;
+}
 
-            if(RsDirUtil::getFileHash(job.full_path, hash,size, this))
-            {
-                // store the result
+bool HashStorageWorker::hashFile(const std::string& full_path, RsFileHash& hash, uint64_t& size)
+{
+    FILE *fd = RsDirUtil::rs_fopen(full_path.c_str(), "rb") ;
 
-#ifdef HASHSTORAGE_DEBUG
-                std::cerr << "done."<< std::endl;
+    if(fd == NULL)
+        return false ;
+
+    // We read large blocks directly into our own buffer, so stdio buffering is useless.
+
+    setvbuf(fd, NULL, _IONBF, 0) ;
+#if defined(POSIX_FADV_SEQUENTIAL) && !defined(WINDOWS_SYS)
+    posix_fadvise(fileno(fd), 0, 0, POSIX_FADV_SEQUENTIAL) ;
 #endif
 
-                RS_STACK_MUTEX(mHashMtx) ;
-                HashStorageInfo& info(mFiles[job.real_path]);
+    SHA_CTX sha_ctx ;
+    SHA1_Init(&sha_ctx) ;
 
-                info.filename = job.real_path ;
-                info.size = size ;
-                info.modf_stamp = job.ts ;
-                info.time_stamp = time(NULL);
-                info.hash = hash;
+    size = 0 ;
+    uint64_t not_reported = 0 ;
+    size_t len ;
 
-                mChanged = true ;
-                mTotalHashedSize += size ;
-            }
-            else
-                std::cerr << "ERROR: cannot hash file " << job.full_path << std::endl;
+    while((len = fread(mBuffer, 1, HASH_STORAGE_READ_BUFFER_SIZE, fd)) > 0)
+    {
+        SHA1_Update(&sha_ctx, mBuffer, len) ;
+        size += len ;
+        not_reported += len ;
+
+        if(not_reported >= HASH_STORAGE_REPORT_SIZE)
+        {
+            mStorage->reportHashedBytes(not_reported) ;
+            not_reported = 0 ;
 
-            ++mHashCounter ;
+            if(shouldStop())
+            {
+                fclose(fd) ;
+                return false ;
+            }
         }
     }
-    // call the client
+    mStorage->reportHashedBytes(not_reported) ;
 
-    if(!hash.isNull())
-        job.client->hash_callback(job.client_param, job.full_path, hash, size);
+    bool ok = !ferror(fd) ;
+    fclose(fd) ;
+
+    if(!ok)
+        return false ;
+
+    unsigned char sha_buf[SHA_DIGEST_LENGTH];
+    SHA1_Final(&sha_buf[0], &sha_ctx) ;
+
+    hash = RsFileHash(sha_buf) ;
+    return true ;
 }
 
 bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t mod_time,RsFileHash& known_hash,HashStorageClient *c,uint32_t client_param)
@@ -263,13 +509,17 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t
 
     // we need to schedule a re-hashing
 
-    if(mFilesToHash.find(real_path) != mFilesToHash.end())
+    uint64_t device = fileDeviceId(real_path) ;
+    std::map<std::string,FileHashJob>& device_jobs(mFilesToHash[device]) ;
+
+    if(device_jobs.find(real_path) != device_jobs.end())
         return false ;
 
     FileHashJob job ;
 
     job.client = c ;
     job.size = size ;
+    job.device = device ;
     job.client_param = client_param ;
     job.full_path = full_path ;
     job.real_path = real_path ;
@@ -278,7 +528,7 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t
 	// We store the files indexed by their real path, so that we allow to not re-hash files that are pointed multiple times through the directory links
 	// The client will be notified with the full path instead of the real path.
 
-    mFilesToHash[real_path] = job;
+    device_jobs[real_path] = job;
 
     mTotalSizeToHash += size ;
     ++mTotalFilesToHash;
@@ -289,6 +539,7 @@ bool HashStorage::requestHash(const std::string& full_path,uint64_t size,time_t
         std::cerr << "Starting hashing thread." << std::endl;
         mHashCounter = 0;
         mTotalHashedSize = 0;
+        mHashingStartTime = now ;
 
 		start("fs hash cache") ;
     }
@@ -27,6 +27,7 @@
 #pragma once
 
 #include <map>
+#include <vector>
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 
@@ -51,10 +52,34 @@ public:
     virtual bool hash_confirm(uint32_t client_param)=0 ;
 };
 
+class HashStorage ;
+
+/*!
+ * \brief The HashStorageWorker class
+ * 		One hashing thread of the HashStorage pool. Workers pick jobs from the storage queue, hash the file using a large
+ * 		read buffer, and send the result back to the storage.
+ */
+class HashStorageWorker: public RsTickingThread
+{
+public:
+    HashStorageWorker(HashStorage *storage) ;
+    virtual ~HashStorageWorker() ;
+
+    virtual void data_tick() ;
+
+private:
+    bool hashFile(const std::string& full_path, RsFileHash& hash, uint64_t& size) ;
+
+    HashStorage *mStorage ;
+    unsigned char *mBufferMemory ;	// allocated memory
+    unsigned char *mBuffer ;		// aligned read buffer, inside mBufferMemory
+};
+
 class HashStorage: public RsTickingThread
 {
 public:
     HashStorage(const std::string& save_file_name) ;
+    virtual ~HashStorage() ;
 
     /*!
      * \brief requestHash  Requests the hash for the given file, assuming size and mod_time are the same.
@@ -87,6 +112,16 @@ public:
 	void togglePauseHashingProcess() ;
 	bool hashingProcessPaused();
 
+    // Size of the pool of hashing threads, and maximum number of files hashed at the same time on a single storage
+    // device. The default of 1 per device avoids thrashing spinning disks. SSD/NVMe users can raise it.
+    void setMaxHashingThreads(uint32_t n) ;
+    uint32_t maxHashingThreads() ;
+    void setMaxHashingThreadsPerDevice(uint32_t n) ;
+    uint32_t maxHashingThreadsPerDevice() ;
+
+    // Stops and deletes the hashing threads. Must be called when stopping the storage thread.
+    void stopWorkers() ;
+
     // Functions called by the thread
 
     virtual void data_tick() ;
@@ -121,14 +156,32 @@ private:
         std::string full_path;		// canonicalized file name (means: symlinks removed, loops removed, etc)
         std::string real_path;		// path supplied by the client.
         uint64_t size ;
+        uint64_t device ;			// storage device the file is on. Used to limit concurrent hashing per disk.
         HashStorageClient *client;
         uint32_t client_param ;
         time_t ts;
     };
 
-    // current work
+    // Functions called by the hashing threads
+
+    friend class HashStorageWorker ;
+
+    bool getNextJob(FileHashJob& job) ;
+    void jobDone(const FileHashJob& job, bool hashed, const RsFileHash& hash, uint64_t size) ;
+    void reportHashedBytes(uint64_t n) ;
+
+    void locked_updateWorkers(std::vector<HashStorageWorker*>& to_stop) ;
+
+    // current work, sorted by device, then by real path.
+
+    std::map<uint64_t,std::map<std::string,FileHashJob> > mFilesToHash ;
+    std::map<uint64_t,uint32_t> mActiveJobsPerDevice ;
+    uint32_t mActiveJobs ;
+    std::string mLastStartedFile ;	// for display only
 
-    std::map<std::string,FileHashJob> mFilesToHash ;
+    std::vector<HashStorageWorker*> mWorkers ;
+    uint32_t mMaxHashingThreads ;
+    uint32_t mMaxHashingThreadsPerDevice ;
 
     // thread/mutex stuff
 
@@ -139,6 +192,8 @@ private:
     uint64_t mTotalSizeToHash ;
     uint64_t mTotalHashedSize ;
     uint64_t mTotalFilesToHash ;
+    time_t mHashingStartTime ;
+    time_t mLastNotifyTime ;
     time_t mLastSaveTime ;
 };
 
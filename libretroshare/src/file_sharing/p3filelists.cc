@@ -265,6 +265,7 @@ void p3FileDatabase::stopThreads()
     P3FILELISTS_DEBUG() << "Stopping hash cache thread..." ; std::cerr.flush() ;
 #endif
     mHashCache->fullstop();
+    mHashCache->stopWorkers();
 #ifdef DEBUG_P3FILELISTS
     P3FILELISTS_DEBUG() << "Done." << std::endl;
     P3FILELISTS_DEBUG() << "Stopping directory watcher thread..." ; std::cerr.flush() ;
@@ -345,6 +346,28 @@ cleanup = true;
 
         rskv->tlvkvs.pairs.push_back(kv);
     }
+    {
+        std::string s ;
+        rs_sprintf(s, "%u", mHashCache->maxHashingThreads()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = HASHING_THREADS_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
+    {
+        std::string s ;
+        rs_sprintf(s, "%u", mHashCache->maxHashingThreadsPerDevice()) ;
+
+        RsTlvKeyValue kv;
+
+        kv.key = HASHING_THREADS_PER_DEVICE_SS;
+        kv.value = s ;
+
+        rskv->tlvkvs.pairs.push_back(kv);
+    }
 	{
         RsTlvKeyValue kv;
 
@@ -513,6 +536,18 @@ bool p3FileDatabase::loadList(std::list<RsItem *>& load)
                 if(sscanf(kit->value.c_str(),"%d",&t) == 1)
                     max_share_depth = (uint32_t)t ;
 			}
+			else if(kit->key == HASHING_THREADS_SS)
+			{
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setMaxHashingThreads(t) ;
+			}
+			else if(kit->key == HASHING_THREADS_PER_DEVICE_SS)
+			{
+                uint32_t t=0 ;
+                if(sscanf(kit->value.c_str(),"%u",&t) == 1)
+                    mHashCache->setMaxHashingThreadsPerDevice(t) ;
+			}
 
             delete *it ;
             continue ;
@@ -606,6 +641,7 @@ void p3FileDatabase::cleanup()
                 // also remove the existing file
 
                 remove(mRemoteDirectories[i]->filename().c_str()) ;
+                remove(mRemoteDirectories[i]->summaryFilename().c_str()) ;
 
                 delete mRemoteDirectories[i];
                 mRemoteDirectories[i] = NULL ;
@@ -658,6 +694,14 @@ void p3FileDatabase::cleanup()
                 ++it ;
             }
 
+        // give up directory updates sent in parts, for which the remaining parts never came.
+
+        for(uint32_t i=0;i<mRemoteDirectories.size();++i)
+        {
+            if(mRemoteDirectories[i] != NULL)
+                mRemoteDirectories[i]->cleanupDirUpdates(DELAY_BEFORE_DROP_REQUEST) ;
+        }
+
 		// This is needed at least here, because loadList() might never have been called, if there is no config file present.
 
 		if(mLocalDirWatcher->hashSalt().isNull())
@@ -1126,6 +1170,24 @@ int  p3FileDatabase::maxShareDepth() const
     RS_STACK_MUTEX(mFLSMtx) ;
     return mLocalDirWatcher->maxShareDepth() ;
 }
+void p3FileDatabase::setMaxHashingThreads(uint32_t n)
+{
+    mHashCache->setMaxHashingThreads(n) ;
+    IndicateConfigChanged();
+}
+uint32_t p3FileDatabase::maxHashingThreads()
+{
+    return mHashCache->maxHashingThreads() ;
+}
+void p3FileDatabase::setMaxHashingThreadsPerDevice(uint32_t n)
+{
+    mHashCache->setMaxHashingThreadsPerDevice(n) ;
+    IndicateConfigChanged();
+}
+uint32_t p3FileDatabase::maxHashingThreadsPerDevice()
+{
+    return mHashCache->maxHashingThreadsPerDevice() ;
+}
 void p3FileDatabase::setWatchEnabled(bool b)
 {
     RS_STACK_MUTEX(mFLSMtx) ;
@@ -1429,6 +1491,7 @@ void p3FileDatabase::tickSend()
 void p3FileDatabase::handleDirSyncRequest(RsFileListsSyncRequestItem *item)
 {
     RsFileListsSyncResponseItem *ritem = new RsFileListsSyncResponseItem;
+    std::list<RsTlvBinaryData> parts ;
 
     // look at item TS. If local is newer, send the full directory content.
     {
@@ -1483,7 +1546,12 @@ void p3FileDatabase::handleDirSyncRequest(RsFileListsSyncRequestItem *item)
                 ritem->last_known_recurs_modf_TS = local_recurs_max_time;
 
                 // We supply the peer id, in order to possibly remove some subdirs, if entries are not allowed to be seen by this peer.
-                mLocalSharedDirs->serialiseDirEntry(entry_index,ritem->directory_content_data,item->PeerId()) ;
+                // Friends that can handle it get the content in parts, with only the name and TS of the files they already know.
+
+                if(item->flags & RsFileListsItem::FLAGS_SYNC_STREAM_OK)
+                    mLocalSharedDirs->serialiseDirEntryParts(entry_index,parts,item->PeerId(),item->last_known_recurs_modf_TS) ;
+                else
+                    mLocalSharedDirs->serialiseDirEntry(entry_index,ritem->directory_content_data,item->PeerId()) ;
             }
             else
             {
@@ -1499,7 +1567,38 @@ void p3FileDatabase::handleDirSyncRequest(RsFileListsSyncRequestItem *item)
 
     // sends the response.
 
-    splitAndSendItem(ritem) ;
+    if(parts.empty())
+    {
+        splitAndSendItem(ritem) ;
+        return ;
+    }
+
+#ifdef DEBUG_P3FILELISTS
+    P3FILELISTS_DEBUG() << "  Sending directory content in " << parts.size() << " parts." << std::endl;
+#endif
+
+    for(std::list<RsTlvBinaryData>::iterator it(parts.begin());it!=parts.end();)
+    {
+        RsFileListsSyncResponseItem *pitem = new RsFileListsSyncResponseItem;
+
+        pitem->PeerId(ritem->PeerId()) ;
+        pitem->request_id                = ritem->request_id;
+        pitem->entry_hash                = ritem->entry_hash ;
+        pitem->last_known_recurs_modf_TS = ritem->last_known_recurs_modf_TS ;
+        pitem->flags                     = ritem->flags | RsFileListsItem::FLAGS_SYNC_STREAM ;
+
+        // move the data to the item, without copying it.
+
+        pitem->directory_content_data.bin_data = it->bin_data ;
+        pitem->directory_content_data.bin_len  = it->bin_len ;
+        it->TlvShallowClear() ;
+
+        if(++it == parts.end())
+            pitem->flags |= RsFileListsItem::FLAGS_SYNC_STREAM_END ;
+
+        splitAndSendItem(pitem) ;
+    }
+    delete ritem ;
 }
 
 void p3FileDatabase::splitAndSendItem(RsFileListsSyncResponseItem *ritem)
@@ -1654,6 +1753,7 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
     // find the correct friend entry
 
     uint32_t fi = 0 ;
+    bool request_done = true ;
 
     {
         RS_STACK_MUTEX(mFLSMtx) ;
@@ -1711,7 +1811,19 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
         P3FILELISTS_DEBUG() << "Performing update of directory index " << std::hex << entry_index << std::dec << " from friend " << item->PeerId() << std::endl;
 #endif
 
-        if(mRemoteDirectories[fi]->deserialiseUpdateDirEntry(entry_index,item->directory_content_data))
+        bool ok ;
+
+        if(item->flags & RsFileListsItem::FLAGS_SYNC_STREAM)
+        {
+            // parts are used as they come. The request is kept until the last one, so that no new request is sent meanwhile.
+
+            ok = mRemoteDirectories[fi]->deserialiseUpdateDirEntryPart(entry_index,item->directory_content_data,item->flags & RsFileListsItem::FLAGS_SYNC_STREAM_END) ;
+            request_done = !ok || (item->flags & RsFileListsItem::FLAGS_SYNC_STREAM_END) ;
+        }
+        else
+            ok = mRemoteDirectories[fi]->deserialiseUpdateDirEntry(entry_index,item->directory_content_data) ;
+
+        if(ok)
 			mRemoteDirectories[fi]->lastSweepTime() = now - DELAY_BETWEEN_REMOTE_DIRECTORIES_SWEEP + 10 ;  // force re-sweep in 10 secs, so as to fasten updated
         else
             P3FILELISTS_ERROR() << "(EE) Cannot deserialise dir entry. ERROR. "<< std::endl;
@@ -1724,6 +1836,7 @@ void p3FileDatabase::handleDirSyncResponse(RsFileListsSyncResponseItem*& sitem)
 
 	// remove the original request from pending list in the end. doing this here avoids that a new request is added while the previous response is not treated.
 
+    if(request_done)
     {
         RS_STACK_MUTEX(mFLSMtx) ;
 
@@ -1773,6 +1886,8 @@ void p3FileDatabase::locked_recursSweepRemoteDirectory(RemoteDirectoryStorage *r
 #endif
        }
 
+   // the hierarchy has been loaded by getDirectoryUpdateTime() above, so it can be iterated.
+
    for(DirectoryStorage::DirIterator it(rds,e);it;++it)
        locked_recursSweepRemoteDirectory(rds,*it,depth+1);
 }
@@ -1834,7 +1949,7 @@ bool p3FileDatabase::locked_generateAndSendSyncRequest(RemoteDirectoryStorage *r
     RsFileListsSyncRequestItem *item = new RsFileListsSyncRequestItem ;
 
     item->entry_hash = entry_hash ;
-    item->flags = RsFileListsItem::FLAGS_SYNC_REQUEST ;
+    item->flags = RsFileListsItem::FLAGS_SYNC_REQUEST | RsFileListsItem::FLAGS_SYNC_STREAM_OK ;
     item->request_id = sync_req_id ;
     item->last_known_recurs_modf_TS = max_known_recurs_modf_time ;
     item->PeerId(rds->peerId()) ;
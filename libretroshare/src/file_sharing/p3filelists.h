@@ -136,6 +136,11 @@ class p3FileDatabase: public p3Service, public p3Config, public ftSearch //, pub
 		void setMaxShareDepth(int i) ;
 		int  maxShareDepth() const ;
 
+		void setMaxHashingThreads(uint32_t n) ;
+		uint32_t maxHashingThreads() ;
+		void setMaxHashingThreadsPerDevice(uint32_t n) ;
+		uint32_t maxHashingThreadsPerDevice() ;
+
         // computes/gathers statistics about shared directories
 
 		int getSharedDirStatistics(const RsPeerId& pid,SharedDirStats& stats);
@@ -66,6 +66,9 @@ public:
     static const uint32_t FLAGS_ENTRY_WAS_REMOVED = 0x0010 ;
     static const uint32_t FLAGS_SYNC_PARTIAL      = 0x0020 ;
     static const uint32_t FLAGS_SYNC_PARTIAL_END  = 0x0040 ;
+    static const uint32_t FLAGS_SYNC_STREAM_OK    = 0x0080 ;	// request: the client can use directory content sent in parts
+    static const uint32_t FLAGS_SYNC_STREAM       = 0x0100 ;	// response: one part of the directory content
+    static const uint32_t FLAGS_SYNC_STREAM_END   = 0x0200 ;	// response: last part of the directory content
 };
 
 /*!
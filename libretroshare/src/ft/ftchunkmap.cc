@@ -39,6 +39,7 @@
 static const uint32_t SOURCE_CHUNK_MAP_UPDATE_PERIOD	=   60 ; //! TTL for chunkmap info
 static const uint32_t INACTIVE_CHUNK_TIME_LAPSE 		= 3600 ; //! TTL for an inactive chunk
 static const uint32_t FT_CHUNKMAP_MAX_CHUNK_JUMP		=   50 ; //! Maximum chunk jump in progressive DL mode
+static const uint32_t FT_CHUNKMAP_STREAMING_WINDOW	=    8 ; //! Chunks fetched in order after the playback cursor
 
 std::ostream& operator<<(std::ostream& o,const ftChunk& c)
 {
@@ -78,6 +79,15 @@ ChunkMap::ChunkMap(uint64_t s,bool availability)
 	_strategy = FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE ;
 	_total_downloaded = 0 ;
 	_file_is_complete = false ;
+
+	// all chunks are outstanding, and no source is known yet.
+	_chunk_availability.resize(n,0) ;
+	_full_sources = 0 ;
+	_playback_cursor = 0 ;
+	_outstanding_by_availability.resize(1) ;
+
+	for(uint32_t i=0;i<n;++i)
+		_outstanding_by_availability[0].insert(_outstanding_by_availability[0].end(),i) ;
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "*** ChunkMap::ChunkMap: starting new chunkmap:" << std::endl ; 
 	std::cerr << "   File size: " << s << std::endl ;
@@ -110,16 +120,84 @@ void ChunkMap::setAvailabilityMap(const CompressedChunkMap& map)
 	for(uint32_t i=0;i<_map.size();++i)
 		if(map[i] > 0)
 		{
-			_map[i] = FileChunksInfo::CHUNK_DONE ;
+			setChunkState(i,FileChunksInfo::CHUNK_DONE) ;
 			_total_downloaded += sizeOfChunk(i) ;
 		}
 		else
 		{
-			_map[i] = FileChunksInfo::CHUNK_OUTSTANDING ;
+			setChunkState(i,FileChunksInfo::CHUNK_OUTSTANDING) ;
 			_file_is_complete = false ;
 		}
 }
 
+void ChunkMap::setChunkState(uint32_t c,FileChunksInfo::ChunkState s)
+{
+	if(_map[c] == s)
+		return ;
+
+	if(_map[c] == FileChunksInfo::CHUNK_OUTSTANDING)
+		outstandingChunks(_chunk_availability[c]).erase(c) ;
+	else if(s == FileChunksInfo::CHUNK_OUTSTANDING)
+		outstandingChunks(_chunk_availability[c]).insert(c) ;
+
+	_map[c] = s ;
+}
+
+std::set<ChunkMap::ChunkNumber>& ChunkMap::outstandingChunks(uint32_t availability)
+{
+	if(availability >= _outstanding_by_availability.size())
+		_outstanding_by_availability.resize(availability+1) ;
+
+	return _outstanding_by_availability[availability] ;
+}
+
+void ChunkMap::updateSourceAvailability(const SourceChunksInfo *old_info,const SourceChunksInfo *new_info)
+{
+	// Full maps only change the counter of full sources. Partial maps are compared chunk by chunk, and
+	// only chunks which availability changes are moved to another set.
+
+	bool old_full = old_info != NULL && old_info->is_full ;
+	bool new_full = new_info != NULL && new_info->is_full ;
+
+	_full_sources = _full_sources + new_full - old_full ;
+
+	bool old_partial = old_info != NULL && !old_full ;
+	bool new_partial = new_info != NULL && !new_full ;
+
+	if(!old_partial && !new_partial)
+		return ;
+
+	for(uint32_t i=0;i<_map.size();++i)
+	{
+		bool had = old_partial && old_info->cmap[i] ;
+		bool has = new_partial && new_info->cmap[i] ;
+
+		if(had == has)
+			continue ;
+
+		bool outstanding = (_map[i] == FileChunksInfo::CHUNK_OUTSTANDING) ;
+
+		if(outstanding)
+			outstandingChunks(_chunk_availability[i]).erase(i) ;
+
+		if(has)
+			++_chunk_availability[i] ;
+		else
+			--_chunk_availability[i] ;
+
+		if(outstanding)
+			outstandingChunks(_chunk_availability[i]).insert(i) ;
+	}
+}
+
+uint32_t ChunkMap::getChunkAvailability(uint32_t chunk_number) const
+{
+	if(chunk_number >= _chunk_availability.size())
+		return 0 ;
+
+	return _chunk_availability[chunk_number] + _full_sources ;
+}
+
 void ChunkMap::dataReceived(const ftChunk::ChunkId& cid)
 {
 	// 1 - find which chunk contains the received data.
@@ -164,12 +242,12 @@ void ChunkMap::dataReceived(const ftChunk::ChunkId& cid)
 		std::cerr << "*** ChunkMap::dataReceived: Chunk is complete. Removing it." << std::endl ;
 #endif
 
-		_map[n] = FileChunksInfo::CHUNK_CHECKING ;
+		setChunkState(n,FileChunksInfo::CHUNK_CHECKING) ;
 
 		if(n > 0 || _file_size > CHUNKMAP_FIXED_CHUNK_SIZE)	// dont' put <1MB files into checking mode. This is useless.
 			_chunks_checking_queue.push_back(n) ;
 		else
-			_map[n] = FileChunksInfo::CHUNK_DONE ;
+			setChunkState(n,FileChunksInfo::CHUNK_DONE) ;
 
 		_slices_to_download.erase(itc) ;
 
@@ -236,7 +314,7 @@ void ChunkMap::setChunkCheckingResult(uint32_t chunk_number,bool check_succeeded
 	
 	if(check_succeeded)
 	{
-		_map[chunk_number] = FileChunksInfo::CHUNK_DONE ;
+		setChunkState(chunk_number,FileChunksInfo::CHUNK_DONE) ;
 
 		// We also check whether the file is complete or not.
 
@@ -252,7 +330,7 @@ void ChunkMap::setChunkCheckingResult(uint32_t chunk_number,bool check_succeeded
 	else
 	{
 		_total_downloaded -= sizeOfChunk(chunk_number) ;	// restore completion.
-		_map[chunk_number] = FileChunksInfo::CHUNK_OUTSTANDING ;
+		setChunkState(chunk_number,FileChunksInfo::CHUNK_OUTSTANDING) ;
 	}
 }
 
@@ -331,7 +409,7 @@ bool ChunkMap::getDataChunk(const RsPeerId& peer_id,uint32_t size_hint,ftChunk&
 				//
 				uint32_t soc = sizeOfChunk(c) ;
 				_active_chunks_feed[peer_id] = Chunk( c*(uint64_t)_chunk_size, soc ) ;
-				_map[c] = FileChunksInfo::CHUNK_ACTIVE ;
+				setChunkState(c,FileChunksInfo::CHUNK_ACTIVE) ;
 				_slices_to_download[c]._remains = soc ;			// init the list of slices to download
 				it = _active_chunks_feed.find(peer_id) ;
 #ifdef DEBUG_FTCHUNK
@@ -380,7 +458,7 @@ void ChunkMap::removeInactiveChunks(std::vector<ftChunk::ChunkId>& to_remove)
 			for(std::map<ftChunk::ChunkId,uint32_t>::const_iterator it2(it->second._slices.begin());it2!=it->second._slices.end();++it2)
 				to_remove.push_back(it2->first) ;
 
-			_map[it->first] = FileChunksInfo::CHUNK_OUTSTANDING ;	// reset the chunk
+			setChunkState(it->first,FileChunksInfo::CHUNK_OUTSTANDING) ;	// reset the chunk
 
 			_total_downloaded -= (sizeOfChunk(it->first) - it->second._remains) ;	// restore completion.
 
@@ -453,20 +531,33 @@ void ChunkMap::setPeerAvailabilityMap(const RsPeerId& peer_id,const CompressedCh
 
 	// sets the map.
 	//
-	SourceChunksInfo& mi(_peers_chunks_availability[peer_id]) ;
-	mi.cmap = cmap ;
-	mi.TS = time(NULL) ;
-	mi.is_full = true ;
+	SourceChunksInfo new_info ;
+	new_info.cmap = cmap ;
+	new_info.TS = time(NULL) ;
+	new_info.is_full = true ;
 
 	// Checks wether the map is full of not.
 	//
 	for(uint32_t i=0;i<_map.size();++i)
 		if(!cmap[i])
 		{
-			mi.is_full = false ;
+			new_info.is_full = false ;
 			break ;
 		}
 
+	std::map<RsPeerId,SourceChunksInfo>::iterator it(_peers_chunks_availability.find(peer_id)) ;
+
+	if(it == _peers_chunks_availability.end())
+	{
+		updateSourceAvailability(NULL,&new_info) ;
+		_peers_chunks_availability[peer_id] = new_info ;
+	}
+	else
+	{
+		updateSourceAvailability(&it->second,&new_info) ;
+		it->second = new_info ;
+	}
+
 #ifdef DEBUG_FTCHUNK
 	std::cerr << "ChunkMap::setPeerAvailabilityMap: Setting chunk availability info for peer " << peer_id << std::endl ;
 #endif
@@ -506,6 +597,8 @@ SourceChunksInfo *ChunkMap::getSourceChunksInfo(const RsPeerId& peer_id)
 			pchunks.cmap._map.resize( CompressedChunkMap::getCompressedSize(_map.size()),~(uint32_t)0 ) ;
 			pchunks.TS = 0 ;
 			pchunks.is_full = true ;
+
+			updateSourceAvailability(NULL,&pchunks) ;
 		}
 		else
 		{
@@ -548,6 +641,28 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 	else
 		map_is_too_old = false ;// the map is not too old
 
+	// These strategies don't need to go through the whole map.
+
+	if(_strategy == FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST && !_map.empty())
+	{
+		uint32_t start = std::min(_playback_cursor / _chunk_size, (uint64_t)_map.size()-1) ;
+		uint32_t end   = std::min(start + FT_CHUNKMAP_STREAMING_WINDOW, (uint32_t)_map.size()) ;
+
+		for(uint32_t i=start;i<end;++i)
+			if(_map[i] == FileChunksInfo::CHUNK_OUTSTANDING && (peer_chunks->is_full || peer_chunks->cmap[i]))
+				return i ;
+	}
+
+	if(_strategy == FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST || _strategy == FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST)
+	{
+		uint32_t c = getRarestAvailableChunk(peer_chunks) ;
+#ifdef DEBUG_FTCHUNK
+		if(c < _map.size())
+			std::cerr << "ChunkMap::getAvailableChunk: returning chunk " << c << " with availability " << getChunkAvailability(c) << " for peer " << peer_id << std::endl;
+#endif
+		return c ;
+	}
+
 	uint32_t available_chunks = 0 ;
 	uint32_t available_chunks_before_max_dist = 0 ;
 
@@ -598,6 +713,40 @@ uint32_t ChunkMap::getAvailableChunk(const RsPeerId& peer_id,bool& map_is_too_ol
 	return _map.size() ;
 }
 
+uint32_t ChunkMap::getRarestAvailableChunk(const SourceChunksInfo *peer_chunks) const
+{
+	if(_map.empty())
+		return 0 ;
+
+	// Among chunks with the same availability, start from a random place so that peers downloading
+	// the same file don't all pick the same chunk.
+
+	ChunkNumber start = rand() % _map.size() ;
+
+	for(uint32_t a=0;a<_outstanding_by_availability.size();++a)
+	{
+		const std::set<ChunkNumber>& chunks(_outstanding_by_availability[a]) ;
+
+		if(chunks.empty())
+			continue ;
+
+		std::set<ChunkNumber>::const_iterator it(chunks.lower_bound(start)) ;
+
+		if(peer_chunks->is_full)
+			return (it != chunks.end())? *it : *chunks.begin() ;
+
+		for(;it!=chunks.end();++it)
+			if(peer_chunks->cmap[*it])
+				return *it ;
+
+		for(it=chunks.begin();it!=chunks.end() && *it < start;++it)
+			if(peer_chunks->cmap[*it])
+				return *it ;
+	}
+
+	return _map.size() ;
+}
+
 void ChunkMap::getChunksInfo(FileChunksInfo& info) const 
 {
 	info.file_size = _file_size ;
@@ -623,6 +772,7 @@ void ChunkMap::removeFileSource(const RsPeerId& peer_id)
 	if(it == _peers_chunks_availability.end())
 		return ;
 
+	updateSourceAvailability(&it->second,NULL) ;
 	_peers_chunks_availability.erase(it) ;
 }
 
@@ -639,7 +789,7 @@ void ChunkMap::forceCheck()
 {
 	for(uint32_t i=0;i<_map.size();++i)
 	{
-		_map[i] = FileChunksInfo::CHUNK_CHECKING ;
+		setChunkState(i,FileChunksInfo::CHUNK_CHECKING) ;
 		_chunks_checking_queue.push_back(i) ;
 	}
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <set>
 #include "retroshare/rstypes.h"
 
 // ftChunkMap: 
@@ -131,11 +132,20 @@ class ChunkMap
       /// Decides how chunks are selected. 
       ///    STREAMING: the 1st chunk is always returned
       ///       RANDOM: a uniformly random chunk is selected among available chunks for the current source.
-      ///              
+      /// RAREST_FIRST: a chunk that the fewest sources have is selected, so that sources downloading the same file
+      ///               always have something to exchange.
+      ///    STREAMING_RAREST: chunks right after the playback cursor are selected in order, rarest first otherwise.
 
 		void setStrategy(FileChunksInfo::ChunkStrategy s) { _strategy = s ; }
 		FileChunksInfo::ChunkStrategy getStrategy() const { return _strategy ; }
 
+		/// Position (in bytes) a media player is reading the file at. Used by the STREAMING_RAREST strategy.
+		void setPlaybackCursor(uint64_t offset) { _playback_cursor = offset ; }
+		uint64_t getPlaybackCursor() const { return _playback_cursor ; }
+
+		/// Number of sources known to have the given chunk.
+		uint32_t getChunkAvailability(uint32_t chunk_number) const ;
+
       /// Properly fills an vector of fixed size chunks with availability or download state.
       /// chunks is given with the proper number of chunks and we have to adapt to it. This can be used
       /// to display square chunks in the gui or display a blue bar of availability by collapsing info from all peers.
@@ -207,9 +217,19 @@ class ChunkMap
 		//
 		uint32_t getAvailableChunk(const RsPeerId& peer_id,bool& chunk_map_too_old) ;
 
+		/// Returns the outstanding chunk available from the given source that the fewest sources have.
+		uint32_t getRarestAvailableChunk(const SourceChunksInfo *peer_chunks) const ;
+
 	private:
         bool hasChunkState(uint64_t offset, uint32_t chunk_size, FileChunksInfo::ChunkState state) const;
 
+		/// All changes of chunk state go through this, to keep the outstanding chunks sorted by availability.
+		void setChunkState(uint32_t chunk_number, FileChunksInfo::ChunkState s) ;
+
+		/// Updates the availability counts when the map of a source changes. NULL means no map.
+		void updateSourceAvailability(const SourceChunksInfo *old_info,const SourceChunksInfo *new_info) ;
+		std::set<ChunkNumber>& outstandingChunks(uint32_t availability) ;
+
 		uint64_t												_file_size ;						//! total size of the file in bytes.
 		uint32_t												_chunk_size ;						//! Size of chunks. Common to all chunks.
 		FileChunksInfo::ChunkStrategy 				_strategy ;							//! how do we allocate new chunks
@@ -221,6 +241,12 @@ class ChunkMap
 		bool													_file_is_complete ;           //! set to true when the file is complete.
 		bool													_assume_availability ;			//! true if all sources always have the complete file.
 		std::vector<uint32_t>							_chunks_checking_queue ;		//! Queue of downloaded chunks to be checked.
+
+		// Rarity histogram. Sources that have the full file count for all chunks, so they are only counted in _full_sources.
+		std::vector<uint32_t>							_chunk_availability ;			//! number of partial sources having each chunk
+		uint32_t												_full_sources ;					//! number of sources having the complete file
+		std::vector<std::set<ChunkNumber> >			_outstanding_by_availability ;//! outstanding chunks, indexed by _chunk_availability
+		uint64_t												_playback_cursor ;				//! where a media player reads the file
 };
 
 
@@ -111,6 +111,7 @@ ftController::ftController(ftDataMultiplex *dm, p3ServiceControl *sc, uint32_t f
     mFtServiceType(ftServiceId),
     mDefaultEncryptionPolicy(RS_FILE_CTRL_ENCRYPTION_POLICY_PERMISSIVE),
     mFilePermDirectDLPolicy(RS_FILE_PERM_DIRECT_DL_PER_USER),
+    mPipelinedTransfers(true),
     cnt(0),
     ctrlMutex("ftController"),
     doneMutex("ftController"),
@@ -140,6 +141,7 @@ bool ftController::getFileDownloadChunksDetails(const RsFileHash& hash,FileChunk
 	if(it != mDownloads.end())
 	{
 		it->second->mCreator->getChunkMap(info) ;
+		it->second->mTransfer->getPeerTransferInfo(info.peer_transfer_info) ;
 		//info.flags = it->second->mFlags ;
 
 		return true ;
@@ -1155,6 +1157,7 @@ bool 	ftController::FileRequest(const std::string& fname, const RsFileHash& hash
 
 	ftFileCreator *fc = new ftFileCreator(savepath, size, hash,assume_availability);
 	ftTransferModule *tm = new ftTransferModule(fc, mDataplex,this);
+	tm->setPipelining(pipelinedTransfers()) ;
 
 #ifdef CONTROL_DEBUG
 	std::cerr << "Note: setting chunk strategy to " << mDefaultChunkStrategy <<std::endl ;
@@ -1248,6 +1251,18 @@ bool ftController::setChunkStrategy(const RsFileHash& hash,FileChunksInfo::Chunk
 	return true ;
 }
 
+bool ftController::setPlaybackCursor(const RsFileHash& hash,uint64_t offset)
+{
+	RsStackMutex stack(ctrlMutex); /******* LOCKED ********/
+
+    std::map<RsFileHash,ftFileControl*>::iterator mit=mDownloads.find(hash);
+	if (mit==mDownloads.end())
+		return false;
+
+	mit->second->mCreator->setPlaybackCursor(offset) ;
+	return true ;
+}
+
 bool 	ftController::FileCancel(const RsFileHash& hash)
 {
     mFtServer->activateTunnels(hash,mDefaultEncryptionPolicy,TransferRequestFlags(0),false);
@@ -1792,6 +1807,7 @@ const std::string default_chunk_strategy_ss("DEFAULT_CHUNK_STRATEGY");
 const std::string free_space_limit_ss("FREE_SPACE_LIMIT");
 const std::string default_encryption_policy_ss("DEFAULT_ENCRYPTION_POLICY");
 const std::string file_perm_direct_dl_ss("FILE_PERM_DIRECT_DL");
+const std::string memory_mapped_reads_ss("MEMORY_MAPPED_READS");
 
 
 	/* p3Config Interface */
@@ -1831,6 +1847,10 @@ bool ftController::saveList(bool &cleanup, std::list<RsItem *>& saveData)
 																	  	break ;
 		case FileChunksInfo::CHUNK_STRATEGY_RANDOM:		configMap[default_chunk_strategy_ss] =  "RANDOM" ;
 																		break ;
+		case FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST:		configMap[default_chunk_strategy_ss] =  "RAREST_FIRST" ;
+																		break ;
+		case FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST:	configMap[default_chunk_strategy_ss] =  "STREAMING_RAREST" ;
+																		break ;
 
 		default:
 		case FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE:configMap[default_chunk_strategy_ss] =  "PROGRESSIVE" ;
@@ -1854,6 +1874,8 @@ bool ftController::saveList(bool &cleanup, std::list<RsItem *>& saveData)
 	rs_sprintf(s, "%lu", RsDiscSpace::freeSpaceLimit());
 	configMap[free_space_limit_ss] = s ;
 
+	configMap[memory_mapped_reads_ss] = mDataplex->memoryMappedReads()?"YES":"NO" ;
+
 	RsConfigKeyValueSet *rskv = new RsConfigKeyValueSet();
 
 	/* Convert to TLV */
@@ -2124,6 +2146,16 @@ bool  ftController::loadConfigMap(std::map<std::string, std::string> &configMap)
 			setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
 			std::cerr << "Note: loading default value for chunk strategy: progressive" << std::endl;
 		}
+		else if(mit->second == "RAREST_FIRST")
+		{
+			setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+			std::cerr << "Note: loading default value for chunk strategy: rarest first" << std::endl;
+		}
+		else if(mit->second == "STREAMING_RAREST")
+		{
+			setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST) ;
+			std::cerr << "Note: loading default value for chunk strategy: streaming/rarest first" << std::endl;
+		}
 		else
 			std::cerr << "**** ERROR ***: Unknown value for default chunk strategy in keymap." << std::endl ;
 	}
@@ -2166,6 +2198,9 @@ bool  ftController::loadConfigMap(std::map<std::string, std::string> &configMap)
 		}
 	}
 
+	if(configMap.end() != (mit = configMap.find(memory_mapped_reads_ss)))
+		mDataplex->setMemoryMappedReads(mit->second == "YES") ;
+
 	return true;
 }
 
@@ -2192,6 +2227,20 @@ uint32_t ftController::defaultEncryptionPolicy()
     return mDefaultEncryptionPolicy ;
 }
 
+void ftController::setPipelinedTransfers(bool b)
+{
+    RsStackMutex stack(ctrlMutex); /******* LOCKED ********/
+    mPipelinedTransfers = b ;
+
+    for(std::map<RsFileHash,ftFileControl*>::iterator it(mDownloads.begin());it!=mDownloads.end();++it)
+        it->second->mTransfer->setPipelining(b) ;
+}
+bool ftController::pipelinedTransfers()
+{
+    RsStackMutex stack(ctrlMutex); /******* LOCKED ********/
+    return mPipelinedTransfers ;
+}
+
 void ftController::setFilePermDirectDL(uint32_t perm)
 {
 	RsStackMutex stack(ctrlMutex); /******* LOCKED ********/
@@ -2220,6 +2269,18 @@ uint32_t ftController::freeDiskSpaceLimit() const
 	return RsDiscSpace::freeSpaceLimit() ;
 }
 
+void ftController::setMemoryMappedReads(bool b)
+{
+	mDataplex->setMemoryMappedReads(b) ;
+
+	IndicateConfigChanged() ;
+}
+
+bool ftController::memoryMappedReads()
+{
+	return mDataplex->memoryMappedReads() ;
+}
+
 FileChunksInfo::ChunkStrategy ftController::defaultChunkStrategy()
 {
 	RsStackMutex stack(ctrlMutex); /******* LOCKED ********/
@@ -139,13 +139,20 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
         bool  alreadyHaveFile(const RsFileHash& hash, FileInfo &info);
 
         bool 	setChunkStrategy(const RsFileHash& hash,FileChunksInfo::ChunkStrategy s);
+        bool 	setPlaybackCursor(const RsFileHash& hash,uint64_t offset);
 		void 	setDefaultChunkStrategy(FileChunksInfo::ChunkStrategy s);
         void 	setDefaultEncryptionPolicy(uint32_t s);
         FileChunksInfo::ChunkStrategy	defaultChunkStrategy();
 		uint32_t freeDiskSpaceLimit() const ;
 		void setFreeDiskSpaceLimit(uint32_t size_in_mb) ;
+		void setMemoryMappedReads(bool b) ;
+		bool memoryMappedReads() ;
         uint32_t defaultEncryptionPolicy();
 
+        // Keep a window of data requests in flight for each source, sized after its bandwidth-delay product.
+        void setPipelinedTransfers(bool b) ;
+        bool pipelinedTransfers() ;
+
         void setMaxUploadsPerFriend(uint32_t m) ;
         uint32_t getMaxUploadsPerFriend() ;
 
@@ -242,6 +249,7 @@ class ftController: public RsTickingThread, public pqiServiceMonitor, public p3C
 		uint32_t mFtServiceType;
 		uint32_t mDefaultEncryptionPolicy;
 		uint32_t mFilePermDirectDLPolicy;
+		bool mPipelinedTransfers;
 
         uint32_t cnt ;
 		RsMutex ctrlMutex;
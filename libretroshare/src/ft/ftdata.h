@@ -36,6 +36,7 @@
  */
 
 #include <string>
+#include <vector>
 #include <inttypes.h>
 
 #include <retroshare/rstypes.h>
@@ -52,6 +53,15 @@ class ftDataSend
 		/* Client Send */
         virtual bool    sendDataRequest(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize) = 0;
 
+		/// Request several slices of the same file at once. The default sends one request per slice.
+        virtual bool    sendDataRequests(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, const std::vector<std::pair<uint64_t,uint32_t> >& slices)
+		{
+			bool ok = true ;
+			for(uint32_t i=0;i<slices.size();++i)
+				ok = sendDataRequest(peerId,hash,size,slices[i].first,slices[i].second) && ok ;
+			return ok ;
+		}
+
 		/* Server Send */
         virtual bool    sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize, void *data) = 0;
 
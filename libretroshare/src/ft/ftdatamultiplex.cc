@@ -73,11 +73,31 @@ ftRequest::ftRequest(uint32_t type, const RsPeerId& peerId, const RsFileHash& ha
 
 ftDataMultiplex::ftDataMultiplex(const RsPeerId& ownId, ftDataSend *server, ftSearch *search)
 	:RsQueueThread(DMULTIPLEX_MIN, DMULTIPLEX_MAX, DMULTIPLEX_RELAX), dataMtx("ftDataMultiplex"),
-	mDataSend(server),  mSearch(search), mOwnId(ownId)
+	mDataSend(server),  mSearch(search), mOwnId(ownId), mMappedReads(false), mMappedBytesServed(0), mBufferedBytesServed(0)
 {
 	return;
 }
 
+void ftDataMultiplex::setMemoryMappedReads(bool b)
+{
+	RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
+	mMappedReads = b ;
+}
+
+bool ftDataMultiplex::memoryMappedReads()
+{
+	RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
+	return mMappedReads ;
+}
+
+void ftDataMultiplex::getDiskReadStatistics(uint64_t& mapped_bytes, uint64_t& buffered_bytes)
+{
+	RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
+
+	mapped_bytes = mMappedBytesServed ;
+	buffered_bytes = mBufferedBytesServed ;
+}
+
 bool ftDataMultiplex::getFileData(const RsFileHash& hash, uint64_t offset, uint32_t& requested_size, uint8_t *data)
 {
     RsStackMutex stack(dataMtx); /******* LOCK MUTEX ******/
@@ -101,7 +121,7 @@ bool ftDataMultiplex::getFileData(const RsFileHash& hash, uint64_t offset, uint3
         FileSearchFlags hintflags =   RS_FILE_HINTS_EXTRA | RS_FILE_HINTS_LOCAL | RS_FILE_HINTS_SPEC_ONLY | RS_FILE_HINTS_NETWORK_WIDE;
         if(mSearch->search(hash, hintflags, info))
         {
-            provider = new ftFileProvider(info.path, info.size, hash);
+            provider = new ftFileProvider(info.path, info.size, hash, mMappedReads);
             mServers[hash] = provider;
         }
     }
@@ -250,6 +270,15 @@ bool	ftDataMultiplex::sendDataRequest(const RsPeerId& peerId, const RsFileHash&
 	return mDataSend->sendDataRequest(peerId,hash,size,offset,chunksize);
 }
 
+bool	ftDataMultiplex::sendDataRequests(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, const std::vector<std::pair<uint64_t,uint32_t> >& slices)
+{
+#ifdef MPLEX_DEBUG
+	std::cerr << "ftDataMultiplex::sendDataRequests() Client Send, " << slices.size() << " slices";
+	std::cerr << std::endl;
+#endif
+	return mDataSend->sendDataRequests(peerId,hash,size,slices);
+}
+
 	/* Server Send */
 bool	ftDataMultiplex::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize, void *data)
 {
@@ -640,6 +669,13 @@ bool ftDataMultiplex::handleRecvChunkCrcRequest(const RsPeerId& peerId, const Rs
 			crc = sha1cache._map[chunk_number] ;
 			found = true  ;
 		}
+
+		// Files being downloaded keep the sums of the chunks they have verified.
+
+		std::map<RsFileHash, ftClient>::iterator itc = mClients.find(hash) ;
+
+		if(!found && itc != mClients.end() && itc->second.mCreator->getChunkCheckSum(chunk_number,crc))
+			found = true ;
 	}
 
 	if(found)
@@ -896,6 +932,11 @@ bool	ftDataMultiplex::locked_handleServerRequest(ftFileProvider *provider, const
 
 	if (provider->getFileData(peerId,offset, chunksize, data))
 	{
+		if(provider->isMemoryMapped())
+			mMappedBytesServed += chunksize ;
+		else
+			mBufferedBytesServed += chunksize ;
+
 		/* send data out */
 		sendData(peerId, hash, size, offset, chunksize, data);
 		return true;
@@ -1123,7 +1164,7 @@ bool	ftDataMultiplex::handleSearchRequest(const RsPeerId& peerId, const RsFileHa
 
 		if(it == mServers.end())
 		{
-			provider = new ftFileProvider(info.path, info.size, hash);
+			provider = new ftFileProvider(info.path, info.size, hash, mMappedReads);
 			mServers[hash] = provider;
 #ifdef MPLEX_DEBUG
 			std::cerr << " created new file provider " << (void*)provider << std::endl;
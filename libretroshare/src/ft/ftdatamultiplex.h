@@ -118,11 +118,20 @@ class ftDataMultiplex: public ftDataRecv, public RsQueueThread
 		void		deleteUnusedServers() ;
 		void 	  handlePendingCrcRequests() ;
 
+		// When enabled, large shared files are read through a memory mapping. Only affects providers
+		// created afterwards. Disabled by default.
+		void setMemoryMappedReads(bool b) ;
+		bool memoryMappedReads() ;
+
+		// Total number of bytes sent to peers, read from memory mapped files and through buffered reads.
+		void getDiskReadStatistics(uint64_t& mapped_bytes, uint64_t& buffered_bytes) ;
+
 
 		/*************** SEND INTERFACE (calls ftDataSend) *******************/
 
 		/* Client Send */
 		bool	sendDataRequest(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize);
+		bool	sendDataRequests(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, const std::vector<std::pair<uint64_t,uint32_t> >& slices);
 
 		/* Server Send */
 		bool	sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize, void *data);
@@ -189,6 +198,10 @@ class ftDataMultiplex: public ftDataRecv, public RsQueueThread
 		ftSearch   *mSearch;
 		RsPeerId mOwnId;
 
+		bool mMappedReads ;
+		uint64_t mMappedBytesServed ;
+		uint64_t mBufferedBytesServed ;
+
 		friend class ftServer;
 };
 
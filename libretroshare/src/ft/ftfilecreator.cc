@@ -4,7 +4,9 @@
 #endif
 
 #include "ftfilecreator.h"
+#include "ftfileio.h"
 #include <errno.h>
+#include <algorithm>
 #include <stdio.h>
 #include <time.h>
 #include <sys/stat.h>
@@ -17,6 +19,7 @@
 
 #define CHUNK_MAX_AGE           120
 #define MAX_FTCHUNKS_PER_PEER    20
+#define FILE_HASH_READ_SIZE      65536
 
 /***********************************************************
 *
@@ -25,7 +28,7 @@
 ***********************************************************/
 
 ftFileCreator::ftFileCreator(const std::string& path, uint64_t size, const RsFileHash& hash,bool assume_availability)
-	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability)
+	: ftFileProvider(path,size,hash), chunkMap(size,assume_availability), mFileHashedBytes(0)
 {
 	/* 
          * FIXME any inits to do?
@@ -45,6 +48,8 @@ ftFileCreator::ftFileCreator(const std::string& path, uint64_t size, const RsFil
 	time_t now = time(NULL) ;
 	_creation_time = now ;
 
+	SHA1_Init(&mFileHasher) ;
+
 	struct stat64 buf;
 
 	// Initialise last recv time stamp to last modification time for the partial file.
@@ -137,15 +142,10 @@ void ftFileCreator::closeFile()
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
-	if(fd != NULL)
-	{
 #ifdef FILE_DEBUG
-		std::cerr << "CLOSED FILE " << (void*)fd << " (" << file_name << ")." << std::endl ;
+	std::cerr << "CLOSED FILE " << (void*)mFileIO << " (" << file_name << ")." << std::endl ;
 #endif
-		fclose(fd) ;
-	}
-
-	fd = NULL ;
+	locked_closeFile() ;
 }
 
 uint64_t ftFileCreator::getRecvd()
@@ -174,9 +174,8 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 	{
 		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
-		if (fd == NULL)
-			if (!locked_initializeFileAttrs())
-				return false;
+		if (!locked_initializeFileAttrs())
+			return false;
 
 		/* 
 		 * check its at the correct location 
@@ -188,20 +187,24 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 
 		}
 
-		/* 
-		 * go to the offset of the file 
-		 */
-		if (0 != fseeko64(this->fd, offset, SEEK_SET))
-		{
-			std::cerr << "ftFileCreator::addFileData() Bad fseek at offset " << offset << ", fd=" << (void*)(this->fd) << ", size=" << mSize << ", errno=" << errno << std::endl;
-			return 0;
-		}
+		// The file cannot be closed until locked_endIO() is called.
+		locked_startIO() ;
+	}
 
-		if (1 != fwrite(data, chunk_size, 1, this->fd))
-		{
-			std::cerr << "ftFileCreator::addFileData() Bad fwrite." << std::endl;
-			std::cerr << "ERRNO: " << errno << std::endl;
+	/* 
+	 * write at the offset of the file. This is done without the mutex, so that
+	 * slices from different sources can be written at the same time.
+	 */
+	bool ok = mFileIO->writeAt(offset, data, chunk_size) ;
+
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
+		locked_endIO() ;
+
+		if (!ok)
+		{
+			std::cerr << "ftFileCreator::addFileData() Bad write at offset " << offset << ", size=" << mSize << std::endl;
 			return 0;
 		}
 
@@ -211,6 +214,8 @@ bool ftFileCreator::addFileData(uint64_t offset, uint32_t chunk_size, void *data
 		std::cerr << " pos: " << offset;
 		std::cerr << std::endl;
 #endif
+		locked_hashReceivedData(offset,chunk_size,(const unsigned char *)data) ;
+
 		/* 
 		 * Notify ftFileChunker about chunks received 
 		 */
@@ -294,46 +299,22 @@ int ftFileCreator::locked_initializeFileAttrs()
 	 * cant use FileProviders verion because that opens readonly.
 	 */
 
-	if (fd)
+	if (mFileIO->isOpen())
 		return 1;
 
 	/* 
-	 * check if the file exists 
+	 * attempt to open file, or create it if needed
 	 */
 
+	if (!mFileIO->open(file_name, ftFileIO::FT_FILE_IO_CREATE))
 	{
-#ifdef FILE_DEBUG
-		std::cerr << "ftFileCreator::initializeFileAttrs() trying (r+b) " << file_name << " this: " << this << std::endl;
-#endif
-	}
-
-	/* 
-	 * attempt to open file 
-	 */
-
-	fd = RsDirUtil::rs_fopen(file_name.c_str(), "r+b");
-
-	if (!fd)
-	{
-#ifdef FILE_DEBUG
-		std::cerr << "ftFileCreator::initializeFileAttrs() Failed to open (r+b): ";
-		std::cerr << file_name << ", errno = " << errno << std::endl;
-
-		std::cerr << "ftFileCreator::initializeFileAttrs() opening w+b";
-		std::cerr << std::endl;
-#endif
-
-		/* try opening for write */
-		fd = RsDirUtil::rs_fopen(file_name.c_str(), "w+b");
-		if (!fd)
-		{
-			std::cerr << "ftFileCreator::initializeFileAttrs()";
-			std::cerr << " Failed to open (w+b): "<< file_name << ", errno = " << errno << std::endl;
-			return 0;
-		}
+		std::cerr << "ftFileCreator::initializeFileAttrs()";
+		std::cerr << " Failed to open (w+b): "<< file_name << ", errno = " << errno << std::endl;
+		return 0;
 	}
+	mCloseRequested = false ;
 #ifdef FILE_DEBUG
-	std::cerr << "OPENNED FILE " << (void*)fd << " (" << file_name << "), for r/w." << std::endl ;
+	std::cerr << "OPENNED FILE " << (void*)mFileIO << " (" << file_name << "), for r/w." << std::endl ;
 #endif
 
 	return 1;
@@ -471,7 +452,8 @@ void ftFileCreator::setChunkStrategy(FileChunksInfo::ChunkStrategy s)
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	// Let's check, for safety.
-	if(s != FileChunksInfo::CHUNK_STRATEGY_STREAMING && s != FileChunksInfo::CHUNK_STRATEGY_RANDOM && s != FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE)
+	if(s != FileChunksInfo::CHUNK_STRATEGY_STREAMING && s != FileChunksInfo::CHUNK_STRATEGY_RANDOM && s != FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE
+	        && s != FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST && s != FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST)
 	{
 		std::cerr << "ftFileCreator::ERROR: invalid chunk strategy " << s << "!" << " setting default value " << FileChunksInfo::CHUNK_STRATEGY_STREAMING << std::endl ;
 		s = FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE ;
@@ -482,6 +464,12 @@ void ftFileCreator::setChunkStrategy(FileChunksInfo::ChunkStrategy s)
 #endif
 	chunkMap.setStrategy(s) ;
 }
+void ftFileCreator::setPlaybackCursor(uint64_t offset)
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	chunkMap.setPlaybackCursor(offset) ;
+}
 
 /* Returns true if more to get 
  * But can return size = 0, if we are still waiting for the data.
@@ -666,8 +654,159 @@ bool ftFileCreator::hashReceivedData(RsFileHash& hash)
 		return false ;
 	}
 
+	SHA_CTX sha_ctx ;
+	uint64_t hashed_bytes ;
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+		sha_ctx = mFileHasher ;
+		hashed_bytes = mFileHashedBytes ;
+	}
+#ifdef FILE_DEBUG
+	std::cerr << "  " << hashed_bytes << " bytes out of " << mSize << " already hashed." << std::endl;
+#endif
 	uint64_t tmpsize ;
-	return RsDirUtil::getFileHash(file_name,hash,tmpsize) ;
+
+	if(hashed_bytes == 0)
+		return RsDirUtil::getFileHash(file_name,hash,tmpsize) ;
+
+	// Only hash the data that was not received in order.
+
+	FILE *fd = RsDirUtil::rs_fopen(file_name.c_str(),"rb") ;
+
+	if(fd == NULL)
+		return false ;
+
+	if(fseeko64(fd,hashed_bytes,SEEK_SET) != 0)
+	{
+		fclose(fd) ;
+		return false ;
+	}
+
+	unsigned char *buf = new unsigned char[FILE_HASH_READ_SIZE] ;
+	size_t len ;
+
+	while((len = fread(buf,1,FILE_HASH_READ_SIZE,fd)) > 0)
+		SHA1_Update(&sha_ctx,buf,len) ;
+
+	delete[] buf ;
+
+	bool ok = !ferror(fd) ;
+	fclose(fd) ;
+
+	if(!ok)
+		return false ;
+
+	unsigned char sha_buf[SHA_DIGEST_LENGTH] ;
+	SHA1_Final(&sha_buf[0],&sha_ctx) ;
+
+	hash = Sha1CheckSum(sha_buf) ;
+	return true ;
+}
+
+void ftFileCreator::locked_hashReceivedData(uint64_t offset, uint32_t chunk_size, const unsigned char *data)
+{
+	/* ALREADY LOCKED */
+
+	// Data that was already hashed is skipped. It should be the same, and if it is not, the chunk will
+	// fail the check and be downloaded again.
+
+	if(offset <= mFileHashedBytes && offset + chunk_size > mFileHashedBytes)
+	{
+		uint32_t skip = mFileHashedBytes - offset ;
+
+		SHA1_Update(&mFileHasher,data + skip,chunk_size - skip) ;
+		mFileHashedBytes += chunk_size - skip ;
+	}
+
+	// Slices normally lie within a single chunk, but nothing forces the source to send them that way.
+
+	static const uint64_t csize = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+
+	for(uint64_t pos = offset;pos < offset + chunk_size;)
+	{
+		uint32_t chunk_number = pos / csize ;
+		uint64_t chunk_start = chunk_number * csize ;
+		uint64_t end = std::min(offset + chunk_size, chunk_start + csize) ;
+
+		if(mChunkCheckSums.find(chunk_number) == mChunkCheckSums.end())
+		{
+			ftChunkHasher& hasher(mChunkHashers[chunk_number]) ;
+			uint64_t hashed_end = chunk_start + hasher.hashed_bytes ;
+
+			if(pos <= hashed_end && end > hashed_end)
+			{
+				SHA1_Update(&hasher.ctx,data + (hashed_end - offset),end - hashed_end) ;
+				hasher.hashed_bytes += end - hashed_end ;
+			}
+		}
+		pos = end ;
+	}
+}
+
+bool ftFileCreator::locked_computeChunkCheckSum(uint32_t chunk_number, Sha1CheckSum& sum)
+{
+	/* ALREADY LOCKED */
+
+	std::map<uint32_t,Sha1CheckSum>::const_iterator it = mChunkCheckSums.find(chunk_number) ;
+
+	if(it != mChunkCheckSums.end())
+	{
+		sum = it->second ;
+		return true ;
+	}
+
+	static const uint64_t csize = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+	uint64_t chunk_start = chunk_number * csize ;
+
+	if(chunk_start >= mSize)
+		return false ;
+
+	uint32_t len = std::min(csize, mSize - chunk_start) ;
+	ftChunkHasher hasher ;
+
+	std::map<uint32_t,ftChunkHasher>::const_iterator ith = mChunkHashers.find(chunk_number) ;
+
+	if(ith != mChunkHashers.end())
+		hasher = ith->second ;
+
+#ifdef FILE_DEBUG
+	std::cerr << "ftFileCreator: chunk " << chunk_number << ": " << hasher.hashed_bytes << " bytes out of " << len << " hashed on the fly." << std::endl;
+#endif
+	if(hasher.hashed_bytes < len)
+	{
+		uint32_t to_read = len - hasher.hashed_bytes ;
+		unsigned char *buff = new unsigned char[to_read] ;
+		int64_t res = mFileIO->readAt(chunk_start + hasher.hashed_bytes,buff,to_read) ;
+
+		if(res > 0)
+			SHA1_Update(&hasher.ctx,buff,res) ;
+
+		delete[] buff ;
+
+		if(res <= 0)
+			return false ;
+	}
+
+	unsigned char sha_buf[SHA_DIGEST_LENGTH] ;
+	SHA1_Final(&sha_buf[0],&hasher.ctx) ;
+
+	sum = Sha1CheckSum(sha_buf) ;
+	return true ;
+}
+
+void ftFileCreator::locked_resetChunkCheckSum(uint32_t chunk_number)
+{
+	/* ALREADY LOCKED */
+
+	mChunkCheckSums.erase(chunk_number) ;
+	mChunkHashers.erase(chunk_number) ;
+
+	if(mFileHashedBytes > (uint64_t)chunk_number * (uint64_t)ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE)
+	{
+		SHA1_Init(&mFileHasher) ;
+		mFileHashedBytes = 0 ;
+	}
 }
 
 void ftFileCreator::forceCheck()
@@ -675,6 +814,27 @@ void ftFileCreator::forceCheck()
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
 	chunkMap.forceCheck(); 
+
+	// The check is forced because the file is not what it should be, so the data is read again from the disk.
+
+	mChunkCheckSums.clear() ;
+	mChunkHashers.clear() ;
+
+	SHA1_Init(&mFileHasher) ;
+	mFileHashedBytes = 0 ;
+}
+
+bool ftFileCreator::getChunkCheckSum(uint32_t chunk_number,Sha1CheckSum& sum)
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	std::map<uint32_t,Sha1CheckSum>::const_iterator it = mChunkCheckSums.find(chunk_number) ;
+
+	if(it == mChunkCheckSums.end())
+		return false ;
+
+	sum = it->second ;
+	return true ;
 }
 
 void ftFileCreator::getSourcesList(uint32_t chunk_num,std::vector<RsPeerId>& sources)
@@ -698,16 +858,17 @@ bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
 	if(!locked_initializeFileAttrs() )
 		return false ;
 
-	static const uint32_t chunk_size = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
-	unsigned char *buff = new unsigned char[chunk_size] ;
-	uint32_t len ;
+	Sha1CheckSum comp ;
 
-	if(fseeko64(fd,(uint64_t)chunk_number * (uint64_t)chunk_size,SEEK_SET)==0 && (len = fread(buff,1,chunk_size,fd)) > 0)
+	if(locked_computeChunkCheckSum(chunk_number,comp))
 	{
-		Sha1CheckSum comp = RsDirUtil::sha1sum(buff,len) ;
-
 		if(sum == comp)
+		{
 			chunkMap.setChunkCheckingResult(chunk_number,true) ;
+
+			mChunkCheckSums[chunk_number] = comp ;
+			mChunkHashers.erase(chunk_number) ;
+		}
 		else
 		{
 			std::cerr << "Sum mismatch for chunk " << chunk_number << std::endl;
@@ -715,15 +876,16 @@ bool ftFileCreator::verifyChunk(uint32_t chunk_number,const Sha1CheckSum& sum)
 			std::cerr << "    Reference hash = " << sum.toStdString() << std::endl;
 
 			chunkMap.setChunkCheckingResult(chunk_number,false) ;
+			locked_resetChunkCheckSum(chunk_number) ;
 		}
 	}
 	else
 	{
-		printf("Chunk verification: cannot fseek!\n") ;
+		printf("Chunk verification: cannot read chunk!\n") ;
 		chunkMap.setChunkCheckingResult(chunk_number,false) ;
+		locked_resetChunkCheckSum(chunk_number) ;
 	}
 
-	delete[] buff ;
 	return true ;
 }
 
@@ -35,6 +35,7 @@
 #include "ftfileprovider.h"
 #include "ftchunkmap.h"
 #include <map>
+#include <openssl/sha.h>
 
 class ZeroInitCounter
 {
@@ -43,6 +44,18 @@ class ZeroInitCounter
 		uint32_t cnt ;
 };
 
+// Sha1 state of a chunk being received. Slices are hashed as they are written, as long as they arrive
+// in order. Whatever comes after hashed_bytes is read back from the disk when the chunk is checked.
+//
+class ftChunkHasher
+{
+	public:
+		ftChunkHasher(): hashed_bytes(0) { SHA1_Init(&ctx) ; }
+
+		SHA_CTX ctx ;
+		uint32_t hashed_bytes ;
+};
+
 class ftFileCreator: public ftFileProvider
 {
 	public:
@@ -63,8 +76,10 @@ class ftFileCreator: public ftFileProvider
 
 		void setChunkStrategy(FileChunksInfo::ChunkStrategy s) ;
 		FileChunksInfo::ChunkStrategy getChunkStrategy() ;
+		void setPlaybackCursor(uint64_t offset) ;
 
 		// Computes a sha1sum of the partial file, to check that the data is overall consistent.
+		// Data received in order since the beginning of the file is already hashed, so only the rest is read.
 		// This function is not mutexed. This is a bit dangerous, but otherwise we might stuck the GUI for a 
 		// long time. Therefore, we must pay attention not to call this function
 		// at a time file_name nor hash can be modified, which is quite easy.
@@ -77,6 +92,10 @@ class ftFileCreator: public ftFileProvider
 
 		bool verifyChunk(uint32_t, const Sha1CheckSum&) ;
 
+		// Returns the sha1 sum of a chunk that has been verified, without reading the file.
+		//
+		bool getChunkCheckSum(uint32_t chunk_number,Sha1CheckSum& sum) ;
+
 		// Looks into the chunkmap for downloaded chunks that have not yet been certified.
 		// For each of them, returns the chunk number and a source peer to ask the CRC to.
 		//
@@ -138,6 +157,15 @@ class ftFileCreator: public ftFileProvider
 
 		bool 	locked_printChunkMap();
 		int 	locked_notifyReceived(uint64_t offset, uint32_t chunk_size);
+
+		// Feeds the written data to the sha1 states of the file and of the chunks it belongs to.
+		void	locked_hashReceivedData(uint64_t offset, uint32_t chunk_size, const unsigned char *data);
+
+		// Finishes the sha1 sum of a chunk, reading from the disk the part that was not hashed on the fly.
+		bool	locked_computeChunkCheckSum(uint32_t chunk_number, Sha1CheckSum& sum);
+
+		// Forgets the sums of chunks which data is going to be received again.
+		void	locked_resetChunkCheckSum(uint32_t chunk_number);
 		/* 
 		 * structure to track missing chunks 
 		 */
@@ -147,6 +175,12 @@ class ftFileCreator: public ftFileProvider
 
 		ChunkMap chunkMap ;
 
+		std::map<uint32_t,ftChunkHasher> mChunkHashers ;	/// sha1 states of chunks being received
+		std::map<uint32_t,Sha1CheckSum> mChunkCheckSums ;	/// sums of verified chunks
+
+		SHA_CTX mFileHasher ;		/// sha1 state of the whole file, fed while data comes in order.
+		uint64_t mFileHashedBytes ;
+
 		time_t _last_recv_time_t ;	/// last time stamp when data was received. Used for queue control.
 		time_t _creation_time ;		/// time at which the file creator was created. Used to spot long-inactive transfers.
 };
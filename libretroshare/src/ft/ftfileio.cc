@@ -0,0 +1,349 @@
+/*
+ * libretroshare/src/ft/ftfileio.cc
+ *
+ * File Transfer for RetroShare.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#ifdef WINDOWS_SYS
+#include "util/rswin.h"
+#endif // WINDOWS_SYS
+
+#include <errno.h>
+#include <iostream>
+#include <algorithm>
+
+#ifndef WINDOWS_SYS
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+#include "util/rsdir.h"
+#include "ftfileio.h"
+
+/********
+* #define DEBUG_FT_FILE_IO 1
+********/
+
+#ifndef WINDOWS_SYS
+static const uint64_t FT_FILE_IO_MIN_MAPPED_SIZE = 64*1024*1024 ;	// smaller files are read with pread()
+#endif
+
+ftFileIO *ftFileIO::create(bool allow_mapping)
+{
+#ifdef WINDOWS_SYS
+	(void) allow_mapping ;
+	return new ftStdioFileIO ;
+#else
+	// Mapping multi-GB files needs a 64 bits address space.
+
+	if(allow_mapping && sizeof(void*) >= 8)
+		return new ftMappedFileIO ;
+
+	return new ftPosixFileIO ;
+#endif
+}
+
+/***********************************************************
+*
+*	ftStdioFileIO methods
+*
+***********************************************************/
+
+ftStdioFileIO::ftStdioFileIO()
+	: mFile(NULL), mFileMtx("ftStdioFileIO")
+{
+}
+
+ftStdioFileIO::~ftStdioFileIO()
+{
+	close() ;
+}
+
+bool ftStdioFileIO::open(const std::string& path,OpenMode mode)
+{
+	RS_STACK_MUTEX(mFileMtx) ;
+
+	if(mFile != NULL)
+		return true ;
+
+	if(mode == FT_FILE_IO_READ_ONLY)
+		mFile = RsDirUtil::rs_fopen(path.c_str(), "rb");
+	else
+	{
+		mFile = RsDirUtil::rs_fopen(path.c_str(), "r+b");
+
+		if(mFile == NULL && mode == FT_FILE_IO_CREATE)
+			mFile = RsDirUtil::rs_fopen(path.c_str(), "w+b");
+	}
+
+#ifdef DEBUG_FT_FILE_IO
+	std::cerr << "ftStdioFileIO::open(): " << path << " mode " << mode << ": " << (void*)mFile << std::endl;
+#endif
+	return mFile != NULL ;
+}
+
+void ftStdioFileIO::close()
+{
+	RS_STACK_MUTEX(mFileMtx) ;
+
+	if(mFile != NULL)
+		fclose(mFile) ;
+
+	mFile = NULL ;
+}
+
+int64_t ftStdioFileIO::readAt(uint64_t offset,void *data,uint32_t size)
+{
+	RS_STACK_MUTEX(mFileMtx) ;
+
+	if(mFile == NULL)
+		return -1 ;
+
+	if(0 != fseeko64(mFile, offset, SEEK_SET))
+	{
+		std::cerr << "ftStdioFileIO::readAt() Bad fseek at offset " << offset << ", errno=" << errno << std::endl;
+		return -1 ;
+	}
+	size_t len = fread(data, 1, size, mFile) ;
+
+	if(len < size && ferror(mFile))
+	{
+		clearerr(mFile) ;
+		return -1 ;
+	}
+	return len ;
+}
+
+bool ftStdioFileIO::writeAt(uint64_t offset,const void *data,uint32_t size)
+{
+	RS_STACK_MUTEX(mFileMtx) ;
+
+	if(mFile == NULL)
+		return false ;
+
+	if(0 != fseeko64(mFile, offset, SEEK_SET))
+	{
+		std::cerr << "ftStdioFileIO::writeAt() Bad fseek at offset " << offset << ", errno=" << errno << std::endl;
+		return false ;
+	}
+	if(1 != fwrite(data, size, 1, mFile))
+	{
+		std::cerr << "ftStdioFileIO::writeAt() Bad fwrite. ERRNO: " << errno << std::endl;
+		return false ;
+	}
+	return true ;
+}
+
+#ifndef WINDOWS_SYS
+/***********************************************************
+*
+*	ftPosixFileIO methods
+*
+***********************************************************/
+
+ftPosixFileIO::ftPosixFileIO()
+	: mFd(-1)
+{
+}
+
+ftPosixFileIO::~ftPosixFileIO()
+{
+	close() ;
+}
+
+bool ftPosixFileIO::open(const std::string& path,OpenMode mode)
+{
+	if(mFd >= 0)
+		return true ;
+
+	int flags = (mode == FT_FILE_IO_READ_ONLY)? O_RDONLY : O_RDWR ;
+
+	if(mode == FT_FILE_IO_CREATE)
+		flags |= O_CREAT ;
+
+	mFd = ::open(path.c_str(), flags, 0644) ;
+
+#ifdef DEBUG_FT_FILE_IO
+	std::cerr << "ftPosixFileIO::open(): " << path << " mode " << mode << ": fd=" << mFd << std::endl;
+#endif
+	return mFd >= 0 ;
+}
+
+void ftPosixFileIO::close()
+{
+	if(mFd >= 0)
+		::close(mFd) ;
+
+	mFd = -1 ;
+}
+
+int64_t ftPosixFileIO::readAt(uint64_t offset,void *data,uint32_t size)
+{
+	uint32_t done = 0 ;
+
+	while(done < size)
+	{
+		ssize_t n = ::pread(mFd, (unsigned char*)data + done, size - done, (off_t)(offset + done)) ;
+
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue ;
+
+			std::cerr << "ftPosixFileIO::readAt() pread failed at offset " << offset + done << ", errno=" << errno << std::endl;
+			return -1 ;
+		}
+		if(n == 0)	// end of file
+			break ;
+
+		done += n ;
+	}
+	return done ;
+}
+
+bool ftPosixFileIO::writeAt(uint64_t offset,const void *data,uint32_t size)
+{
+	uint32_t done = 0 ;
+
+	while(done < size)
+	{
+		ssize_t n = ::pwrite(mFd, (const unsigned char*)data + done, size - done, (off_t)(offset + done)) ;
+
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue ;
+
+			std::cerr << "ftPosixFileIO::writeAt() pwrite failed at offset " << offset + done << ", errno=" << errno << std::endl;
+			return false ;
+		}
+		done += n ;
+	}
+	return true ;
+}
+
+void ftPosixFileIO::adviseReadAhead(uint64_t offset,uint32_t size)
+{
+#ifdef POSIX_FADV_WILLNEED
+	if(mFd >= 0)
+		posix_fadvise(mFd, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED) ;
+#else
+	(void) offset ;
+	(void) size ;
+#endif
+}
+
+/***********************************************************
+*
+*	ftMappedFileIO methods
+*
+***********************************************************/
+
+ftMappedFileIO::ftMappedFileIO()
+	: mMap(NULL), mMapSize(0)
+{
+}
+
+ftMappedFileIO::~ftMappedFileIO()
+{
+	close() ;
+}
+
+bool ftMappedFileIO::open(const std::string& path,OpenMode mode)
+{
+	if(mFd >= 0)
+		return true ;
+
+	if(!ftPosixFileIO::open(path,mode))
+		return false ;
+
+	struct stat buf ;
+
+	if(0 != fstat(mFd, &buf) || (uint64_t)buf.st_size < FT_FILE_IO_MIN_MAPPED_SIZE)
+		return true ;
+
+	void *map = mmap(NULL, buf.st_size, PROT_READ, MAP_SHARED, mFd, 0) ;
+
+	if(map == MAP_FAILED)
+	{
+		std::cerr << "ftMappedFileIO::open(): cannot map " << path << ", errno=" << errno << ". Falling back to pread()." << std::endl;
+		return true ;
+	}
+	mMap = (unsigned char *)map ;
+	mMapSize = buf.st_size ;
+
+#ifdef DEBUG_FT_FILE_IO
+	std::cerr << "ftMappedFileIO::open(): mapped " << path << ", " << mMapSize << " bytes." << std::endl;
+#endif
+	return true ;
+}
+
+void ftMappedFileIO::close()
+{
+	if(mMap != NULL)
+		munmap(mMap, mMapSize) ;
+
+	mMap = NULL ;
+	mMapSize = 0 ;
+
+	ftPosixFileIO::close() ;
+}
+
+int64_t ftMappedFileIO::readAt(uint64_t offset,void *data,uint32_t size)
+{
+	if(mMap == NULL)
+		return ftPosixFileIO::readAt(offset,data,size) ;
+
+	if(offset >= mMapSize)
+		return 0 ;
+
+	uint32_t len = (offset + size > mMapSize)? (uint32_t)(mMapSize - offset) : size ;
+
+	memcpy(data, mMap + offset, len) ;
+	return len ;
+}
+
+void ftMappedFileIO::adviseReadAhead(uint64_t offset,uint32_t size)
+{
+	if(mMap == NULL)
+	{
+		ftPosixFileIO::adviseReadAhead(offset,size) ;
+		return ;
+	}
+	if(offset >= mMapSize)
+		return ;
+
+	// madvise() needs a page-aligned start address.
+
+	static const uint64_t page_size = sysconf(_SC_PAGESIZE) ;
+
+	uint64_t start = offset - (offset % page_size) ;
+	uint64_t end   = std::min(offset + size, mMapSize) ;
+
+	madvise(mMap + start, end - start, MADV_SEQUENTIAL) ;
+	madvise(mMap + start, end - start, MADV_WILLNEED) ;
+}
+#endif
@@ -0,0 +1,158 @@
+/*
+ * libretroshare/src/ft/ftfileio.h
+ *
+ * File Transfer for RetroShare.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "util/rsthreads.h"
+
+/*!
+ * \brief The ftFileIO class
+ * 		Disk backend used by ftFileProvider/ftFileCreator. All reads and writes are positional, so that
+ * 		concurrent slices of the same file never share a file cursor, and the caller does not need to
+ * 		hold its own mutex while the system call is running.
+ */
+class ftFileIO
+{
+public:
+	enum OpenMode {
+		FT_FILE_IO_READ_ONLY  = 0x00,	// open an existing file for reading
+		FT_FILE_IO_READ_WRITE = 0x01,	// open an existing file for reading and writing
+		FT_FILE_IO_CREATE     = 0x02	// same as READ_WRITE, but creates the file if missing
+	};
+
+	virtual ~ftFileIO() {}
+
+	virtual bool open(const std::string& path, OpenMode mode) = 0;
+	virtual void close() = 0;
+	virtual bool isOpen() const = 0;
+
+	/*!
+	 * \brief readAt  reads at most size bytes at the given offset.
+	 * \return number of bytes actually read (less than size only at end of file), or -1 on error.
+	 */
+	virtual int64_t readAt(uint64_t offset, void *data, uint32_t size) = 0;
+
+	/*!
+	 * \brief writeAt writes exactly size bytes at the given offset.
+	 * \return true if all bytes were written.
+	 */
+	virtual bool writeAt(uint64_t offset, const void *data, uint32_t size) = 0;
+
+	/*!
+	 * \brief adviseReadAhead tells the backend that the given range is likely to be read soon, because
+	 * 		a peer is reading the file sequentially. This is only a hint, and backends may ignore it.
+	 */
+	virtual void adviseReadAhead(uint64_t /*offset*/, uint32_t /*size*/) {}
+
+	/*!
+	 * \brief isMapped returns true when reads are served from a memory mapping of the file.
+	 */
+	virtual bool isMapped() const { return false; }
+
+	/*!
+	 * \brief create  returns a new (closed) backend of the best type available on this platform:
+	 * 		pread/pwrite on a raw file descriptor when possible, otherwise locked stdio.
+	 * \param allow_mapping if true, large files are memory-mapped when opened, and slices are copied
+	 * 		straight from the page cache. Only use it for files that are complete and not truncated
+	 * 		while open, since a read beyond the end of a shrunk mapping raises SIGBUS.
+	 */
+	static ftFileIO *create(bool allow_mapping = false);
+};
+
+/*!
+ * \brief The ftStdioFileIO class
+ * 		Portable fallback, based on FILE* and fseeko64. Since the FILE has a single cursor, the seek+read
+ * 		pairs are serialised by an internal mutex.
+ */
+class ftStdioFileIO: public ftFileIO
+{
+public:
+	ftStdioFileIO();
+	virtual ~ftStdioFileIO();
+
+	virtual bool open(const std::string& path, OpenMode mode);
+	virtual void close();
+	virtual bool isOpen() const { return mFile != NULL; }
+
+	virtual int64_t readAt(uint64_t offset, void *data, uint32_t size);
+	virtual bool writeAt(uint64_t offset, const void *data, uint32_t size);
+
+private:
+	FILE *mFile;
+	RsMutex mFileMtx;
+};
+
+#ifndef WINDOWS_SYS
+/*!
+ * \brief The ftPosixFileIO class
+ * 		Uses pread()/pwrite() on a raw file descriptor. These calls do not move any shared cursor, so they
+ * 		can run concurrently from multiple threads without locking.
+ */
+class ftPosixFileIO: public ftFileIO
+{
+public:
+	ftPosixFileIO();
+	virtual ~ftPosixFileIO();
+
+	virtual bool open(const std::string& path, OpenMode mode);
+	virtual void close();
+	virtual bool isOpen() const { return mFd >= 0; }
+
+	virtual int64_t readAt(uint64_t offset, void *data, uint32_t size);
+	virtual bool writeAt(uint64_t offset, const void *data, uint32_t size);
+	virtual void adviseReadAhead(uint64_t offset, uint32_t size);
+
+protected:
+	int mFd;
+};
+
+/*!
+ * \brief The ftMappedFileIO class
+ * 		Same as ftPosixFileIO, but files larger than FT_FILE_IO_MIN_MAPPED_SIZE are mapped read-only in
+ * 		memory when opened, so that reads are a single copy from the page cache. Read-ahead hints are
+ * 		passed to madvise(). If the mapping cannot be created, reads fall back to pread().
+ */
+class ftMappedFileIO: public ftPosixFileIO
+{
+public:
+	ftMappedFileIO();
+	virtual ~ftMappedFileIO();
+
+	virtual bool open(const std::string& path, OpenMode mode);
+	virtual void close();
+
+	virtual int64_t readAt(uint64_t offset, void *data, uint32_t size);
+	virtual void adviseReadAhead(uint64_t offset, uint32_t size);
+	virtual bool isMapped() const { return mMap != NULL; }
+
+private:
+	unsigned char *mMap;
+	uint64_t mMapSize;
+};
+#endif
@@ -3,6 +3,7 @@
 #endif // WINDOWS_SYS
 
 #include "ftfileprovider.h"
+#include "ftfileio.h"
 #include "ftchunkmap.h"
 
 #include "util/rsdir.h"
@@ -21,9 +22,10 @@
 #endif
 
 static const time_t UPLOAD_CHUNK_MAPS_TIME = 20 ;	// time to ask for a new chunkmap from uploaders in seconds.
+static const uint32_t UPLOAD_READ_AHEAD_SIZE = 4*1024*1024 ;	// data asked in advance to the disk for peers reading sequentially.
 
-ftFileProvider::ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash)
-	: mSize(size), hash(hash), file_name(path), fd(NULL), ftcMutex("ftFileProvider")
+ftFileProvider::ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash, bool allow_mapping)
+	: mSize(size), hash(hash), file_name(path), mFileIO(ftFileIO::create(allow_mapping)), mPendingIO(0), mCloseRequested(false), ftcMutex("ftFileProvider")
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
@@ -38,19 +40,46 @@ ftFileProvider::~ftFileProvider()
 #ifdef DEBUG_FT_FILE_PROVIDER
 	std::cout << "ftFileProvider::~ftFileProvider(): Destroying file provider for " << hash << std::endl ;
 #endif
-	if (fd!=NULL) {
-		fclose(fd);
-		fd = NULL ;
+	if (mFileIO->isOpen()) {
+		mFileIO->close();
 #ifdef DEBUG_FT_FILE_PROVIDER
 		std::cout << "ftFileProvider::~ftFileProvider(): closed file: " << hash << std::endl ;
 #endif
 	}
+	delete mFileIO ;
 }
 
 bool	ftFileProvider::fileOk()
 {
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
-	return (fd != NULL);
+	return mFileIO->isOpen();
+}
+
+bool	ftFileProvider::isMemoryMapped()
+{
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+	return mFileIO->isMapped();
+}
+
+void ftFileProvider::locked_closeFile()
+{
+	// Some other thread is still reading/writing the file. The last one will close it.
+
+	if(mPendingIO > 0)
+	{
+		mCloseRequested = true ;
+		return ;
+	}
+	mFileIO->close() ;
+	mCloseRequested = false ;
+}
+
+void ftFileProvider::locked_endIO()
+{
+	--mPendingIO ;
+
+	if(mPendingIO == 0 && mCloseRequested)
+		locked_closeFile() ;
 }
 
 RsFileHash ftFileProvider::getHash()
@@ -141,95 +170,99 @@ void ftFileProvider::getAvailabilityMap(CompressedChunkMap& cmap)
 
 bool ftFileProvider::getFileData(const RsPeerId& peer_id,uint64_t offset, uint32_t &chunk_size, void *data, bool /*allow_unverified*/)
 {
-	/* dodgey checking outside of mutex...
-	 * much check again inside FileAttrs().
-	 */
-	if (fd == NULL)
-		if (!initializeFileAttrs())
-			return false;
+	uint32_t data_size ;
+	uint32_t readahead_size = 0 ;
+	{
+		RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
 
-	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+		if (!locked_initializeFileAttrs())
+			return false;
 
-	/* 
-	 * FIXME: Warning of comparison between unsigned and signed int?
-	 */
+		if(offset >= mSize)
+		{
+			std::cerr << "ftFileProvider::getFileData(): request (" << offset << ") exceeds file size (" << mSize << "! " << std::endl;
+			return false ;
+		}
 
-	if(offset >= mSize)
-	{
-		std::cerr << "ftFileProvider::getFileData(): request (" << offset << ") exceeds file size (" << mSize << "! " << std::endl;
-		return false ;
-	}
+		data_size = chunk_size;
 
-	uint32_t data_size    = chunk_size;
-	uint64_t base_loc     = offset;
-	
-	if (base_loc + data_size > mSize)
-	{
-		data_size = mSize - base_loc;
-		chunk_size = mSize - base_loc;
-		std::cerr <<"Chunk Size greater than total file size, adjusting chunk size " << data_size << std::endl;
-	}
+		if (offset + data_size > mSize)
+		{
+			data_size = mSize - offset;
+			chunk_size = mSize - offset;
+			std::cerr <<"Chunk Size greater than total file size, adjusting chunk size " << data_size << std::endl;
+		}
 
-	if(data_size > 0 && data != NULL)
-	{	
-		/*
-		 * seek for base_loc 
-		 */
-        if(fseeko64(fd, base_loc, SEEK_SET) == -1)
-        {
-            #ifdef DEBUG_FT_FILE_PROVIDER
-            std::cerr << "ftFileProvider::getFileData() Failed to seek. Data_size=" << data_size << ", base_loc=" << base_loc << " !" << std::endl;
-            #endif
-            //free(data); No!! It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
-            return 0;
-        }
-
-		// Data space allocated by caller.
-		//void *data = malloc(chunk_size);
-		
-		/* 
-		 * read the data 
-                 */
-		
-		if (1 != fread(data, data_size, 1, fd))
+		if(data_size == 0 || data == NULL)
 		{
-                        #ifdef DEBUG_FT_FILE_PROVIDER
-                        std::cerr << "ftFileProvider::getFileData() Failed to get data. Data_size=" << data_size << ", base_loc=" << base_loc << " !" << std::endl;
-                        #endif
-			//free(data); No!! It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
+			std::cerr << "No data to read, or NULL buffer used" << std::endl;
 			return 0;
 		}
 
-		/* 
-		 * Update status of ftFileStatus to reflect last usage (for GUI display)
-		 * We need to store.
-		 * (a) Id, 
-		 * (b) Offset, 
-		 * (c) Size, 
-		 * (d) timestamp
-		 */
+		// If this peer keeps asking slices in order, ask the next ones to the disk in advance. This is
+		// only done once every half read-ahead window, so as not to flood the kernel with hints.
 
-		// This creates the peer info, and updates it.
-		//
-		time_t now = time(NULL) ;
-		uploading_peers[peer_id].updateStatus(offset,data_size,now) ;
+		std::map<RsPeerId,PeerUploadInfo>::iterator pit = uploading_peers.find(peer_id) ;
 
-#ifdef DEBUG_TRANSFERS
-		std::cerr << "ftFileProvider::getFileData() ";
-		std::cerr << " at " << RsUtil::AccurateTimeString();
-		std::cerr << " hash: " << hash;
-		std::cerr << " for peerId: " << peer_id;
-		std::cerr << " offset: " << offset;
-		std::cerr << " chunkSize: " << chunk_size;
-		std::cerr << std::endl;
-#endif
+		if(pit != uploading_peers.end() && pit->second.req_loc + pit->second.req_size == offset
+		        && offset + data_size + UPLOAD_READ_AHEAD_SIZE/2 > pit->second.readahead_end)
+		{
+			readahead_size = UPLOAD_READ_AHEAD_SIZE ;
+			pit->second.readahead_end = offset + data_size + readahead_size ;
+		}
 
+		// The file cannot be closed until locked_endIO() is called.
+		locked_startIO() ;
 	}
-	else 
+
+	/*
+	 * read the data, without holding the mutex. Positional reads do not move any shared
+	 * cursor, so other slices of the same file can be served at the same time.
+	 * Data space allocated by caller.
+	 */
+
+	bool ok = (mFileIO->readAt(offset, data, data_size) == (int64_t)data_size) ;
+
+	if(ok && readahead_size > 0 && offset + data_size < mSize)
+		mFileIO->adviseReadAhead(offset + data_size, readahead_size) ;
+
+	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
+
+	locked_endIO() ;
+
+	if (!ok)
 	{
-		std::cerr << "No data to read, or NULL buffer used" << std::endl;
+#ifdef DEBUG_FT_FILE_PROVIDER
+		std::cerr << "ftFileProvider::getFileData() Failed to get data. Data_size=" << data_size << ", base_loc=" << offset << " !" << std::endl;
+#endif
+		//free(data); No!! It's already freed upwards in ftDataMultiplex::locked_handleServerRequest()
 		return 0;
 	}
+
+	/*
+	 * Update status of ftFileStatus to reflect last usage (for GUI display)
+	 * We need to store.
+	 * (a) Id,
+	 * (b) Offset,
+	 * (c) Size,
+	 * (d) timestamp
+	 */
+
+	// This creates the peer info, and updates it.
+	//
+	time_t now = time(NULL) ;
+	uploading_peers[peer_id].updateStatus(offset,data_size,now) ;
+
+#ifdef DEBUG_TRANSFERS
+	std::cerr << "ftFileProvider::getFileData() ";
+	std::cerr << " at " << RsUtil::AccurateTimeString();
+	std::cerr << " hash: " << hash;
+	std::cerr << " for peerId: " << peer_id;
+	std::cerr << " offset: " << offset;
+	std::cerr << " chunkSize: " << chunk_size;
+	std::cerr << std::endl;
+#endif
+
 	return 1;
 }
 
@@ -287,50 +320,42 @@ void ftFileProvider::getClientMap(const RsPeerId& peer_id,CompressedChunkMap& cm
 
 int ftFileProvider::initializeFileAttrs()
 {
-#ifdef DEBUG_FT_FILE_PROVIDER
-	std::cerr << "ftFileProvider::initializeFileAttrs() Filename: " << file_name << std::endl;
-#endif
-
 	RsStackMutex stack(ftcMutex); /********** STACK LOCKED MTX ******/
-	if (fd)
-		return 1;
 
-	/* 
-	 * check if the file exists 
-	 */
+	return locked_initializeFileAttrs() ;
+}
 
-	{
+int ftFileProvider::locked_initializeFileAttrs()
+{
 #ifdef DEBUG_FT_FILE_PROVIDER
-		std::cerr << "ftFileProvider::initializeFileAttrs() trying (r+b) " << std::endl;
+	std::cerr << "ftFileProvider::initializeFileAttrs() Filename: " << file_name << std::endl;
 #endif
-	}
+
+	if (mFileIO->isOpen())
+		return 1;
 
 	/* 
 	 * attempt to open file 
 	 */
 
-	fd = RsDirUtil::rs_fopen(file_name.c_str(), "r+b");
-	if (!fd)
+	if (!mFileIO->open(file_name, ftFileIO::FT_FILE_IO_READ_WRITE))
 	{
 		std::cerr << "ftFileProvider::initializeFileAttrs() Failed to open (r+b): ";
 		std::cerr << file_name << std::endl;
 
 		/* try opening read only */
-		fd = RsDirUtil::rs_fopen(file_name.c_str(), "rb");
-		if (!fd)
+		if (!mFileIO->open(file_name, ftFileIO::FT_FILE_IO_READ_ONLY))
 		{
 			std::cerr << "ftFileProvider::initializeFileAttrs() Failed to open (rb): ";
 			std::cerr << file_name << std::endl;
 
-			/* try opening read only */
 			return 0;
 		}
 	}
+	mCloseRequested = false ;
 #ifdef DEBUG_FT_FILE_PROVIDER
 	std::cerr << "ftFileProvider:: openned file " << file_name << std::endl ;
 #endif
 
 	return 1;
 }
-
-
@@ -35,10 +35,16 @@
 #include "util/rsthreads.h"
 #include "retroshare/rsfiles.h"
 
+class ftFileIO ;
+
 class ftFileProvider
 {
 	public:
-		ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash);
+		/**
+		 * @param allow_mapping read large files through a memory mapping instead of buffered reads. Only
+		 * for complete files that are not modified while being shared.
+		 */
+		ftFileProvider(const std::string& path, uint64_t size, const RsFileHash& hash, bool allow_mapping = false);
 		virtual ~ftFileProvider();
 
         /**
@@ -56,6 +62,9 @@ class ftFileProvider
 		uint64_t getFileSize();
 		bool fileOk();
 
+		// True if slices are served from a memory mapping of the file, rather than through buffered reads.
+		bool isMemoryMapped();
+
 		// Provides a client for the map of chunks actually present in the file. If the provider is also
 		// a file creator, because the file is actually being downloaded, then the map may be partially complete.
 		// Otherwize, a plain map is returned.
@@ -75,11 +84,21 @@ class ftFileProvider
 		uint64_t fileSize() const { return mSize ; }
 	protected:
 		virtual	int initializeFileAttrs(); /* does for both */
+		virtual int locked_initializeFileAttrs();
+
+		// Disk I/O is done outside of ftcMutex. These keep track of the operations in progress, so
+		// that closing the file while another thread reads/writes it is deferred to the last of them.
+		//
+		void locked_closeFile() ;
+		void locked_startIO() { ++mPendingIO ; }
+		void locked_endIO() ;
 
 		uint64_t    mSize;
 		RsFileHash hash;
 		std::string file_name;
-		FILE *fd;
+		ftFileIO *mFileIO;	// never changes after construction, so it can be used without the mutex.
+		uint32_t mPendingIO;
+		bool mCloseRequested;
 
 		/* 
 		 * Structure to gather statistics FIXME: lastRequestor - figure out a 
@@ -89,7 +108,7 @@ class ftFileProvider
 		{
 			public:
 				PeerUploadInfo() 
-					: req_loc(0),req_size(1),  lastTS_t(0), lastTS(0),transfer_rate(0), total_size(0), client_chunk_map_stamp(0) {}
+					: req_loc(0),req_size(1),  lastTS_t(0), lastTS(0),transfer_rate(0), total_size(0), readahead_end(0), client_chunk_map_stamp(0) {}
 
 				void updateStatus(uint64_t offset,uint32_t data_size,time_t now) ;
 
@@ -102,6 +121,9 @@ class ftFileProvider
 				float 	  transfer_rate ;
 				uint32_t		total_size ;
 
+				// end of the range for which read-ahead was already asked, when this peer reads sequentially.
+				uint64_t readahead_end ;
+
 				// Info about what the downloading peer already has
 				CompressedChunkMap client_chunk_map ;
 				time_t client_chunk_map_stamp ;
@@ -62,6 +62,23 @@
 
 static const time_t FILE_TRANSFER_LOW_PRIORITY_TASKS_PERIOD = 5 ;           // low priority tasks handling every 5 seconds
 static const time_t FILE_TRANSFER_MAX_DELAY_BEFORE_DROP_USAGE_RECORD = 10 ; // keep usage records for 10 secs at most.
+static const time_t FILE_TRANSFER_ENCRYPTION_CONTEXT_MAX_AGE         = 60 ; // keep unused encryption keys for 60 secs at most.
+
+static const uint32_t FILE_TRANSFER_MAX_SLICES_PER_REQUESTS_ITEM = 128 ;              // multi-slice data request items bigger than this are
+static const uint64_t FILE_TRANSFER_MAX_BYTES_PER_REQUESTS_ITEM  = 16 * 1024 * 1024 ; // dropped, so larger requests are split over several items.
+
+// time counter for the encryption statistics: CPU cycles on x86, nanoseconds elsewhere.
+
+static inline uint64_t getEncryptionTicks()
+{
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+	return __builtin_ia32_rdtsc() ;
+#else
+	struct timespec ts ;
+	clock_gettime(CLOCK_MONOTONIC,&ts) ;
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec ;
+#endif
+}
 
 /* Setup */
 ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
@@ -69,14 +86,14 @@ ftServer::ftServer(p3PeerMgr *pm, p3ServiceControl *sc)
       mPeerMgr(pm), mServiceCtrl(sc),
       mFileDatabase(NULL),
       mFtController(NULL), mFtExtra(NULL),
-      mFtDataplex(NULL), mFtSearch(NULL), srvMutex("ftServer")
+      mFtDataplex(NULL), mFtSearch(NULL), srvMutex("ftServer"), mEncryptionMtx("ftServer encryption")
 {
 	addSerialType(new RsFileTransferSerialiser()) ;
 }
 
 const std::string FILE_TRANSFER_APP_NAME = "ft";
 const uint16_t FILE_TRANSFER_APP_MAJOR_VERSION	= 	1;
-const uint16_t FILE_TRANSFER_APP_MINOR_VERSION  = 	0;
+const uint16_t FILE_TRANSFER_APP_MINOR_VERSION  = 	1;	// 1: multi-slice data requests
 const uint16_t FILE_TRANSFER_MIN_MAJOR_VERSION  = 	1;
 const uint16_t FILE_TRANSFER_MIN_MINOR_VERSION	=	0;
 
@@ -305,6 +322,10 @@ bool ftServer::setChunkStrategy(const RsFileHash& hash,FileChunksInfo::ChunkStra
 {
 	return mFtController->setChunkStrategy(hash,s);
 }
+bool ftServer::setPlaybackCursor(const RsFileHash& hash,uint64_t offset)
+{
+	return mFtController->setPlaybackCursor(hash,offset);
+}
 void ftServer::setDefaultChunkStrategy(FileChunksInfo::ChunkStrategy s)
 {
 	mFtController->setDefaultChunkStrategy(s) ;
@@ -323,6 +344,19 @@ void ftServer::setFreeDiskSpaceLimit(uint32_t s)
 	mFtController->setFreeDiskSpaceLimit(s) ;
 }
 
+void ftServer::setMemoryMappedReads(bool b)
+{
+	mFtController->setMemoryMappedReads(b) ;
+}
+bool ftServer::memoryMappedReads()
+{
+	return mFtController->memoryMappedReads() ;
+}
+void ftServer::getDiskReadStatistics(uint64_t& mapped_bytes, uint64_t& buffered_bytes)
+{
+	mFtDataplex->getDiskReadStatistics(mapped_bytes,buffered_bytes) ;
+}
+
 void ftServer::setDefaultEncryptionPolicy(uint32_t s)
 {
 	mFtController->setDefaultEncryptionPolicy(s) ;
@@ -534,8 +568,16 @@ void ftServer::addVirtualPeer(const TurtleFileHash& hash,const TurtleVirtualPeer
 	{
 		if(findRealHash(hash,real_hash))
 		{
-			RS_STACK_MUTEX(srvMutex) ;
-			mEncryptedPeerIds[virtual_peer_id] = hash ;
+			{
+				RS_STACK_MUTEX(srvMutex) ;
+				mEncryptedPeerIds[virtual_peer_id] = hash ;
+			}
+
+			uint8_t key[32] ;
+			getEncryptionKey(real_hash,key) ;
+
+			RS_STACK_MUTEX(mEncryptionMtx) ;
+			++mEncryptionContexts[real_hash].nb_virtual_peers ;
 		}
 		else
 			real_hash = hash;
@@ -553,13 +595,28 @@ void ftServer::addVirtualPeer(const TurtleFileHash& hash,const TurtleVirtualPeer
 void ftServer::removeVirtualPeer(const TurtleFileHash& hash,const TurtleVirtualPeerId& virtual_peer_id)
 {
 	RsFileHash real_hash ;
-	if(findRealHash(hash,real_hash))
+	bool encrypted = findRealHash(hash,real_hash) ;
+
+	if(encrypted)
 		mFtController->removeFileSource(real_hash,virtual_peer_id) ;
 	else
 		mFtController->removeFileSource(hash,virtual_peer_id) ;
 
-	RS_STACK_MUTEX(srvMutex) ;
-	mEncryptedPeerIds.erase(virtual_peer_id) ;
+	{
+		RS_STACK_MUTEX(srvMutex) ;
+		encrypted = encrypted && mEncryptedPeerIds.erase(virtual_peer_id) > 0 ;
+	}
+
+	if(encrypted)
+	{
+		RS_STACK_MUTEX(mEncryptionMtx) ;
+		std::map<RsFileHash,EncryptionContext>::iterator it = mEncryptionContexts.find(real_hash) ;
+
+		if(it != mEncryptionContexts.end() && it->second.nb_virtual_peers <= 1)
+			mEncryptionContexts.erase(it) ;
+		else if(it != mEncryptionContexts.end())
+			--it->second.nb_virtual_peers ;
+	}
 }
 
 bool ftServer::handleTunnelRequest(const RsFileHash& hash,const RsPeerId& peer_id)
@@ -848,6 +905,11 @@ void ftServer::setFollowSymLinks(bool b)           { mFileDatabase->setFollowSym
 void ftServer::setIgnoreDuplicates(bool ignore)    { mFileDatabase->setIgnoreDuplicates(ignore); }
 void ftServer::setMaxShareDepth(int depth)         { mFileDatabase->setMaxShareDepth(depth) ; }
 
+void ftServer::setMaxHashingThreads(uint32_t n)          { mFileDatabase->setMaxHashingThreads(n) ; }
+uint32_t ftServer::maxHashingThreads()                   { return mFileDatabase->maxHashingThreads() ; }
+void ftServer::setMaxHashingThreadsPerDevice(uint32_t n) { mFileDatabase->setMaxHashingThreadsPerDevice(n) ; }
+uint32_t ftServer::maxHashingThreadsPerDevice()          { return mFileDatabase->maxHashingThreadsPerDevice() ; }
+
 void ftServer::togglePauseHashingProcess()  { mFileDatabase->togglePauseHashingProcess() ; }
 bool ftServer::hashingProcessPaused() { return mFileDatabase->hashingProcessPaused() ; }
 
@@ -971,6 +1033,58 @@ bool	ftServer::sendDataRequest(const RsPeerId& peerId, const RsFileHash& hash, u
 	return true;
 }
 
+/* Client Send */
+bool	ftServer::sendDataRequests(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, const std::vector<std::pair<uint64_t,uint32_t> >& slices)
+{
+#ifdef SERVER_DEBUG
+	FTSERVER_DEBUG() << "ftServer::sendDataRequests() to peer " << peerId << " for hash " << hash << ", " << slices.size() << " slices" << std::endl;
+#endif
+	// Turtle items carry a single slice, and older peers do not know the multi-slice item.
+
+	if(slices.size() < 2 || mTurtleRouter->isTurtlePeer(peerId) || !peerHandlesDataRequests(peerId))
+		return ftDataSend::sendDataRequests(peerId,hash,size,slices) ;
+
+	for(uint32_t i=0;i<slices.size();)
+	{
+		RsFileTransferDataRequestsItem *rfi = new RsFileTransferDataRequestsItem();
+
+		rfi->PeerId(peerId);
+
+		rfi->file.filesize   = size;
+		rfi->file.hash       = hash;
+
+		uint64_t total_size = 0 ;
+
+		// each item gets at least one slice
+
+		do
+		{
+			rfi->fileoffsets.push_back(slices[i].first) ;
+			rfi->chunksizes.push_back(slices[i].second) ;
+			total_size += slices[i].second ;
+			++i ;
+		}
+		while(i < slices.size() && rfi->fileoffsets.size() < FILE_TRANSFER_MAX_SLICES_PER_REQUESTS_ITEM
+		                        && total_size + slices[i].second <= FILE_TRANSFER_MAX_BYTES_PER_REQUESTS_ITEM) ;
+
+		sendItem(rfi);
+	}
+
+	return true;
+}
+
+bool ftServer::peerHandlesDataRequests(const RsPeerId& peerId)
+{
+	RsPeerServiceInfo info ;
+
+	if(!mServiceCtrl->getServicesProvided(peerId,info))
+		return false ;
+
+	std::map<uint32_t,RsServiceInfo>::const_iterator it = info.mServiceList.find(getServiceInfo().mServiceType) ;
+
+	return it != info.mServiceList.end() && it->second.mVersionMajor == FILE_TRANSFER_APP_MAJOR_VERSION && it->second.mVersionMinor >= 1 ;
+}
+
 bool ftServer::sendChunkMapRequest(const RsPeerId& peerId,const RsFileHash& hash,bool is_client)
 {
 #ifdef SERVER_DEBUG
@@ -1124,7 +1238,35 @@ bool	ftServer::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t
 
 		/******** New Serialiser Type *******/
 
-		if(mTurtleRouter->isTurtlePeer(peerId))
+		RsFileHash encrypted_hash ;
+
+		if(mTurtleRouter->isTurtlePeer(peerId) && findEncryptedHash(peerId,encrypted_hash))
+		{
+			// The slice is serialised straight from the data into the encrypted item, so that it is not copied
+			// into a clear item first.
+
+			RsTurtleFileDataItem item ;
+
+			item.chunk_offset = offset+baseoffset ;
+			item.chunk_size = chunk;
+			item.chunk_data = &(((uint8_t *) data)[offset]) ;
+
+			RsTurtleGenericDataItem *encrypted_item ;
+			bool ok = encryptItem(&item, hash, encrypted_item) ;	// counts its own allocations
+
+			item.chunk_data = NULL ;	// not ours
+
+			if(!ok)
+				return false ;
+
+			{
+				RS_STACK_MUTEX(mEncryptionMtx) ;
+				++mEncryptionStats.sent_slices ;
+			}
+
+			mTurtleRouter->sendTurtleData(peerId,encrypted_item) ;
+		}
+		else if(mTurtleRouter->isTurtlePeer(peerId))
 		{
 			RsTurtleFileDataItem *item = new RsTurtleFileDataItem ;
 
@@ -1132,6 +1274,12 @@ bool	ftServer::sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t
 			item->chunk_size = chunk;
 			item->chunk_data = rs_malloc(chunk) ;
 
+			{
+				RS_STACK_MUTEX(mEncryptionMtx) ;
+				++mEncryptionStats.sent_slices ;
+				mEncryptionStats.allocations += (item->chunk_data != NULL)? 2 : 1 ;
+			}
+
 			if(item->chunk_data == NULL)
 			{
 				delete item;
@@ -1208,6 +1356,55 @@ void ftServer::deriveEncryptionKey(const RsFileHash& hash, uint8_t *key)
 	SHA256_Final (key, &sha_ctx);
 }
 
+void ftServer::getEncryptionKey(const RsFileHash& hash, uint8_t *key)
+{
+	RS_STACK_MUTEX(mEncryptionMtx) ;
+
+	std::map<RsFileHash,EncryptionContext>::iterator it = mEncryptionContexts.find(hash) ;
+
+	if(it == mEncryptionContexts.end())
+	{
+		// Items can still come after the last virtual peer is gone. Contexts without virtual peers are removed
+		// by cleanEncryptionContexts() once they have not been used for a while.
+
+		it = mEncryptionContexts.insert(std::make_pair(hash,EncryptionContext())).first ;
+		it->second.nb_virtual_peers = 0 ;
+
+		deriveEncryptionKey(hash,it->second.key) ;
+		++mEncryptionStats.key_derivations ;
+	}
+
+	it->second.last_used = time(NULL) ;
+	memcpy(key,it->second.key,32) ;
+}
+
+void ftServer::cleanEncryptionContexts(time_t max_age)
+{
+	RS_STACK_MUTEX(mEncryptionMtx) ;
+	time_t now = time(NULL) ;
+
+	for(std::map<RsFileHash,EncryptionContext>::iterator it(mEncryptionContexts.begin());it!=mEncryptionContexts.end();)
+		if(it->second.nb_virtual_peers == 0 && it->second.last_used + max_age <= now)
+		{
+#ifdef SERVER_DEBUG
+			FTSERVER_DEBUG() << "Removing unused encryption context for hash " << it->first << std::endl;
+#endif
+			std::map<RsFileHash,EncryptionContext>::iterator tmp(it) ;
+			++tmp ;
+			mEncryptionContexts.erase(it) ;
+			it = tmp ;
+		}
+		else
+			++it ;
+}
+
+void ftServer::getEncryptionStatistics(ftEncryptionStatistics& stats)
+{
+	RS_STACK_MUTEX(mEncryptionMtx) ;
+	stats = mEncryptionStats ;
+	stats.contexts = mEncryptionContexts.size() ;
+}
+
 static const uint32_t ENCRYPTED_FT_INITIALIZATION_VECTOR_SIZE = 12 ;
 static const uint32_t ENCRYPTED_FT_AUTHENTICATION_TAG_SIZE    = 16 ;
 static const uint32_t ENCRYPTED_FT_HEADER_SIZE                =  4 ;
@@ -1219,6 +1416,8 @@ static const uint8_t  ENCRYPTED_FT_FORMAT_AEAD_CHACHA20_SHA256   = 0x02 ;
 
 bool ftServer::encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHash& hash,RsTurtleGenericDataItem *& encrypted_item)
 {
+	uint64_t start_ticks = getEncryptionTicks() ;
+
 	uint8_t initialization_vector[ENCRYPTED_FT_INITIALIZATION_VECTOR_SIZE] ;
 
 	RSRandom::random_bytes(initialization_vector,ENCRYPTED_FT_INITIALIZATION_VECTOR_SIZE) ;
@@ -1240,8 +1439,17 @@ bool ftServer::encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHas
 	encrypted_item->data_bytes = rs_malloc( total_data_size ) ;
 	encrypted_item->data_size  = total_data_size ;
 
+	{
+		RS_STACK_MUTEX(mEncryptionMtx) ;
+		mEncryptionStats.allocations += (encrypted_item->data_bytes != NULL)? 2 : 1 ;
+	}
+
 	if(encrypted_item->data_bytes == NULL)
+	{
+		delete encrypted_item ;
+		encrypted_item = NULL ;
 		return false ;
+	}
 
 	uint8_t *edata = (uint8_t*)encrypted_item->data_bytes ;
 	uint32_t edata_size = item_serialized_size;
@@ -1281,14 +1489,26 @@ bool ftServer::encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHas
 	assert(ENCRYPTED_FT_AUTHENTICATION_TAG_SIZE + offset == total_data_size) ;
 
 	uint8_t encryption_key[32] ;
-	deriveEncryptionKey(hash,encryption_key) ;
+	getEncryptionKey(hash,encryption_key) ;
 
 	if(edata[2] == ENCRYPTED_FT_FORMAT_AEAD_CHACHA20_POLY1305)
 		librs::crypto::AEAD_chacha20_poly1305(encryption_key,initialization_vector,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
 	else if(edata[2] == ENCRYPTED_FT_FORMAT_AEAD_CHACHA20_SHA256)
 		librs::crypto::AEAD_chacha20_sha256  (encryption_key,initialization_vector,&edata[clear_item_offset],edata_size, &edata[aad_offset],aad_size, &edata[authentication_tag_offset],true) ;
 	else
+	{
+		delete encrypted_item ;
+		encrypted_item = NULL ;
 		return false ;
+	}
+
+	{
+		RS_STACK_MUTEX(mEncryptionMtx) ;
+
+		++mEncryptionStats.encrypted_items ;
+		mEncryptionStats.encrypted_bytes += total_data_size ;
+		mEncryptionStats.encryption_cycles += getEncryptionTicks() - start_ticks ;
+	}
 
 #ifdef SERVER_DEBUG
 	FTSERVER_DEBUG() << "  encryption key  : " << RsUtil::BinToHex(encryption_key,32) << std::endl;
@@ -1303,8 +1523,10 @@ bool ftServer::encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHas
 
 bool ftServer::decryptItem(RsTurtleGenericDataItem *encrypted_item,const RsFileHash& hash,RsTurtleGenericTunnelItem *& decrypted_item)
 {
+	uint64_t start_ticks = getEncryptionTicks() ;
+
 	uint8_t encryption_key[32] ;
-	deriveEncryptionKey(hash,encryption_key) ;
+	getEncryptionKey(hash,encryption_key) ;
 
 	uint8_t *edata = (uint8_t*)encrypted_item->data_bytes ;
 	uint32_t offset = 0;
@@ -1372,10 +1594,31 @@ bool ftServer::decryptItem(RsTurtleGenericDataItem *encrypted_item,const RsFileH
 		return false ;
 	}
 
-	decrypted_item = dynamic_cast<RsTurtleGenericTunnelItem*>(deserialise(&edata[clear_item_offset],&edata_size)) ;
+	// the data is decrypted in place, so the item is deserialised from the encrypted item's own buffer.
+
+	RsItem *item = deserialise(&edata[clear_item_offset],&edata_size) ;
+	decrypted_item = dynamic_cast<RsTurtleGenericTunnelItem*>(item) ;
+
+	// the deserialiser allocates the item, and the data of file data items.
+
+	RsTurtleFileDataItem *data_item = dynamic_cast<RsTurtleFileDataItem*>(item) ;
+	uint32_t allocations = (item != NULL)? 1 : 0 ;
+
+	if(data_item != NULL && data_item->chunk_data != NULL)
+		++allocations ;
+
+	RS_STACK_MUTEX(mEncryptionMtx) ;
+	mEncryptionStats.allocations += allocations ;
 
 	if(decrypted_item == NULL)
+	{
+		delete item ;
 		return false ;
+	}
+
+	++mEncryptionStats.decrypted_items ;
+	mEncryptionStats.decrypted_bytes += encrypted_item->data_size ;
+	mEncryptionStats.decryption_cycles += getEncryptionTicks() - start_ticks ;
 
 	return true ;
 }
@@ -1554,6 +1797,19 @@ int	ftServer::tick()
 		mFtDataplex->deleteUnusedServers() ;
 		mFtDataplex->handlePendingCrcRequests() ;
 		mFtDataplex->dispatchReceivedChunkCheckSum() ;
+
+		cleanEncryptionContexts(FILE_TRANSFER_ENCRYPTION_CONTEXT_MAX_AGE) ;
+
+#ifdef SERVER_DEBUG
+		ftEncryptionStatistics stats ;
+		getEncryptionStatistics(stats) ;
+
+		FTSERVER_DEBUG() << "Encrypted tunnels: " << stats.encrypted_items << " items encrypted, " << stats.decrypted_items << " items decrypted, "
+		                 << stats.encryption_cycles / (double)std::max(stats.encrypted_bytes,(uint64_t)1) << " cycles/byte to encrypt, "
+		                 << stats.decryption_cycles / (double)std::max(stats.decrypted_bytes,(uint64_t)1) << " cycles/byte to decrypt, "
+		                 << stats.allocations / (double)std::max(stats.sent_slices + stats.decrypted_items,(uint64_t)1) << " allocations per slice, "
+		                 << stats.key_derivations << " key derivations, " << stats.contexts << " keys cached." << std::endl;
+#endif
 	}
 
 	return moreToTick;
@@ -1663,6 +1919,33 @@ int ftServer::handleIncoming()
 		}
 			break ;
 
+		case RS_PKT_SUBTYPE_FT_DATA_REQUESTS:
+		{
+			RsFileTransferDataRequestsItem *f = dynamic_cast<RsFileTransferDataRequestsItem*>(item) ;
+
+			if (f && f->fileoffsets.size() == f->chunksizes.size() && checkUploadLimit(f->PeerId(),f->file.hash))
+			{
+				uint64_t total_size = 0 ;
+
+				for(uint32_t i=0;i<f->chunksizes.size();++i)
+					total_size += f->chunksizes[i] ;
+
+				if(f->fileoffsets.size() > FILE_TRANSFER_MAX_SLICES_PER_REQUESTS_ITEM || total_size > FILE_TRANSFER_MAX_BYTES_PER_REQUESTS_ITEM)
+				{
+					std::cerr << "(WW) peer " << f->PeerId() << " requests " << f->fileoffsets.size() << " slices (" << total_size << " bytes) of file "
+					          << f->file.hash << " at once. This is more than allowed. Dropping the request." << std::endl;
+					break ;
+				}
+
+#ifdef SERVER_DEBUG
+				FTSERVER_DEBUG() << "ftServer::handleIncoming: received " << f->fileoffsets.size() << " data requests for hash " << f->file.hash << std::endl;
+#endif
+				for(uint32_t i=0;i<f->fileoffsets.size();++i)
+					mFtDataplex->recvDataRequest(f->PeerId(), f->file.hash,  f->file.filesize, f->fileoffsets[i], f->chunksizes[i]);
+			}
+		}
+			break ;
+
 		case RS_PKT_SUBTYPE_FT_DATA:
 		{
 			RsFileTransferDataItem *f = dynamic_cast<RsFileTransferDataItem*>(item) ;
@@ -68,6 +68,27 @@ class p3PeerMgr;
 class p3ServiceControl;
 class p3FileDatabase;
 
+// Counters of the end-to-end encryption of turtle file transfer items. Cycles are CPU time stamp counter ticks
+// on x86, and nanoseconds elsewhere.
+
+struct ftEncryptionStatistics
+{
+	ftEncryptionStatistics()
+	    : encrypted_items(0), decrypted_items(0), encrypted_bytes(0), decrypted_bytes(0),
+	      encryption_cycles(0), decryption_cycles(0), sent_slices(0), allocations(0), key_derivations(0), contexts(0) {}
+
+	uint64_t encrypted_items ;
+	uint64_t decrypted_items ;
+	uint64_t encrypted_bytes ;
+	uint64_t decrypted_bytes ;
+	uint64_t encryption_cycles ;
+	uint64_t decryption_cycles ;
+	uint64_t sent_slices ;			// file data slices sent through tunnels
+	uint64_t allocations ;			// memory blocks allocated to send slices through tunnels, and to encrypt and decrypt items
+	uint64_t key_derivations ;
+	uint32_t contexts ;				// encryption keys currently cached
+};
+
 class ftServer: public p3Service, public RsFiles, public ftDataSend, public RsTurtleClientService, public RsServiceSerializer
 {
 
@@ -132,10 +153,14 @@ public:
     virtual bool setDestinationDirectory(const RsFileHash& hash,const std::string& new_path) ;
     virtual bool setDestinationName(const RsFileHash& hash,const std::string& new_name) ;
     virtual bool setChunkStrategy(const RsFileHash& hash,FileChunksInfo::ChunkStrategy s) ;
+    virtual bool setPlaybackCursor(const RsFileHash& hash,uint64_t offset) ;
     virtual void setDefaultChunkStrategy(FileChunksInfo::ChunkStrategy) ;
     virtual FileChunksInfo::ChunkStrategy defaultChunkStrategy() ;
     virtual uint32_t freeDiskSpaceLimit() const ;
     virtual void setFreeDiskSpaceLimit(uint32_t size_in_mb) ;
+    virtual void setMemoryMappedReads(bool b) ;
+    virtual bool memoryMappedReads() ;
+    virtual void getDiskReadStatistics(uint64_t& mapped_bytes, uint64_t& buffered_bytes) ;
     virtual void setDefaultEncryptionPolicy(uint32_t policy) ;	// RS_FILE_CTRL_ENCRYPTION_POLICY_STRICT/PERMISSIVE
     virtual uint32_t defaultEncryptionPolicy() ;
 	virtual void setMaxUploadSlotsPerFriend(uint32_t n) ;
@@ -230,6 +255,10 @@ public:
 
 	virtual void setMaxShareDepth(int depth) ;
 	virtual int  maxShareDepth() const;
+	virtual void setMaxHashingThreads(uint32_t n) ;
+	virtual uint32_t maxHashingThreads() ;
+	virtual void setMaxHashingThreadsPerDevice(uint32_t n) ;
+	virtual uint32_t maxHashingThreadsPerDevice() ;
 
 	virtual bool ignoreDuplicates() ;
 	virtual void setIgnoreDuplicates(bool ignore) ;
@@ -242,6 +271,7 @@ public:
 
     virtual bool sendData(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize, void *data);
     virtual bool sendDataRequest(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, uint64_t offset, uint32_t chunksize);
+    virtual bool sendDataRequests(const RsPeerId& peerId, const RsFileHash& hash, uint64_t size, const std::vector<std::pair<uint64_t,uint32_t> >& slices);
     virtual bool sendChunkMapRequest(const RsPeerId& peer_id,const RsFileHash& hash,bool is_client) ;
     virtual bool sendChunkMap(const RsPeerId& peer_id,const RsFileHash& hash,const CompressedChunkMap& cmap,bool is_client) ;
     virtual bool sendSingleChunkCRCRequest(const RsPeerId& peer_id,const RsFileHash& hash,uint32_t chunk_number) ;
@@ -252,6 +282,11 @@ public:
     bool encryptItem(RsTurtleGenericTunnelItem *clear_item,const RsFileHash& hash,RsTurtleGenericDataItem *& encrypted_item);
     bool decryptItem(RsTurtleGenericDataItem *encrypted_item, const RsFileHash& hash, RsTurtleGenericTunnelItem *&decrypted_item);
 
+    void getEncryptionStatistics(ftEncryptionStatistics& stats) ;
+
+    // Forgets the encryption keys that no virtual peer uses, and that have not been used since max_age seconds.
+    void cleanEncryptionContexts(time_t max_age) ;
+
     /*************** Internal Transfer Fns *************************/
     virtual int tick();
 
@@ -282,6 +317,12 @@ protected:
     bool encryptHash(const RsFileHash& hash, RsFileHash& hash_of_hash);
 
 	bool checkUploadLimit(const RsPeerId& pid,const RsFileHash& hash);
+
+	// true when the peer's file transfer service understands multi-slice data requests
+	bool peerHandlesDataRequests(const RsPeerId& pid);
+
+	// Gets the encryption key of real hash hash from the cache, deriving it if needed.
+	void getEncryptionKey(const RsFileHash& hash, uint8_t *key);
 private:
 
     /**** INTERNAL FUNCTIONS ***/
@@ -310,6 +351,20 @@ private:
     std::map<RsFileHash,RsFileHash> mEncryptedHashes ; // This map is such that sha1(it->second) = it->first
     std::map<RsPeerId,RsFileHash> mEncryptedPeerIds ;  // This map holds the hash to be used with each peer id
     std::map<RsPeerId,std::map<RsFileHash,time_t> > mUploadLimitMap ;
+
+    // Encryption keys of the files transferred through encrypted tunnels, by real hash. A key is kept as long as
+    // virtual peers use it, so that it is derived once per file rather than once per item.
+
+    struct EncryptionContext
+    {
+        uint8_t key[32] ;
+        uint32_t nb_virtual_peers ;
+        time_t last_used ;
+    };
+
+    RsMutex mEncryptionMtx ;
+    std::map<RsFileHash,EncryptionContext> mEncryptionContexts ;
+    ftEncryptionStatistics mEncryptionStats ;
 };
 
 
@@ -28,6 +28,7 @@
  *****/
 
 #include <time.h>
+#include <sys/time.h>
 
 #include "retroshare/rsturtle.h"
 #include "fttransfermodule.h"
@@ -62,6 +63,15 @@ const double FT_TM_RATE_INCREASE_SLOWER  = 0.05 ;
 const double FT_TM_RATE_INCREASE_AVERAGE = 0.3 ;
 const double FT_TM_RATE_INCREASE_FASTER  = 1.0 ;
 
+// Pipelining mode. The window of each peer is the amount of data requested and not received yet.
+const uint32_t FT_TM_PIPELINE_MIN_WINDOW     = 64 * 1024;        /* 64KB */
+const uint32_t FT_TM_PIPELINE_MAX_WINDOW     = 16 * 1024 * 1024; /* 16MB */
+const uint32_t FT_TM_PIPELINE_MIN_SLICE      = 16 * 1024;        /* 16KB */
+const uint32_t FT_TM_PIPELINE_MAX_SLICE      = 1024 * 1024;      /* 1MB, the size of a chunk */
+const uint32_t FT_TM_PIPELINE_SLICES_PER_WINDOW = 8;
+const double   FT_TM_PIPELINE_MIN_RTT_PERIOD = 10.0 ; /* min rtt is forgotten after 10 seconds */
+const double   FT_TM_PIPELINE_QUEUEING_RTT   = 1.5 ;  /* srtt/minRtt ratio above which the window stops growing */
+
 //const int32_t FT_TM_FAST_RTT    = 1.0;
 //const int32_t FT_TM_STD_RTT     = 5.0;
 //const int32_t FT_TM_SLOW_RTT    = 20.0;
@@ -76,8 +86,23 @@ const double FT_TM_RATE_INCREASE_FASTER  = 1.0 ;
 #define FT_TM_FLAG_CHECKING 		3
 #define FT_TM_FLAG_CHUNK_CRC 		4
 
+static double getCurrentTS()
+{
+#ifndef WINDOWS_SYS
+	struct timeval cts_tmp;
+	gettimeofday(&cts_tmp, NULL);
+	double cts =  (cts_tmp.tv_sec) + ((double) cts_tmp.tv_usec) / 1000000.0;
+#else
+	struct _timeb timebuf;
+	_ftime( &timebuf);
+	double cts =  (timebuf.time) + ((double) timebuf.millitm) / 1000.0;
+#endif
+	return cts;
+}
+
 ftTransferModule::ftTransferModule(ftFileCreator *fc, ftDataMultiplex *dm, ftController *c)
-	:mFileCreator(fc), mMultiplexor(dm), mFtController(c), tfMtx("ftTransferModule"), mFlag(FT_TM_FLAG_DOWNLOADING),mPriority(SPEED_NORMAL)
+	:mFileCreator(fc), mMultiplexor(dm), mFtController(c), tfMtx("ftTransferModule"), mFlag(FT_TM_FLAG_DOWNLOADING),mPriority(SPEED_NORMAL),
+	mPipelining(false)
 {
   	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
 
@@ -241,11 +266,42 @@ bool ftTransferModule::setPeerState(const RsPeerId& peerId,uint32_t state,uint32
   {
     //change to offline, remove peerId in online peer list
     if (it!=mOnlinePeers.end()) mOnlinePeers.erase(it);
+
+    // whatever was requested will not come.
+    (mit->second).pendingSlices.clear();
+    (mit->second).inFlight = 0;
   }
 
   return true;
 }
 
+void ftTransferModule::setPipelining(bool b)
+{
+	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
+	mPipelining = b ;
+}
+
+bool ftTransferModule::pipelining()
+{
+	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
+	return mPipelining ;
+}
+
+void ftTransferModule::getPeerTransferInfo(std::map<RsPeerId,FileChunksInfo::PeerTransferInfo>& info)
+{
+	RsStackMutex stack(tfMtx); /******* STACK LOCKED ******/
+
+	for(std::map<RsPeerId,peerInfo>::const_iterator mit(mFileSources.begin());mit!=mFileSources.end();++mit)
+	{
+		FileChunksInfo::PeerTransferInfo& pinfo(info[mit->first]) ;
+
+		pinfo.rtt_ms           = (uint32_t)(mit->second.srtt * 1000.0) ;
+		pinfo.in_flight_bytes  = mit->second.inFlight ;
+		pinfo.window_bytes     = mPipelining?(mit->second.window):0 ;
+		pinfo.pending_requests = mit->second.pendingSlices.size() ;
+	}
+}
+
 
 bool ftTransferModule::getPeerState(const RsPeerId& peerId,uint32_t &state,uint32_t &tfRate)
 {
@@ -326,6 +382,10 @@ bool ftTransferModule::recvFileData(const RsPeerId& peerId, uint64_t offset, uin
 
 	locked_storeData(offset, chunk_size, data);
 
+	// keep the pipe full, without waiting for the next tick.
+	if(mPipelining && mFileStatus.stat == ftFileStatus::PQIFILE_DOWNLOADING)
+		locked_fillPipeline(mit->second, getCurrentTS());
+
 	_last_activity_time_stamp = time(NULL) ;
 
 	free(data) ;
@@ -347,6 +407,143 @@ void ftTransferModule::locked_requestData(const RsPeerId& peerId, uint64_t offse
   mMultiplexor->sendDataRequest(peerId, mHash, mSize, offset,chunk_size);
 }
 
+void ftTransferModule::locked_addPendingSlice(peerInfo &info, uint64_t offset, uint32_t chunk_size, double now)
+{
+	std::map<uint64_t,ftPendingSlice>::iterator it = info.pendingSlices.find(offset) ;
+
+	// a slice asked again, after the file creator gave up waiting for it.
+	if(it != info.pendingSlices.end())
+		info.inFlight -= std::min(info.inFlight,it->second.remaining) ;
+
+	info.pendingSlices[offset] = ftPendingSlice(chunk_size,now) ;
+	info.inFlight += chunk_size ;
+}
+
+void ftTransferModule::locked_recvPendingSlice(peerInfo &info, uint64_t offset, uint32_t chunk_size, double now)
+{
+	// Data comes back in pieces smaller than the requested slices: find the slice it belongs to.
+
+	std::map<uint64_t,ftPendingSlice>::iterator it = info.pendingSlices.upper_bound(offset) ;
+
+	if(it == info.pendingSlices.begin())
+		return ;
+
+	--it ;
+
+	if(offset >= it->first + it->second.size)
+		return ;
+
+	uint32_t n = std::min(chunk_size,it->second.remaining) ;
+
+	it->second.remaining -= n ;
+	info.inFlight -= std::min(info.inFlight,n) ;
+
+	if(it->second.remaining > 0)
+		return ;
+
+	/* slice complete: new rtt sample */
+
+	double sample = now - it->second.sentTS ;
+	uint32_t slice_size = it->second.size ;
+
+	info.pendingSlices.erase(it) ;
+
+	info.srtt = (info.srtt == 0)? sample : (0.875 * info.srtt + 0.125 * sample) ;
+
+	if(info.minRtt == 0 || sample < info.minRtt || now > info.minRttTS + FT_TM_PIPELINE_MIN_RTT_PERIOD)
+	{
+		info.minRtt = sample ;
+		info.minRttTS = now ;
+	}
+
+	/* Window update. As long as the rtt stays close to its minimum, the pipe is not full and the window grows by
+	 * what has just been received, which doubles it every rtt. When queues start to build up, the window is set
+	 * to the bandwidth-delay product measured with the data rate, plus the margin given by the priority.
+	 */
+
+	double window ;
+
+	if(info.srtt < FT_TM_PIPELINE_QUEUEING_RTT * info.minRtt)
+		window = (double)info.window + slice_size ;
+	else
+		window = info.actualRate * info.minRtt * (1.0 + info.mRateIncrease) ;
+
+	if(info.desiredRate > 0)
+		window = std::min(window, info.desiredRate * info.srtt * 1.1) ;
+
+	window = std::min(window, (double)FT_TM_PIPELINE_MAX_WINDOW) ;
+	window = std::max(window, (double)FT_TM_PIPELINE_MIN_WINDOW) ;
+
+	info.window = (uint32_t)window ;
+
+#ifdef FT_DEBUG
+	std::cerr << "ftTransferModule::locked_recvPendingSlice() peer " << info.peerId << ": rtt=" << sample << " srtt=" << info.srtt
+	          << " minRtt=" << info.minRtt << " window=" << info.window << " inFlight=" << info.inFlight << std::endl;
+#endif
+}
+
+void ftTransferModule::locked_expirePendingSlices(peerInfo &info, double now)
+{
+	double timeout = std::max((double)FT_TM_DOWNLOAD_TIMEOUT, 4 * info.srtt) ;
+	bool expired = false ;
+
+	for(std::map<uint64_t,ftPendingSlice>::iterator it(info.pendingSlices.begin());it!=info.pendingSlices.end();)
+		if(now > it->second.sentTS + timeout)
+		{
+			info.inFlight -= std::min(info.inFlight,it->second.remaining) ;
+			info.pendingSlices.erase(it++) ;
+			expired = true ;
+		}
+		else
+			++it ;
+
+	// lost data means the window was too large.
+	if(expired)
+		info.window = std::max(FT_TM_PIPELINE_MIN_WINDOW, info.window / 2) ;
+}
+
+void ftTransferModule::locked_fillPipeline(peerInfo &info, double now)
+{
+	if(info.window < FT_TM_PIPELINE_MIN_WINDOW)
+		info.window = FT_TM_PIPELINE_MIN_WINDOW ;
+
+	uint32_t slice_size = info.window / FT_TM_PIPELINE_SLICES_PER_WINDOW ;
+	slice_size = std::max(FT_TM_PIPELINE_MIN_SLICE, std::min(FT_TM_PIPELINE_MAX_SLICE, slice_size)) ;
+
+	std::vector<std::pair<uint64_t,uint32_t> > slices ;
+
+	uint64_t req_offset = 0;
+	uint32_t req_size =0 ;
+
+	while(info.inFlight < info.window && locked_getChunk(info.peerId,slice_size,req_offset,req_size))
+	{
+		if(req_size == 0)
+			break ;
+
+		slices.push_back(std::make_pair(req_offset,req_size)) ;
+		locked_addPendingSlice(info,req_offset,req_size,now) ;
+
+		/* keeps the rate increase up to date with the priority */
+		if (!info.rttActive)
+		{
+			info.rttStart = (time_t)now;
+			info.rttActive = true;
+			info.rttOffset = req_offset + req_size;
+		}
+	}
+
+	if(slices.empty())
+		return ;
+
+	info.state = PQIPEER_DOWNLOADING;
+
+#ifdef FT_DEBUG
+	std::cerr << "ftTransferModule::locked_fillPipeline() peer " << info.peerId << ": requesting " << slices.size()
+	          << " slices. window=" << info.window << " inFlight=" << info.inFlight << std::endl;
+#endif
+	mMultiplexor->sendDataRequests(info.peerId, mHash, mSize, slices) ;
+}
+
 bool ftTransferModule::locked_getChunk(const RsPeerId& peer_id,uint32_t size_hint,uint64_t &offset, uint32_t &chunk_size)
 {
 #ifdef FT_DEBUG
@@ -746,6 +943,15 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 		info.lastTS = ts;
 	}
 
+	double now = getCurrentTS() ;
+	locked_expirePendingSlices(info,now) ;
+
+	if(mPipelining)
+	{
+		locked_fillPipeline(info,now) ;
+		return true ;
+	}
+
 	/****************
 	 * NOTE: If we continually increase the request rate thus: ...
 	 * uint32_t next_req = info.actualRate * 1.25;
@@ -834,6 +1040,7 @@ bool ftTransferModule::locked_tickPeerTransfer(peerInfo &info)
 		{
 			info.state = PQIPEER_DOWNLOADING;
 			locked_requestData(info.peerId,req_offset,req_size);
+			locked_addPendingSlice(info,req_offset,req_size,now);
 
 			/* start next rtt measurement */
 			if (!info.rttActive)
@@ -875,6 +1082,8 @@ bool ftTransferModule::locked_recvPeerData(peerInfo &info, uint64_t offset, uint
   info.state = PQIPEER_DOWNLOADING;
   info.lastTransfers += chunk_size;
 
+  locked_recvPendingSlice(info, offset, chunk_size, getCurrentTS());
+
    if ((info.rttActive) && (info.rttOffset == offset + chunk_size))
    {
  	  /* update tip */
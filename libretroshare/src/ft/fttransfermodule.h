@@ -53,6 +53,18 @@ const uint32_t  PQIPEER_SUSPEND              = 0x0010;
 
 class HashThread ;
 
+/* A slice requested to a peer, for which not all data has been received yet */
+class ftPendingSlice
+{
+public:
+	ftPendingSlice() : size(0), remaining(0), sentTS(0) {}
+	ftPendingSlice(uint32_t size_in,double sentTS_in) : size(size_in), remaining(size_in), sentTS(sentTS_in) {}
+
+	uint32_t size;
+	uint32_t remaining;
+	double   sentTS;	/* precise time of the request, in seconds */
+};
+
 class peerInfo
 {
 public:
@@ -60,7 +72,8 @@ public:
 		lastTS(0),
 		recvTS(0), lastTransfers(0), nResets(0), 
 		rtt(0), rttActive(false), rttStart(0), rttOffset(0),
-		mRateIncrease(1)
+		mRateIncrease(1),
+		inFlight(0), window(0), srtt(0), minRtt(0), minRttTS(0)
 	{
 		return;
 	}
@@ -69,7 +82,8 @@ public:
 		lastTS(0),
 		recvTS(0), lastTransfers(0), nResets(0), 
 		rtt(0), rttActive(false), rttStart(0), rttOffset(0),
-		mRateIncrease(1)
+		mRateIncrease(1),
+		inFlight(0), window(0), srtt(0), minRtt(0), minRttTS(0)
 	{
 		return;
 	}
@@ -89,6 +103,15 @@ public:
 	time_t	 rttStart;  /* ts of request */
 	uint64_t rttOffset; /* end of request */
 	float    mRateIncrease; /* current rate */
+
+	/* requests in flight, by offset. Used for rtt measurement, and for
+	 * the window of pipelined requests */
+	std::map<uint64_t,ftPendingSlice> pendingSlices;
+	uint32_t inFlight;  /* bytes requested and not received yet */
+	uint32_t window;    /* max bytes in flight, when pipelining */
+	double   srtt;      /* smoothed rtt of slices, in seconds */
+	double   minRtt;    /* smallest recent rtt, in seconds */
+	double   minRttTS;  /* when minRtt was measured */
 };
 
 class ftFileStatus
@@ -157,6 +180,15 @@ public:
   DwlSpeed downloadPriority() const { return mPriority ; }
   void setDownloadPriority(DwlSpeed p) { mPriority =p ; }
 
+  // Pipelining mode: instead of asking each peer for one second worth of data per tick, keep a
+  // window of requests in flight sized after the bandwidth-delay product of the peer, and refill it
+  // as soon as data arrives.
+  void setPipelining(bool b) ;
+  bool pipelining() ;
+
+  // rtt and data in flight for each source
+  void getPeerTransferInfo(std::map<RsPeerId,FileChunksInfo::PeerTransferInfo>& info) ;
+
   // read/reset the last time the transfer module was active (either wrote data, or was solicitaded by clients)
   time_t lastActvTimeStamp() ;
   void resetActvTimeStamp() ;
@@ -166,6 +198,11 @@ private:
   bool locked_tickPeerTransfer(peerInfo &info);
   bool locked_recvPeerData(peerInfo &info, uint64_t offset,
 			uint32_t chunk_size, void *data);
+
+  void locked_addPendingSlice(peerInfo &info, uint64_t offset, uint32_t chunk_size, double now);
+  void locked_recvPendingSlice(peerInfo &info, uint64_t offset, uint32_t chunk_size, double now);
+  void locked_expirePendingSlices(peerInfo &info, double now);
+  void locked_fillPipeline(peerInfo &info, double now);
   
   bool checkFile() ;
   bool checkCRC() ;
@@ -193,6 +230,7 @@ private:
 
   HashThread *_hash_thread ;
   DwlSpeed mPriority ;	// transfer speed priority
+  bool mPipelining ;
 };
 
 #endif  //FT_TRANSFER_MODULE_HEADER
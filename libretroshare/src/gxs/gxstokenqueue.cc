@@ -31,72 +31,66 @@
 
 bool GxsTokenQueue::queueRequest(uint32_t token, uint32_t req_type)
 {
-	RS_STACK_MUTEX(mQueueMtx);
-	mQueue.push_back(GxsTokenQueueItem(token, req_type));
+	{
+		RS_STACK_MUTEX(mQueueMtx);
+		mQueue[token] = req_type;
+	}
+
+	// done off-mutex, since the observer is called right away if the request is already finished.
+
+	if(!mGenExchange->getTokenService()->observeRequest(token, this))
+	{
+		std::cerr << "GxsTokenQueue::queueRequest() ERROR unknown token: " << token;
+		std::cerr << std::endl;
+
+		RS_STACK_MUTEX(mQueueMtx);
+		mQueue.erase(token);
+		return false;
+	}
 	return true;
 }
 
 
-void GxsTokenQueue::checkRequests()
+void GxsTokenQueue::requestCompleted(uint32_t token, uint32_t status)
 {
-	{
-		RsStackMutex stack(mQueueMtx); /********** STACK LOCKED MTX ******/
-		if (mQueue.empty())
-		{
-			return;
-		}
-	}
+	RS_STACK_MUTEX(mQueueMtx);
 
-	// Must check all, and move to a different list - for reentrant / good mutex behaviour.
-	std::list<GxsTokenQueueItem> toload;
-	std::list<GxsTokenQueueItem>::iterator it;
+	std::map<uint32_t, uint32_t>::iterator it = mQueue.find(token);
 
-	bool stuffToLoad = false;
-	{
-		RsStackMutex stack(mQueueMtx); /********** STACK LOCKED MTX ******/
-		for(it = mQueue.begin(); it != mQueue.end();)
-		{
-			uint32_t token = it->mToken;
-			uint32_t status = mGenExchange->getTokenService()->requestStatus(token);
-	
-			if (status == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
-			{
-				toload.push_back(*it);
-				it = mQueue.erase(it);
-				stuffToLoad = true;
+	if(it == mQueue.end())
+		return;
 
+	if (status == RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE)
+	{
 #ifdef GXS_DEBUG
-				std::cerr << "GxsTokenQueue::checkRequests() token: " << token << " Complete";
-				std::cerr << std::endl;
-#endif
-				++it;
-			}
-			else if (status == RsTokenService::GXS_REQUEST_V2_STATUS_FAILED)
-			{
-				// maybe we should do alternative callback?
-				std::cerr << "GxsTokenQueue::checkRequests() ERROR Request Failed: " << token;
-				std::cerr << std::endl;
-
-				it = mQueue.erase(it);
-			}
-			else
-			{
-#ifdef GXS_DEBUG
-				std::cerr << "GxsTokenQueue::checkRequests() token: " << token << " is unfinished, status: " << status;
-				std::cerr << std::endl;
+		std::cerr << "GxsTokenQueue::requestCompleted() token: " << token << " Complete";
+		std::cerr << std::endl;
 #endif
-				++it;
-			}
-		}
+		mCompleted.push_back(GxsTokenQueueItem(token, it->second));
 	}
+	else
+	{
+		// maybe we should do alternative callback?
+		std::cerr << "GxsTokenQueue::requestCompleted() ERROR Request Failed: " << token;
+		std::cerr << std::endl;
+	}
+
+	mQueue.erase(it);
+}
+
+
+void GxsTokenQueue::checkRequests()
+{
+	// Move to a different list - for reentrant / good mutex behaviour.
+	std::list<GxsTokenQueueItem> toload;
 
-	if (stuffToLoad)
 	{
-		for(it = toload.begin(); it != toload.end(); ++it)
-		{
-			handleResponse(it->mToken, it->mReqType);
-		}
+		RsStackMutex stack(mQueueMtx); /********** STACK LOCKED MTX ******/
+		toload.swap(mCompleted);
 	}
+
+	for(std::list<GxsTokenQueueItem>::iterator it = toload.begin(); it != toload.end(); ++it)
+		handleResponse(it->mToken, it->mReqType);
 }
 
 	// This must be overloaded to complete the functionality.
@@ -43,16 +43,21 @@ struct GxsTokenQueueItem
 
 
 /**
- * A little helper class, to manage callbacks from requests
+ * A little helper class, to manage callbacks from requests.
+ * The data access calls back the queue when a request is finished, and the responses are handled by the
+ * service thread in checkRequests(), so that services do not have to poll the status of each request.
  */
-class GxsTokenQueue
+class GxsTokenQueue: public RsTokenObserver
 {
 public:
 	GxsTokenQueue(RsGenExchange *gxs) :
 	    mGenExchange(gxs), mQueueMtx("GxsTokenQueueMtx") {}
 
 	bool queueRequest(uint32_t token, uint32_t req_type);
-	void checkRequests(); /// must be called by
+	void checkRequests(); /// must be called by the service thread, to handle the responses of completed requests
+
+	/// RsTokenObserver. Can be called by any thread.
+	virtual void requestCompleted(uint32_t token, uint32_t status);
 
 protected:
 
@@ -62,7 +67,8 @@ protected:
 private:
 	RsGenExchange *mGenExchange;
 	RsMutex mQueueMtx;
-	std::list<GxsTokenQueueItem> mQueue;
+	std::map<uint32_t, uint32_t> mQueue;		// pending requests: token => req_type
+	std::list<GxsTokenQueueItem> mCompleted;	// waiting for handleResponse()
 };
 
 
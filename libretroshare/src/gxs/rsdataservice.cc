@@ -48,6 +48,8 @@
 #define GRP_LAST_POST_UPDATE_TRIGGER std::string("LAST_POST_UPDATE")
 
 #define MSG_INDEX_GRPID std::string("INDEX_MESSAGES_GRPID")
+#define MSG_INDEX_GRPID_TS std::string("INDEX_MESSAGES_GRPID_TS")
+#define MSG_INDEX_GRPID_ORIGID std::string("INDEX_MESSAGES_GRPID_ORIGID")
 
 // generic
 #define KEY_NXS_DATA        std::string("nxsData")
@@ -113,6 +115,94 @@ const std::string RsGeneralDataService::MSG_META_STATUS = KEY_MSG_STATUS;
 
 const uint32_t RsGeneralDataService::GXS_MAX_ITEM_SIZE = 1572864; // 1.5 Mbytes
 
+// Messages and groups are stored by batches of this size, each in its own transaction, so that other threads can
+// access the database between two batches when a large number of them is received at once.
+static const uint32_t INGEST_BATCH_SIZE = 512;
+
+// Above this number of messages, the indexes of the message table are dropped before storing, and rebuilt at
+// the end, which is faster than updating it for each row.
+static const uint32_t MSG_INGEST_DEFERRED_INDEX_THRESHOLD = 4096;
+
+static std::string lastPostUpdateTriggerSQL()
+{
+    return "CREATE TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER +
+            " INSERT ON " + MSG_TABLE_NAME +
+            std::string(" BEGIN ") +
+            " UPDATE " + GRP_TABLE_NAME + " SET " + KEY_GRP_LAST_POST + "= new."
+            + KEY_RECV_TS + " WHERE " + KEY_GRP_ID + "=new." + KEY_GRP_ID + ";"
+            + std::string("END;");
+}
+
+// Indexes of the message table. The last two serve the paged queries of retrieveGxsMsgMetaData(): messages of a
+// group sorted by publish time, and lookup of the other versions of a message.
+static void createMsgIndexes(RetroDb *db)
+{
+    db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+    db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_TS + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_TIME_STAMP + "," + KEY_MSG_ID + ");");
+    db->execSQL("CREATE INDEX IF NOT EXISTS " + MSG_INDEX_GRPID_ORIGID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID + "," + KEY_ORIG_MSG_ID + "," + KEY_TIME_STAMP + ");");
+}
+
+static void dropMsgIndexes(RetroDb *db)
+{
+    db->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID + ";");
+    db->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_TS + ";");
+    db->execSQL("DROP INDEX IF EXISTS " + MSG_INDEX_GRPID_ORIGID + ";");
+}
+
+// WHERE clause selecting the messages of a group matching a query, on the columns of the message table. Versions
+// of a message share their original msg id, and the latest one is the one no other version was published after.
+static std::string msgMetaQuerySelection(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query)
+{
+    const std::string threadHead = KEY_MSG_PARENT_ID + "='" + RsGxsMessageId().toStdString() + "'";
+    std::string where = KEY_GRP_ID + "='" + grpId.toStdString() + "'";
+
+    if(query.mThreadHeadsOnly)
+        where += " AND " + threadHead;
+
+    if(query.mOrigMsgsOnly)
+        where += " AND " + KEY_MSG_ID + "=" + KEY_ORIG_MSG_ID;
+    else if(query.mLatestOnly)
+    {
+        const std::string cur = MSG_TABLE_NAME + ".";
+
+        where += " AND NOT EXISTS (SELECT 1 FROM " + MSG_TABLE_NAME + " AS newer WHERE newer." + KEY_GRP_ID + "=" + cur + KEY_GRP_ID
+                + " AND newer." + KEY_ORIG_MSG_ID + "=" + cur + KEY_ORIG_MSG_ID
+                + (query.mThreadHeadsOnly ? " AND newer." + threadHead : std::string())
+                + " AND (newer." + KEY_TIME_STAMP + ">" + cur + KEY_TIME_STAMP
+                + " OR (newer." + KEY_TIME_STAMP + "=" + cur + KEY_TIME_STAMP + " AND newer." + KEY_MSG_ID + ">" + cur + KEY_MSG_ID + ")))";
+    }
+
+    // flags are stored as signed 32 bits ints, masks are converted the same way so that the high bit matches.
+    if(query.mStatusMask)
+        rs_sprintf_append(where, " AND (%s & %d)=%d", KEY_MSG_STATUS.c_str(), (int32_t)query.mStatusMask,
+                          (int32_t)(query.mStatusMask & query.mStatusFilter));
+
+    if(query.mFlagMask)
+        rs_sprintf_append(where, " AND (%s & %d)=%d", KEY_NXS_FLAGS.c_str(), (int32_t)query.mFlagMask,
+                          (int32_t)(query.mFlagMask & query.mFlagFilter));
+
+    if(query.mBefore)
+        rs_sprintf_append(where, " AND %s<=%d", KEY_TIME_STAMP.c_str(), (int32_t)query.mBefore);
+
+    if(query.mAfter)
+        rs_sprintf_append(where, " AND %s>=%d", KEY_TIME_STAMP.c_str(), (int32_t)query.mAfter);
+
+    return where;
+}
+
+// Memory used by the meta data caches of each service, split evenly between groups and messages.
+static const uint32_t RS_DATA_SERVICE_DEFAULT_CACHE_SIZE = 32*1024*1024;
+
+static uint32_t metaDataSize(const RsGxsMsgMetaData& m)
+{
+    return sizeof(RsGxsMsgMetaData) + m.mMsgName.size() + m.mServiceString.size() + m.signSet.TlvSize();
+}
+
+static uint32_t metaDataSize(const RsGxsGrpMetaData& g)
+{
+    return sizeof(RsGxsGrpMetaData) + g.mGroupName.size() + g.mServiceString.size() + g.keys.TlvSize() + g.signSet.TlvSize();
+}
+
 static int addColumn(std::list<std::string> &list, const std::string &attribute)
 {
     list.push_back(attribute);
@@ -121,10 +211,14 @@ static int addColumn(std::list<std::string> &list, const std::string &attribute)
 
 RsDataService::RsDataService(const std::string &serviceDir, const std::string &dbName, uint16_t serviceType,
                              RsGxsSearchModule * /* mod */, const std::string& key)
-    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL)
+    : RsGeneralDataService(), mDbMutex("RsDataService"), mServiceDir(serviceDir), mDbName(dbName), mDbPath(mServiceDir + "/" + dbName), mServType(serviceType), mDb(NULL),
+      mCacheSize(RS_DATA_SERVICE_DEFAULT_CACHE_SIZE),
+      mGrpMetaDataCache(RS_DATA_SERVICE_DEFAULT_CACHE_SIZE/2),
+      mMsgMetaDataCache(RS_DATA_SERVICE_DEFAULT_CACHE_SIZE - RS_DATA_SERVICE_DEFAULT_CACHE_SIZE/2)
 {
     bool isNewDatabase = !RsDirUtil::fileExists(mDbPath);
     mGrpMetaDataCache_ContainsAllDatabase = false ;
+    mGrpMetaDataCache_DatabaseSize = 0 ;
 
     mDb = new RetroDb(mDbPath, RetroDb::OPEN_READWRITE_CREATE, key);
 
@@ -360,14 +454,9 @@ void RsDataService::initialise(bool isNewDatabase)
                      KEY_GRP_REP_CUTOFF + " INT," +
                      KEY_SIGN_SET + " BLOB);");
 
-        mDb->execSQL("CREATE TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER +
-                " INSERT ON " + MSG_TABLE_NAME +
-                std::string(" BEGIN ") +
-                " UPDATE " + GRP_TABLE_NAME + " SET " + KEY_GRP_LAST_POST + "= new."
-                + KEY_RECV_TS + " WHERE " + KEY_GRP_ID + "=new." + KEY_GRP_ID + ";"
-                + std::string("END;"));
+        mDb->execSQL(lastPostUpdateTriggerSQL());
 
-        mDb->execSQL("CREATE INDEX " + MSG_INDEX_GRPID + " ON " + MSG_TABLE_NAME + "(" + KEY_GRP_ID +  ");");
+        createMsgIndexes(mDb);
 
         // Insert release, no need to upgrade
         ContentValue cv;
@@ -445,6 +534,10 @@ void RsDataService::initialise(bool isNewDatabase)
         }
     }
 
+    // Indexes may be missing if a bulk insertion was interrupted (see storeMessage()), or if the database was
+    // created before they were added.
+    createMsgIndexes(mDb);
+
     if (ok) {
         std::cerr << "Database " << mDbName << " release " << currentDatabaseRelease << " successfully initialised." << std::endl;
     } else {
@@ -704,13 +797,50 @@ RsNxsMsg* RsDataService::locked_getMessage(RetroCursor &c)
 
 int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
 {
+    bool deferIndex = msg.size() >= MSG_INGEST_DEFERRED_INDEX_THRESHOLD;
 
-    RsStackMutex stack(mDbMutex);
+    if(deferIndex)
+    {
+        RsStackMutex stack(mDbMutex);
+        dropMsgIndexes(mDb);
+    }
+
+    bool ret = true;
+
+    for(std::list<RsNxsMsg*>::const_iterator mit = msg.begin(); mit != msg.end();)
+    {
+        RsStackMutex stack(mDbMutex);
+
+        if(!locked_storeMessageBatch(mit, msg.end()))
+            ret = false;
+    }
 
+    if(deferIndex)
+    {
+        RsStackMutex stack(mDbMutex);
+        createMsgIndexes(mDb);
+    }
+
+    return ret;
+}
+
+bool RsDataService::locked_storeMessageBatch(std::list<RsNxsMsg*>::const_iterator& mit, const std::list<RsNxsMsg*>::const_iterator& end)
+{
     // start a transaction
     mDb->beginTransaction();
 
-    for(std::list<RsNxsMsg*>::const_iterator mit = msg.begin(); mit != msg.end(); ++mit)
+    // The trigger that updates the last post time of the group rewrites the group row for every message. It is
+    // disabled during the batch, and the last post time of each group is set once at the end, to the receive time of
+    // the last message stored for that group, which is what the trigger would have done.
+
+    bool hasLastPostTrigger = mDb->triggerExists(GRP_LAST_POST_UPDATE_TRIGGER);
+
+    if(hasLastPostTrigger)
+        mDb->execSQL("DROP TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER + ";");
+
+    std::map<RsGxsGroupId, uint32_t> lastPostTs;
+
+    for(uint32_t n = 0; mit != end && n < INGEST_BATCH_SIZE; ++mit, ++n)
     {
         RsNxsMsg* msgPtr = *mit;
         RsGxsMsgMetaData* msgMetaPtr = msgPtr->metaData;
@@ -772,6 +902,8 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
         cv.put(KEY_MSG_STATUS, (int32_t)msgMetaPtr->mMsgStatus);
         cv.put(KEY_CHILD_TS, (int32_t)msgMetaPtr->mChildTs);
 
+        // The insertion statement is compiled once and re-used by RetroDb for all messages.
+
         if (!mDb->sqlInsert(MSG_TABLE_NAME, "", cv))
         {
             std::cerr << "RsDataService::storeMessage() sqlInsert Failed";
@@ -780,17 +912,34 @@ int RsDataService::storeMessage(const std::list<RsNxsMsg*>& msg)
             std::cerr << std::endl;
             std::cerr << "\t & MessageId: " << msgMetaPtr->mMsgId.toStdString();
             std::cerr << std::endl;
+            continue;
+        }
+
+        lastPostTs[msgMetaPtr->mGroupId] = msgMetaPtr->recvTS;
+    }
+
+    for(std::map<RsGxsGroupId, uint32_t>::const_iterator it = lastPostTs.begin(); it != lastPostTs.end(); ++it)
+    {
+        if(hasLastPostTrigger)
+        {
+            ContentValue cv;
+            cv.put(KEY_GRP_LAST_POST, (int32_t)it->second);
+            mDb->sqlUpdate(GRP_TABLE_NAME, KEY_GRP_ID + "='" + it->first.toStdString() + "'", cv);
         }
 
         // This is needed so that mLastPost is correctly updated in the group meta when it is re-loaded.
 
-        locked_clearGrpMetaCache(msgMetaPtr->mGroupId);
+        locked_clearGrpMetaCache(it->first);
+
+        // the cache does not contain the new messages
+        mMsgMetaDataCache_CompleteGroups.erase(it->first);
     }
 
-    // finish transaction
-    bool ret = mDb->commitTransaction();
+    if(hasLastPostTrigger)
+        mDb->execSQL(lastPostUpdateTriggerSQL());
 
-    return ret;
+    // finish transaction
+    return mDb->commitTransaction();
 }
 
 bool RsDataService::validSize(RsNxsMsg* msg) const
@@ -803,13 +952,25 @@ bool RsDataService::validSize(RsNxsMsg* msg) const
 
 int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 {
+    bool ret = true;
 
-    RsStackMutex stack(mDbMutex);
+    for(std::list<RsNxsGrp*>::const_iterator sit = grp.begin(); sit != grp.end();)
+    {
+        RsStackMutex stack(mDbMutex);
+
+        if(!locked_storeGroupBatch(sit, grp.end()))
+            ret = false;
+    }
 
+    return ret;
+}
+
+bool RsDataService::locked_storeGroupBatch(std::list<RsNxsGrp*>::const_iterator& sit, const std::list<RsNxsGrp*>::const_iterator& end)
+{
     // begin transaction
     mDb->beginTransaction();
 
-    for(std::list<RsNxsGrp*>::const_iterator sit = grp.begin();sit != grp.end(); ++sit)
+    for(uint32_t n = 0; sit != end && n < INGEST_BATCH_SIZE; ++sit, ++n)
 	{
 		RsNxsGrp* grpPtr = *sit;
 		RsGxsGrpMetaData* grpMetaPtr = grpPtr->metaData;
@@ -887,9 +1048,7 @@ int RsDataService::storeGroup(const std::list<RsNxsGrp*>& grp)
 		}
 	}
     // finish transaction
-    bool ret = mDb->commitTransaction();
-
-    return ret;
+    return mDb->commitTransaction();
 }
 
 void RsDataService::locked_clearGrpMetaCache(const RsGxsGroupId& gid)
@@ -1213,14 +1372,23 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
         std::vector<RsGxsMsgMetaData*> metaSet;
 
         if(msgIdV.empty()){
-            RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
-
-            if (c)
+            if(!locked_retrieveAllMsgMetaFromCache(grpId, metaSet))
             {
-                locked_retrieveMsgMeta(c, metaSet);
+                RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString() + "'", "");
+
+                if (c)
+                {
+                    locked_retrieveMsgMeta(c, metaSet);
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-              std::cerr << "Retrieving (all) Msg metadata grpId=" << grpId << ", " << std::dec << metaSet.size() << " messages" << std::endl;
+                    std::cerr << "Retrieving (all) Msg metadata grpId=" << grpId << ", " << std::dec << metaSet.size() << " messages" << std::endl;
 #endif
+                    // Set before filling the cache, so that evicting messages of this group while filling is noticed.
+
+                    mMsgMetaDataCache_CompleteGroups[grpId] = metaSet.size();
+
+                    for(uint32_t i=0; i<metaSet.size(); ++i)
+                        mMsgMetaDataCache.put(std::make_pair(grpId, metaSet[i]->mMsgId), *metaSet[i], metaDataSize(*metaSet[i]));
+                }
             }
         }else{
 
@@ -1229,15 +1397,27 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
 
             for(; sit!=msgIdV.end(); ++sit){
                 const RsGxsMessageId& msgId = *sit;
+                RsGxsMsgMetaData *cached = mMsgMetaDataCache.find(std::make_pair(grpId, msgId));
+
+                if(cached != NULL)
+                {
+                    metaSet.push_back(new RsGxsMsgMetaData(*cached));
+                    continue;
+                }
+
                 RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, KEY_GRP_ID+ "='" + grpId.toStdString()
                                                + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
 
                 if (c)
                 {
+                    uint32_t n = metaSet.size();
+
                     locked_retrieveMsgMeta(c, metaSet);
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
               std::cerr << "Retrieving Msg metadata grpId=" << grpId << ", " << std::dec << metaSet.size() << " messages" << std::endl;
 #endif
+                    for(uint32_t i=n; i<metaSet.size(); ++i)
+                        mMsgMetaDataCache.put(std::make_pair(grpId, metaSet[i]->mMsgId), *metaSet[i], metaDataSize(*metaSet[i]));
                 }
             }
         }
@@ -1256,6 +1436,84 @@ int RsDataService::retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaRes
     return 1;
 }
 
+int RsDataService::retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query,
+                                          std::vector<RsGxsMsgMetaData*>& msgMeta, uint32_t& totalCount)
+{
+    RsStackMutex stack(mDbMutex);
+
+#ifdef RS_DATA_SERVICE_DEBUG_TIME
+    RsScopeTimer timer("");
+#endif
+
+    const std::string where = msgMetaQuerySelection(grpId, query);
+
+    RetroCursor* c = mDb->sqlQuery(MSG_TABLE_NAME, mMsgMetaColumns, where,
+                                   KEY_TIME_STAMP + " DESC," + KEY_MSG_ID + " DESC", query.mLimit, query.mOffset);
+    locked_retrieveMsgMeta(c, msgMeta);
+
+    // the total is only worth another query when a page was asked for.
+
+    totalCount = msgMeta.size();
+
+    if(query.mLimit > 0 || query.mOffset > 0)
+    {
+        std::list<std::string> countColumn;
+        countColumn.push_back("COUNT(*)");
+
+        c = mDb->sqlQuery(MSG_TABLE_NAME, countColumn, where, "");
+
+        if(c)
+        {
+            if(c->moveToFirst())
+                totalCount = c->getInt32(0);
+
+            delete c;
+        }
+    }
+
+#ifdef RS_DATA_SERVICE_DEBUG_TIME
+    std::cerr << "RsDataService::retrieveGxsMsgMetaData() " << mDbName << ", query on grp " << grpId << ", Results: "
+              << msgMeta.size() << "/" << totalCount << ", Time: " << timer.duration() << std::endl;
+#endif
+
+    return 1;
+}
+
+bool RsDataService::locked_retrieveAllMsgMetaFromCache(const RsGxsGroupId& grpId, std::vector<RsGxsMsgMetaData*>& metaSet)
+{
+    std::map<RsGxsGroupId,uint32_t>::iterator cit = mMsgMetaDataCache_CompleteGroups.find(grpId);
+
+    if(cit == mMsgMetaDataCache_CompleteGroups.end())
+    {
+        mMsgMetaDataCache.countMiss();
+        return false;
+    }
+
+    typedef t_MetaDataLruCache<std::pair<RsGxsGroupId,RsGxsMessageId>,RsGxsMsgMetaData>::const_iterator CacheIterator;
+    std::vector<CacheIterator> found;
+
+    for(CacheIterator it = mMsgMetaDataCache.lowerBound(std::make_pair(grpId, RsGxsMessageId())); it != mMsgMetaDataCache.end() && it->first.first == grpId; ++it)
+        found.push_back(it);
+
+    if(found.size() != cit->second)	// some messages were evicted or dropped
+    {
+        mMsgMetaDataCache_CompleteGroups.erase(cit);
+        mMsgMetaDataCache.countMiss();
+        return false;
+    }
+
+#ifdef RS_DATA_SERVICE_DEBUG_CACHE
+    std::cerr << "Retrieving (all) Msg metadata grpId=" << grpId << ", " << std::dec << found.size() << " messages from cache!" << std::endl;
+#endif
+
+    for(uint32_t i=0; i<found.size(); ++i)
+    {
+        metaSet.push_back(new RsGxsMsgMetaData(found[i]->second.meta));
+        mMsgMetaDataCache.touch(found[i]);
+    }
+    return true;
+}
+
 void RsDataService::locked_retrieveMsgMeta(RetroCursor *c, std::vector<RsGxsMsgMetaData *> &msgMeta)
 {
 
@@ -1291,109 +1549,115 @@ int RsDataService::retrieveGxsGrpMetaData(std::map<RsGxsGroupId, RsGxsGrpMetaDat
 
     if(grp.empty())
     {
-        if(mGrpMetaDataCache_ContainsAllDatabase)	// grab all the stash from the cache, so as to avoid decryption costs.
+        // The cache is complete only if no group was evicted since it was filled.
+
+        if(mGrpMetaDataCache_ContainsAllDatabase && mGrpMetaDataCache.entries() == mGrpMetaDataCache_DatabaseSize)	// grab all the stash from the cache, so as to avoid decryption costs.
         {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-        std::cerr << (void*)this << ": RsDataService::retrieveGxsGrpMetaData() retrieving all from cache!" << std::endl;
+            std::cerr << (void*)this << ": RsDataService::retrieveGxsGrpMetaData() retrieving all from cache!" << std::endl;
 #endif
 
-            for(std::map<RsGxsGroupId,RsGxsGrpMetaData>::const_iterator it(mGrpMetaDataCache.begin());it!=mGrpMetaDataCache.end();++it)
-            grp[it->first] = new RsGxsGrpMetaData(it->second);
+            for(t_MetaDataLruCache<RsGxsGroupId,RsGxsGrpMetaData>::const_iterator it(mGrpMetaDataCache.begin());it!=mGrpMetaDataCache.end();++it)
+            {
+                grp[it->first] = new RsGxsGrpMetaData(it->second.meta);
+                mGrpMetaDataCache.touch(it);
+            }
         }
         else
-    {
+        {
 #ifdef RS_DATA_SERVICE_DEBUG
-        std::cerr << "RsDataService::retrieveGxsGrpMetaData() retrieving all" << std::endl;
+            std::cerr << "RsDataService::retrieveGxsGrpMetaData() retrieving all" << std::endl;
 #endif
+            mGrpMetaDataCache.countMiss();
 
-        RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "", "");
-
-        if(c)
-        {
-            bool valid = c->moveToFirst();
+            RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "", "");
 
-            while(valid)
+            if(c)
             {
-                RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0);
-                if(g)
+                bool valid = c->moveToFirst();
+
+                while(valid)
                 {
-                    grp[g->mGroupId] = g;
-                        mGrpMetaDataCache[g->mGroupId] = *g ;
+                    RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0);
+                    if(g)
+                    {
+                        grp[g->mGroupId] = g;
+                        mGrpMetaDataCache.put(g->mGroupId, *g, metaDataSize(*g)) ;
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-                    std::cerr << (void *)this << ": Retrieving (all) Grp metadata grpId=" << g->mGroupId << std::endl;
+                        std::cerr << (void *)this << ": Retrieving (all) Grp metadata grpId=" << g->mGroupId << std::endl;
 #endif
-                }
-                valid = c->moveToNext();
+                    }
+                    valid = c->moveToNext();
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
-                ++resultCount;
+                    ++resultCount;
 #endif
-            }
-            delete c;
-        }
+                }
+                delete c;
 
                 mGrpMetaDataCache_ContainsAllDatabase = true ;
-    }
-
+                mGrpMetaDataCache_DatabaseSize = grp.size() ;
+            }
+        }
     }else
     {
         std::map<RsGxsGroupId, RsGxsGrpMetaData *>::iterator mit = grp.begin();
 
-          for(; mit != grp.end(); ++mit)
-          {
-              std::map<RsGxsGroupId, RsGxsGrpMetaData>::const_iterator itt = mGrpMetaDataCache.find(mit->first) ;
-              if(itt != mGrpMetaDataCache.end())
-              {
+        for(; mit != grp.end(); ++mit)
+        {
+            RsGxsGrpMetaData *cached = mGrpMetaDataCache.find(mit->first) ;
+
+            if(cached != NULL)
+            {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-          std::cerr << "Retrieving Grp metadata grpId=" << mit->first << " from cache!" << std::endl;
+                std::cerr << "Retrieving Grp metadata grpId=" << mit->first << " from cache!" << std::endl;
 #endif
-          grp[mit->first] = new RsGxsGrpMetaData(itt->second) ;
-              }
-              else
-          {
+                grp[mit->first] = new RsGxsGrpMetaData(*cached) ;
+            }
+            else
+            {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-              std::cerr << "Retrieving Grp metadata grpId=" << mit->first ;
+                std::cerr << "Retrieving Grp metadata grpId=" << mit->first ;
 #endif
 
-              const RsGxsGroupId& grpId = mit->first;
-              RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
+                const RsGxsGroupId& grpId = mit->first;
+                RetroCursor* c = mDb->sqlQuery(GRP_TABLE_NAME, mGrpMetaColumns, "grpId='" + grpId.toStdString() + "'", "");
 
-              if(c)
-              {
-                  bool valid = c->moveToFirst();
+                if(c)
+                {
+                    bool valid = c->moveToFirst();
 
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-                      if(!valid)
-                                  std::cerr << " Empty query! GrpId " << grpId << " is not in database" << std::endl;
+                    if(!valid)
+                        std::cerr << " Empty query! GrpId " << grpId << " is not in database" << std::endl;
 #endif
-                  while(valid)
-                  {
-                      RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0);
-
-                      if(g)
-                      {
-                          grp[g->mGroupId] = g;
-                        mGrpMetaDataCache[g->mGroupId] = *g ;
+                    while(valid)
+                    {
+                        RsGxsGrpMetaData* g = locked_getGrpMeta(*c, 0);
+
+                        if(g)
+                        {
+                            grp[g->mGroupId] = g;
+                            mGrpMetaDataCache.put(g->mGroupId, *g, metaDataSize(*g)) ;
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
                             std::cerr << ". Got it. Updating cache." << std::endl;
 #endif
-                      }
-                      valid = c->moveToNext();
+                        }
+                        valid = c->moveToNext();
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
-                      ++resultCount;
+                        ++resultCount;
 #endif
-                  }
-                  delete c;
-              }
+                    }
+                    delete c;
+                }
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-            else
-              std::cerr << ". not found!" << std::endl;
+                else
+                    std::cerr << ". not found!" << std::endl;
 #endif
-          }
-          }
-
-      }
+            }
+        }
+    }
 
 #ifdef RS_DATA_SERVICE_DEBUG_TIME
     std::cerr << "RsDataService::retrieveGxsGrpMetaData() " << mDbName << ", Requests: " << requestedGroups << ", Results: " << resultCount << ", Time: " << timer.duration() << std::endl;
@@ -1412,11 +1676,16 @@ int RsDataService::resetDataStore()
     {
         RsStackMutex stack(mDbMutex);
 
-        mDb->execSQL("DROP INDEX " + MSG_INDEX_GRPID);
+        dropMsgIndexes(mDb);
         mDb->execSQL("DROP TABLE " + DATABASE_RELEASE_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + MSG_TABLE_NAME);
         mDb->execSQL("DROP TABLE " + GRP_TABLE_NAME);
         mDb->execSQL("DROP TRIGGER " + GRP_LAST_POST_UPDATE_TRIGGER);
+
+        mGrpMetaDataCache.clear();
+        mGrpMetaDataCache_ContainsAllDatabase = false;
+        mMsgMetaDataCache.clear();
+        mMsgMetaDataCache_CompleteGroups.clear();
     }
 
     // recreate database
@@ -1434,13 +1703,21 @@ int RsDataService::updateGroupMetaData(GrpLocMetaData &meta)
     RsStackMutex stack(mDbMutex);
     RsGxsGroupId& grpId = meta.grpId;
 
+    bool ok = mDb->sqlUpdate(GRP_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString() + "'", meta.val);
+
+    // write the change through to the cached entry, if any. Drop it if the change cannot be applied.
+
+    RsGxsGrpMetaData *cached = mGrpMetaDataCache.peek(grpId);
+
+    if(cached != NULL && !(ok && updateCachedGrpMeta(*cached, meta.val)))
+    {
 #ifdef RS_DATA_SERVICE_DEBUG_CACHE
-    std::cerr << (void*)this << ": erasing old entry from cache." << std::endl;
+        std::cerr << (void*)this << ": erasing old entry from cache." << std::endl;
 #endif
+        locked_clearGrpMetaCache(meta.grpId);
+    }
 
-    locked_clearGrpMetaCache(meta.grpId);
-
-    return mDb->sqlUpdate(GRP_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString() + "'", meta.val) ? 1 : 0;
+    return ok ? 1 : 0;
 }
 
 int RsDataService::updateMessageMetaData(MsgLocMetaData &metaData)
@@ -1452,8 +1729,65 @@ int RsDataService::updateMessageMetaData(MsgLocMetaData &metaData)
     RsStackMutex stack(mDbMutex);
     RsGxsGroupId& grpId = metaData.msgId.first;
     RsGxsMessageId& msgId = metaData.msgId.second;
-    return mDb->sqlUpdate(MSG_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString()
-                          + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", metaData.val) ? 1 : 0;
+    bool ok = mDb->sqlUpdate(MSG_TABLE_NAME,  KEY_GRP_ID+ "='" + grpId.toStdString()
+                          + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", metaData.val);
+
+    // write the change through to the cached entry, if any. Drop it if the change cannot be applied.
+
+    RsGxsMsgMetaData *cached = mMsgMetaDataCache.peek(metaData.msgId);
+
+    if(cached != NULL && !(ok && updateCachedMsgMeta(*cached, metaData.val)))
+        mMsgMetaDataCache.erase(metaData.msgId);
+
+    return ok ? 1 : 0;
+}
+
+bool RsDataService::updateCachedGrpMeta(RsGxsGrpMetaData& meta, const ContentValue& cv)
+{
+    std::map<std::string, uint8_t> keys;
+    cv.getKeyTypeMap(keys);
+
+    for(std::map<std::string, uint8_t>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+        int32_t value;
+
+        if(it->first == KEY_NXS_SERV_STRING)
+        {
+            if(!cv.getAsString(it->first, meta.mServiceString))
+                return false;
+        }
+        else if(it->first == KEY_GRP_STATUS && cv.getAsInt32(it->first, value))
+            meta.mGroupStatus = value;
+        else if(it->first == KEY_GRP_SUBCR_FLAG && cv.getAsInt32(it->first, value))
+            meta.mSubscribeFlags = value;
+        else if(it->first == KEY_GRP_REP_CUTOFF && cv.getAsInt32(it->first, value))
+            meta.mReputationCutOff = value;
+        else
+            return false;
+    }
+    return true;
+}
+
+bool RsDataService::updateCachedMsgMeta(RsGxsMsgMetaData& meta, const ContentValue& cv)
+{
+    std::map<std::string, uint8_t> keys;
+    cv.getKeyTypeMap(keys);
+
+    for(std::map<std::string, uint8_t>::const_iterator it = keys.begin(); it != keys.end(); ++it)
+    {
+        int32_t value;
+
+        if(it->first == KEY_NXS_SERV_STRING)
+        {
+            if(!cv.getAsString(it->first, meta.mServiceString))
+                return false;
+        }
+        else if(it->first == KEY_MSG_STATUS && cv.getAsInt32(it->first, value))
+            meta.mMsgStatus = value;
+        else
+            return false;
+    }
+    return true;
 }
 
 int RsDataService::removeMsgs(const GxsMsgReq& msgIds)
@@ -1585,6 +1919,8 @@ bool RsDataService::locked_removeMessageEntries(const GxsMsgReq& msgIds)
             const RsGxsMessageId& msgId = *vit;
             mDb->sqlDelete(MSG_TABLE_NAME, KEY_GRP_ID+ "='" + grpId.toStdString()
                     + "' AND " + KEY_MSG_ID + "='" + msgId.toStdString() + "'", "");
+
+            mMsgMetaDataCache.erase(std::make_pair(grpId, msgId));
         }
     }
 
@@ -1616,11 +1952,36 @@ bool RsDataService::locked_removeGroupEntries(const std::vector<RsGxsGroupId>& g
     return ret;
 }
 uint32_t RsDataService::cacheSize() const {
-    return 0;
+    return mCacheSize;
 }
 
-int RsDataService::setCacheSize(uint32_t /* size */)
+int RsDataService::setCacheSize(uint32_t size)
 {
-    return 0;
+    RsStackMutex stack(mDbMutex);
+
+    mCacheSize = size;
+    mGrpMetaDataCache.setMaxSize(size/2);
+    mMsgMetaDataCache.setMaxSize(size - size/2);
+
+    return 1;
+}
+
+void RsDataService::getCacheStatistics(RsDataServiceCacheStatistics& stats)
+{
+    RsStackMutex stack(mDbMutex);
+
+    stats.msgHits      = mMsgMetaDataCache.hits();
+    stats.msgMisses    = mMsgMetaDataCache.misses();
+    stats.msgEvictions = mMsgMetaDataCache.evictions();
+    stats.msgEntries   = mMsgMetaDataCache.entries();
+    stats.msgSize      = mMsgMetaDataCache.size();
+
+    stats.grpHits      = mGrpMetaDataCache.hits();
+    stats.grpMisses    = mGrpMetaDataCache.misses();
+    stats.grpEvictions = mGrpMetaDataCache.evictions();
+    stats.grpEntries   = mGrpMetaDataCache.entries();
+    stats.grpSize      = mGrpMetaDataCache.size();
+
+    stats.maxSize      = mCacheSize;
 }
 
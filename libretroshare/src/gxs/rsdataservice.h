@@ -29,6 +29,9 @@
 #include "gxs/rsgds.h"
 #include "util/retrodb.h"
 
+#include <list>
+#include <map>
+
 class MsgUpdate
 {
 public:
@@ -39,6 +42,152 @@ public:
 	ContentValue cv;
 };
 
+/*!
+ * Hit/miss counters of the meta data caches of RsDataService. Sizes are in bytes.
+ */
+struct RsDataServiceCacheStatistics
+{
+    RsDataServiceCacheStatistics()
+        : msgHits(0), msgMisses(0), msgEvictions(0), msgEntries(0), msgSize(0),
+          grpHits(0), grpMisses(0), grpEvictions(0), grpEntries(0), grpSize(0), maxSize(0) {}
+
+    uint64_t msgHits;
+    uint64_t msgMisses;
+    uint64_t msgEvictions;
+    uint32_t msgEntries;
+    uint32_t msgSize;
+
+    uint64_t grpHits;
+    uint64_t grpMisses;
+    uint64_t grpEvictions;
+    uint32_t grpEntries;
+    uint32_t grpSize;
+
+    uint32_t maxSize;
+};
+
+/*!
+ * Size bounded cache of meta data, with least recently used eviction. The size of each entry is given by the caller.
+ * Entries are kept sorted by key, so that all messages of a group can be enumerated when the key is (grpId,msgId).
+ */
+template<class Key, class MetaClass> class t_MetaDataLruCache
+{
+public:
+    struct Entry
+    {
+        MetaClass meta;
+        uint32_t size;
+        typename std::list<Key>::iterator lruPos;
+    };
+    typedef typename std::map<Key, Entry>::const_iterator const_iterator;
+
+    t_MetaDataLruCache(uint32_t maxSize) : mMaxSize(maxSize), mSize(0), mHits(0), mMisses(0), mEvictions(0) {}
+
+    // Returns the cached entry or NULL, and counts a hit or a miss. The entry becomes the most recently used one.
+    MetaClass *find(const Key& key)
+    {
+        typename std::map<Key, Entry>::iterator it = mEntries.find(key);
+
+        if(it == mEntries.end())
+        {
+            ++mMisses;
+            return NULL;
+        }
+        ++mHits;
+        mLru.splice(mLru.begin(), mLru, it->second.lruPos);
+        return &it->second.meta;
+    }
+
+    // Same as find(), for entries found by iterating.
+    void touch(const_iterator it)
+    {
+        ++mHits;
+        mLru.splice(mLru.begin(), mLru, it->second.lruPos);
+    }
+
+    // Returns the cached entry or NULL, without changing counters nor order.
+    MetaClass *peek(const Key& key)
+    {
+        typename std::map<Key, Entry>::iterator it = mEntries.find(key);
+        return (it == mEntries.end()) ? NULL : &it->second.meta;
+    }
+
+    void countMiss() { ++mMisses; }
+
+    void put(const Key& key, const MetaClass& meta, uint32_t size)
+    {
+        erase(key);
+
+        if(size > mMaxSize)
+            return;
+
+        mLru.push_front(key);
+
+        Entry& e(mEntries[key]);
+        e.meta = meta;
+        e.size = size;
+        e.lruPos = mLru.begin();
+        mSize += size;
+
+        shrink();
+    }
+
+    void erase(const Key& key)
+    {
+        typename std::map<Key, Entry>::iterator it = mEntries.find(key);
+
+        if(it == mEntries.end())
+            return;
+
+        mSize -= it->second.size;
+        mLru.erase(it->second.lruPos);
+        mEntries.erase(it);
+    }
+
+    void clear()
+    {
+        mEntries.clear();
+        mLru.clear();
+        mSize = 0;
+    }
+
+    void setMaxSize(uint32_t maxSize)
+    {
+        mMaxSize = maxSize;
+        shrink();
+    }
+
+    const_iterator lowerBound(const Key& key) const { return mEntries.lower_bound(key); }
+    const_iterator begin() const { return mEntries.begin(); }
+    const_iterator end() const { return mEntries.end(); }
+
+    uint32_t entries() const { return mEntries.size(); }
+    uint32_t size() const { return mSize; }
+    uint64_t hits() const { return mHits; }
+    uint64_t misses() const { return mMisses; }
+    uint64_t evictions() const { return mEvictions; }
+
+private:
+    void shrink()
+    {
+        while(mSize > mMaxSize && !mLru.empty())
+        {
+            erase(mLru.back());
+            ++mEvictions;
+        }
+    }
+
+    std::map<Key, Entry> mEntries;
+    std::list<Key> mLru;		// most recently used first
+
+    uint32_t mMaxSize;
+    uint32_t mSize;
+
+    uint64_t mHits;
+    uint64_t mMisses;
+    uint64_t mEvictions;
+};
+
 class RsDataService : public RsGeneralDataService
 {
 public:
@@ -82,6 +231,18 @@ public:
      */
     int retrieveGxsMsgMetaData(const GxsMsgReq& reqIds, GxsMsgMetaResult& msgMeta);
 
+    /*!
+     * Retrieves meta data of the messages of a group selected by a query. The selection,
+     * ordering and paging are done by the database, the meta data cache is not used.
+     * @param grpId group of the messages
+     * @param query filters, ordering and page to retrieve
+     * @param msgMeta meta data of the messages of the page, newest first
+     * @param totalCount number of messages matching the query, regardless of the page
+     * @return error code
+     */
+    int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query,
+                               std::vector<RsGxsMsgMetaData*>& msgMeta, uint32_t& totalCount);
+
     /*!
      * remove msgs in data store
      * @param grpId group Id of message to be removed
@@ -122,6 +283,11 @@ public:
      */
     int setCacheSize(uint32_t size);
 
+    /*!
+     * @param stats hit/miss counters and sizes of the group and message meta data caches
+     */
+    void getCacheStatistics(RsDataServiceCacheStatistics& stats);
+
     /*!
      * Stores a list of signed messages into data store
      * @param msg map of message and decoded meta data information
@@ -236,6 +402,20 @@ private:
     bool locked_removeMessageEntries(const GxsMsgReq& msgIds);
     bool locked_removeGroupEntries(const std::vector<RsGxsGroupId>& grpIds);
 
+    /*!
+     * Stores at most INGEST_BATCH_SIZE messages in a single transaction, starting at mit
+     * @param mit first message to store, moved to the first message that was not stored
+     * @return false if the transaction failed
+     */
+    bool locked_storeMessageBatch(std::list<RsNxsMsg*>::const_iterator& mit, const std::list<RsNxsMsg*>::const_iterator& end);
+
+    /*!
+     * Same as locked_storeMessageBatch() for groups
+     * @param sit first group to store, moved to the first group that was not stored
+     * @return false if the transaction failed
+     */
+    bool locked_storeGroupBatch(std::list<RsNxsGrp*>::const_iterator& sit, const std::list<RsNxsGrp*>::const_iterator& end);
+
 private:
     /*!
      * Start release update
@@ -347,8 +527,28 @@ private:
     
     void locked_clearGrpMetaCache(const RsGxsGroupId& gid);
 
-    std::map<RsGxsGroupId,RsGxsGrpMetaData> mGrpMetaDataCache ;
+    // Fills metaSet with all messages of the group if they are all in the cache. Returns false otherwise.
+    bool locked_retrieveAllMsgMetaFromCache(const RsGxsGroupId& grpId, std::vector<RsGxsMsgMetaData*>& metaSet);
+
+    // Applies an update of the meta data to the cached entries, so that they do not need to be re-read from the
+    // database. Returns false if the update contains a field that cannot be applied, in which case the caller
+    // must drop the cached entry.
+
+    static bool updateCachedGrpMeta(RsGxsGrpMetaData& meta, const ContentValue& cv);
+    static bool updateCachedMsgMeta(RsGxsMsgMetaData& meta, const ContentValue& cv);
+
+    uint32_t mCacheSize;
+
+    t_MetaDataLruCache<RsGxsGroupId,RsGxsGrpMetaData> mGrpMetaDataCache ;
     bool mGrpMetaDataCache_ContainsAllDatabase ;
+    uint32_t mGrpMetaDataCache_DatabaseSize ;	// number of groups in database when ContainsAllDatabase was set
+
+    // Messages meta data, and number of messages of the groups for which all messages were cached. If a message of
+    // such a group is evicted, the number of cached messages of the group does not match anymore, and the group is
+    // read again from the database.
+
+    t_MetaDataLruCache<std::pair<RsGxsGroupId,RsGxsMessageId>,RsGxsMsgMetaData> mMsgMetaDataCache ;
+    std::map<RsGxsGroupId,uint32_t> mMsgMetaDataCache_CompleteGroups ;
 };
 
 #endif // RSDATASERVICE_H
@@ -99,6 +99,34 @@ typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > NxsMsgDataResult;
 typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsNxsMsg*> > NxsMsgRelatedDataResult;
 typedef std::map<RsGxsGroupId,      std::vector<RsNxsMsg*> > GxsMsgResult; // <grpId, msgs>
 
+/*!
+ * Selects the meta data of the messages of a group inside the data store, instead of
+ * retrieving all of it and filtering afterwards. Messages are sorted by publish time
+ * stamp, newest first, so that mOffset and mLimit select a page of the group.
+ */
+class RsGxsMsgMetaQuery
+{
+public:
+    RsGxsMsgMetaQuery() : mThreadHeadsOnly(false), mOrigMsgsOnly(false), mLatestOnly(false),
+        mStatusMask(0), mStatusFilter(0), mFlagMask(0), mFlagFilter(0), mBefore(0), mAfter(0),
+        mOffset(0), mLimit(0) {}
+
+    bool mThreadHeadsOnly;  // only msgs with no parent
+    bool mOrigMsgsOnly;     // only first versions of msgs
+    bool mLatestOnly;       // only the latest version of each msg (among thread heads if mThreadHeadsOnly)
+
+    // exact match of the masked bits, as RsTokReqOptions
+    uint32_t mStatusMask, mStatusFilter;
+    uint32_t mFlagMask, mFlagFilter;
+
+    // publish time range, 0 for no bound
+    time_t mBefore;
+    time_t mAfter;
+
+    uint32_t mOffset;
+    uint32_t mLimit;        // 0 for no limit
+};
+
 /*!
  * The main role of GDS is the preparation and handing out of messages requested from
  * RsGeneralExchangeService and RsGeneralExchangeService
@@ -179,6 +207,17 @@ public:
      */
     virtual int retrieveGxsMsgMetaData(const GxsMsgReq& msgIds, GxsMsgMetaResult& msgMeta) = 0;
 
+    /*!
+     * Retrieves meta data of the messages of a group selected by a query
+     * @param grpId group of the messages
+     * @param query filters, ordering and page to retrieve
+     * @param msgMeta meta data of the messages of the page, newest first
+     * @param totalCount number of messages matching the query, regardless of the page
+     * @return error code
+     */
+    virtual int retrieveGxsMsgMetaData(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query,
+                                       std::vector<RsGxsMsgMetaData*>& msgMeta, uint32_t& totalCount) = 0;
+
     /*!
      * remove msgs in data store listed in msgIds param
      * @param msgIds ids of messages to be removed
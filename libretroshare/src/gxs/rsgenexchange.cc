@@ -67,11 +67,88 @@ static const uint32_t INDEX_AUTHEN_ADMIN        = 0x00000040; // admin key
 
 static const uint32_t MSG_CLEANUP_PERIOD     = 60*59; // 59 minutes
 static const uint32_t INTEGRITY_CHECK_PERIOD = 60*31; // 31 minutes
+static const uint32_t VALIDATION_REPORT_SIZE = 100;   // batches of received data at least this large get their validation rate logged
+
+// Signature checks of a received msg. Keys are collected by the service thread in prepareMsgValidation(), then the
+// job runs the RSA checks and computes the hash in any thread of the validation pool, and the service thread commits the
+// result in finishMsgValidation().
+
+class GxsMsgValidationJob: public RsGxsValidationJob
+{
+public:
+	GxsMsgValidationJob(RsNxsMsg *m)
+	    : msg(m), checkPublishSign(false), checkIdentitySign(false), publishValidate(true), idValidate(true), result(0) {}
+
+	virtual void run()
+	{
+		// signatures are copied because the validation temporarily clears the signature set of the msg
+
+		if(checkPublishSign)
+		{
+			RsTlvKeySignature sign = msg->metaData->signSet.keySignSet[INDEX_AUTHEN_PUBLISH];
+			publishValidate = GxsSecurity::validateNxsMsg(*msg, sign, publishKey);
+		}
+		if(checkIdentitySign)
+		{
+			RsTlvKeySignature sign = msg->metaData->signSet.keySignSet[INDEX_AUTHEN_IDENTITY];
+			idValidate = GxsSecurity::validateNxsMsg(*msg, sign, authorKey);
+		}
+		if(publishValidate && idValidate)
+		{
+			pqihash pHash;
+			pHash.addData(msg->msg.bin_data, msg->msg.bin_len);
+			pHash.Complete(msg->metaData->mHash);
+		}
+	}
+
+	RsNxsMsg *msg ;
+	RsGxsMessageId pendingId ;		// key in mMsgPendingValidate
+
+	bool checkPublishSign ;
+	RsTlvPublicRSAKey publishKey ;
+	bool checkIdentitySign ;
+	RsTlvPublicRSAKey authorKey ;
+
+	bool publishValidate ;
+	bool idValidate ;
+	int result ;					// result of prepareMsgValidation()
+};
+
+class GxsGrpValidationJob: public RsGxsValidationJob
+{
+public:
+	GxsGrpValidationJob(RsNxsGrp *g) : grp(g), checkIdentitySign(false), idValidate(true), result(0) {}
+
+	virtual void run()
+	{
+		if(checkIdentitySign)
+		{
+			RsTlvKeySignature sign = grp->metaData->signSet.keySignSet[INDEX_AUTHEN_IDENTITY];
+			idValidate = GxsSecurity::validateNxsGrp(*grp, sign, authorKey);
+		}
+		if(idValidate)
+		{
+			pqihash pHash;
+			pHash.addData(grp->grp.bin_data, grp->grp.bin_len);
+			pHash.Complete(grp->metaData->mHash);
+		}
+	}
+
+	RsNxsGrp *grp ;
+	RsGxsGroupId pendingId ;		// key in mGrpPendingValidate
+
+	bool checkIdentitySign ;
+	RsTlvPublicRSAKey authorKey ;
+
+	bool idValidate ;
+	int result ;
+};
 
 RsGenExchange::RsGenExchange(RsGeneralDataService *gds, RsNetworkExchangeService *ns,
                              RsSerialType *serviceSerialiser, uint16_t servType, RsGixs* gixs,
                              uint32_t authenPolicy)
   : mGenMtx("GenExchange"),
+    mRequestMtx("GenExchange requests"),
     mDataStore(gds),
     mNetService(ns),
     mSerialiser(serviceSerialiser),
@@ -94,6 +171,7 @@ RsGenExchange::RsGenExchange(RsGeneralDataService *gds, RsNetworkExchangeService
   VALIDATE_MAX_WAITING_TIME(60)
 {
     mDataAccess = new RsGxsDataAccess(gds);
+    mDataAccess->setRequestProcessor(this);
 }
 
 void RsGenExchange::setNetworkExchangeService(RsNetworkExchangeService *ns)
@@ -108,6 +186,11 @@ void RsGenExchange::setNetworkExchangeService(RsNetworkExchangeService *ns)
 
 RsGenExchange::~RsGenExchange()
 {
+    // no request pool thread should be using the service anymore
+
+    mDataAccess->setRequestProcessor(NULL);
+    RsGxsRequestPool::instance().unregister(this);
+
     // need to destruct in a certain order (bad thing, TODO: put down instance ownership rules!)
     delete mNetService;
 
@@ -132,6 +215,19 @@ bool RsGenExchange::getGroupServerUpdateTS(const RsGxsGroupId& gid, time_t& grp_
     return mNetService->getGroupServerUpdateTS(gid,grp_server_update_TS,msg_server_update_TS) ;
 }
 
+void RsGenExchange::processPendingRequests()
+{
+	RS_STACK_MUTEX(mRequestMtx) ;
+
+	// Meta Changes should happen first.
+	// This is important, as services want to change Meta, then get results.
+	// Services shouldn't rely on this ordering - but some do.
+	processGrpMetaChanges();
+	processMsgMetaChanges();
+
+	mDataAccess->processRequests();
+}
+
 void RsGenExchange::data_tick()
 {
 	static const double timeDelta = 0.1; // slow tick in sec
@@ -142,13 +238,9 @@ void RsGenExchange::data_tick()
 
 void RsGenExchange::tick()
 {
-	// Meta Changes should happen first.
-	// This is important, as services want to change Meta, then get results.
-	// Services shouldn't rely on this ordering - but some do.
-	processGrpMetaChanges();
-	processMsgMetaChanges();
-
-	mDataAccess->processRequests();
+	// Requests are normally processed by the request pool as soon as they are made. This catches the meta
+	// changes, and the requests that could not be processed yet.
+	processPendingRequests();
 
 	publishGrps();
 
@@ -163,12 +255,17 @@ void RsGenExchange::tick()
 
 	processRoutingClues() ;
 
-	if(!mNotifications.empty())
+	// notifications are also added by the request pool threads, hence the swap.
+
+	std::vector<RsGxsNotify*> notifications;
 	{
-		notifyChanges(mNotifications);
-		mNotifications.clear();
+		RS_STACK_MUTEX(mGenMtx) ;
+		notifications.swap(mNotifications);
 	}
 
+	if(!notifications.empty())
+		notifyChanges(notifications);
+
 	// implemented service tick function
 	service_tick();
 
@@ -779,11 +876,10 @@ int RsGenExchange::createMessage(RsNxsMsg* msg)
 	}
 }
 
-int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uint32_t& /*signFlag*/, RsTlvSecurityKeySet& grpKeySet)
+int RsGenExchange::prepareMsgValidation(RsNxsMsg *msg, const uint32_t& grpFlag, RsTlvSecurityKeySet& grpKeySet, GxsMsgValidationJob& job)
 {
     bool needIdentitySign = false;
     bool needPublishSign = false;
-    bool publishValidate = true, idValidate = true;
 
     uint8_t author_flag = GXS_SERV::MSG_AUTHEN_ROOT_AUTHOR_SIGN;
     uint8_t publish_flag = GXS_SERV::MSG_AUTHEN_ROOT_PUBLISH_SIGN;
@@ -821,8 +917,6 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 
     if(needPublishSign)
 	{
-		RsTlvKeySignature sign = metaData.signSet.keySignSet[INDEX_AUTHEN_PUBLISH];
-
 		std::map<RsGxsId, RsTlvPublicRSAKey>& keys = grpKeySet.public_keys;
 		std::map<RsGxsId, RsTlvPublicRSAKey>::iterator mit = keys.begin();
 
@@ -847,8 +941,8 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 
 		if(!keyId.isNull())
 		{
-			RsTlvPublicRSAKey& key = keys[keyId];
-			publishValidate &= GxsSecurity::validateNxsMsg(*msg, sign, key);
+			job.checkPublishSign = true;
+			job.publishKey = keys[keyId];
 		}
 		else
 		{
@@ -863,15 +957,9 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
             for(std::map<RsGxsId, RsTlvPrivateRSAKey>::const_iterator it(grpKeySet.private_keys.begin());it!=grpKeySet.private_keys.end();++it)
 				std::cerr << "(EE) " << it->first << std::endl;
 
-			publishValidate = false;
+			job.publishValidate = false;
 		}
 	}
-    else
-    {
-    	publishValidate = true;
-    }
-
-
 
     if(needIdentitySign)
     {
@@ -881,52 +969,15 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 
             if(haveKey)
 	    {
-
-		    RsTlvPublicRSAKey authorKey;
-		    bool auth_key_fetched = mGixs->getKey(metaData.mAuthorId, authorKey) ;
-
-		    if (auth_key_fetched)
-		    {
-			    RsTlvKeySignature sign = metaData.signSet.keySignSet[INDEX_AUTHEN_IDENTITY];
-			    idValidate &= GxsSecurity::validateNxsMsg(*msg, sign, authorKey);
-			    mGixs->timeStampKey(metaData.mAuthorId,RsIdentityUsage(mServType,RsIdentityUsage::MESSAGE_AUTHOR_SIGNATURE_VALIDATION,metaData.mGroupId,metaData.mMsgId)) ;
-		    }
+		    if (mGixs->getKey(metaData.mAuthorId, job.authorKey))
+			    job.checkIdentitySign = true;
 		    else
 		    {
 			    std::cerr << "RsGenExchange::validateMsg()";
 			    std::cerr << " ERROR Cannot Retrieve AUTHOR KEY for Message Validation";
 			    std::cerr << std::endl;
-			    idValidate = false;
+			    job.idValidate = false;
 		    }
-
-            	if(idValidate)
-		{
-			// get key data and check that the key is actually PGP-linked. If not, reject the post.
-
-			RsIdentityDetails details ;
-
-			if(!mGixs->getIdDetails(metaData.mAuthorId,details))
-			{
-				// the key cannot ke reached, although it's in cache. Weird situation.
-				std::cerr << "RsGenExchange::validateMsg(): cannot get key data for ID=" << metaData.mAuthorId << ", although it's supposed to be already in cache. Cannot validate." << std::endl;
-				idValidate = false ;
-			}
-			else 
-			{
-
-				// now check reputation of the message author. The reputation will need to be at least as high as this value for the msg to validate.
-                // At validation step, we accept all messages, except the ones signed by locally rejected identities.
-
-				if(details.mReputation.mOverallReputationLevel == RsReputations::REPUTATION_LOCALLY_NEGATIVE)
-				{
-#ifdef GEN_EXCH_DEBUG	
-					std::cerr << "RsGenExchange::validateMsg(): message from " << metaData.mAuthorId << ", rejected because reputation level (" << details.mReputation.mOverallReputationLevel <<") indicate that you banned this ID." << std::endl;
-#endif
-					idValidate = false ;
-				}
-			}
-
-				}
 	    }
             else
             {
@@ -945,28 +996,58 @@ int RsGenExchange::validateMsg(RsNxsMsg *msg, const uint32_t& grpFlag, const uin
 #ifdef GEN_EXCH_DEBUG
             std::cerr << "Gixs not enabled while request identity signature validation!" << std::endl;
 #endif
-            idValidate = false;
+            job.idValidate = false;
         }
     }
-    else
+
+    return VALIDATE_SUCCESS;
+}
+
+int RsGenExchange::finishMsgValidation(GxsMsgValidationJob& job)
+{
+    RsGxsMsgMetaData& metaData = *(job.msg->metaData);
+
+    if(job.checkIdentitySign)
     {
-    	idValidate = true;
+	    mGixs->timeStampKey(metaData.mAuthorId,RsIdentityUsage(mServType,RsIdentityUsage::MESSAGE_AUTHOR_SIGNATURE_VALIDATION,metaData.mGroupId,metaData.mMsgId)) ;
+
+	    if(job.idValidate)
+	    {
+		    // get key data and check that the key is actually PGP-linked. If not, reject the post.
+
+		    RsIdentityDetails details ;
+
+		    if(!mGixs->getIdDetails(metaData.mAuthorId,details))
+		    {
+			    // the key cannot ke reached, although it's in cache. Weird situation.
+			    std::cerr << "RsGenExchange::validateMsg(): cannot get key data for ID=" << metaData.mAuthorId << ", although it's supposed to be already in cache. Cannot validate." << std::endl;
+			    job.idValidate = false ;
+		    }
+		    else if(details.mReputation.mOverallReputationLevel == RsReputations::REPUTATION_LOCALLY_NEGATIVE)
+		    {
+			    // now check reputation of the message author. The reputation will need to be at least as high as this value for the msg to validate.
+			    // At validation step, we accept all messages, except the ones signed by locally rejected identities.
+#ifdef GEN_EXCH_DEBUG	
+			    std::cerr << "RsGenExchange::validateMsg(): message from " << metaData.mAuthorId << ", rejected because reputation level (" << details.mReputation.mOverallReputationLevel <<") indicate that you banned this ID." << std::endl;
+#endif
+			    job.idValidate = false ;
+		    }
+	    }
     }
 
 #ifdef GEN_EXCH_DEBUG
-    std::cerr << ", publish val=" << publishValidate << ", idValidate=" << idValidate << ". Result=" << (publishValidate && idValidate) << std::endl;
+    std::cerr << "Validate message: msgId=" << metaData.mMsgId << ", publish val=" << job.publishValidate << ", idValidate=" << job.idValidate << ". Result=" << (job.publishValidate && job.idValidate) << std::endl;
 #endif
     
-    if(publishValidate && idValidate)
+    if(job.publishValidate && job.idValidate)
     	return VALIDATE_SUCCESS;
     else
     	return VALIDATE_FAIL;
-
 }
 
-int RsGenExchange::validateGrp(RsNxsGrp* grp)
+int RsGenExchange::prepareGrpValidation(RsNxsGrp* grp, GxsGrpValidationJob& job)
 {
-    bool needIdentitySign = false, idValidate = false;
+    bool needIdentitySign = false;
     RsGxsGrpMetaData& metaData = *(grp->metaData);
 
     uint8_t author_flag = GXS_SERV::GRP_OPTION_AUTHEN_AUTHOR_SIGN;
@@ -996,27 +1077,14 @@ int RsGenExchange::validateGrp(RsNxsGrp* grp)
 #ifdef GEN_EXCH_DEBUG
 			    std::cerr << "  have ID key in cache: yes" << std::endl;
 #endif
-
-			    RsTlvPublicRSAKey authorKey;
-			    bool auth_key_fetched = mGixs->getKey(metaData.mAuthorId, authorKey) ;
-
-			    if (auth_key_fetched)
-			    {
-
-				    RsTlvKeySignature sign = metaData.signSet.keySignSet[INDEX_AUTHEN_IDENTITY];
-				    idValidate = GxsSecurity::validateNxsGrp(*grp, sign, authorKey);
-
-#ifdef GEN_EXCH_DEBUG
-				    std::cerr << "  key ID validation result: " << idValidate << std::endl;
-#endif
-					mGixs->timeStampKey(metaData.mAuthorId,RsIdentityUsage(mServType,RsIdentityUsage::GROUP_AUTHOR_SIGNATURE_VALIDATION,metaData.mGroupId));
-			    }
+			    if (mGixs->getKey(metaData.mAuthorId, job.authorKey))
+				    job.checkIdentitySign = true;
 			    else
 			    {
 				    std::cerr << "RsGenExchange::validateGrp()";
 				    std::cerr << " ERROR Cannot Retrieve AUTHOR KEY for Group Sign Validation";
 				    std::cerr << std::endl;
-				    idValidate = false;
+				    job.idValidate = false;
 			    }
 
 		    }else
@@ -1036,19 +1104,29 @@ int RsGenExchange::validateGrp(RsNxsGrp* grp)
 #ifdef GEN_EXCH_DEBUG
 		    std::cerr << "  (EE) Gixs not enabled while request identity signature validation!" << std::endl;
 #endif
-		    idValidate = false;
+		    job.idValidate = false;
 	    }
     }
-    else
+
+    return VALIDATE_SUCCESS;
+}
+
+int RsGenExchange::finishGrpValidation(GxsGrpValidationJob& job)
+{
+    RsGxsGrpMetaData& metaData = *(job.grp->metaData);
+
+    if(job.checkIdentitySign)
     {
-	    idValidate = true;
+#ifdef GEN_EXCH_DEBUG
+	    std::cerr << "  key ID validation result: " << job.idValidate << std::endl;
+#endif
+	    mGixs->timeStampKey(metaData.mAuthorId,RsIdentityUsage(mServType,RsIdentityUsage::GROUP_AUTHOR_SIGNATURE_VALIDATION,metaData.mGroupId));
     }
 
-    if(idValidate)
+    if(job.idValidate)
 	    return VALIDATE_SUCCESS;
     else
 	    return VALIDATE_FAIL;
-
 }
 
 bool RsGenExchange::checkAuthenFlag(const PrivacyBitPos& pos, const uint8_t& flag) const
@@ -1825,6 +1903,26 @@ RsReputations::ReputationLevel RsGenExchange::minReputationForForwardingMessages
 {
 	return RsNetworkExchangeService::minReputationForForwardingMessages(group_sign_flags,identity_sign_flags);
 }
+
+void RsGenExchange::setValidationThreadCount(uint32_t n)
+{
+	RsGxsValidationPool::instance().setWorkerCount(n) ;
+}
+
+uint32_t RsGenExchange::validationThreadCount()
+{
+	return RsGxsValidationPool::instance().workerCount() ;
+}
+
+void RsGenExchange::getValidationStatistics(RsGxsValidationStatistics& stats)
+{
+	RsGxsValidationPool::instance().getStatistics(stats) ;
+
+	RS_STACK_MUTEX(mGenMtx) ;
+
+	stats.pendingMsgs = mMsgPendingValidate.size() ;
+	stats.pendingGrps = mGrpPendingValidate.size() ;
+}
 uint32_t RsGenExchange::getSyncPeriod(const RsGxsGroupId& grpId)
 {
 	RS_STACK_MUTEX(mGenMtx) ;
@@ -1880,6 +1978,7 @@ void RsGenExchange::setGroupSubscribeFlags(uint32_t& token, const RsGxsGroupId&
     g.val.put(RsGeneralDataService::GRP_META_SUBSCRIBE_FLAG, (int32_t)flag);
     g.val.put(RsGeneralDataService::GRP_META_SUBSCRIBE_FLAG+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 void RsGenExchange::setGroupStatusFlags(uint32_t& token, const RsGxsGroupId& grpId, const uint32_t& status, const uint32_t& mask)
@@ -1893,6 +1992,7 @@ void RsGenExchange::setGroupStatusFlags(uint32_t& token, const RsGxsGroupId& grp
     g.val.put(RsGeneralDataService::GRP_META_STATUS, (int32_t)status);
     g.val.put(RsGeneralDataService::GRP_META_STATUS+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 
@@ -1905,6 +2005,7 @@ void RsGenExchange::setGroupServiceString(uint32_t& token, const RsGxsGroupId& g
     g.grpId = grpId;
     g.val.put(RsGeneralDataService::GRP_META_SERV_STRING, servString);
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 void RsGenExchange::setMsgStatusFlags(uint32_t& token, const RsGxsGrpMsgIdPair& msgId, const uint32_t& status, const uint32_t& mask)
@@ -1918,6 +2019,7 @@ void RsGenExchange::setMsgStatusFlags(uint32_t& token, const RsGxsGrpMsgIdPair&
     m.val.put(RsGeneralDataService::MSG_META_STATUS+GXS_MASK, (int32_t)mask); // HACK, need to perform mask operation in a non-blocking location
     m.msgId = msgId;
     mMsgLocMetaMap.insert(std::make_pair(token, m));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 void RsGenExchange::setMsgServiceString(uint32_t& token, const RsGxsGrpMsgIdPair& msgId, const std::string& servString )
@@ -1929,6 +2031,7 @@ void RsGenExchange::setMsgServiceString(uint32_t& token, const RsGxsGrpMsgIdPair
     m.val.put(RsGeneralDataService::MSG_META_SERV_STRING, servString);
     m.msgId = msgId;
     mMsgLocMetaMap.insert(std::make_pair(token, m));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 void RsGenExchange::processMsgMetaChanges()
@@ -2344,6 +2447,7 @@ RsGenExchange::ServiceCreate_Return RsGenExchange::service_CreateGroup(RsGxsGrpI
 
 void RsGenExchange::processGroupUpdatePublish()
 {
+	RsStackMutex rstack(mRequestMtx) ;	// group meta must not be changed by a request pool thread meanwhile
 					RS_STACK_MUTEX(mGenMtx) ;
 
 	// get keys for group update publish
@@ -2922,9 +3026,12 @@ void RsGenExchange::processRecvdMessages()
 	    std::cerr << "  updating received messages:" << std::endl;
 #endif
 
-		// 3 - Validate each message
+		// 3 - Collect the keys needed to validate each message. Messages whose author key is not available yet stay pending.
 
-	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();)
+		std::vector<GxsMsgValidationJob*> jobs ;
+		std::vector<RsGxsValidationJob*> pool_jobs ;
+
+	    for(NxsMsgPendingVect::iterator pend_it = mMsgPendingValidate.begin();pend_it != mMsgPendingValidate.end();++pend_it)
 	    {
 		    RsNxsMsg* msg = pend_it->second.mItem;
 
@@ -2940,20 +3047,14 @@ void RsGenExchange::processRecvdMessages()
 			//          ok = false ;
 			//      }
 
-#ifdef GEN_EXCH_DEBUG
-		    std::cerr << "    deserialised info: grp id=" << meta->mGroupId << ", msg id=" << meta->mMsgId ;
-#endif
 			std::map<RsGxsGroupId, RsGxsGrpMetaData*>::iterator mit = grpMetas.find(msg->grpId);
 
 #ifdef GEN_EXCH_DEBUG
 			    std::cerr << "    msg info         : grp id=" << msg->grpId << ", msg id=" << msg->msgId << std::endl;
 #endif
-			// validate msg
-
 			if(mit == grpMetas.end())
 			{
 				std::cerr << "RsGenExchange::processRecvdMessages(): impossible situation: grp meta " << msg->grpId << " not available." << std::endl;
-				++pend_it ;
 				continue ;
 			}
 
@@ -2961,14 +3062,47 @@ void RsGenExchange::processRecvdMessages()
 
 			GxsSecurity::createPublicKeysFromPrivateKeys(grpMeta->keys);	// make sure we have the public keys that correspond to the private ones, as it happens. Most of the time this call does nothing.
 
-			int validateReturn = validateMsg(msg, grpMeta->mGroupFlags, grpMeta->mSignFlags, grpMeta->keys);
+			GxsMsgValidationJob *job = new GxsMsgValidationJob(msg) ;
+			job->pendingId = pend_it->first ;
+			job->result = prepareMsgValidation(msg, grpMeta->mGroupFlags, grpMeta->keys, *job);
 
 #ifdef GEN_EXCH_DEBUG
 			std::cerr << "    grpMeta.mSignFlags: " << std::hex << grpMeta->mSignFlags << std::dec << std::endl;
 			std::cerr << "    grpMeta.mAuthFlags: " << std::hex << grpMeta->mAuthenFlags << std::dec << std::endl;
-			std::cerr << "    message validation result: " << (int)validateReturn << std::endl;
 #endif
+			if(job->result == VALIDATE_FAIL_TRY_LATER)
+			{
+				delete job ;
+				continue ;
+			}
+
+			jobs.push_back(job) ;
+			pool_jobs.push_back(job) ;
+	    }
+
+		// 4 - Check the signatures. This is the expensive part, so it is spread over the validation threads.
+
+		RsGxsValidationPool::instance().runJobs(pool_jobs) ;
+
+		if(jobs.size() >= VALIDATION_REPORT_SIZE)
+		{
+			RsGxsValidationStatistics stats ;
+			RsGxsValidationPool::instance().getStatistics(stats) ;
+
+			std::cerr << "RsGenExchange: validated " << jobs.size() << " messages for service " << std::hex << mServType << std::dec << ". Validation rate: "
+			          << stats.jobsPerSecond << " items/s, using " << stats.workers << " validation threads. Queue depth: " << stats.queueDepth << std::endl;
+		}
+
+		// 5 - Commit the results, in the order of the pending list
+
+		for(uint32_t i=0;i<jobs.size();++i)
+	    {
+			RsNxsMsg *msg = jobs[i]->msg ;
+			int validateReturn = finishMsgValidation(*jobs[i]) ;
 
+#ifdef GEN_EXCH_DEBUG
+			std::cerr << "    message validation result: " << (int)validateReturn << std::endl;
+#endif
 			if(validateReturn == VALIDATE_SUCCESS)
 			{
 				msg->metaData->mMsgStatus = GXS_SERV::GXS_MSG_STATUS_UNPROCESSED | GXS_SERV::GXS_MSG_STATUS_GUI_NEW | GXS_SERV::GXS_MSG_STATUS_GUI_UNREAD;
@@ -2979,19 +3113,20 @@ void RsGenExchange::processRecvdMessages()
 				if (std::find(msgv.begin(), msgv.end(), msg->msgId) == msgv.end())
 					msgv.push_back(msg->msgId);
 
-				computeHash(msg->msg, msg->metaData->mHash);
+				// the hash was computed by the validation job
+
 				msg->metaData->recvTS = time(NULL);
 
 #ifdef GEN_EXCH_DEBUG
-				std::cerr << "    new status flags: " << meta->mMsgStatus << std::endl;
-				std::cerr << "    computed hash: " << meta->mHash << std::endl;
+				std::cerr << "    new status flags: " << msg->metaData->mMsgStatus << std::endl;
+				std::cerr << "    computed hash: " << msg->metaData->mHash << std::endl;
 				std::cerr << "Message received. Identity=" << msg->metaData->mAuthorId << ", from peer " << msg->PeerId() << std::endl;
 #endif
 
 				if(!msg->metaData->mAuthorId.isNull())
 					mRoutingClues[msg->metaData->mAuthorId].insert(msg->PeerId()) ;
 			}
-			else if(validateReturn == VALIDATE_FAIL)
+			else
 			{
 				// In this case, we notify the network exchange service not to DL the message again, at least not yet.
 
@@ -3002,18 +3137,11 @@ void RsGenExchange::processRecvdMessages()
 				messages_to_reject.push_back(msg->msgId) ;
 				delete msg ;
 			}
-			else if(validateReturn == VALIDATE_FAIL_TRY_LATER)
-			{
-				++pend_it ;
-				continue;
-			}
 
 			// Remove the entry from mMsgPendingValidate, but do not delete msg since it's either pushed into msg_to_store or deleted in the FAIL case!
 
-			NxsMsgPendingVect::iterator tmp = pend_it ;
-			++tmp ;
-			mMsgPendingValidate.erase(pend_it) ;
-			pend_it = tmp ;
+			mMsgPendingValidate.erase(jobs[i]->pendingId) ;
+			delete jobs[i] ;
 	    }
 
 	    if(!msgIds.empty())
@@ -3061,7 +3189,10 @@ void RsGenExchange::processRecvdGroups()
 	std::vector<RsGxsGroupId> existingGrpIds;
 	mDataStore->retrieveGroupIds(existingGrpIds);
 
-	// 2 - go through each and every new group data and validate the signatures.
+	// 2 - go through each and every new group data and collect the keys needed to validate the signatures.
+
+	std::vector<GxsGrpValidationJob*> jobs ;
+	std::vector<RsGxsValidationJob*> pool_jobs ;
 
 	for(NxsGrpPendValidVect::iterator vit = mGrpPendingValidate.begin(); vit != mGrpPendingValidate.end();)
 	{
@@ -3069,7 +3200,7 @@ void RsGenExchange::processRecvdGroups()
 		RsNxsGrp* grp = gpsi.mItem;
 
 #ifdef GEN_EXCH_DEBUG
-		std::cerr << "  processing validation for group " << meta->mGroupId << ", original attempt time: " << time(NULL) - gpsi.mFirstTryTS << " seconds ago" << std::endl;
+		std::cerr << "  processing validation for group " << grp->grpId << ", original attempt time: " << time(NULL) - gpsi.mFirstTryTS << " seconds ago" << std::endl;
 #endif
 		if(grp->metaData == NULL)
 		{
@@ -3093,22 +3224,46 @@ void RsGenExchange::processRecvdGroups()
 			continue;
 		}
 
-		// group signature validation
+		GxsGrpValidationJob *job = new GxsGrpValidationJob(grp) ;
+		job->pendingId = vit->first ;
+		job->result = prepareGrpValidation(grp, *job);
 
-		uint8_t ret = validateGrp(grp);
+		if(job->result == VALIDATE_FAIL_TRY_LATER)
+		{
+#ifdef GEN_EXCH_DEBUG
+			std::cerr << "  failed to validate incoming grp, trying again later. grpId: " << grp->grpId << std::endl;
+#endif
+			delete job ;
+		}
+		else
+		{
+			jobs.push_back(job) ;
+			pool_jobs.push_back(job) ;
+		}
+		++vit ;
+	}
+
+	// 3 - check the signatures in the validation threads
+
+	RsGxsValidationPool::instance().runJobs(pool_jobs) ;
+
+	// 4 - commit the results
+
+	for(uint32_t i=0;i<jobs.size();++i)
+	{
+		RsNxsGrp* grp = jobs[i]->grp ;
+		int ret = finishGrpValidation(*jobs[i]);
 
 		if(ret == VALIDATE_SUCCESS)
 		{
 			grp->metaData->mGroupStatus = GXS_SERV::GXS_GRP_STATUS_UNPROCESSED | GXS_SERV::GXS_GRP_STATUS_UNREAD;
 
-			computeHash(grp->grp, grp->metaData->mHash);
-
-			// group has been validated. Let's notify the global router for the clue
+			// the hash was computed by the validation job. Group has been validated. Let's notify the global router for the clue
 
 			if(!grp->metaData->mAuthorId.isNull())
 			{
 #ifdef GEN_EXCH_DEBUG
-				std::cerr << "Group routage info: Identity=" << meta->mAuthorId << " from " << grp->PeerId() << std::endl;
+				std::cerr << "Group routage info: Identity=" << grp->metaData->mAuthorId << " from " << grp->PeerId() << std::endl;
 #endif
 				mRoutingClues[grp->metaData->mAuthorId].insert(grp->PeerId()) ;
 			}
@@ -3135,28 +3290,18 @@ void RsGenExchange::processRecvdGroups()
 				mGroupUpdates.push_back(update);
 			}
 		}
-		else if(ret == VALIDATE_FAIL)
+		else
 		{
 #ifdef GEN_EXCH_DEBUG
 			std::cerr << "  failed to validate incoming meta, grpId: " << grp->grpId << ": wrong signature" << std::endl;
 #endif
 			delete grp;
 		}
-		else  if(ret == VALIDATE_FAIL_TRY_LATER)
-		{
-#ifdef GEN_EXCH_DEBUG
-			std::cerr << "  failed to validate incoming grp, trying again later. grpId: " << grp->grpId << std::endl;
-#endif
-			++vit ;
-			continue;
-		}
 
 		// Erase entry from the list
 
-		NxsGrpPendValidVect::iterator tmp(vit) ;
-		++tmp ;
-		mGrpPendingValidate.erase(vit) ;
-		vit = tmp ;
+		mGrpPendingValidate.erase(jobs[i]->pendingId) ;
+		delete jobs[i] ;
 	}
 
 	if(!grpIds.empty())
@@ -3175,6 +3320,7 @@ void RsGenExchange::processRecvdGroups()
 
 void RsGenExchange::performUpdateValidation()
 {
+	RsStackMutex rstack(mRequestMtx) ;	// group meta must not be changed by a request pool thread meanwhile
 					RS_STACK_MUTEX(mGenMtx) ;
 
 	if(mGroupUpdates.empty())
@@ -3313,6 +3459,7 @@ void RsGenExchange::setGroupReputationCutOff(uint32_t& token, const RsGxsGroupId
     g.grpId = grpId;
     g.val.put(RsGeneralDataService::GRP_META_CUTOFF_LEVEL, (int32_t)CutOff);
     mGrpLocMetaMap.insert(std::make_pair(token, g));
+    RsGxsRequestPool::instance().schedule(this);
 }
 
 void RsGenExchange::removeDeleteExistingMessages( std::list<RsNxsMsg*>& msgs, GxsMsgReq& msgIdsNotify)
@@ -38,6 +38,7 @@
 #include "retroshare/rsgxsservice.h"
 #include "rsitems/rsnxsitems.h"
 #include "rsgxsutil.h"
+#include "rsgxsvalidationpool.h"
 
 template<class GxsItem, typename Identity = std::string>
 class GxsPendingItem
@@ -98,8 +99,10 @@ typedef std::map<RsGxsGrpMsgIdPair, std::vector<RsGxsMsgItem*> > GxsMsgRelatedDa
  */
 
 class RsGixs;
+class GxsMsgValidationJob;
+class GxsGrpValidationJob;
 
-class RsGenExchange : public RsNxsObserver, public RsTickingThread, public RsGxsIface
+class RsGenExchange : public RsNxsObserver, public RsTickingThread, public RsGxsIface, public RsGxsRequestProcessor
 {
 public:
 
@@ -158,6 +161,12 @@ public:
      */
     void tick();
 
+    /*!
+     * Applies the pending local meta changes, then processes the pending data requests. Called by the
+     * request pool as soon as a request is made, and by tick().
+     */
+    virtual void processPendingRequests();
+
     /*!
      * Any backgroup processing needed by
      */
@@ -677,6 +686,19 @@ public:
     uint32_t serviceFullType() const { return ((uint32_t)mServType << 8) + (((uint32_t) RS_PKT_VERSION_SERVICE) << 24); }
 
     virtual RsReputations::ReputationLevel minReputationForForwardingMessages(uint32_t group_sign_flags,uint32_t identity_flags);
+
+    /*!
+     * Sets the number of threads that check the signatures of received msgs and groups. These threads are
+     * shared by all GXS services. With 0, signatures are checked by the service threads only.
+     */
+    static void setValidationThreadCount(uint32_t n) ;
+    static uint32_t validationThreadCount() ;
+
+    /*!
+     * Returns the validation queue depth and rate of the validation threads, and the number of msgs and groups
+     * of this service that are waiting for validation.
+     */
+    virtual void getValidationStatistics(RsGxsValidationStatistics& stats) ;
 protected:
 
     /** Notifications **/
@@ -793,23 +815,32 @@ private:
     void generateGroupKeys(RsTlvSecurityKeySet& keySet, bool genPublishKeys);
 
     /*!
-     * Attempts to validate msg signatures
+     * Prepares the validation of msg signatures: finds which signatures must be checked and
+     * collects the keys to check them with. The checks themselves are run by the job, possibly
+     * in another thread, and the result is completed by finishMsgValidation()
      * @param msg message to be validated
      * @param grpFlag the distribution flag for the group the message belongs to
-     * @param grpFlag the signature flag for the group the message belongs to
      * @param grpKeySet the key set user has for the message's group
-     * @return VALIDATE_SUCCESS for success, VALIDATE_FAIL for fail,
-     * 		   VALIDATE_ID_SIGN_NOT_AVAIL for Id sign key not avail (but requested)
+     * @param job is filled with the signatures to check
+     * @return VALIDATE_SUCCESS if the job can be run, VALIDATE_FAIL for fail,
+     * 		   VALIDATE_FAIL_TRY_LATER for Id sign key not avail (but requested)
+     */
+    int prepareMsgValidation(RsNxsMsg* msg, const uint32_t& grpFlag, RsTlvSecurityKeySet& grpKeySet, GxsMsgValidationJob& job);
+
+    /*!
+     * Checks the author's reputation once the signatures of the job have been checked
+     * @return VALIDATE_SUCCESS for success, VALIDATE_FAIL for fail
      */
-    int validateMsg(RsNxsMsg* msg, const uint32_t& grpFlag, const uint32_t &signFlag, RsTlvSecurityKeySet& grpKeySet);
+    int finishMsgValidation(GxsMsgValidationJob& job);
 
     /*!
-	 * Attempts to validate group signatures
+	 * Same as above, for group signatures
 	 * @param grp group to be validated
-	 * @return VALIDATE_SUCCESS for success, VALIDATE_FAIL for fail,
-	 * 		   VALIDATE_ID_SIGN_NOT_AVAIL for Id sign key not avail (but requested)
+	 * @return VALIDATE_SUCCESS if the job can be run, VALIDATE_FAIL for fail,
+	 * 		   VALIDATE_FAIL_TRY_LATER for Id sign key not avail (but requested)
 	 */
-	int validateGrp(RsNxsGrp* grp);
+	int prepareGrpValidation(RsNxsGrp* grp, GxsGrpValidationJob& job);
+	int finishGrpValidation(GxsGrpValidationJob& job);
 
     /*!
      * Checks flag against a given privacy bit block
@@ -853,6 +884,7 @@ private:
     void removeDeleteExistingMessages(std::list<RsNxsMsg*>& msgs, GxsMsgReq& msgIdsNotify);
 
     RsMutex mGenMtx;
+    RsMutex mRequestMtx;	// serialises processPendingRequests(), so that requests still see the meta changes made before them
     RsGxsDataAccess* mDataAccess;
     RsGeneralDataService* mDataStore;
     RsNetworkExchangeService *mNetService;
@@ -42,7 +42,7 @@
  **********/
 
 RsGxsDataAccess::RsGxsDataAccess(RsGeneralDataService* ds) :
-    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0) {}
+    mDataStore(ds), mDataMutex("RsGxsDataAccess"), mNextToken(0), mRequestProcessor(NULL) {}
 
 
 RsGxsDataAccess::~RsGxsDataAccess()
@@ -313,14 +313,92 @@ void RsGxsDataAccess::setReq(GxsRequest* req, uint32_t token, uint32_t ansType,
 	return;
 }
 void    RsGxsDataAccess::storeRequest(GxsRequest* req)
+{
+	RsGxsRequestProcessor *processor = NULL;
+
+	{
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		req->status = GXS_REQUEST_V2_STATUS_PENDING;
+		req->reqTime = time(NULL);
+		mRequests[req->token] = req;
+
+		processor = mRequestProcessor;
+	}
+
+	if(processor != NULL)
+		RsGxsRequestPool::instance().schedule(processor);
+}
+
+void RsGxsDataAccess::setRequestProcessor(RsGxsRequestProcessor *p)
 {
 	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+	mRequestProcessor = p;
+}
 
-        req->status = GXS_REQUEST_V2_STATUS_PENDING;
-        req->reqTime = time(NULL);
-	mRequests[req->token] = req;
+bool RsGxsDataAccess::observeRequest(const uint32_t token, RsTokenObserver *observer)
+{
+	uint32_t status;
 
-	return;
+	{
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		std::map<uint32_t, uint32_t>::const_iterator pit = mPublicToken.find(token);
+		GxsRequest *req = NULL;
+
+		if(pit != mPublicToken.end())
+			status = pit->second;
+		else if((req = locked_retrieveRequest(token)) != NULL)
+			status = req->status;
+		else
+			return false;
+
+		// finished requests are notified right away, off-mutex
+
+		if(status != GXS_REQUEST_V2_STATUS_COMPLETE && status != GXS_REQUEST_V2_STATUS_FAILED)
+		{
+			mObservers[token] = observer;
+			return true;
+		}
+	}
+
+	observer->requestCompleted(token, status);
+	return true;
+}
+
+bool RsGxsDataAccess::getMsgTotalCounts(const uint32_t token, std::map<RsGxsGroupId, uint32_t>& counts)
+{
+	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+	GxsRequest *req = locked_retrieveRequest(token);
+
+	if(req == NULL || (req->status != GXS_REQUEST_V2_STATUS_COMPLETE && req->status != GXS_REQUEST_V2_STATUS_DONE))
+	{
+		std::cerr << "RsGxsDataAccess::getMsgTotalCounts() Req not ready" << std::endl;
+		return false;
+	}
+
+	counts = req->mMsgTotalCounts;
+	return true;
+}
+
+void RsGxsDataAccess::notifyObserver(const uint32_t &token, const uint32_t &status)
+{
+	RsTokenObserver *observer = NULL;
+
+	{
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		std::map<uint32_t, RsTokenObserver*>::iterator it = mObservers.find(token);
+
+		if(it == mObservers.end())
+			return;
+
+		observer = it->second;
+		mObservers.erase(it);
+	}
+
+	observer->requestCompleted(token, status);
 }
 
 uint32_t RsGxsDataAccess::requestStatus(uint32_t token)
@@ -346,15 +424,21 @@ uint32_t RsGxsDataAccess::requestStatus(uint32_t token)
 
 bool RsGxsDataAccess::cancelRequest(const uint32_t& token)
 {
-	RsStackMutex stack(mDataMutex); /****** LOCKED *****/
-
-	GxsRequest* req = locked_retrieveRequest(token);
-	if (!req)
 	{
-		return false;
+		RsStackMutex stack(mDataMutex); /****** LOCKED *****/
+
+		GxsRequest* req = locked_retrieveRequest(token);
+		if (!req)
+		{
+			return false;
+		}
+
+		req->status = GXS_REQUEST_V2_STATUS_CANCELLED;
 	}
 
-	req->status = GXS_REQUEST_V2_STATUS_CANCELLED;
+	// the observer will not get the result: tell it now.
+
+	notifyObserver(token, GXS_REQUEST_V2_STATUS_FAILED);
 
 	return true;
 }
@@ -373,6 +457,7 @@ bool RsGxsDataAccess::clearRequest(const uint32_t& token)
 
 	delete it->second;
 	mRequests.erase(it);
+	mObservers.erase(token);
 
 	return true;
 }
@@ -874,13 +959,19 @@ void RsGxsDataAccess::processRequests()
 			          << req->token << std::endl;
 		}
 
+		uint32_t token = req->token;
+		bool finished = false;
 		{
 			RsStackMutex stack(mDataMutex); /******* LOCKED *******/
 			if (req->status == GXS_REQUEST_V2_STATUS_PARTIAL)
 			{
 				req->status = ok ? GXS_REQUEST_V2_STATUS_COMPLETE : GXS_REQUEST_V2_STATUS_FAILED;
+				finished = true;
 			}
 		} // END OF MUTEX.
+
+		if(finished)
+			notifyObserver(token, ok ? GXS_REQUEST_V2_STATUS_COMPLETE : GXS_REQUEST_V2_STATUS_FAILED);
 	}
 }
 
@@ -1064,7 +1155,7 @@ bool RsGxsDataAccess::getMsgData(MsgDataReq* req)
 	GxsMsgReq msgIdOut;
 
 	// filter based on options
-	getMsgList(req->mMsgIds, req->Options, msgIdOut);
+	getMsgList(req->mMsgIds, req->Options, msgIdOut, req->mMsgTotalCounts);
 
 	mDataStore->retrieveNxsMsgs(msgIdOut, req->mMsgData, true, true);
 
@@ -1077,7 +1168,7 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
         GxsMsgReq msgIdOut;
 
         // filter based on options
-        getMsgList(req->mMsgIds, req->Options, msgIdOut);
+        getMsgList(req->mMsgIds, req->Options, msgIdOut, req->mMsgTotalCounts);
 
         mDataStore->retrieveGxsMsgMetaData(msgIdOut, req->mMsgMetaData);
 
@@ -1085,11 +1176,81 @@ bool RsGxsDataAccess::getMsgSummary(MsgMetaReq* req)
 }
 
 
-bool RsGxsDataAccess::getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgReq& msgIdsOut)
+bool RsGxsDataAccess::useStoreQuery(const RsTokReqOptions& opts) const
+{
+    // without any filter nor page, the meta data cache of the data store answers faster.
+
+    return opts.mPageSize || opts.mStatusMask || opts.mMsgFlagMask || opts.mBefore || opts.mAfter
+            || (opts.mOptions & (RS_TOKREQOPT_MSG_ORIGMSG | RS_TOKREQOPT_MSG_LATEST | RS_TOKREQOPT_MSG_THREAD));
+}
+
+void RsGxsDataAccess::getMsgListFromStore(const RsGxsGroupId& grpId, const RsTokReqOptions& opts,
+                                          std::vector<RsGxsMessageId>& msgIdsOut, uint32_t& totalCount)
+{
+    RsGxsMsgMetaQuery query;
+
+    // same precedence as getMsgList(): ORIGMSG wins over LATEST
+    query.mOrigMsgsOnly = opts.mOptions & RS_TOKREQOPT_MSG_ORIGMSG;
+    query.mLatestOnly = !query.mOrigMsgsOnly && (opts.mOptions & RS_TOKREQOPT_MSG_LATEST);
+    query.mThreadHeadsOnly = opts.mOptions & RS_TOKREQOPT_MSG_THREAD;
+    query.mStatusMask = opts.mStatusMask;
+    query.mStatusFilter = opts.mStatusFilter;
+    query.mFlagMask = opts.mMsgFlagMask;
+    query.mFlagFilter = opts.mMsgFlagFilter;
+    query.mBefore = opts.mBefore;
+    query.mAfter = opts.mAfter;
+
+    if(opts.mPageSize)
+    {
+        query.mOffset = opts.mPageOffset;
+        query.mLimit = opts.mPageSize;
+    }
+
+    std::vector<RsGxsMsgMetaData*> metaV;
+    mDataStore->retrieveGxsMsgMetaData(grpId, query, metaV, totalCount);
+
+#ifdef DATA_DEBUG
+    std::cerr << "RsGxsDataAccess::getMsgListFromStore() grpId " << grpId << ": " << metaV.size() << " msgs of "
+              << totalCount << " matching" << std::endl;
+#endif
+
+    for(uint32_t i=0; i<metaV.size(); ++i)
+    {
+        msgIdsOut.push_back(metaV[i]->mMsgId);
+        delete metaV[i];
+    }
+}
+
+bool RsGxsDataAccess::getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgReq& msgIdsOut,
+                                 std::map<RsGxsGroupId, uint32_t>& totalCounts)
 {
+    // Requests for whole groups are filtered, sorted and paged by the data store, so that only the messages
+    // asked for are loaded. Explicit msg ids are filtered below.
+
+    GxsMsgReq remainingIds;
+    bool storeQuery = useStoreQuery(opts);
+
+    for(GxsMsgReq::const_iterator mit = msgIds.begin(); mit != msgIds.end(); ++mit)
+    {
+        if(!storeQuery || !mit->second.empty())
+        {
+            remainingIds.insert(*mit);
+            continue;
+        }
+
+        std::vector<RsGxsMessageId> grpMsgIds;
+        getMsgListFromStore(mit->first, opts, grpMsgIds, totalCounts[mit->first]);
+
+        if(!grpMsgIds.empty())
+            msgIdsOut[mit->first].swap(grpMsgIds);
+    }
+
+    if(remainingIds.empty())
+        return true;
+
     GxsMsgMetaResult result;
 
-    mDataStore->retrieveGxsMsgMetaData(msgIds, result);
+    mDataStore->retrieveGxsMsgMetaData(remainingIds, result);
 
     /* CASEs this handles.
      * Input is groupList + Flags.
@@ -1251,6 +1412,12 @@ bool RsGxsDataAccess::getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions&
 
     metaFilter.clear();
 
+    for(meta_it = result.begin(); meta_it != result.end(); ++meta_it)
+    {
+        GxsMsgReq::const_iterator oit = msgIdsOut.find(meta_it->first);
+        totalCounts[meta_it->first] = (oit == msgIdsOut.end()) ? 0 : oit->second.size();
+    }
+
     // delete meta data
     cleanseMsgMetaMap(result);
 
@@ -1669,34 +1836,9 @@ bool RsGxsDataAccess::getServiceStatistic(ServiceStatisticRequest *req)
 
 bool RsGxsDataAccess::getMsgList(MsgIdReq* req)
 {
-
-    GxsMsgMetaResult result;
-
-    mDataStore->retrieveGxsMsgMetaData(req->mMsgIds, result);
-
-
-    GxsMsgMetaResult::iterator mit = result.begin(), mit_end = result.end();
-
-    for(; mit != mit_end; ++mit)
-    {
-        const RsGxsGroupId grpId = mit->first;
-        std::vector<RsGxsMsgMetaData*>& metaV = mit->second;
-        std::vector<RsGxsMsgMetaData*>::iterator vit = metaV.begin(),
-        vit_end = metaV.end();
-
-        for(; vit != vit_end; ++vit)
-        {
-            RsGxsMsgMetaData* meta = *vit;
-            req->mMsgIdResult[grpId].push_back(meta->mMsgId);
-            delete meta; // discard meta data mem
-        }
-    }
-
-    GxsMsgReq msgIdOut;
-
-    // filter based on options
-    getMsgList(req->mMsgIdResult, req->Options, msgIdOut);
-    req->mMsgIdResult = msgIdOut;
+    // filter based on options. Empty msg id lists stand for the whole group, and are kept as such so that
+    // the data store can do the filtering.
+    getMsgList(req->mMsgIds, req->Options, req->mMsgIdResult, req->mMsgTotalCounts);
 
     return true;
 }
@@ -1879,18 +2021,23 @@ uint32_t RsGxsDataAccess::generatePublicToken()
 bool RsGxsDataAccess::updatePublicRequestStatus(const uint32_t& token,
 		const uint32_t& status)
 {
-	RsStackMutex stack(mDataMutex);
-	std::map<uint32_t, uint32_t>::iterator mit = mPublicToken.find(token);
-
-	if(mit != mPublicToken.end())
-	{
-		mit->second = status;
-	}
-	else
 	{
-		return false;
+		RsStackMutex stack(mDataMutex);
+		std::map<uint32_t, uint32_t>::iterator mit = mPublicToken.find(token);
+
+		if(mit != mPublicToken.end())
+		{
+			mit->second = status;
+		}
+		else
+		{
+			return false;
+		}
 	}
 
+	if(status == GXS_REQUEST_V2_STATUS_COMPLETE || status == GXS_REQUEST_V2_STATUS_FAILED)
+		notifyObserver(token, status);
+
 	return true;
 }
 
@@ -28,6 +28,7 @@
 
 #include "retroshare/rstokenservice.h"
 #include "rsgxsrequesttypes.h"
+#include "rsgxsrequestpool.h"
 #include "rsgds.h"
 
 
@@ -123,6 +124,12 @@ public:
     /* Poll */
     uint32_t requestStatus(const uint32_t token);
 
+    /* Completion callback */
+    bool observeRequest(const uint32_t token, RsTokenObserver *observer);
+
+    /* Paging */
+    bool getMsgTotalCounts(const uint32_t token, std::map<RsGxsGroupId, uint32_t>& counts);
+
     /* Cancel Request */
     bool cancelRequest(const uint32_t &token);
 
@@ -165,6 +172,13 @@ public:
      */
     void processRequests();
 
+    /*!
+     * New requests get p scheduled in the request pool, so that they are processed right away rather than at the
+     * next call of processRequests() by the service.
+     * @param p the processor that calls processRequests(), NULL to disable
+     */
+    void setRequestProcessor(RsGxsRequestProcessor *p);
+
     /*!
      * @param token
      * @param grpStatistic
@@ -298,6 +312,14 @@ private:
      */
     bool locked_updateRequestStatus(const uint32_t &token, const uint32_t &status);
 
+    /*!
+     * Calls the observer of a finished request, if any. Must be called without mDataMutex, since observers can
+     * call back the data access.
+     * @param token the token of the request
+     * @param status final status of the request
+     */
+    void notifyObserver(const uint32_t &token, const uint32_t &status);
+
     /*!
      * Use to query the status and other values of a given token
      * @param token the toke of the request to check for
@@ -471,11 +493,30 @@ private:
     /*!
      * This is a filter method which applies the request options to the list of ids
      * requested
-     * @param msgIds the msg ids for filter to be applied to
+     * @param msgIds the msg ids for filter to be applied to, an empty list standing for all msgs of the group
      * @param opts the options used to parameterise the id filter
      * @param msgIdsOut the left overs ids after filter is applied to msgIds
+     * @param totalCounts number of msgs passing the filter per group, before paging
      */
-    bool getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgReq& msgIdsOut);
+    bool getMsgList(const GxsMsgReq& msgIds, const RsTokReqOptions& opts, GxsMsgReq& msgIdsOut,
+                    std::map<RsGxsGroupId, uint32_t>& totalCounts);
+
+    /*!
+     * @return true if the options are worth a query of the data store, rather than filtering all msgs of
+     *         the group in memory
+     */
+    bool useStoreQuery(const RsTokReqOptions& opts) const;
+
+    /*!
+     * Lets the data store select the msgs of a whole group passing the options, sorted by publish time
+     * (newest first) and paged as asked in opts
+     * @param grpId the group
+     * @param opts the options used to parameterise the query
+     * @param msgIdsOut ids of the msgs of the page
+     * @param totalCount number of msgs passing the filter, regardless of the page
+     */
+    void getMsgListFromStore(const RsGxsGroupId& grpId, const RsTokReqOptions& opts,
+                             std::vector<RsGxsMessageId>& msgIdsOut, uint32_t& totalCount);
 
 private:
 
@@ -486,6 +527,9 @@ private:
     uint32_t mNextToken;
     std::map<uint32_t, uint32_t> mPublicToken;
     std::map<uint32_t, GxsRequest*> mRequests;
+    std::map<uint32_t, RsTokenObserver*> mObservers;
+
+    RsGxsRequestProcessor *mRequestProcessor;
 
 
 
@@ -255,6 +255,7 @@ static const uint32_t REJECTED_MESSAGE_RETRY_DELAY            =      24*3600; //
 static const uint32_t GROUP_STATS_UPDATE_DELAY                =          240; // update unsubscribed group statistics every 3 mins
 static const uint32_t GROUP_STATS_UPDATE_NB_PEERS             =            2; // number of peers to which the group stats are asked
 static const uint32_t MAX_ALLOWED_GXS_MESSAGE_SIZE            =       199000; // 200,000 bytes including signature and headers
+static const uint32_t MSG_SKETCH_MIN_SIZE                     =          512; // groups with fewer msg ids to send get the plain list, even if the peer supports sketches
 
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_UNKNOWN             = 0x00 ;
 static const uint32_t RS_NXS_ITEM_ENCRYPTION_STATUS_NO_ERROR            = 0x01 ;
@@ -351,6 +352,7 @@ void RsGxsNetService::getItemNames(std::map<uint8_t,std::string>& names) const
 	names[RS_PKT_SUBTYPE_NXS_SESSION_KEY_ITEM     ] = "Session Key" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM        ] = "Message Sync" ;
 	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM    ] = "Message Sync Request" ;
+	names[RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_ITEM ] = "Message Sync Sketch" ;
 	names[RS_PKT_SUBTYPE_NXS_MSG_ITEM             ] = "Message Data" ;
 	names[RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         ] = "Transaction" ;
 	names[RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM ] = "Publish key" ;
@@ -632,6 +634,7 @@ void RsGxsNetService::syncWithPeers()
             msg->clear();
             msg->PeerId(peerId);
             msg->updateTS = updateTS;
+            msg->flag |= RsNxsSyncMsgReqItem::FLAG_SKETCH_CAPABLE ;
 
             int req_delay  = (int)locked_getGrpConfig(grpId).msg_req_delay ;
             int keep_delay = (int)locked_getGrpConfig(grpId).msg_keep_delay ;
@@ -1568,6 +1571,7 @@ void RsGxsNetService::recvNxsItemQueue()
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_STATS_ITEM: handleRecvSyncGrpStatistics   (dynamic_cast<RsNxsSyncGrpStatsItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_GRP_REQ_ITEM:   handleRecvSyncGroup           (dynamic_cast<RsNxsSyncGrpReqItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:   handleRecvSyncMessage         (dynamic_cast<RsNxsSyncMsgReqItem*>(ni),item_was_encrypted) ; break ;
+            case RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_ITEM:handleRecvSyncMsgSketch       (dynamic_cast<RsNxsSyncMsgSketchItem*>(ni)) ; break ;
             case RS_PKT_SUBTYPE_NXS_GRP_PUBLISH_KEY_ITEM:handleRecvPublishKeys         (dynamic_cast<RsNxsGroupPublishKeyItem*>(ni)) ; break ;
 
             default:
@@ -4145,47 +4149,26 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
     uint32_t transN = locked_getTransactionId();
     RsGxsCircleId should_encrypt_to_this_circle_id ;
 
-    time_t now = time(NULL) ;
-
-    uint32_t max_send_delay = locked_getGrpConfig(item->grpId).msg_req_delay;	// we should use "sync" but there's only one variable used in the GUI: the req one.
-
     if(canSendMsgIds(msgMetas, *grpMeta, peer, should_encrypt_to_this_circle_id))
     {
-	    for(std::vector<RsGxsMsgMetaData*>::iterator vit = msgMetas.begin();vit != msgMetas.end(); ++vit)
-		{
-			RsGxsMsgMetaData* m = *vit;
-
-            // Check reputation
+	    std::vector<RsGxsMsgMetaData*> toSend ;
+	    locked_selectMsgsToSend(*grpMeta,item->createdSinceTS,msgMetas,toSend) ;
 
-            if(!m->mAuthorId.isNull())
-			{
-				RsIdentityDetails details ;
+	    // Large groups are summarised into a sketch for peers that understand it. The peer will then only ask for the
+	    // ids of the buckets that differ. Circle-restricted groups always get the (encrypted) list.
 
-				if(!rsIdentity->getIdDetails(m->mAuthorId,details))
-				{
-#ifdef NXS_NET_DEBUG_0
-					GXSNETDEBUG_PG(item->PeerId(),item->grpId) << " not sending grp message ID " << (*vit)->mMsgId << ", because the identity of the author (" << m->mAuthorId << ") is not accessible (unknown/not cached)" << std::endl;
-#endif
-					continue ;
-				}
+	    if((item->flag & RsNxsSyncMsgReqItem::FLAG_SKETCH_CAPABLE) && should_encrypt_to_this_circle_id.isNull() && toSend.size() >= MSG_SKETCH_MIN_SIZE)
+	    {
+		    locked_sendMsgSketch(peer,item->grpId,item->createdSinceTS,toSend) ;
 
-				if(details.mReputation.mOverallReputationLevel < minReputationForForwardingMessages(grpMeta->mSignFlags, details.mFlags))
-				{
-#ifdef NXS_NET_DEBUG_0
-					GXSNETDEBUG_PG(item->PeerId(),item->grpId) << " not sending item ID " << (*vit)->mMsgId << ", because the author is flags " << std::hex << details.mFlags << std::dec << " and reputation level " << details.mReputation.mOverallReputationLevel << std::endl;
-#endif
-					continue ;
-				}
-			}
-			// Check publish TS
+		    for(std::vector<RsGxsMsgMetaData*>::iterator vit = msgMetas.begin(); vit != msgMetas.end(); ++vit)
+			    delete *vit;
+		    return ;
+	    }
 
-			if(item->createdSinceTS > (*vit)->mPublishTs || ((max_send_delay > 0) && (*vit)->mPublishTs + max_send_delay < now))
-			{
-#ifdef NXS_NET_DEBUG_0
-				GXSNETDEBUG_PG(item->PeerId(),item->grpId) << "  not sending item ID " << (*vit)->mMsgId << ", because it is too old (publishTS = " << (time(NULL)-(*vit)->mPublishTs)/86400 << " days ago" << std::endl;
-#endif
-				continue ;
-			}
+	    for(std::vector<RsGxsMsgMetaData*>::iterator vit = toSend.begin();vit != toSend.end(); ++vit)
+		{
+			RsGxsMsgMetaData* m = *vit;
 
 			RsNxsSyncMsgItem* mItem = new RsNxsSyncMsgItem(mServType);
 			mItem->flag = RsNxsSyncGrpItem::FLAG_RESPONSE;
@@ -4254,6 +4237,288 @@ void RsGxsNetService::handleRecvSyncMessage(RsNxsSyncMsgReqItem *item,bool item_
 	    delete *vit;
 }
 
+// Selects, among the messages of a group, the ones which ids can be sent to friends: the author must be known and have a
+// sufficient reputation, and the message must be recent enough for both the peer's request and the group's sync delay.
+
+void RsGxsNetService::locked_selectMsgsToSend(const RsGxsGrpMetaData& grpMeta,uint32_t createdSinceTS,const std::vector<RsGxsMsgMetaData*>& msgMetas,std::vector<RsGxsMsgMetaData*>& toSend)
+{
+    time_t now = time(NULL) ;
+    uint32_t max_send_delay = locked_getGrpConfig(grpMeta.mGroupId).msg_req_delay;	// we should use "sync" but there's only one variable used in the GUI: the req one.
+
+    for(std::vector<RsGxsMsgMetaData*>::const_iterator vit = msgMetas.begin();vit != msgMetas.end(); ++vit)
+    {
+        RsGxsMsgMetaData* m = *vit;
+
+        // Check reputation
+
+        if(!m->mAuthorId.isNull())
+        {
+            RsIdentityDetails details ;
+
+            if(!rsIdentity->getIdDetails(m->mAuthorId,details))
+            {
+#ifdef NXS_NET_DEBUG_0
+                GXSNETDEBUG__G(grpMeta.mGroupId) << " not sending grp message ID " << m->mMsgId << ", because the identity of the author (" << m->mAuthorId << ") is not accessible (unknown/not cached)" << std::endl;
+#endif
+                continue ;
+            }
+
+            if(details.mReputation.mOverallReputationLevel < minReputationForForwardingMessages(grpMeta.mSignFlags, details.mFlags))
+            {
+#ifdef NXS_NET_DEBUG_0
+                GXSNETDEBUG__G(grpMeta.mGroupId) << " not sending item ID " << m->mMsgId << ", because the author is flags " << std::hex << details.mFlags << std::dec << " and reputation level " << details.mReputation.mOverallReputationLevel << std::endl;
+#endif
+                continue ;
+            }
+        }
+        // Check publish TS
+
+        if(createdSinceTS > m->mPublishTs || ((max_send_delay > 0) && m->mPublishTs + max_send_delay < now))
+        {
+#ifdef NXS_NET_DEBUG_0
+            GXSNETDEBUG__G(grpMeta.mGroupId) << "  not sending item ID " << m->mMsgId << ", because it is too old (publishTS = " << (time(NULL)-m->mPublishTs)/86400 << " days ago" << std::endl;
+#endif
+            continue ;
+        }
+
+        toSend.push_back(m) ;
+    }
+}
+
+void RsGxsNetService::locked_sendMsgSketch(const RsPeerId& peer,const RsGxsGroupId& grpId,uint32_t createdSinceTS,const std::vector<RsGxsMsgMetaData*>& msgMetas)
+{
+    RsGxsMsgIdSketch sketch(RsGxsMsgIdSketch::numBucketsForSize(msgMetas.size())) ;
+
+    for(std::vector<RsGxsMsgMetaData*>::const_iterator vit = msgMetas.begin();vit != msgMetas.end(); ++vit)
+        sketch.add((*vit)->mMsgId) ;
+
+    RsNxsSyncMsgSketchItem *sitem = new RsNxsSyncMsgSketchItem(mServType) ;
+
+    sitem->flag = RsNxsSyncMsgSketchItem::FLAG_SKETCH ;
+    sitem->grpId = grpId ;
+    sitem->createdSinceTS = createdSinceTS ;
+    sitem->updateTS = mServerMsgUpdateMap[grpId].msgUpdateTS ;
+    sitem->messageCount = msgMetas.size() ;
+    sitem->numBuckets = sketch.numBuckets() ;
+    sitem->bucketHashes = sketch.bucketHashes() ;
+    sitem->PeerId(peer) ;
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,grpId) << "  sending sketch of " << msgMetas.size() << " msg ids in " << sketch.numBuckets() << " buckets instead of the list." << std::endl;
+#endif
+    sendItem(sitem) ;
+}
+
+void RsGxsNetService::handleRecvSyncMsgSketch(RsNxsSyncMsgSketchItem *item)
+{
+    if (!item)
+        return;
+
+    RS_STACK_MUTEX(mNxsMutex) ;
+
+    if(!RsGxsMsgIdSketch::isValidNumBuckets(item->numBuckets))
+    {
+        std::cerr << "(EE) received a msg sketch item with " << item->numBuckets << " buckets from peer " << item->PeerId() << ". Dropping it." << std::endl;
+        return ;
+    }
+
+    if(item->flag & RsNxsSyncMsgSketchItem::FLAG_SKETCH)
+        locked_handleRecvMsgSketch(item) ;
+    else if(item->flag & RsNxsSyncMsgSketchItem::FLAG_REQUEST_BUCKETS)
+        locked_handleRecvMsgBucketsRequest(item) ;
+    else if(item->flag & RsNxsSyncMsgSketchItem::FLAG_UP_TO_DATE)
+    {
+        // The buckets we asked for only hold msgs that the peer does not send. Same as an empty request list in locked_genReqMsgTransaction().
+
+        locked_stampPeerGroupUpdateTime(item->PeerId(),item->grpId,item->updateTS,item->messageCount) ;
+    }
+}
+
+void RsGxsNetService::locked_handleRecvMsgSketch(const RsNxsSyncMsgSketchItem *item)
+{
+    const RsPeerId& peer = item->PeerId() ;
+    const RsGxsGroupId& grpId = item->grpId ;
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,grpId) << "handleRecvMsgSketch(): received sketch of " << item->messageCount << " msg ids in " << item->numBuckets << " buckets." << std::endl;
+#endif
+    if(item->bucketHashes.size() != item->numBuckets)
+    {
+        std::cerr << "(EE) received a msg sketch for group " << grpId << " from peer " << peer << " with " << item->bucketHashes.size() << " hashes for " << item->numBuckets << " buckets. Dropping it." << std::endl;
+        return ;
+    }
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+    grpMetas[grpId] = NULL;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+    RsGxsGrpMetaData* grpMeta = grpMetas[grpId];
+
+    // we only ask for msgs of subscribed groups, so the sketch is not what we asked for.
+
+    if(grpMeta == NULL || !(grpMeta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED))
+        return ;
+
+    // Same as what is done when receiving the list of msg ids in locked_genReqMsgTransaction()
+
+    RsGxsGrpConfig& gnsr(locked_getGrpConfig(grpId));
+
+    std::set<RsPeerId>::size_type oldSuppliersCount = gnsr.suppliers.ids.size();
+    uint32_t oldVisibleCount = gnsr.max_visible_count;
+
+    gnsr.suppliers.ids.insert(peer) ;
+    gnsr.max_visible_count = std::max(gnsr.max_visible_count, item->messageCount) ;
+
+    if (oldVisibleCount != gnsr.max_visible_count || oldSuppliersCount != gnsr.suppliers.ids.size())
+        mNewStatsToNotify.insert(grpId) ;
+
+    // Compute the same sketch over our own msgs, and ask for the msg ids of the buckets that differ. Our msgs are filtered
+    // the way the peer filters the msgs it sends (reputation of the author, sync delay). Otherwise the buckets that hold
+    // msgs the peer does not send would always differ, and we would ask for them at every sync.
+
+    GxsMsgReq reqIds;
+    reqIds[grpId] = std::vector<RsGxsMessageId>();
+    GxsMsgMetaResult result;
+    mDataStore->retrieveGxsMsgMetaData(reqIds, result);
+    std::vector<RsGxsMsgMetaData*>& msgMetaV = result[grpId];
+
+    std::vector<RsGxsMsgMetaData*> selected ;
+    locked_selectMsgsToSend(*grpMeta,item->createdSinceTS,msgMetaV,selected) ;
+
+    RsGxsMsgIdSketch sketch(item->numBuckets) ;
+
+    for(std::vector<RsGxsMsgMetaData*>::const_iterator vit = selected.begin(); vit != selected.end(); ++vit)
+        sketch.add((*vit)->mMsgId) ;
+
+    for(std::vector<RsGxsMsgMetaData*>::const_iterator vit = msgMetaV.begin(); vit != msgMetaV.end(); ++vit)
+        delete *vit ;
+
+    msgMetaV.clear() ;
+
+    RsNxsSyncMsgSketchItem *ritem = new RsNxsSyncMsgSketchItem(mServType) ;
+    sketch.differingBuckets(item->bucketHashes,ritem->buckets) ;
+
+    if(ritem->buckets.empty())
+    {
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG_PG(peer,grpId) << "  all buckets are identical. Group is up to date with this peer." << std::endl;
+#endif
+        delete ritem ;
+        locked_stampPeerGroupUpdateTime(peer,grpId,item->updateTS,item->messageCount) ;
+        return ;
+    }
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,grpId) << "  requesting msg ids of " << ritem->buckets.size() << " differing buckets out of " << item->numBuckets << std::endl;
+#endif
+    ritem->flag = RsNxsSyncMsgSketchItem::FLAG_REQUEST_BUCKETS ;
+    ritem->grpId = grpId ;
+    ritem->createdSinceTS = item->createdSinceTS ;
+    ritem->updateTS = item->updateTS ;
+    ritem->messageCount = item->messageCount ;
+    ritem->numBuckets = item->numBuckets ;
+    ritem->PeerId(peer) ;
+
+    sendItem(ritem) ;
+}
+
+void RsGxsNetService::locked_handleRecvMsgBucketsRequest(const RsNxsSyncMsgSketchItem *item)
+{
+    const RsPeerId& peer = item->PeerId() ;
+    const RsGxsGroupId& grpId = item->grpId ;
+
+#ifdef NXS_NET_DEBUG_0
+    GXSNETDEBUG_PG(peer,grpId) << "handleRecvMsgBucketsRequest(): peer asks for msg ids of " << item->buckets.size() << " buckets." << std::endl;
+#endif
+    // If the group has changed since the sketch was sent, the ids of the requested buckets would not be enough to bring the
+    // peer up to date with the new TS. Drop the request: the peer will ask again with its old TS and get a new sketch.
+
+    ServerMsgMap::const_iterator sit = mServerMsgUpdateMap.find(grpId) ;
+
+    if(sit == mServerMsgUpdateMap.end() || sit->second.msgUpdateTS != item->updateTS)
+    {
+#ifdef NXS_NET_DEBUG_0
+        GXSNETDEBUG_PG(peer,grpId) << "  group has changed since the sketch was sent. Ignoring request." << std::endl;
+#endif
+        return ;
+    }
+
+    RsGxsGrpMetaTemporaryMap grpMetas;
+    grpMetas[grpId] = NULL;
+
+    mDataStore->retrieveGxsGrpMetaData(grpMetas);
+    RsGxsGrpMetaData* grpMeta = grpMetas[grpId];
+
+    // sketches are never sent for circle-restricted groups, since the list of msg ids of these must be encrypted.
+
+    if(grpMeta == NULL || !(grpMeta->mSubscribeFlags & GXS_SERV::GROUP_SUBSCRIBE_SUBSCRIBED) || grpMeta->mCircleType == GXS_CIRCLE_TYPE_EXTERNAL)
+        return ;
+
+    GxsMsgReq req;
+    req[grpId] = std::vector<RsGxsMessageId>();
+
+    GxsMsgMetaResult metaResult;
+    mDataStore->retrieveGxsMsgMetaData(req, metaResult);
+    std::vector<RsGxsMsgMetaData*>& msgMetas = metaResult[grpId];
+
+    RsGxsCircleId should_encrypt_to_this_circle_id ;
+    std::list<RsNxsItem*> itemL;
+    uint32_t transN = locked_getTransactionId();
+
+    if(canSendMsgIds(msgMetas, *grpMeta, peer, should_encrypt_to_this_circle_id) && should_encrypt_to_this_circle_id.isNull())
+    {
+        std::vector<RsGxsMsgMetaData*> toSend ;
+        locked_selectMsgsToSend(*grpMeta,item->createdSinceTS,msgMetas,toSend) ;
+
+        std::vector<bool> requested(item->numBuckets,false) ;
+
+        for(uint32_t i=0;i<item->buckets.size();++i)
+            if(item->buckets[i] < item->numBuckets)
+                requested[item->buckets[i]] = true ;
+
+        for(std::vector<RsGxsMsgMetaData*>::const_iterator vit = toSend.begin();vit != toSend.end(); ++vit)
+        {
+            if(!requested[RsGxsMsgIdSketch::bucketOf((*vit)->mMsgId,item->numBuckets)])
+                continue ;
+
+            RsNxsSyncMsgItem* mItem = new RsNxsSyncMsgItem(mServType);
+            mItem->flag = RsNxsSyncGrpItem::FLAG_RESPONSE;
+            mItem->grpId = (*vit)->mGroupId;
+            mItem->msgId = (*vit)->mMsgId;
+            mItem->authorId = (*vit)->mAuthorId;
+            mItem->PeerId(peer);
+            mItem->transactionNumber = transN;
+
+            itemL.push_back(mItem);
+        }
+
+        if(!itemL.empty())
+        {
+#ifdef NXS_NET_DEBUG_0
+            GXSNETDEBUG_PG(peer,grpId) << "  sending msg info list of " << itemL.size() << " items." << std::endl;
+#endif
+            locked_pushMsgRespFromList(itemL, peer, grpId, transN);
+        }
+        else
+        {
+            RsNxsSyncMsgSketchItem *uitem = new RsNxsSyncMsgSketchItem(mServType) ;
+
+            uitem->flag = RsNxsSyncMsgSketchItem::FLAG_UP_TO_DATE ;
+            uitem->grpId = grpId ;
+            uitem->createdSinceTS = item->createdSinceTS ;
+            uitem->updateTS = item->updateTS ;
+            uitem->messageCount = toSend.size() ;
+            uitem->numBuckets = item->numBuckets ;
+            uitem->PeerId(peer) ;
+
+            sendItem(uitem) ;
+        }
+    }
+
+    for(std::vector<RsGxsMsgMetaData*>::iterator vit = msgMetas.begin(); vit != msgMetas.end(); ++vit)
+        delete *vit;
+}
+
 void RsGxsNetService::locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId& grp_id,const uint32_t& transN)
 {
 #ifdef NXS_NET_DEBUG_1
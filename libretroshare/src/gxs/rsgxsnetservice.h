@@ -353,6 +353,13 @@ private:
      */
     void handleRecvSyncMessage(RsNxsSyncMsgReqItem* item,bool item_was_encrypted);
 
+    /*!
+     * Handles a sketch of the msg ids of a group (client side), or a request for the msg ids
+     * of some buckets of a sketch (server side)
+     * @param item contains the sketch or the list of buckets
+     */
+    void handleRecvSyncMsgSketch(RsNxsSyncMsgSketchItem* item);
+
     /*!
      * Handles an nxs item for group publish key
      * @param item contaims keys/grp info
@@ -393,6 +400,19 @@ private:
     void locked_pushMsgTransactionFromList(std::list<RsNxsItem*>& reqList, const RsPeerId& peerId, const uint32_t& transN);	// forms a msg list request
     void locked_pushGrpRespFromList(std::list<RsNxsItem*>& respList, const RsPeerId& peer, const uint32_t& transN);
     void locked_pushMsgRespFromList(std::list<RsNxsItem*>& itemL, const RsPeerId& sslId, const RsGxsGroupId &grp_id, const uint32_t& transN);
+
+    /*!
+     * Selects the msgs which ids can be sent to friends, according to reputation and publish time. This does not
+     * depend on the friend, so the client side of a sync can make the same selection as the server.
+     */
+    void locked_selectMsgsToSend(const RsGxsGrpMetaData& grpMeta, uint32_t createdSinceTS, const std::vector<RsGxsMsgMetaData*>& msgMetas, std::vector<RsGxsMsgMetaData*>& toSend);
+
+    /*!
+     * Sends a sketch of the given msg ids in place of the list of ids, see RsNxsSyncMsgSketchItem
+     */
+    void locked_sendMsgSketch(const RsPeerId& peer, const RsGxsGroupId& grpId, uint32_t createdSinceTS, const std::vector<RsGxsMsgMetaData*>& msgMetas);
+    void locked_handleRecvMsgSketch(const RsNxsSyncMsgSketchItem* item);
+    void locked_handleRecvMsgBucketsRequest(const RsNxsSyncMsgSketchItem* item);
     
     void syncWithPeers();
     void syncGrpStatistics();
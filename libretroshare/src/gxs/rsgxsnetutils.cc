@@ -313,3 +313,59 @@ int MsgCircleIdsRequestVetting::getType() const
 }
 
 
+
+const uint32_t RsGxsMsgIdSketch::IDS_PER_BUCKET ;
+const uint32_t RsGxsMsgIdSketch::MIN_BUCKETS ;
+const uint32_t RsGxsMsgIdSketch::MAX_BUCKETS ;
+
+RsGxsMsgIdSketch::RsGxsMsgIdSketch(uint32_t num_buckets) : mHashes(num_buckets,0) {}
+
+uint32_t RsGxsMsgIdSketch::numBucketsForSize(uint32_t n_ids)
+{
+	uint32_t n = MIN_BUCKETS ;
+
+	while(n < MAX_BUCKETS && n*IDS_PER_BUCKET < n_ids)
+		n <<= 1 ;
+
+	return n ;
+}
+
+bool RsGxsMsgIdSketch::isValidNumBuckets(uint32_t num_buckets)
+{
+	return num_buckets >= MIN_BUCKETS && num_buckets <= MAX_BUCKETS && (num_buckets & (num_buckets-1)) == 0 ;
+}
+
+uint32_t RsGxsMsgIdSketch::bucketOf(const RsGxsMessageId& id,uint32_t num_buckets)
+{
+	// msg ids are hashes, so their bytes are uniformly distributed. The first 4 bytes select the bucket.
+
+	const unsigned char *b = id.toByteArray() ;
+	uint32_t v = (uint32_t(b[0]) << 24) | (uint32_t(b[1]) << 16) | (uint32_t(b[2]) << 8) | uint32_t(b[3]) ;
+
+	return v & (num_buckets - 1) ;
+}
+
+void RsGxsMsgIdSketch::add(const RsGxsMessageId& id)
+{
+	// ...and the next 8 bytes are XOR-ed into the bucket hash.
+
+	const unsigned char *b = id.toByteArray() ;
+	uint64_t h = 0 ;
+
+	for(int i=4;i<12;++i)
+		h = (h << 8) | b[i] ;
+
+	mHashes[bucketOf(id,mHashes.size())] ^= h ;
+}
+
+void RsGxsMsgIdSketch::differingBuckets(const std::vector<uint64_t>& hashes,std::vector<uint32_t>& buckets) const
+{
+	buckets.clear() ;
+
+	if(hashes.size() != mHashes.size())
+		return ;
+
+	for(uint32_t i=0;i<mHashes.size();++i)
+		if(hashes[i] != mHashes[i])
+			buckets.push_back(i) ;
+}
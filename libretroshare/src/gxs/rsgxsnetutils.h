@@ -289,5 +289,36 @@ public:
 	bool mShouldEncrypt;
 };
 
+/*!
+ * Bucketed hashes of a set of msg ids, exchanged in RsNxsSyncMsgSketchItem. Two peers with the same msg ids
+ * in a bucket get the same hash for it, so comparing sketches tells which buckets hold the ids one of the peers
+ * is missing, and only the ids of these buckets need to be sent.
+ */
+class RsGxsMsgIdSketch
+{
+public:
+	static const uint32_t IDS_PER_BUCKET = 16 ;	// average number of msg ids per bucket
+	static const uint32_t MIN_BUCKETS    = 16 ;
+	static const uint32_t MAX_BUCKETS    = 4096 ;	// 32KB of hashes, whatever the number of msg ids
+
+	RsGxsMsgIdSketch(uint32_t num_buckets) ;
+
+	// Number of buckets to use for a set of the given size. Always a power of 2.
+	static uint32_t numBucketsForSize(uint32_t n_ids) ;
+	static bool isValidNumBuckets(uint32_t num_buckets) ;
+
+	static uint32_t bucketOf(const RsGxsMessageId& id,uint32_t num_buckets) ;
+
+	void add(const RsGxsMessageId& id) ;
+
+	// Fills buckets with the indices of buckets whose hash differs from the ones in hashes.
+	void differingBuckets(const std::vector<uint64_t>& hashes,std::vector<uint32_t>& buckets) const ;
+
+	uint32_t numBuckets() const { return mHashes.size() ; }
+	const std::vector<uint64_t>& bucketHashes() const { return mHashes ; }
+
+private:
+	std::vector<uint64_t> mHashes ;
+};
 
 #endif /* RSGXSNETUTILS_H_ */
@@ -0,0 +1,172 @@
+/*
+ * libretroshare/src/gxs: rsgxsrequestpool.cc
+ *
+ * RetroShare C++ Interface. Threads processing the data requests of GXS services.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <sys/time.h>
+#include <errno.h>
+
+#include <iostream>
+#include <algorithm>
+
+#include "rsgxsrequestpool.h"
+
+/***
+ * #define DEBUG_REQUEST_POOL 1
+ ***/
+
+static const uint32_t REQUEST_POOL_WORKERS   =   2 ;
+static const uint32_t REQUEST_POOL_MAX_WAIT  = 500 ; // ms. Idle workers wake up this often to check for a stop order.
+
+class RsGxsRequestPool::Worker: public RsTickingThread
+{
+public:
+	Worker(RsGxsRequestPool *pool) : mPool(pool) {}
+
+	virtual void data_tick() { mPool->runOne(REQUEST_POOL_MAX_WAIT) ; }
+
+private:
+	RsGxsRequestPool *mPool ;
+};
+
+RsGxsRequestPool& RsGxsRequestPool::instance()
+{
+	static RsGxsRequestPool pool ;
+	return pool ;
+}
+
+RsGxsRequestPool::RsGxsRequestPool()
+{
+	pthread_mutex_init(&mMtx,NULL) ;
+	pthread_cond_init(&mCond,NULL) ;
+
+	for(uint32_t i=0;i<REQUEST_POOL_WORKERS;++i)
+	{
+		Worker *w = new Worker(this) ;
+		w->start("gxs requests") ;
+		mWorkers.push_back(w) ;
+	}
+}
+
+RsGxsRequestPool::~RsGxsRequestPool()
+{
+	for(uint32_t i=0;i<mWorkers.size();++i)
+		mWorkers[i]->shutdown() ;
+
+	pthread_mutex_lock(&mMtx) ;
+	pthread_cond_broadcast(&mCond) ;
+	pthread_mutex_unlock(&mMtx) ;
+
+	for(uint32_t i=0;i<mWorkers.size();++i)
+	{
+		mWorkers[i]->fullstop() ;
+		delete mWorkers[i] ;
+	}
+
+	pthread_cond_destroy(&mCond) ;
+	pthread_mutex_destroy(&mMtx) ;
+}
+
+uint32_t RsGxsRequestPool::workerCount()
+{
+	return mWorkers.size() ;
+}
+
+void RsGxsRequestPool::schedule(RsGxsRequestProcessor *p)
+{
+	pthread_mutex_lock(&mMtx) ;
+
+	if(std::find(mQueue.begin(),mQueue.end(),p) == mQueue.end())
+	{
+		mQueue.push_back(p) ;
+		pthread_cond_broadcast(&mCond) ;
+	}
+
+	pthread_mutex_unlock(&mMtx) ;
+}
+
+void RsGxsRequestPool::unregister(RsGxsRequestProcessor *p)
+{
+	pthread_mutex_lock(&mMtx) ;
+
+	std::deque<RsGxsRequestProcessor*>::iterator it = std::find(mQueue.begin(),mQueue.end(),p) ;
+
+	if(it != mQueue.end())
+		mQueue.erase(it) ;
+
+	while(mRunning.find(p) != mRunning.end())
+		pthread_cond_wait(&mCond,&mMtx) ;
+
+	pthread_mutex_unlock(&mMtx) ;
+}
+
+void RsGxsRequestPool::runOne(uint32_t max_wait_ms)
+{
+	struct timeval now ;
+	gettimeofday(&now,NULL) ;
+
+	uint64_t deadline_us = (uint64_t)now.tv_sec*1000000 + now.tv_usec + (uint64_t)max_wait_ms*1000 ;
+
+	struct timespec deadline ;
+	deadline.tv_sec  = deadline_us / 1000000 ;
+	deadline.tv_nsec = (deadline_us % 1000000) * 1000 ;
+
+	RsGxsRequestProcessor *p = NULL ;
+
+	pthread_mutex_lock(&mMtx) ;
+
+	while(p == NULL)
+	{
+		// a processor that is being processed by another thread is left in the queue, so that the new
+		// requests it got in the meantime are processed afterwards.
+
+		for(std::deque<RsGxsRequestProcessor*>::iterator it(mQueue.begin());it!=mQueue.end();++it)
+			if(mRunning.find(*it) == mRunning.end())
+			{
+				p = *it ;
+				mQueue.erase(it) ;
+				break ;
+			}
+
+		if(p == NULL && pthread_cond_timedwait(&mCond,&mMtx,&deadline) == ETIMEDOUT)
+			break ;
+	}
+
+	if(p != NULL)
+		mRunning.insert(p) ;
+
+	pthread_mutex_unlock(&mMtx) ;
+
+	if(p == NULL)
+		return ;
+
+#ifdef DEBUG_REQUEST_POOL
+	std::cerr << "RsGxsRequestPool: processing requests of " << (void*)p << std::endl;
+#endif
+	p->processPendingRequests() ;
+
+	pthread_mutex_lock(&mMtx) ;
+	mRunning.erase(p) ;
+	pthread_cond_broadcast(&mCond) ;	// wakes up unregister(), and workers waiting for p to be free
+	pthread_mutex_unlock(&mMtx) ;
+}
@@ -0,0 +1,89 @@
+/*
+ * libretroshare/src/gxs: rsgxsrequestpool.h
+ *
+ * RetroShare C++ Interface. Threads processing the data requests of GXS services.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#ifndef RSGXSREQUESTPOOL_H
+#define RSGXSREQUESTPOOL_H
+
+#include <pthread.h>
+
+#include <vector>
+#include <deque>
+#include <set>
+
+#include "util/rsthreads.h"
+
+/*!
+ * Anything that has pending requests to process, typically a GXS service.
+ * processPendingRequests() is never called by two threads of the pool at once for the same processor.
+ */
+class RsGxsRequestProcessor
+{
+public:
+	virtual ~RsGxsRequestProcessor() {}
+	virtual void processPendingRequests() = 0 ;
+};
+
+/*!
+ * Pool of threads shared by all GXS services, that processes requests as soon as they are made, instead of
+ * waiting for the next tick of the service. Idle threads sleep until work is scheduled.
+ */
+class RsGxsRequestPool
+{
+public:
+	static RsGxsRequestPool& instance() ;
+
+	/*!
+	 * Wakes up a thread to call p->processPendingRequests(). Does nothing if p is already waiting for a thread.
+	 */
+	void schedule(RsGxsRequestProcessor *p) ;
+
+	/*!
+	 * Removes p from the pool, waiting for a thread that might be processing it. Must be called before p
+	 * is deleted.
+	 */
+	void unregister(RsGxsRequestProcessor *p) ;
+
+	uint32_t workerCount() ;
+
+private:
+	class Worker ;
+	friend class Worker ;
+
+	RsGxsRequestPool() ;
+	~RsGxsRequestPool() ;
+
+	// Waits for a processor to be scheduled, for at most the given time, and processes it.
+	void runOne(uint32_t max_wait_ms) ;
+
+	// pthread primitives are used directly, since the pool threads need to sleep until woken up.
+	pthread_mutex_t mMtx ;
+	pthread_cond_t mCond ;
+
+	std::deque<RsGxsRequestProcessor*> mQueue ;
+	std::set<RsGxsRequestProcessor*> mRunning ;	// processors currently processed by a thread
+	std::vector<Worker*> mWorkers ;
+};
+
+#endif // RSGXSREQUESTPOOL_H
@@ -43,6 +43,9 @@ struct GxsRequest
 	RsTokReqOptions Options;
 
 	uint32_t status;
+
+	// number of msgs per group passing the options of a msg request, before paging
+	std::map<RsGxsGroupId, uint32_t> mMsgTotalCounts;
 };
 
 class GroupMetaReq : public GxsRequest
@@ -0,0 +1,213 @@
+/*
+ * libretroshare/src/gxs: rsgxsvalidationpool.cc
+ *
+ * RetroShare C++ Interface. Thread pool checking signatures of incoming GXS data.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <unistd.h>
+
+#ifdef WINDOWS_SYS
+#include <windows.h>
+#endif
+
+#include <iostream>
+#include <algorithm>
+
+#include "rsgxsvalidationpool.h"
+
+/***
+ * #define DEBUG_VALIDATION_POOL 1
+ ***/
+
+static const uint32_t VALIDATION_MAX_DEFAULT_WORKERS =    4 ;
+static const uint32_t VALIDATION_WORKER_MIN_SLEEP    =    5 ; // ms
+static const uint32_t VALIDATION_WORKER_MAX_SLEEP    =  250 ; // ms
+static const double   VALIDATION_WORKER_RELAX        =  2.0 ;
+static const uint32_t VALIDATION_RATE_PERIOD         =   10 ; // seconds over which the validation rate is measured
+static const uint32_t VALIDATION_WAIT_SLEEP          =  500 ; // us, while the jobs of a runJobs() call are finished by the workers
+
+static uint32_t numberOfCores()
+{
+#ifdef WINDOWS_SYS
+	SYSTEM_INFO info ;
+	GetSystemInfo(&info) ;
+	return info.dwNumberOfProcessors ;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN) ;
+	return (n > 0)?n:1 ;
+#endif
+}
+
+class RsGxsValidationPool::Worker: public RsQueueThread
+{
+public:
+	Worker(RsGxsValidationPool *pool)
+	    : RsQueueThread(VALIDATION_WORKER_MIN_SLEEP,VALIDATION_WORKER_MAX_SLEEP,VALIDATION_WORKER_RELAX), mPool(pool) {}
+
+protected:
+	virtual bool workQueued() { return !mPool->queueIsEmpty() ; }
+	virtual bool doWork() { return mPool->runOneJob() ; }
+
+private:
+	RsGxsValidationPool *mPool ;
+};
+
+RsGxsValidationPool& RsGxsValidationPool::instance()
+{
+	static RsGxsValidationPool pool ;
+	return pool ;
+}
+
+RsGxsValidationPool::RsGxsValidationPool()
+    : mPoolMtx("RsGxsValidationPool"),mJobsDone(0),mRateJobs(0),mRateStart(time(NULL)),mRate(0.0f)
+{
+	// The service threads also validate, so leave one core for them.
+
+	uint32_t n = numberOfCores() ;
+	setWorkerCount(std::min(VALIDATION_MAX_DEFAULT_WORKERS,(n > 1)?(n-1):1)) ;
+}
+
+RsGxsValidationPool::~RsGxsValidationPool()
+{
+	setWorkerCount(0) ;
+}
+
+void RsGxsValidationPool::setWorkerCount(uint32_t n)
+{
+	std::vector<Worker*> to_stop ;
+
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		while(mWorkers.size() < n)
+		{
+			Worker *w = new Worker(this) ;
+			w->start("gxs validation") ;
+			mWorkers.push_back(w) ;
+		}
+		while(mWorkers.size() > n)
+		{
+			to_stop.push_back(mWorkers.back()) ;
+			mWorkers.pop_back() ;
+		}
+	}
+
+	// Workers need the mutex to finish their current job, so they are stopped off-mutex.
+
+	for(uint32_t i=0;i<to_stop.size();++i)
+	{
+		to_stop[i]->fullstop() ;
+		delete to_stop[i] ;
+	}
+#ifdef DEBUG_VALIDATION_POOL
+	std::cerr << "RsGxsValidationPool: now using " << n << " worker threads." << std::endl;
+#endif
+}
+
+uint32_t RsGxsValidationPool::workerCount()
+{
+	RS_STACK_MUTEX(mPoolMtx) ;
+	return mWorkers.size() ;
+}
+
+bool RsGxsValidationPool::queueIsEmpty()
+{
+	RS_STACK_MUTEX(mPoolMtx) ;
+	return mQueue.empty() ;
+}
+
+bool RsGxsValidationPool::runOneJob()
+{
+	QueuedJob qj ;
+
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		if(mQueue.empty())
+			return false ;
+
+		qj = mQueue.front() ;
+		mQueue.pop_front() ;
+	}
+
+	qj.job->run() ;
+
+	RS_STACK_MUTEX(mPoolMtx) ;
+
+	--*qj.remaining ;
+	++mJobsDone ;
+	++mRateJobs ;
+
+	return true ;
+}
+
+void RsGxsValidationPool::runJobs(const std::vector<RsGxsValidationJob*>& jobs)
+{
+	uint32_t remaining = jobs.size() ;
+
+	{
+		RS_STACK_MUTEX(mPoolMtx) ;
+
+		for(uint32_t i=0;i<jobs.size();++i)
+		{
+			QueuedJob qj ;
+			qj.job = jobs[i] ;
+			qj.remaining = &remaining ;
+
+			mQueue.push_back(qj) ;
+		}
+	}
+
+	// Help the workers until the queue is empty, then wait for the jobs they are still running.
+
+	while(runOneJob()) ;
+
+	while(true)
+	{
+		{
+			RS_STACK_MUTEX(mPoolMtx) ;
+
+			if(remaining == 0)
+				return ;
+		}
+		usleep(VALIDATION_WAIT_SLEEP) ;
+	}
+}
+
+void RsGxsValidationPool::getStatistics(RsGxsValidationStatistics& stats)
+{
+	RS_STACK_MUTEX(mPoolMtx) ;
+
+	time_t now = time(NULL) ;
+
+	if(now >= mRateStart + (time_t)VALIDATION_RATE_PERIOD)
+	{
+		mRate = mRateJobs / (float)(now - mRateStart) ;
+		mRateJobs = 0 ;
+		mRateStart = now ;
+	}
+
+	stats.workers = mWorkers.size() ;
+	stats.queueDepth = mQueue.size() ;
+	stats.jobsDone = mJobsDone ;
+	stats.jobsPerSecond = mRate ;
+}
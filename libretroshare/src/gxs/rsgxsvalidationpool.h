@@ -0,0 +1,95 @@
+/*
+ * libretroshare/src/gxs: rsgxsvalidationpool.h
+ *
+ * RetroShare C++ Interface. Thread pool checking signatures of incoming GXS data.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#ifndef RSGXSVALIDATIONPOOL_H
+#define RSGXSVALIDATIONPOOL_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <vector>
+#include <deque>
+
+#include "util/rsthreads.h"
+#include "retroshare/rsgxsifacetypes.h"
+
+/*!
+ * Unit of work of the validation pool. run() can be called by any thread of the pool, so it should only
+ * touch data that is owned by the job.
+ */
+class RsGxsValidationJob
+{
+public:
+	virtual ~RsGxsValidationJob() {}
+	virtual void run() = 0 ;
+};
+
+/*!
+ * Pool of threads that run the signature checks of the msgs and groups received by all GXS services. The
+ * service thread that submits the jobs also runs them, so validation still goes on with no worker.
+ */
+class RsGxsValidationPool
+{
+public:
+	static RsGxsValidationPool& instance() ;
+
+	void setWorkerCount(uint32_t n) ;
+	uint32_t workerCount() ;
+
+	/*!
+	 * Runs all jobs, in any order, and returns when they are all done. Can be called by several threads at once.
+	 */
+	void runJobs(const std::vector<RsGxsValidationJob*>& jobs) ;
+
+	// fills the pool part of the statistics
+	void getStatistics(RsGxsValidationStatistics& stats) ;
+
+private:
+	class Worker ;
+	friend class Worker ;
+
+	struct QueuedJob
+	{
+		RsGxsValidationJob *job ;
+		uint32_t *remaining ;		// jobs of the same runJobs() call that are not done yet
+	};
+
+	RsGxsValidationPool() ;
+	~RsGxsValidationPool() ;
+
+	bool queueIsEmpty() ;
+	bool runOneJob() ;				// runs the next job of the queue, if any. Returns false if the queue was empty.
+
+	RsMutex mPoolMtx ;
+	std::deque<QueuedJob> mQueue ;
+	std::vector<Worker*> mWorkers ;
+
+	uint64_t mJobsDone ;
+	uint64_t mRateJobs ;			// jobs done since mRateStart
+	time_t   mRateStart ;
+	float    mRate ;
+};
+
+#endif // RSGXSVALIDATIONPOOL_H
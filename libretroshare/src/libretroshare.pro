@@ -380,6 +380,7 @@ HEADERS +=	ft/ftchunkmap.h \
 			ft/ftdatamultiplex.h \
 			ft/ftextralist.h \
 			ft/ftfilecreator.h \
+			ft/ftfileio.h \
 			ft/ftfileprovider.h \
 			ft/ftfilesearch.h \
 			ft/ftsearch.h \
@@ -421,6 +422,7 @@ HEADERS +=	pqi/authssl.h \
 			pqi/pqihandler.h \
 			pqi/pqihash.h \
 			pqi/p3historymgr.h \
+			pqi/historystore.h \
 			pqi/pqiindic.h \
 			pqi/pqiipset.h \
 			pqi/pqilistener.h \
@@ -549,6 +551,7 @@ SOURCES +=	ft/ftchunkmap.cc \
 			ft/ftdatamultiplex.cc \
 			ft/ftextralist.cc \
 			ft/ftfilecreator.cc \
+			ft/ftfileio.cc \
 			ft/ftfileprovider.cc \
 			ft/ftfilesearch.cc \
 			ft/ftserver.cc \
@@ -579,6 +582,7 @@ SOURCES +=	pqi/authgpg.cc \
 			pqi/pqibin.cc \
 			pqi/pqihandler.cc \
 			pqi/p3historymgr.cc \
+			pqi/historystore.cc \
 			pqi/pqiipset.cc \
 			pqi/pqiloopback.cc \
 			pqi/pqimonitor.cc \
@@ -757,6 +761,8 @@ HEADERS += rsitems/rsnxsitems.h \
 	gxs/rsgxsifacehelper.h \
 	gxs/gxstokenqueue.h \
 	gxs/rsgxsnetutils.h \
+	gxs/rsgxsvalidationpool.h \
+	gxs/rsgxsrequestpool.h \
 	gxs/rsgxsiface.h \
 	gxs/rsgxsrequesttypes.h
 
@@ -774,6 +780,8 @@ SOURCES += rsitems/rsnxsitems.cc \
 	gxs/gxssecurity.cc \
 	gxs/gxstokenqueue.cc \
 	gxs/rsgxsnetutils.cc \
+	gxs/rsgxsvalidationpool.cc \
+	gxs/rsgxsrequestpool.cc \
 	gxs/rsgxsutil.cc \
 	gxs/rsgxsrequesttypes.cc
 
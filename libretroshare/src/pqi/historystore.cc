@@ -0,0 +1,573 @@
+/*
+ * libretroshare/src/pqi: historystore.cc
+ *
+ * 3P/PQI network interface for RetroShare.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <set>
+
+#include "pqi/historystore.h"
+#include "rsitems/rshistoryitems.h"
+#include "crypto/chacha20.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/folderiterator.h"
+#include "util/rsdir.h"
+#include "util/rsmemory.h"
+#include "util/rsrandom.h"
+#include "util/rsstring.h"
+
+/****
+ * #define HISTORY_STORE_DEBUG 1
+ ***/
+
+static const uint32_t HISTORY_SEGMENT_MAX_SIZE     = 64*1024 ;	// start a new segment after this many bytes...
+static const uint32_t HISTORY_SEGMENT_MAX_RECORDS  = 256 ;		// ...or this many messages.
+
+static const uint32_t HISTORY_RECORD_SIZE_FIELD    =  4 ;
+static const uint32_t HISTORY_RECORD_NONCE_SIZE    = 12 ;
+static const uint32_t HISTORY_RECORD_TAG_SIZE      = 16 ;
+static const uint32_t HISTORY_RECORD_MAX_SIZE      = 1024*1024 ;	// anything larger is a corrupted record
+
+static const std::string HISTORY_SEGMENT_EXTENSION = ".hst" ;
+
+// additional data of the AEAD: the nonce, followed by the chat id.
+
+static void historyRecordAAD(const unsigned char *nonce,const RsPeerId& chat_id,unsigned char *aad)
+{
+	memcpy(aad,nonce,HISTORY_RECORD_NONCE_SIZE) ;
+	memcpy(aad+HISTORY_RECORD_NONCE_SIZE,chat_id.toByteArray(),RsPeerId::SIZE_IN_BYTES) ;
+}
+
+HistoryStore::HistoryStore(const std::string& directory)
+	: mDirectory(directory), mDirectoryScanned(false), mHasKey(false), mNextMsgId(1)
+{
+	memset(mKey,0,KEY_SIZE) ;
+}
+
+void HistoryStore::setKey(const uint8_t key[KEY_SIZE])
+{
+	memcpy(mKey,key,KEY_SIZE) ;
+	mHasKey = true ;
+
+	// prefixes depend on the key
+
+	mChats.clear() ;
+	mMsgIdToPrefix.clear() ;
+	mDirectoryScanned = false ;
+}
+
+bool HistoryStore::getKey(uint8_t key[KEY_SIZE]) const
+{
+	if(!mHasKey)
+		return false ;
+
+	memcpy(key,mKey,KEY_SIZE) ;
+	return true ;
+}
+
+std::string HistoryStore::chatPrefix(const RsPeerId& chat_id) const
+{
+	unsigned char buf[KEY_SIZE + RsPeerId::SIZE_IN_BYTES] ;
+
+	memcpy(buf,mKey,KEY_SIZE) ;
+	memcpy(buf+KEY_SIZE,chat_id.toByteArray(),RsPeerId::SIZE_IN_BYTES) ;
+
+	return RsDirUtil::sha1sum(buf,sizeof(buf)).toStdString() ;
+}
+
+std::string HistoryStore::segmentPath(const std::string& prefix,uint32_t number) const
+{
+	std::string name ;
+	rs_sprintf(name,"%s_%08x",prefix.c_str(),number) ;
+
+	return RsDirUtil::makePath(mDirectory,name + HISTORY_SEGMENT_EXTENSION) ;
+}
+
+void HistoryStore::locked_scanDirectory()
+{
+	if(mDirectoryScanned)
+		return ;
+
+	mDirectoryScanned = true ;
+
+	if(!RsDirUtil::checkCreateDirectory(mDirectory))
+	{
+		std::cerr << "(EE) HistoryStore: cannot create directory " << mDirectory << std::endl;
+		return ;
+	}
+
+	// the segment files are named [40 hex chars]_[8 hex chars].hst
+
+	for(librs::util::FolderIterator it(mDirectory,false);it.isValid();it.next())
+	{
+		const std::string& name(it.file_name()) ;
+		uint32_t number ;
+
+		if(it.file_type() != librs::util::FolderIterator::TYPE_FILE || name.length() != 40+1+8+HISTORY_SEGMENT_EXTENSION.length() || name[40] != '_'
+		        || name.substr(49) != HISTORY_SEGMENT_EXTENSION || sscanf(name.substr(41,8).c_str(),"%x",&number) != 1)
+			continue ;
+
+		Segment& seg(mChats[name.substr(0,40)].segments[number]) ;
+
+		seg.number = number ;
+		seg.size = it.file_size() ;
+		seg.modtime = it.file_modtime() ;
+	}
+#ifdef HISTORY_STORE_DEBUG
+	std::cerr << "HistoryStore: found " << mChats.size() << " chats in " << mDirectory << std::endl;
+#endif
+}
+
+bool HistoryStore::locked_indexSegment(const std::string& prefix,Segment& seg)
+{
+	std::string fname = segmentPath(prefix,seg.number) ;
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(),"rb") ;
+
+	if(f == NULL)
+	{
+		std::cerr << "(EE) HistoryStore: cannot open " << fname << std::endl;
+		return false ;
+	}
+
+	seg.records.clear() ;
+
+	uint32_t offset = 0 ;
+	unsigned char size_field[HISTORY_RECORD_SIZE_FIELD] ;
+
+	while(fread(size_field,1,HISTORY_RECORD_SIZE_FIELD,f) == HISTORY_RECORD_SIZE_FIELD)
+	{
+		uint32_t size = 0 ;
+		uint32_t field_offset = 0 ;
+		getRawUInt32(size_field,HISTORY_RECORD_SIZE_FIELD,&field_offset,&size) ;
+
+		if(size < HISTORY_RECORD_NONCE_SIZE + HISTORY_RECORD_TAG_SIZE || size > HISTORY_RECORD_MAX_SIZE || offset + HISTORY_RECORD_SIZE_FIELD + size > seg.size)
+			break ;
+
+		Record rec ;
+		rec.offset = offset ;
+		rec.size = HISTORY_RECORD_SIZE_FIELD + size ;
+		rec.msg_id = mNextMsgId++ ;
+
+		seg.records.push_back(rec) ;
+		mMsgIdToPrefix[rec.msg_id] = prefix ;
+
+		offset += rec.size ;
+
+		if(fseek(f,offset,SEEK_SET) != 0)
+			break ;
+	}
+	fclose(f) ;
+
+	// A record may have been partly written when the program stopped. Drop it, so that the next records are
+	// appended where they should.
+
+	if(offset < seg.size)
+	{
+		std::cerr << "(WW) HistoryStore: dropping " << seg.size - offset << " trailing bytes from " << fname << std::endl;
+
+		if(truncate(fname.c_str(),offset) == 0)
+			seg.size = offset ;
+	}
+	return true ;
+}
+
+bool HistoryStore::locked_indexChat(const std::string& prefix,const RsPeerId& chat_id,ChatSegments& chat)
+{
+	if(chat.indexed)
+		return true ;
+
+	chat.chat_id = chat_id ;
+
+	for(std::map<uint32_t,Segment>::iterator it(chat.segments.begin());it!=chat.segments.end();++it)
+		locked_indexSegment(prefix,it->second) ;
+
+	chat.indexed = true ;
+	return true ;
+}
+
+void HistoryStore::locked_removeSegment(const std::string& prefix,ChatSegments& chat,std::map<uint32_t,Segment>::iterator& it)
+{
+#ifdef HISTORY_STORE_DEBUG
+	std::cerr << "HistoryStore: removing segment " << segmentPath(prefix,it->first) << std::endl;
+#endif
+	for(uint32_t i=0;i<it->second.records.size();++i)
+		mMsgIdToPrefix.erase(it->second.records[i].msg_id) ;
+
+	RsDirUtil::removeFile(segmentPath(prefix,it->first)) ;
+
+	std::map<uint32_t,Segment>::iterator tmp(it) ;
+	++tmp ;
+	chat.segments.erase(it) ;
+	it = tmp ;
+}
+
+bool HistoryStore::addMessage(RsHistoryMsgItem *item)
+{
+	if(!mHasKey)
+		return false ;
+
+	locked_scanDirectory() ;
+
+	std::string prefix = chatPrefix(item->chatPeerId) ;
+	ChatSegments& chat(mChats[prefix]) ;
+
+	locked_indexChat(prefix,item->chatPeerId,chat) ;
+
+	// serialise and encrypt
+
+	RsHistorySerialiser serial ;
+	uint32_t item_size = serial.size(item) ;
+	uint32_t record_size = HISTORY_RECORD_SIZE_FIELD + HISTORY_RECORD_NONCE_SIZE + HISTORY_RECORD_TAG_SIZE + item_size ;
+
+	RsTemporaryMemory mem(record_size) ;
+
+	if(!mem)
+		return false ;
+
+	unsigned char *nonce = mem + HISTORY_RECORD_SIZE_FIELD ;
+	unsigned char *tag   = nonce + HISTORY_RECORD_NONCE_SIZE ;
+	unsigned char *data  = tag + HISTORY_RECORD_TAG_SIZE ;
+
+	uint32_t offset = 0 ;
+	setRawUInt32(mem,HISTORY_RECORD_SIZE_FIELD,&offset,record_size - HISTORY_RECORD_SIZE_FIELD) ;
+
+	if(!serial.serialise(item,data,&item_size))
+	{
+		std::cerr << "(EE) HistoryStore: cannot serialise history item." << std::endl;
+		return false ;
+	}
+	RSRandom::random_bytes(nonce,HISTORY_RECORD_NONCE_SIZE) ;
+
+	unsigned char aad[HISTORY_RECORD_NONCE_SIZE + RsPeerId::SIZE_IN_BYTES] ;
+	historyRecordAAD(nonce,item->chatPeerId,aad) ;
+
+	librs::crypto::AEAD_chacha20_poly1305(mKey,nonce,data,item_size,aad,sizeof(aad),tag,true) ;
+
+	// append to the last segment, or start a new one
+
+	if(chat.segments.empty() || chat.segments.rbegin()->second.size >= HISTORY_SEGMENT_MAX_SIZE || chat.segments.rbegin()->second.records.size() >= HISTORY_SEGMENT_MAX_RECORDS)
+	{
+		uint32_t number = chat.segments.empty()? 0 : (chat.segments.rbegin()->first + 1) ;
+
+		Segment& seg(chat.segments[number]) ;
+		seg.number = number ;
+		seg.size = 0 ;
+		seg.modtime = 0 ;
+	}
+	Segment& seg(chat.segments.rbegin()->second) ;
+
+	std::string fname = segmentPath(prefix,seg.number) ;
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(),"ab") ;
+
+	if(f == NULL)
+	{
+		std::cerr << "(EE) HistoryStore: cannot open " << fname << " for writing." << std::endl;
+		return false ;
+	}
+	bool ok = (fwrite(mem,1,record_size,f) == record_size) ;
+
+	if(fclose(f) != 0 || !ok)
+	{
+		std::cerr << "(EE) HistoryStore: cannot write to " << fname << ". Disc full?" << std::endl;
+
+		if(truncate(fname.c_str(),seg.size) != 0)	// do not leave a partial record behind
+			std::cerr << "(EE) HistoryStore: cannot truncate " << fname << std::endl;
+		return false ;
+	}
+
+	Record rec ;
+	rec.offset = seg.size ;
+	rec.size = record_size ;
+	rec.msg_id = mNextMsgId++ ;
+
+	seg.records.push_back(rec) ;
+	seg.size += record_size ;
+	seg.modtime = time(NULL) ;
+
+	mMsgIdToPrefix[rec.msg_id] = prefix ;
+	item->msgId = rec.msg_id ;
+
+	return true ;
+}
+
+RsHistoryMsgItem *HistoryStore::locked_readRecord(const std::string& prefix,const ChatSegments& chat,const Segment& seg,const Record& rec)
+{
+	std::string fname = segmentPath(prefix,seg.number) ;
+	FILE *f = RsDirUtil::rs_fopen(fname.c_str(),"rb") ;
+
+	if(f == NULL)
+	{
+		std::cerr << "(EE) HistoryStore: cannot open " << fname << std::endl;
+		return NULL ;
+	}
+	RsTemporaryMemory mem(rec.size) ;
+
+	bool ok = mem && fseek(f,rec.offset,SEEK_SET) == 0 && fread(mem,1,rec.size,f) == rec.size ;
+	fclose(f) ;
+
+	if(!ok)
+	{
+		std::cerr << "(EE) HistoryStore: cannot read record at offset " << rec.offset << " in " << fname << std::endl;
+		return NULL ;
+	}
+
+	unsigned char *nonce = mem + HISTORY_RECORD_SIZE_FIELD ;
+	unsigned char *tag   = nonce + HISTORY_RECORD_NONCE_SIZE ;
+	unsigned char *data  = tag + HISTORY_RECORD_TAG_SIZE ;
+	uint32_t data_size   = rec.size - (data - (unsigned char*)mem) ;
+
+	unsigned char aad[HISTORY_RECORD_NONCE_SIZE + RsPeerId::SIZE_IN_BYTES] ;
+	historyRecordAAD(nonce,chat.chat_id,aad) ;
+
+	if(!librs::crypto::AEAD_chacha20_poly1305(mKey,nonce,data,data_size,aad,sizeof(aad),tag,false))
+	{
+		std::cerr << "(EE) HistoryStore: authentication failed for record at offset " << rec.offset << " in " << fname << std::endl;
+		return NULL ;
+	}
+
+	RsItem *item = RsHistorySerialiser().deserialise(data,&data_size) ;
+	RsHistoryMsgItem *hitem = dynamic_cast<RsHistoryMsgItem*>(item) ;
+
+	if(hitem == NULL)
+	{
+		std::cerr << "(EE) HistoryStore: cannot deserialise record at offset " << rec.offset << " in " << fname << std::endl;
+		delete item ;
+		return NULL ;
+	}
+	hitem->msgId = rec.msg_id ;
+
+	return hitem ;
+}
+
+bool HistoryStore::getMessages(const RsPeerId& chat_id,uint32_t count,std::list<RsHistoryMsgItem*>& items)
+{
+	items.clear() ;
+
+	if(!mHasKey)
+		return false ;
+
+	locked_scanDirectory() ;
+
+	std::string prefix = chatPrefix(chat_id) ;
+	std::map<std::string,ChatSegments>::iterator cit = mChats.find(prefix) ;
+
+	if(cit == mChats.end())
+		return true ;
+
+	locked_indexChat(prefix,chat_id,cit->second) ;
+
+	// only read the tail we need, from the last segment backwards.
+
+	for(std::map<uint32_t,Segment>::reverse_iterator it(cit->second.segments.rbegin());it!=cit->second.segments.rend();++it)
+		for(uint32_t i=it->second.records.size();i>0;--i)
+		{
+			if(count > 0 && items.size() >= count)
+				return true ;
+
+			RsHistoryMsgItem *item = locked_readRecord(prefix,cit->second,it->second,it->second.records[i-1]) ;
+
+			if(item != NULL)
+				items.push_front(item) ;
+		}
+
+	return true ;
+}
+
+RsHistoryMsgItem *HistoryStore::getMessage(uint32_t msg_id)
+{
+	std::map<uint32_t,std::string>::const_iterator pit = mMsgIdToPrefix.find(msg_id) ;
+
+	if(pit == mMsgIdToPrefix.end())
+		return NULL ;
+
+	ChatSegments& chat(mChats[pit->second]) ;
+
+	for(std::map<uint32_t,Segment>::const_iterator it(chat.segments.begin());it!=chat.segments.end();++it)
+		for(uint32_t i=0;i<it->second.records.size();++i)
+			if(it->second.records[i].msg_id == msg_id)
+				return locked_readRecord(pit->second,chat,it->second,it->second.records[i]) ;
+
+	return NULL ;
+}
+
+void HistoryStore::removeMessages(const std::list<uint32_t>& msg_ids,std::list<uint32_t>& removed_ids)
+{
+	// collect the segments to rewrite
+
+	std::map<std::string,std::map<uint32_t,std::set<uint32_t> > > to_remove ;
+
+	for(std::list<uint32_t>::const_iterator it(msg_ids.begin());it!=msg_ids.end();++it)
+	{
+		std::map<uint32_t,std::string>::const_iterator pit = mMsgIdToPrefix.find(*it) ;
+
+		if(pit == mMsgIdToPrefix.end())
+			continue ;
+
+		ChatSegments& chat(mChats[pit->second]) ;
+
+		for(std::map<uint32_t,Segment>::const_iterator sit(chat.segments.begin());sit!=chat.segments.end();++sit)
+			for(uint32_t i=0;i<sit->second.records.size();++i)
+				if(sit->second.records[i].msg_id == *it)
+					to_remove[pit->second][sit->first].insert(*it) ;
+	}
+
+	for(std::map<std::string,std::map<uint32_t,std::set<uint32_t> > >::const_iterator cit(to_remove.begin());cit!=to_remove.end();++cit)
+	{
+		ChatSegments& chat(mChats[cit->first]) ;
+
+		for(std::map<uint32_t,std::set<uint32_t> >::const_iterator sit(cit->second.begin());sit!=cit->second.end();++sit)
+		{
+			Segment& seg(chat.segments[sit->first]) ;
+			std::string fname = segmentPath(cit->first,seg.number) ;
+
+			// records are copied as they are: no need to decrypt them.
+
+			FILE *fin  = RsDirUtil::rs_fopen(fname.c_str(),"rb") ;
+			FILE *fout = RsDirUtil::rs_fopen((fname+".tmp").c_str(),"wb") ;
+			bool ok = (fin != NULL && fout != NULL) ;
+
+			std::vector<Record> kept ;
+			uint32_t new_size = 0 ;
+
+			for(uint32_t i=0;ok && i<seg.records.size();++i)
+			{
+				const Record& rec(seg.records[i]) ;
+
+				if(sit->second.find(rec.msg_id) != sit->second.end())
+					continue ;
+
+				RsTemporaryMemory mem(rec.size) ;
+
+				ok = mem && fseek(fin,rec.offset,SEEK_SET) == 0 && fread(mem,1,rec.size,fin) == rec.size && fwrite(mem,1,rec.size,fout) == rec.size ;
+
+				kept.push_back(rec) ;
+				kept.back().offset = new_size ;
+				new_size += rec.size ;
+			}
+			if(fin != NULL) fclose(fin) ;
+			if(fout != NULL && fclose(fout) != 0) ok = false ;
+
+			if(!ok || !RsDirUtil::renameFile(fname+".tmp",fname))
+			{
+				std::cerr << "(EE) HistoryStore: cannot rewrite " << fname << std::endl;
+				RsDirUtil::removeFile(fname+".tmp") ;
+				continue ;
+			}
+
+			for(std::set<uint32_t>::const_iterator it(sit->second.begin());it!=sit->second.end();++it)
+			{
+				mMsgIdToPrefix.erase(*it) ;
+				removed_ids.push_back(*it) ;
+			}
+			seg.records = kept ;
+			seg.size = new_size ;
+		}
+	}
+}
+
+bool HistoryStore::clear(const RsPeerId& chat_id)
+{
+	if(!mHasKey)
+		return false ;
+
+	locked_scanDirectory() ;
+
+	std::string prefix = chatPrefix(chat_id) ;
+	std::map<std::string,ChatSegments>::iterator cit = mChats.find(prefix) ;
+
+	if(cit == mChats.end())
+		return false ;
+
+	for(std::map<uint32_t,Segment>::iterator it(cit->second.segments.begin());it!=cit->second.segments.end();)
+		locked_removeSegment(prefix,cit->second,it) ;
+
+	mChats.erase(cit) ;
+	return true ;
+}
+
+bool HistoryStore::limitMessages(const RsPeerId& chat_id,uint32_t max_count)
+{
+	if(!mHasKey)
+		return false ;
+
+	locked_scanDirectory() ;
+
+	std::string prefix = chatPrefix(chat_id) ;
+	std::map<std::string,ChatSegments>::iterator cit = mChats.find(prefix) ;
+
+	if(cit == mChats.end())
+		return false ;
+
+	ChatSegments& chat(cit->second) ;
+	locked_indexChat(prefix,chat_id,chat) ;
+
+	uint32_t total = 0 ;
+	for(std::map<uint32_t,Segment>::const_iterator it(chat.segments.begin());it!=chat.segments.end();++it)
+		total += it->second.records.size() ;
+
+	bool changed = false ;
+
+	for(std::map<uint32_t,Segment>::iterator it(chat.segments.begin());it!=chat.segments.end() && total - it->second.records.size() >= max_count;)
+	{
+		total -= it->second.records.size() ;
+		locked_removeSegment(prefix,chat,it) ;
+		changed = true ;
+	}
+	return changed ;
+}
+
+bool HistoryStore::removeOldSegments(uint32_t max_age)
+{
+	locked_scanDirectory() ;
+
+	time_t now = time(NULL) ;
+	bool changed = false ;
+
+	for(std::map<std::string,ChatSegments>::iterator cit(mChats.begin());cit!=mChats.end();)
+	{
+		for(std::map<uint32_t,Segment>::iterator it(cit->second.segments.begin());it!=cit->second.segments.end();)
+			if(it->second.modtime + (time_t)max_age < now)
+			{
+				locked_removeSegment(cit->first,cit->second,it) ;
+				changed = true ;
+			}
+			else
+				++it ;
+
+		if(cit->second.segments.empty())
+		{
+			std::map<std::string,ChatSegments>::iterator tmp(cit) ;
+			++tmp ;
+			mChats.erase(cit) ;
+			cit = tmp ;
+		}
+		else
+			++cit ;
+	}
+	return changed ;
+}
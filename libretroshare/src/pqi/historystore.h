@@ -0,0 +1,125 @@
+/*
+ * libretroshare/src/pqi: historystore.h
+ *
+ * 3P/PQI network interface for RetroShare.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+
+#include "retroshare/rstypes.h"
+
+class RsHistoryMsgItem;
+
+// Stores the chat history on disc, in append-only segment files. Each chat has its own segments, and each message
+// is encrypted on its own, so that adding a message only writes that message and never rewrites what is already
+// there.
+//
+// Segment files are named after a hash of the chat id and of the key, followed by the segment number, so that
+// chat ids do not show on disc. A record is made of:
+//
+//    [4 bytes: size of what follows] [12 bytes: nonce] [16 bytes: tag] [encrypted serialised RsHistoryMsgItem]
+//
+// The nonce and the chat id are authenticated along with the message, so that records cannot be moved to the
+// segments of another chat.
+//
+// The segments of a chat are indexed the first time the chat is used, by only reading the record sizes. Messages
+// are decrypted when asked for. Old messages are removed by deleting whole segments.
+//
+// This class is not thread safe. p3HistoryMgr protects it with its own mutex.
+
+class HistoryStore
+{
+public:
+	static const uint32_t KEY_SIZE = 32 ;
+
+	HistoryStore(const std::string& directory) ;
+
+	void setKey(const uint8_t key[KEY_SIZE]) ;
+	bool getKey(uint8_t key[KEY_SIZE]) const ;
+	bool hasKey() const { return mHasKey ; }
+
+	// Appends a message to the history of item->chatPeerId. Sets item->msgId.
+	bool addMessage(RsHistoryMsgItem *item) ;
+
+	// Gets the last count messages of the chat (all of them if count is 0), oldest first. Items are allocated.
+	bool getMessages(const RsPeerId& chat_id,uint32_t count,std::list<RsHistoryMsgItem*>& items) ;
+	RsHistoryMsgItem *getMessage(uint32_t msg_id) ;
+
+	// Removes the given messages. This rewrites the segments they are in.
+	void removeMessages(const std::list<uint32_t>& msg_ids,std::list<uint32_t>& removed_ids) ;
+
+	// Removes all messages of a chat.
+	bool clear(const RsPeerId& chat_id) ;
+
+	// Removes the oldest segments of a chat, as long as at least max_count messages remain after them.
+	bool limitMessages(const RsPeerId& chat_id,uint32_t max_count) ;
+
+	// Removes the segments, of all chats, which last message has been written more than max_age seconds ago.
+	bool removeOldSegments(uint32_t max_age) ;
+
+private:
+	struct Record
+	{
+		uint32_t offset ;
+		uint32_t size ;
+		uint32_t msg_id ;
+	};
+	struct Segment
+	{
+		uint32_t number ;
+		uint32_t size ;
+		time_t   modtime ;
+		std::vector<Record> records ;
+	};
+	struct ChatSegments
+	{
+		ChatSegments() : indexed(false) {}
+
+		bool indexed ;
+		RsPeerId chat_id ;	// known once indexed
+		std::map<uint32_t,Segment> segments ;	// by segment number, so oldest first
+	};
+
+	void locked_scanDirectory() ;
+	bool locked_indexChat(const std::string& prefix,const RsPeerId& chat_id,ChatSegments& chat) ;
+	bool locked_indexSegment(const std::string& prefix,Segment& seg) ;
+	void locked_removeSegment(const std::string& prefix,ChatSegments& chat,std::map<uint32_t,Segment>::iterator& it) ;
+	RsHistoryMsgItem *locked_readRecord(const std::string& prefix,const ChatSegments& chat,const Segment& seg,const Record& rec) ;
+
+	std::string chatPrefix(const RsPeerId& chat_id) const ;
+	std::string segmentPath(const std::string& prefix,uint32_t number) const ;
+
+	std::string mDirectory ;
+	bool mDirectoryScanned ;
+
+	uint8_t mKey[KEY_SIZE] ;
+	bool mHasKey ;
+
+	std::map<std::string,ChatSegments> mChats ;			// by file prefix
+	std::map<uint32_t,std::string> mMsgIdToPrefix ;		// for the indexed chats only
+	uint32_t mNextMsgId ;
+};
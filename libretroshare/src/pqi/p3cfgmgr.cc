@@ -34,6 +34,8 @@
 #include <rsserver/p3face.h>
 #include <util/rsdiscspace.h>
 #include "util/rsstring.h"
+#include "util/rsmemory.h"
+#include "serialiser/rsbaseserial.h"
 
 #include "rsitems/rsconfigitems.h"
 
@@ -42,6 +44,12 @@
 */
 #define BACKEDUP_SAVE
 
+static const time_t CONFIG_SAVE_QUIET_DELAY = 5 ;	// a change is saved once no other change came for this long...
+static const time_t CONFIG_SAVE_MAX_DELAY   = 30 ;	// ...but never waits longer than this.
+
+static const uint64_t CONFIG_JOURNAL_MIN_MERGE_SIZE = 64*1024 ;	// the journal is merged into the config file when bigger than both
+static const uint32_t CONFIG_JOURNAL_MAX_SIGN_SIZE  = 4096 ;
+
 
 p3ConfigMgr::p3ConfigMgr(std::string dir)
         :basedir(dir), cfgMtx("p3ConfigMgr"),
@@ -51,39 +59,20 @@ p3ConfigMgr::p3ConfigMgr(std::string dir)
 
 void	p3ConfigMgr::tick()
 {
-	bool toSave = false;
-
       {
 	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
 
-	/* iterate through and check if any have changed */
-	std::list<pqiConfig *>::iterator it;
-	for(it = mConfigs.begin(); it != mConfigs.end(); ++it)
-	{
-		if ((*it)->HasConfigChanged(0))
-		{
-
-#ifdef CONFIG_DEBUG
-			std::cerr << "p3ConfigMgr::tick() Config Changed - Element: ";
-			std::cerr << it->first;
-			std::cerr << std::endl;
-#endif
-
-			toSave = true;
-		}
-	}
-
 	/* disable saving before exit */
 	if (!mConfigSaveActive)
 	{
-		toSave = false;
+		return;
 	}
       }
 
-	if (toSave)
-	{
-		saveConfiguration();
-	}
+	if(!RsDiscSpace::checkForDiscSpace(RS_CONFIG_DIRECTORY))
+		return ;
+
+	saveConfig(false);
 }
 
 
@@ -92,31 +81,42 @@ void	p3ConfigMgr::saveConfiguration()
 	if(!RsDiscSpace::checkForDiscSpace(RS_CONFIG_DIRECTORY))
 		return ;
 
-	saveConfig();
+	saveConfig(true);
 
 
 }
 
-void p3ConfigMgr::saveConfig()
+void p3ConfigMgr::saveConfig(bool force)
 {
 
 	bool ok= true;
+	time_t now = time(NULL);
 
 	RsStackMutex stack(cfgMtx);  /***** LOCK STACK MUTEX ****/
 
+	/* only the configs that changed are saved, and only what changed when they can tell */
 	std::list<pqiConfig *>::iterator it;
 	for(it = mConfigs.begin(); it != mConfigs.end(); ++it)
 	{
-		if ((*it)->HasConfigChanged(1))
+		switch((*it)->checkSaveNeeded(now, force))
 		{
+		case CONFIG_SAVE_FULL:
 #ifdef CONFIG_DEBUG
-			std::cerr << "p3ConfigMgr::globalSaveConfig() Saving Element: ";
-			std::cerr << it->first;
-			std::cerr << std::endl;
+			std::cerr << "p3ConfigMgr::saveConfig() Saving Element: " << (*it)->Filename() << std::endl;
 #endif
 			ok &= (*it)->saveConfiguration();
+			break;
+
+		case CONFIG_SAVE_DELTA:
+#ifdef CONFIG_DEBUG
+			std::cerr << "p3ConfigMgr::saveConfig() Saving changes of Element: " << (*it)->Filename() << std::endl;
+#endif
+			ok &= (*it)->saveConfigurationDelta();
+			break;
+
+		default:
+			break;
 		}
-		/* save metaconfig */
 	}
 	return;
 }
@@ -144,8 +144,7 @@ void p3ConfigMgr::loadConfig()
 		(*cit)->loadConfiguration(dummyHash);
 
 		/* force config to NOT CHANGED */
-		(*cit)->HasConfigChanged(0);
-		(*cit)->HasConfigChanged(1);
+		(*cit)->checkSaveNeeded(0, true);
 	}
 
 	return;
@@ -202,7 +201,7 @@ void    p3ConfigMgr::completeConfiguration()
 
 
 p3Config::p3Config()
-	:pqiConfig()
+	:pqiConfig(), mConfigFileSize(0), mJournalSize(0), mJournalBroken(false)
 {
 	return;
 }
@@ -246,6 +245,16 @@ bool p3Config::loadConfig()
 		pass = false;
 
 		load.clear();
+
+		// the journal goes with the config file. It will be dropped at next save.
+		mJournalBroken = true;
+	}
+	else
+	{
+		RsDirUtil::checkFile(cfgFname, mConfigFileSize);
+
+		// changes saved after the config file
+		loadJournal(load);
 	}
 
 	// try 2nd attempt with backup files if first failed
@@ -331,11 +340,45 @@ bool p3Config::saveConfiguration()
 		return saveConfig();
 }
 
+bool p3Config::saveConfigurationDelta()
+{
+	std::list<RsItem *> toSave;
+	bool written = saveDeltaList(toSave) && !mJournalBroken;
+
+	if(written && !toSave.empty())
+		written = appendJournal(toSave);
+
+	for(std::list<RsItem *>::iterator it = toSave.begin(); it != toSave.end(); ++it)
+		delete *it;
+
+	if(!written)
+		return saveConfig();
+
+	// merge the journal into the config file, so that loading does not replay an ever growing journal.
+	if(mJournalSize > std::max(CONFIG_JOURNAL_MIN_MERGE_SIZE, mConfigFileSize))
+	{
+#ifdef CONFIG_DEBUG
+		std::cerr << "p3Config::saveConfigurationDelta() Merging journal of " << Filename() << ": " << mJournalSize << " bytes" << std::endl;
+#endif
+		return saveConfig();
+	}
+
+	return true;
+}
+
 bool p3Config::saveConfig()
 {
 
 	bool cleanup = true;
 	std::list<RsItem *> toSave;
+
+	// changes waiting for the journal are saved along with the rest.
+	saveDeltaList(toSave);
+
+	for(std::list<RsItem *>::iterator it = toSave.begin(); it != toSave.end(); ++it)
+		delete *it;
+
+	toSave.clear();
 	saveList(cleanup, toSave);
 
 	// temporarily append new to files as these will replace current configuration
@@ -364,12 +407,25 @@ bool p3Config::saveConfig()
 	if(!written)
 		std::cerr << "(EE) Error while writing config file " << Filename() << ": file dropped!!" << std::endl;
 
-	/* store the hash */
+	/* store the hash. The previous one stays if the new file cannot be put in place. */
+	RsFileHash previousHash(Hash());
 	setHash(cfg_bio->gethash());
 
 	// bio is taken care of in stream's destructor, also forces file to close
 	delete stream;
 
+	if(!written)
+	{
+		// the current file, and its journal, stay rather than a partly written file.
+		saveDone();
+
+		RsDirUtil::removeFile(newCfgFname);
+		setHash(previousHash);
+
+		IndicateConfigChanged();	// what changed is not in the journal either: try again later
+		return false;
+	}
+
 	/* sign data */
 	std::string signature;
 	RsFileHash strHash(Hash());
@@ -385,7 +441,7 @@ bool p3Config::saveConfig()
 
     // now rewrite current files to temp files
 	// rename back-up to current file
-	if(!RsDirUtil::renameFile(cfgFname, tmpCfgFname)  || !RsDirUtil::renameFile(signFname, tmpSignFname)){
+	if(RsDirUtil::fileExists(cfgFname) && (!RsDirUtil::renameFile(cfgFname, tmpCfgFname)  || !RsDirUtil::renameFile(signFname, tmpSignFname))){
 #ifdef CONFIG_DEBUG
 		std::cerr << "p3Config::backedUpFileSave() Failed to rename backup meta files: " << std::endl
 				<< cfgFname << " to " << tmpCfgFname << std::endl
@@ -398,7 +454,9 @@ bool p3Config::saveConfig()
 
 	// now rewrite current files to temp files
 	// rename back-up to current file
-	if(!RsDirUtil::renameFile(newCfgFname, cfgFname)  || !RsDirUtil::renameFile(newSignFname, signFname)){
+	bool inPlace = RsDirUtil::renameFile(newCfgFname, cfgFname);
+
+	if(!inPlace  || !RsDirUtil::renameFile(newSignFname, signFname)){
 	#ifdef CONFIG_DEBUG
 				std::cerr << "p3Config::() Failed to rename meta files: " << std::endl
 						<< newCfgFname << " to " << cfgFname << std::endl
@@ -412,10 +470,220 @@ bool p3Config::saveConfig()
 
 	saveDone(); // callback to inherited class to unlock any Mutexes protecting saveList() data
 
+	if(!inPlace)
+	{
+		// the previous file is still the configuration, along with its journal.
+		if(!RsDirUtil::fileExists(cfgFname))
+		{
+			RsDirUtil::renameFile(tmpCfgFname, cfgFname);
+			RsDirUtil::renameFile(tmpSignFname, signFname);
+		}
+		RsDirUtil::removeFile(newCfgFname);
+		RsDirUtil::removeFile(newSignFname);
+
+		setHash(previousHash);
+
+		IndicateConfigChanged();
+		return false;
+	}
+
+	// the journal was written against the previous file.
+	uint64_t jnlSize = 0;
+	std::string jnlFname = Filename() + ".jnl";
+
+	if(RsDirUtil::checkFile(jnlFname, jnlSize))
+		RsDirUtil::removeFile(jnlFname);
+
+	mJournalSize = 0;
+	mJournalBroken = false;
+	RsDirUtil::checkFile(cfgFname, mConfigFileSize);
+
 	return written;
 
 }
 
+/* The journal of a config file is a list of records, appended at each save of what changed:
+ *
+ *    [4 bytes: size of encrypted data] [4 bytes: size of signature] [encrypted data] [signature]
+ *
+ * Data is encrypted with our own key, like the config file, and is made of the hash of the config file it goes
+ * with, followed by the serialised items. The signature is the signature of the hash of the encrypted data.
+ * Records written against another config file, which may be left behind when saving is interrupted, are skipped.
+ */
+bool p3Config::appendJournal(const std::list<RsItem *>& items)
+{
+	RsSerialiser *rss = setupSerialiser();
+	RsFileHash configHash(Hash());
+
+	uint32_t size = RsFileHash::SIZE_IN_BYTES;
+
+	for(std::list<RsItem *>::const_iterator it = items.begin(); it != items.end(); ++it)
+		size += rss->size(*it);
+
+	RsTemporaryMemory data(size);
+	uint32_t offset = RsFileHash::SIZE_IN_BYTES;
+
+	memcpy(data, configHash.toByteArray(), RsFileHash::SIZE_IN_BYTES);
+
+	for(std::list<RsItem *>::const_iterator it = items.begin(); it != items.end(); ++it)
+	{
+		uint32_t item_size = size - offset;
+
+		if(rss->serialise(*it, &data[offset], &item_size))
+			offset += item_size;
+		else
+			std::cerr << "(EE) p3Config::appendJournal(): One item did not serialize. Dropping the item." << std::endl;
+	}
+	delete rss;
+
+	void *encrypted_data = NULL;
+	int encrypted_size = 0;
+
+	if(!AuthSSL::getAuthSSL()->encrypt(encrypted_data, encrypted_size, data, offset, AuthSSL::getAuthSSL()->OwnId()) || encrypted_data == NULL)
+	{
+		std::cerr << "(EE) p3Config::appendJournal(): cannot encrypt changes of " << Filename() << std::endl;
+		return false;
+	}
+
+	std::string signature;
+	RsFileHash encryptedHash = RsDirUtil::sha1sum((unsigned char *)encrypted_data, encrypted_size);
+	AuthSSL::getAuthSSL()->SignData(encryptedHash.toByteArray(), RsFileHash::SIZE_IN_BYTES, signature);
+
+	unsigned char header[8];
+	uint32_t header_offset = 0;
+	setRawUInt32(header, 8, &header_offset, encrypted_size);
+	setRawUInt32(header, 8, &header_offset, signature.length());
+
+	std::string jnlFname = Filename() + ".jnl";
+	FILE *f = RsDirUtil::rs_fopen(jnlFname.c_str(), "ab");
+	bool written = (f != NULL);
+
+	if(written)
+	{
+		written = (fwrite(header, 1, 8, f) == 8)
+		        && (fwrite(encrypted_data, 1, encrypted_size, f) == (size_t)encrypted_size)
+		        && (fwrite(signature.c_str(), 1, signature.length(), f) == signature.length());
+		written = (fclose(f) == 0) && written;
+	}
+	free(encrypted_data);
+
+	if(!written)
+	{
+		std::cerr << "(EE) p3Config::appendJournal(): cannot write " << jnlFname << std::endl;
+		mJournalBroken = true;	// a partly written record cannot be followed by other ones
+		return false;
+	}
+
+	mJournalSize += 8 + encrypted_size + signature.length();
+	return true;
+}
+
+bool p3Config::loadJournal(std::list<RsItem *>& load)
+{
+	std::string jnlFname = Filename() + ".jnl";
+	uint64_t file_size = 0;
+
+	mJournalSize = 0;
+	mJournalBroken = false;
+
+	if(!RsDirUtil::checkFile(jnlFname, file_size, true))
+		return true;	// nothing changed since the config file was written
+
+	FILE *f = RsDirUtil::rs_fopen(jnlFname.c_str(), "rb");
+
+	if(f == NULL)
+	{
+		mJournalBroken = true;
+		return false;
+	}
+
+	mJournalSize = file_size;
+
+	RsSerialiser *rss = setupSerialiser();
+	RsFileHash configHash(Hash());
+	unsigned char header[8];
+	uint32_t nb_items = 0;
+
+	while(!mJournalBroken && fread(header, 1, 8, f) == 8)
+	{
+		uint32_t header_offset = 0;
+		uint32_t encrypted_size = 0;
+		uint32_t signature_size = 0;
+
+		getRawUInt32(header, 8, &header_offset, &encrypted_size);
+		getRawUInt32(header, 8, &header_offset, &signature_size);
+
+		if(encrypted_size == 0 || encrypted_size > file_size || signature_size > CONFIG_JOURNAL_MAX_SIGN_SIZE)
+		{
+			mJournalBroken = true;
+			break;
+		}
+
+		RsTemporaryMemory encrypted_data(encrypted_size);
+		std::string signature(signature_size, '\0');
+
+		if(fread(encrypted_data, 1, encrypted_size, f) != encrypted_size || (signature_size > 0 && fread(&signature[0], 1, signature_size, f) != signature_size))
+		{
+			mJournalBroken = true;	// the last record was not completely written
+			break;
+		}
+
+		std::string signatureRead;
+		RsFileHash encryptedHash = RsDirUtil::sha1sum(encrypted_data, encrypted_size);
+		AuthSSL::getAuthSSL()->SignData(encryptedHash.toByteArray(), RsFileHash::SIZE_IN_BYTES, signatureRead);
+
+		void *data = NULL;
+		int size = 0;
+
+		if(signatureRead != signature || !AuthSSL::getAuthSSL()->decrypt(data, size, encrypted_data, encrypted_size) || data == NULL)
+		{
+			mJournalBroken = true;
+			break;
+		}
+
+		if(size >= (int)RsFileHash::SIZE_IN_BYTES && RsFileHash((unsigned char *)data) == configHash)
+		{
+			uint32_t offset = RsFileHash::SIZE_IN_BYTES;
+
+			while(offset < (uint32_t)size)
+			{
+				uint32_t item_size = getRsItemSize((unsigned char *)data + offset);
+				uint32_t read_size = item_size;
+
+				if(item_size < 8 || item_size > size - offset)
+				{
+					mJournalBroken = true;
+					break;
+				}
+
+				RsItem *item = rss->deserialise((unsigned char *)data + offset, &read_size);
+
+				if(item != NULL)
+				{
+					load.push_back(item);
+					++nb_items;
+				}
+				else
+					std::cerr << "(WW) p3Config::loadJournal(): skipping unknown item in " << jnlFname << std::endl;
+
+				offset += item_size;
+			}
+		}
+		free(data);
+	}
+
+	fclose(f);
+	delete rss;
+
+#ifdef CONFIG_DEBUG
+	std::cerr << "p3Config::loadJournal() " << jnlFname << ": " << nb_items << " items" << (mJournalBroken ? ", broken" : "") << std::endl;
+#endif
+	if(mJournalBroken)
+		std::cerr << "(WW) p3Config::loadJournal(): " << jnlFname << " is damaged. Changes after the damaged part are lost." << std::endl;
+
+	return !mJournalBroken;
+}
+
 
 /**************************** CONFIGURATION CLASSES ********************/
 
@@ -465,9 +733,10 @@ void            p3GeneralConfig::setSetting(const std::string &opt, const std::s
 		}
 
 		settings[opt] = val;
+		changedSettings.insert(opt);
 	}
 	/* outside mutex */
-	IndicateConfigChanged();
+	IndicateConfigDeltaChanged();
 
 	return;
 }
@@ -518,6 +787,31 @@ bool p3GeneralConfig::saveList(bool &cleanup, std::list<RsItem *>& savelist)
 }
 
 
+bool p3GeneralConfig::saveDeltaList(std::list<RsItem *>& savelist)
+{
+	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+
+	if (changedSettings.empty())
+	{
+		return true;
+	}
+
+	/* settings loaded later replace the earlier ones */
+	RsConfigKeyValueSet *item = new RsConfigKeyValueSet();
+	std::set<std::string>::iterator it;
+	for(it = changedSettings.begin(); it != changedSettings.end(); ++it)
+	{
+		RsTlvKeyValue kv;
+		kv.key = *it;
+		kv.value = settings[*it];
+		item->tlvkvs.pairs.push_back(kv);
+	}
+	changedSettings.clear();
+
+	savelist.push_back(item);
+	return true;
+}
+
 bool    p3GeneralConfig::loadList(std::list<RsItem *>& load)
 {
 #ifdef CONFIG_DEBUG
@@ -559,7 +853,7 @@ bool    p3GeneralConfig::loadList(std::list<RsItem *>& load)
  */
 
 pqiConfig::pqiConfig()
-	: cfgMtx("pqiConfig"), ConfInd(2)
+	: cfgMtx("pqiConfig"), mSaveNeeded(CONFIG_SAVE_FULL), mFirstChangeTS(0), mLastChangeTS(0)
 {
 	return;
 }
@@ -584,13 +878,45 @@ const RsFileHash& pqiConfig::Hash()
 void	pqiConfig::IndicateConfigChanged()
 {
 	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
-	ConfInd.IndicateChanged();
+
+	time_t now = time(NULL);
+
+	if (mSaveNeeded == CONFIG_SAVE_NONE)
+		mFirstChangeTS = now;
+
+	mLastChangeTS = now;
+	mSaveNeeded = CONFIG_SAVE_FULL;
 }
 
-bool	pqiConfig::HasConfigChanged(uint16_t idx)
+void	pqiConfig::IndicateConfigDeltaChanged()
 {
 	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
-	return  ConfInd.Changed(idx);
+
+	time_t now = time(NULL);
+
+	if (mSaveNeeded == CONFIG_SAVE_NONE)
+	{
+		mFirstChangeTS = now;
+		mSaveNeeded = CONFIG_SAVE_DELTA;
+	}
+	mLastChangeTS = now;
+}
+
+uint32_t pqiConfig::checkSaveNeeded(time_t now, bool force)
+{
+	RsStackMutex stack(cfgMtx); /***** LOCK STACK MUTEX ****/
+
+	if (mSaveNeeded == CONFIG_SAVE_NONE)
+		return CONFIG_SAVE_NONE;
+
+	/* wait for changes to come to an end. Also save if the clock went backwards. */
+	if (!force && mLastChangeTS <= now && mLastChangeTS + CONFIG_SAVE_QUIET_DELAY > now && mFirstChangeTS + CONFIG_SAVE_MAX_DELAY > now)
+		return CONFIG_SAVE_NONE;
+
+	uint32_t save = mSaveNeeded;
+	mSaveNeeded = CONFIG_SAVE_NONE;
+
+	return save;
 }
 
 void    pqiConfig::setFilename(const std::string& name)
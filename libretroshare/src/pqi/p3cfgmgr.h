@@ -66,6 +66,11 @@
 
 class p3ConfigMgr;
 
+/* what pqiConfig::checkSaveNeeded() asks for */
+static const uint32_t CONFIG_SAVE_NONE  = 0x00 ;
+static const uint32_t CONFIG_SAVE_DELTA = 0x01 ;	// only the journal needs to be written
+static const uint32_t CONFIG_SAVE_FULL  = 0x02 ;
+
 
 
 //! abstract class for configuration saving
@@ -108,8 +113,29 @@ const RsFileHash& Hash();
  * Checks if configuration has changed
  */
 virtual void	IndicateConfigChanged();
+
+/**
+ * Indicates that only a few things changed in the configuration, which saveConfigurationDelta() can
+ * save without rewriting all of it.
+ */
+void	IndicateConfigDeltaChanged();
+
+/**
+ * saves what changed since the last save. Default is to save the whole configuration.
+ */
+virtual bool	saveConfigurationDelta() { return saveConfiguration(); }
+
 void	setHash(const RsFileHash& h);
 
+	/**
+	 * Tells if the configuration should be saved now, and how. A change is saved once no other change
+	 * came for a few seconds, or once it is old enough, so that bursts of changes are saved at once.
+	 * The indication is cleared when a save is returned.
+	 * @param force save whatever changed, without waiting
+	 * @return one of CONFIG_SAVE_NONE, CONFIG_SAVE_DELTA, CONFIG_SAVE_FULL
+	 */
+	uint32_t checkSaveNeeded(time_t now, bool force);
+
 	RsMutex cfgMtx;
 
 	private:
@@ -119,19 +145,16 @@ void	setHash(const RsFileHash& h);
 	 */
 	void    setFilename(const std::string& name);
 
-	/**
-	 * @param an index for the Confind which contains list of configuarations that can be tracked
-	 */
-	bool    HasConfigChanged(uint16_t idx);
-
-	Indicator ConfInd;
+	uint32_t mSaveNeeded;
+	time_t mFirstChangeTS;
+	time_t mLastChangeTS;
 
 	std::string filename;
 	RsFileHash hash;
 
 	friend class p3ConfigMgr;
 	/* so it can access:
-	 * setFilename() and HasConfigChanged()
+	 * setFilename()
 	 */
 };
 
@@ -160,8 +183,7 @@ class p3ConfigMgr
         void	tick();
 
         /**
-         * save all added configuation including configuration files
-         * creates global signature file
+         * save all changed configurations now
          */
         void	saveConfiguration();
 
@@ -187,8 +209,9 @@ class p3ConfigMgr
 
 		/**
 		 * saves configuration of pqiconfigs in object configs
+		 * @param force saves all changes now, rather than waiting for changes to come to an end
 		 */
-		void saveConfig();
+		void saveConfig(bool force);
 
 		/**
 		 *
@@ -248,6 +271,17 @@ protected:
 	 */
 	virtual void saveDone() {}
 
+	/**
+	 * lists the items that changed since the last call, after IndicateConfigDeltaChanged() has been
+	 * called. They are appended to the journal of the config file rather than rewriting it, and given
+	 * back to loadList() after the items of the config file, so later items must replace earlier ones.
+	 * The journal is merged into the config file when it grows too big.
+	 * @return false if changes cannot be listed: the whole configuration is saved then.
+	 */
+	virtual bool saveDeltaList(std::list<RsItem *>&) { return false; }
+
+	virtual bool saveConfigurationDelta();
+
 private:
 
 	bool loadConfig();
@@ -255,6 +289,13 @@ private:
 
 	bool loadAttempt( const std::string&, const std::string&,
 	                  std::list<RsItem *>& load );
+
+	bool loadJournal(std::list<RsItem *>& load);
+	bool appendJournal(const std::list<RsItem *>& items);
+
+	uint64_t mConfigFileSize;
+	uint64_t mJournalSize;
+	bool mJournalBroken;
 }; // end of p3Config
 
 
@@ -273,11 +314,13 @@ void 		setSetting(const std::string &opt, const std::string &val);
 virtual RsSerialiser *setupSerialiser();
 virtual bool saveList(bool &cleanup, std::list<RsItem* >&);
 virtual bool	loadList(std::list<RsItem *>& );
+virtual bool	saveDeltaList(std::list<RsItem *>& );
 
 	private:
 
 	/* protected by pqiConfig mutex as well! */
 std::map<std::string, std::string> settings;
+std::set<std::string> changedSettings;
 
 
 };
@@ -25,6 +25,8 @@
 
 #include <time.h>
 
+#include <set>
+
 #include "p3historymgr.h"
 #include "rsitems/rshistoryitems.h"
 #include "rsitems/rsconfigitems.h"
@@ -32,6 +34,8 @@
 #include "retroshare/rspeers.h"
 #include "rsitems/rsmsgitems.h"
 #include "rsserver/p3face.h"
+#include "util/rsprint.h"
+#include "util/rsrandom.h"
 #include "util/rsstring.h"
 
 /****
@@ -44,11 +48,9 @@
 
 RsHistory *rsHistory = NULL;
 
-p3HistoryMgr::p3HistoryMgr()
-	: p3Config(), mHistoryMtx("p3HistoryMgr")
+p3HistoryMgr::p3HistoryMgr(const std::string& history_directory)
+	: p3Config(), mStore(history_directory), mStoreKeySaved(false), mHistoryMtx("p3HistoryMgr")
 {
-	nextMsgId = 1;
-
 	mPublicEnable = false;
 	mPrivateEnable = true;
 	mLobbyEnable = true;
@@ -63,6 +65,10 @@ p3HistoryMgr::p3HistoryMgr()
 
 p3HistoryMgr::~p3HistoryMgr()
 {
+	std::list<RsHistoryMsgItem*>::iterator it;
+	for (it = mOldMsgItems.begin(); it != mOldMsgItems.end(); ++it) {
+		delete (*it);
+	}
 }
 
 /***** p3HistoryMgr *****/
@@ -80,6 +86,8 @@ void p3HistoryMgr::addMessage(const ChatMessage& cm)
 		mLastCleanTime = now ;
 	}
 
+	checkStoreKey() ;
+
 	{
 		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
@@ -128,38 +136,19 @@ void p3HistoryMgr::addMessage(const ChatMessage& cm)
         item->message = cm.msg ;
 		//librs::util::ConvertUtf16ToUtf8(chatItem->message, item->message);
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(item->chatPeerId);
-		if (mit != mMessages.end()) {
-			item->msgId = nextMsgId++;
-			mit->second.insert(std::make_pair(item->msgId, item));
+		// only this message is written. Nothing else in the history is touched.
+
+		if (locked_checkStore() && mStore.addMessage(item)) {
 			addMsgId = item->msgId;
 
 			// check the limit
-			uint32_t limit;
-			if (chatPeerId.isNull()) 
-				limit = mPublicSaveCount;
-            else if (cm.chat_id.isLobbyId())
-				limit = mLobbySaveCount;
-			else 
-				limit = mPrivateSaveCount;
+			uint32_t limit = locked_saveCount(cm.chat_id);
 
 			if (limit) {
-				while (mit->second.size() > limit) {
-					delete(mit->second.begin()->second);
-					mit->second.erase(mit->second.begin());
-				}
+				mStore.limitMessages(chatPeerId, limit);
 			}
-		} else {
-			std::map<uint32_t, RsHistoryMsgItem*> msgs;
-			item->msgId = nextMsgId++;
-			msgs.insert(std::make_pair(item->msgId, item));
-			mMessages.insert(std::make_pair(item->chatPeerId, msgs));
-			addMsgId = item->msgId;
-
-			// no need to check the limit
 		}
-
-		IndicateConfigChanged();
+		delete item;
 	}
 
 	if (addMsgId) {
@@ -174,51 +163,10 @@ void p3HistoryMgr::cleanOldMessages()
 #ifdef HISTMGR_DEBUG
 	std::cerr << "****** cleaning old messages." << std::endl;
 #endif
-	time_t now = time(NULL) ;
-	bool changed = false ;
+	// whole segments go at once. Segments are small enough for this not to keep messages much longer than asked for.
 
-	for(std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.begin(); mit != mMessages.end();) 
-	{
-		if (mMaxStorageDurationSeconds > 0)
-		{
-			for(std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.begin();lit!=mit->second.end();)
-				if(lit->second->recvTime + mMaxStorageDurationSeconds < now)
-				{
-					std::map<uint32_t, RsHistoryMsgItem*>::iterator lit2 = lit ;
-					++lit2 ;
-
-#ifdef HISTMGR_DEBUG
-					std::cerr << "   removing msg id " << lit->first << ", for peer id " << mit->first << std::endl;
-#endif
-					delete lit->second ;
-
-					mit->second.erase(lit) ;
-					lit = lit2 ;
-
-					changed = true ;
-				}
-				else
-					++lit ;
-		}
-
-		if(mit->second.empty())
-		{
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit2 = mit ;
-			++mit2 ;
-#ifdef HISTMGR_DEBUG
-			std::cerr << "   removing peer id " << mit->first << ", since it has no messages" << std::endl;
-#endif
-			mMessages.erase(mit) ;
-			mit = mit2 ;
-
-			changed = true ;
-		}
-		else
-			++mit ;
-	}
-
-	if(changed)
-		IndicateConfigChanged() ;
+	if (mMaxStorageDurationSeconds > 0 && locked_checkStore())
+		mStore.removeOldSegments(mMaxStorageDurationSeconds) ;
 }
 
 /***** p3Config *****/
@@ -238,19 +186,20 @@ bool p3HistoryMgr::saveList(bool& cleanup, std::list<RsItem*>& saveData)
 
 	mHistoryMtx.lock(); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			if (lit->second->saveToDisc) {
-				saveData.push_back(lit->second);
-			}
-		}
-	}
+	// messages of old config files are kept there until they are in the store.
+	saveData.insert(saveData.end(), mOldMsgItems.begin(), mOldMsgItems.end());
 
 	RsConfigKeyValueSet *vitem = new RsConfigKeyValueSet;
 
 	RsTlvKeyValue kv;
+
+	uint8_t key[HistoryStore::KEY_SIZE];
+	if (mStore.getKey(key)) {
+		kv.key = "STORE_KEY";
+		kv.value = RsUtil::BinToHex(key, HistoryStore::KEY_SIZE);
+		vitem->tlvkvs.pairs.push_back(kv);
+	}
+
 	kv.key = "PUBLIC_ENABLE";
 	kv.value = mPublicEnable ? "TRUE" : "FALSE";
 	vitem->tlvkvs.pairs.push_back(kv);
@@ -310,23 +259,10 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
    	 {
 		if (NULL != (msgItem = dynamic_cast<RsHistoryMsgItem*>(*it))) {
 
-			std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(msgItem->chatPeerId);
-			msgItem->msgId = nextMsgId++;
-
-#ifdef HISTMGR_DEBUG
-			std::cerr << "Loading msg history item: peer id=" << msgItem->chatPeerId << "), msg id =" << msgItem->msgId  << std::endl;
-#endif
-
-			if (mit != mMessages.end()) {
-				mit->second.insert(std::make_pair(msgItem->msgId, msgItem));
-			} else {
-				std::map<uint32_t, RsHistoryMsgItem*> msgs;
-				msgs.insert(std::make_pair(msgItem->msgId, msgItem));
-				mMessages.insert(std::make_pair(msgItem->chatPeerId, msgs));
-			}
-
-			// don't delete the item !!
+			// Messages used to be saved in the config file. They are moved to the store on first use, and the
+			// config is saved again then. Changes made while loading are not saved.
 
+			mOldMsgItems.push_back(msgItem);
 			continue;
 		}
 
@@ -371,6 +307,23 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 					mLobbySaveCount = atoi(kit->value.c_str());
 					continue;
 				}
+				if (kit->key == "STORE_KEY") {
+					uint8_t key[HistoryStore::KEY_SIZE];
+					uint32_t n = 0;
+					unsigned int byte;
+
+					while (n < HistoryStore::KEY_SIZE && 2*n+2 <= kit->value.length() && sscanf(kit->value.c_str()+2*n, "%2x", &byte) == 1) {
+						key[n++] = byte;
+					}
+
+					if (n == HistoryStore::KEY_SIZE) {
+						mStore.setKey(key);
+						mStoreKeySaved = true;
+					} else {
+						std::cerr << "p3HistoryMgr::loadList() ERROR: cannot read history store key." << std::endl;
+					}
+					continue;
+				}
 			}
 
 			delete (*it);
@@ -385,6 +338,99 @@ bool p3HistoryMgr::loadList(std::list<RsItem*>& load)
 	return true;
 }
 
+uint32_t p3HistoryMgr::locked_saveCount(const ChatId& chat_id) const
+{
+	if (chat_id.isBroadcast())
+		return mPublicSaveCount;
+	if (chat_id.isLobbyId())
+		return mLobbySaveCount;
+
+	return mPrivateSaveCount;
+}
+
+void p3HistoryMgr::checkStoreKey()
+{
+	{
+		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
+
+		if (mStoreKeySaved) {
+			return;
+		}
+
+		if (!mStore.hasKey()) {
+			uint8_t key[HistoryStore::KEY_SIZE];
+			RSRandom::random_bytes(key, HistoryStore::KEY_SIZE);
+
+			mStore.setKey(key);
+		}
+	}
+
+	// messages written with a key that is not on disc would be lost with it.
+
+	if (saveConfiguration()) {
+		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
+		mStoreKeySaved = true;
+	} else {
+		std::cerr << "p3HistoryMgr::checkStoreKey() ERROR: cannot save the history store key. Messages are not saved." << std::endl;
+	}
+}
+
+bool p3HistoryMgr::locked_checkStore()
+{
+	if (!mStore.hasKey() || !mStoreKeySaved) {
+		return false;
+	}
+
+	if (!mOldMsgItems.empty()) {
+		locked_moveOldMessages();
+	}
+
+	return true;
+}
+
+static std::string historyMsgSignature(const RsHistoryMsgItem *item)
+{
+	std::string sign;
+	rs_sprintf(sign, "%d %u %u %s ", item->incoming ? 1 : 0, item->sendTime, item->recvTime, item->peerId.toStdString().c_str());
+
+	return sign + item->message;
+}
+
+void p3HistoryMgr::locked_moveOldMessages()
+{
+	std::cerr << "p3HistoryMgr: moving " << mOldMsgItems.size() << " messages from config file to history store." << std::endl;
+
+	// The config file is saved without the messages some time after they have been moved. If that did not happen,
+	// they are still in the config file at the next start, and the messages that the store already has are skipped.
+
+	std::map<RsPeerId, std::set<std::string> > stored;
+
+	std::list<RsHistoryMsgItem*>::iterator it;
+	for (it = mOldMsgItems.begin(); it != mOldMsgItems.end(); ++it) {
+		std::map<RsPeerId, std::set<std::string> >::iterator sit = stored.find((*it)->chatPeerId);
+
+		if (sit == stored.end()) {
+			sit = stored.insert(std::make_pair((*it)->chatPeerId, std::set<std::string>())).first;
+
+			std::list<RsHistoryMsgItem*> items;
+			mStore.getMessages((*it)->chatPeerId, 0, items);
+
+			for (std::list<RsHistoryMsgItem*>::iterator lit = items.begin(); lit != items.end(); ++lit) {
+				sit->second.insert(historyMsgSignature(*lit));
+				delete (*lit);
+			}
+		}
+
+		if (sit->second.find(historyMsgSignature(*it)) == sit->second.end()) {
+			mStore.addMessage(*it);
+		}
+		delete (*it);
+	}
+	mOldMsgItems.clear();
+
+	IndicateConfigChanged();	// saves the config file without the messages
+}
+
 // have to convert to virtual peer id, to be able to use existing serialiser and file format
 bool p3HistoryMgr::chatIdToVirtualPeerId(ChatId chat_id, RsPeerId &peer_id)
 {
@@ -435,6 +481,8 @@ bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs
 {
 	msgs.clear();
 
+	checkStoreKey();
+
 	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
     RsPeerId chatPeerId;
@@ -462,24 +510,25 @@ bool p3HistoryMgr::getMessages(const ChatId &chatId, std::list<HistoryMsg> &msgs
     std::cerr << "Getting history for virtual peer " << chatPeerId << std::endl;
 #endif
 
-	uint32_t foundCount = 0;
+	// the store keeps whole segments, so it may have more than the save count.
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
+	uint32_t limit = locked_saveCount(chatId);
+	if (limit && (loadCount == 0 || loadCount > limit)) {
+		loadCount = limit;
+	}
+
+	std::list<RsHistoryMsgItem*> items;
+
+	if (locked_checkStore()) {
+		mStore.getMessages(chatPeerId, loadCount, items);
+	}
 
-	if (mit != mMessages.end()) 
+	for (std::list<RsHistoryMsgItem*>::iterator lit = items.begin(); lit != items.end(); ++lit)
 	{
-		std::map<uint32_t, RsHistoryMsgItem*>::reverse_iterator lit;
-
-		for (lit = mit->second.rbegin(); lit != mit->second.rend(); ++lit)
-		{
-			HistoryMsg msg;
-			convertMsg(lit->second, msg);
-			msgs.insert(msgs.begin(), msg);
-			foundCount++;
-			if (loadCount && foundCount >= loadCount) {
-				break;
-			}
-		}
+		HistoryMsg msg;
+		convertMsg(*lit, msg);
+		msgs.push_back(msg);
+		delete (*lit);
 	}
 #ifdef HISTMGR_DEBUG
 	std::cerr << msgs.size() << " messages added." << std::endl;
@@ -492,16 +541,16 @@ bool p3HistoryMgr::getMessage(uint32_t msgId, HistoryMsg &msg)
 {
 	RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-	for (mit = mMessages.begin(); mit != mMessages.end(); ++mit) {
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(msgId);
-		if (lit != mit->second.end()) {
-			convertMsg(lit->second, msg);
-			return true;
-		}
+	RsHistoryMsgItem *item = locked_checkStore() ? mStore.getMessage(msgId) : NULL;
+
+	if (item == NULL) {
+		return false;
 	}
 
-	return false;
+	convertMsg(item, msg);
+	delete item;
+
+	return true;
 }
 
 void p3HistoryMgr::clear(const ChatId &chatId)
@@ -517,19 +566,9 @@ void p3HistoryMgr::clear(const ChatId &chatId)
         std::cerr << "********** p3History::clear()called for virtual peer id " << chatPeerId << std::endl;
 #endif
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit = mMessages.find(chatPeerId);
-		if (mit == mMessages.end()) {
+		if (!locked_checkStore() || !mStore.clear(chatPeerId)) {
 			return;
 		}
-
-		std::map<uint32_t, RsHistoryMsgItem*>::iterator lit;
-		for (lit = mit->second.begin(); lit != mit->second.end(); ++lit) {
-			delete(lit->second);
-		}
-		mit->second.clear();
-		mMessages.erase(mit);
-
-		IndicateConfigChanged();
 	}
 
 	RsServer::notify()->notifyHistoryChanged(0, NOTIFY_TYPE_MOD);
@@ -547,37 +586,13 @@ void p3HistoryMgr::removeMessages(const std::list<uint32_t> &msgIds)
 	{
 		RsStackMutex stack(mHistoryMtx); /********** STACK LOCKED MTX ******/
 
-		std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> >::iterator mit;
-		for (mit = mMessages.begin(); mit != mMessages.end(); ++mit)
-		{
-			iit = ids.begin();
-			while ( !ids.empty() || (iit != ids.end()) )
-			{
-				std::map<uint32_t, RsHistoryMsgItem*>::iterator lit = mit->second.find(*iit);
-				if (lit != mit->second.end())
-				{
-#ifdef HISTMGR_DEBUG
-					std::cerr << "**** Removing " << mit->first << " msg id = " << lit->first << std::endl;
-#endif
-
-					delete(lit->second);
-					mit->second.erase(lit);
-
-					removedIds.push_back(*iit);
-					iit = ids.erase(iit);
-
-					continue;
-				}
-
-				++iit;
-			}
+		if (locked_checkStore()) {
+			mStore.removeMessages(ids, removedIds);
 		}
 	}
 
 	if (!removedIds.empty())
 	{
-		IndicateConfigChanged();
-
 		for (iit = removedIds.begin(); iit != removedIds.end(); ++iit)
 			RsServer::notify()->notifyHistoryChanged(*iit, NOTIFY_TYPE_DEL);
 	}
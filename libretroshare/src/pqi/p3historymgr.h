@@ -32,6 +32,7 @@
 #include "rsitems/rshistoryitems.h"
 #include "retroshare/rshistory.h"
 #include "pqi/p3cfgmgr.h"
+#include "pqi/historystore.h"
 
 class RsChatMsgItem;
 class ChatMessage;
@@ -39,12 +40,13 @@ class ChatMessage;
 //! handles history
 /*!
  * The is a retroshare service which allows peers
- * to store the history of the chat messages
+ * to store the history of the chat messages.
+ * Messages are kept on disc in a HistoryStore. The config file only holds the settings and the store key.
  */
 class p3HistoryMgr: public p3Config
 {
 public:
-	p3HistoryMgr();
+	p3HistoryMgr(const std::string& history_directory);
 	virtual ~p3HistoryMgr();
 
 	/******** p3HistoryMgr *********/
@@ -75,8 +77,20 @@ public:
 private:
     static bool chatIdToVirtualPeerId(ChatId chat_id, RsPeerId& peer_id);
 
-	uint32_t nextMsgId;
-	std::map<RsPeerId, std::map<uint32_t, RsHistoryMsgItem*> > mMessages;
+	// max number of messages to keep for this chat. 0 means no limit.
+	uint32_t locked_saveCount(const ChatId& chat_id) const;
+
+	// generates the key of the store the first time it is needed, and saves it in the config file before anything
+	// is encrypted with it. Saving the config takes the mutex, so this is called without it.
+	void checkStoreKey();
+
+	// returns true when the store can be used, after moving to it the messages of old config files.
+	bool locked_checkStore();
+	void locked_moveOldMessages();
+
+	HistoryStore mStore;
+	bool mStoreKeySaved;
+	std::list<RsHistoryMsgItem*> mOldMsgItems;
 
 	// Removes messages stored for more than mMaxMsgStorageDurationSeconds seconds.
 	// This avoids the stored list to grow crazy with time.
@@ -206,8 +206,11 @@ int BinEncryptedFileInterface::senddata(void* data, int len)
 
 	if((encDataLen > 0) && (encrytedData != NULL))
 	{
-		BinFileInterface::senddata((unsigned char *)encrytedData, encDataLen);
+		int written = BinFileInterface::senddata((unsigned char *)encrytedData, encDataLen);
 		free(encrytedData);
+
+		if(written != encDataLen)
+			return -1;
 	}
 	else
 	{
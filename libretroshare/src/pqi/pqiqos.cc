@@ -19,6 +19,7 @@ pqiQoS::pqiQoS(uint32_t nb_levels,float alpha)
 	float inc = alpha ;
 	_nb_items = 0 ;
     	_id_counter = 0 ;
+	_nb_allocations = 0 ;
 
 for(int i=((int)nb_levels)-1;i>=0;--i,c *= alpha)
 	{
@@ -59,6 +60,7 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 
 	_item_queues[priority].push(ptr,size,_id_counter++) ;
 	++_nb_items ;
+	++_nb_allocations ;	// the record of the item in the queue
     
     	if(_id_counter >= MAX_PACKET_COUNTER_VALUE)
             _id_counter = 0 ;
@@ -88,12 +90,17 @@ void pqiQoS::in_rsItem(void *ptr,int size,int priority)
 // }
 
 
-void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+bool pqiQoS::out_rsItem(void *dst,uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id) 
+{
+	return out_rsItem(selectQueue(),dst,max_slice_size,size,starts,ends,packet_id) ;
+}
+
+int pqiQoS::selectQueue()
 {
 	// Go through the queues. Increment counters.
 
 	if(_nb_items == 0)
-		return NULL ;
+		return -1 ;
 
 	float inc = 1.0f ;
 	int i = _item_queues.size()-1 ;
@@ -110,7 +117,20 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
 			_item_queues[j]._counter -= _item_queues[j]._threshold ;
 		}
 
-	if(last >= 0)
+	return last ;
+}
+
+uint32_t pqiQoS::sliceSize(int queue,uint32_t max_slice_size) const
+{
+	if(queue < 0 || queue >= (int)_item_queues.size())
+		return 0 ;
+
+	return _item_queues[queue].sliceSize(max_slice_size) ;
+}
+
+bool pqiQoS::out_rsItem(int last,void *dst,uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+{
+	if(last >= 0 && last < (int)_item_queues.size())
 	{
 #ifdef DEBUG
 		assert(_nb_items > 0) ;
@@ -118,15 +138,16 @@ void *pqiQoS::out_rsItem(uint32_t max_slice_size, uint32_t& size, bool& starts,
         
         	// now chop a slice of this item
         
-        	void *res = _item_queues[last].slice(max_slice_size,size,starts,ends,packet_id) ;
+        	if(!_item_queues[last].slice(dst,max_slice_size,size,starts,ends,packet_id))
+			return false ;
             
             	if(ends)
 			--_nb_items ;
                 
-		return res ;
+		return true ;
 	}
 	else
-		return NULL ;
+		return false ;
 }
 
 
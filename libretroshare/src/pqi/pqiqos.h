@@ -75,10 +75,28 @@ public:
 			return item ;
 		}
 
-		void *slice(uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		// Size of the slice that slice() would copy for the same max_size.
+
+		uint32_t sliceSize(uint32_t max_size) const
 		{
 			if(_items.empty())
-				return NULL ;
+				return 0 ;
+
+			const ItemRecord& rec(_items.front()) ;
+
+			if(rec.size <= rec.current_offset)
+				return 0 ;
+
+			return std::min(max_size, rec.size - rec.current_offset) ;
+		}
+
+		// Copies the next slice of the first item into dst, which must be able to hold max_size bytes. The item is
+		// freed as soon as its last slice is out.
+
+		bool slice(void *dst,uint32_t max_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) 
+		{
+			if(_items.empty())
+				return false ;
 
 			ItemRecord& rec(_items.front()) ;
 			packet_id = rec.id ;
@@ -91,7 +109,11 @@ public:
 				ends = true ;
 				size = rec.size ;
 
-				return pop() ;
+				void *item = pop() ;
+				memcpy(dst,item,size) ;
+				free(item) ;
+
+				return true ;
 			}
 			starts = (rec.current_offset == 0) ;
 			ends   = (rec.current_offset + max_size >= rec.size) ;
@@ -99,31 +121,20 @@ public:
 			if(rec.size <= rec.current_offset)
 			{
 				std::cerr << "(EE) severe error in slicing in QoS." << std::endl;
-				pop() ;
-				return NULL ;
+				free(pop()) ;
+				return false ;
 			}
 
 			size = std::min(max_size, uint32_t((int)rec.size - (int)rec.current_offset)) ;
-			void *mem = rs_malloc(size) ;
-
-			if(!mem)
-			{
-				std::cerr << "(EE) memory allocation error in QoS." << std::endl;
-				pop() ;
-				return NULL ;
-			}
 
-			memcpy(mem,&((unsigned char*)rec.data)[rec.current_offset],size) ;
+			memcpy(dst,&((unsigned char*)rec.data)[rec.current_offset],size) ;
 
 			if(ends)	// we're taking the whole stuff. So we can delete the entry.
-			{
-				free(rec.data) ;
-				_items.pop_front() ;
-			}
+				free(pop()) ;
 			else
 				rec.current_offset += size ;	// by construction, !ends  implies  rec.current_offset < rec.size
 
-			return mem ;
+			return true ;
 		}
 
 		void push(void *item,uint32_t size,uint32_t id) 
@@ -148,9 +159,18 @@ public:
 		std::list<ItemRecord> _items ;
 	};
 
-	// This function pops items from the queue, y order of priority
+	// This function pops items from the queue, y order of priority. The data is directly copied into dst, which
+	// must be able to hold max_slice_size bytes.
 	//
-	void *out_rsItem(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+	bool out_rsItem(void *dst,uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
+
+	// Same thing in two steps, so that the caller knows how much room the slice needs before giving dst:
+	// selectQueue() picks the queue to serve next (and updates the counters accordingly, so call it once per
+	// slice), sliceSize() tells how many bytes the next slice of that queue takes, and out_rsItem() copies it.
+	//
+	int selectQueue() ;
+	uint32_t sliceSize(int queue,uint32_t max_slice_size) const ;
+	bool out_rsItem(int queue,void *dst,uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id) ;
 
 	// This function is used to queue items.
 	//
@@ -159,6 +179,9 @@ public:
 	void print() const ;
 	uint64_t qos_queue_size() const { return _nb_items ; }
 
+	// number of memory allocations made by the queues since creation. Slices are copied without allocating.
+	uint64_t qos_allocations() const { return _nb_allocations ; }
+
 	// kills all waiting items.
 	void clear() ;
 
@@ -176,6 +199,7 @@ private:
 	float _alpha ;
 	uint64_t _nb_items ;
 	uint32_t _id_counter ;
+	uint64_t _nb_allocations ;
 
 	static const uint32_t MAX_PACKET_COUNTER_VALUE ;
 };
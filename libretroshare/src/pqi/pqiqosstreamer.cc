@@ -72,18 +72,30 @@ void pqiQoSstreamer::locked_clear_out_queue()
 	_total_item_count = 0 ;
 }
 
-void *pqiQoSstreamer::locked_pop_out_data(uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
+bool pqiQoSstreamer::locked_pop_out_data(uint32_t offset,uint32_t max_slice_size, uint32_t& size, bool& starts, bool& ends, uint32_t& packet_id)
 {
-	void *out = pqiQoS::out_rsItem(max_slice_size,size,starts,ends,packet_id) ;
+	if(qos_queue_size() == 0)
+		return false ;
 
-	if(out != NULL) 
-	{
-		_total_item_size -= size ;
-        
-        	if(ends)
-			--_total_item_count ;
-	}
+	// only reserve the room the slice actually takes: when the peer does not accept slicing, max_slice_size is the
+	// largest possible packet, and most items are much smaller than that.
+
+	int queue = pqiQoS::selectQueue() ;
+	uint32_t slice_size = pqiQoS::sliceSize(queue,max_slice_size) ;
+
+	if(slice_size == 0)
+		return false ;
+
+	void *dst = locked_reserveOutputBuffer(offset,slice_size) ;
+
+	if(dst == NULL || !pqiQoS::out_rsItem(queue,dst,max_slice_size,size,starts,ends,packet_id))
+		return false ;
+
+	_total_item_size -= size ;
+
+	if(ends)
+		--_total_item_count ;
 
-	return out ;
+	return true ;
 }
 
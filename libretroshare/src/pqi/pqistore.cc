@@ -420,10 +420,10 @@ bool pqiSSLstore::encryptedSendItems(const std::list<RsItem*>& rsItemList)
 
 	bool result = true;
 
-	if(sizeItems == offset)
-		enc_bio->senddata(data, sizeItems);
-	else
+	if(sizeItems != offset)
 		result = false;
+	else if(sizeItems > 0)
+		result = (enc_bio->senddata(data, sizeItems) == (int)sizeItems);
 
 	return result;
 }
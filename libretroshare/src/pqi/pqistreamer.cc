@@ -53,8 +53,10 @@ static const int   PQISTREAM_AVG_PERIOD 			= 1; 		// update speed estimate every
 static const float PQISTREAM_AVG_FRAC   			= 0.8; 		// for bandpass filter over speed estimate.
 static const float PQISTREAM_AVG_DT_FRAC                        = 0.99;         // for low pass filter over elapsed time
 
-static const int   PQISTREAM_OPTIMAL_PACKET_SIZE  		= 512;		// It is believed that this value should be lower than TCP slices and large enough as compare to encryption padding.
+static const uint32_t PQISTREAM_OPTIMAL_PACKET_SIZE  		= 512;		// It is believed that this value should be lower than TCP slices and large enough as compare to encryption padding.
 										// most importantly, it should be constant, so as to allow correct QoS.
+static const uint32_t PQISTREAM_OUTPUT_RECORD_SIZE		= 1400;		// Slices are grouped up to this size before being sent. 1500 bytes MTU, minus TCP/IP headers and TLS record overhead.
+static const uint32_t PQISTREAM_MIN_SLICE_SIZE			= 64;		// don't bother cutting a slice smaller than this to fill up a record.
 static const int   PQISTREAM_SLICE_FLAG_STARTS			= 0x01;		// 
 static const int   PQISTREAM_SLICE_FLAG_ENDS 			= 0x02;		// these flags should be kept in the range 0x01-0x08
 static const int   PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01     = 0x10;		// Protocol version ID. Should hold on the 4 lower bits.
@@ -100,7 +102,8 @@ static double getCurrentTS()
 pqistreamer::pqistreamer(RsSerialiser *rss, const RsPeerId& id, BinInterface *bio_in, int bio_flags_in)
 	:PQInterface(id), mStreamerMtx("pqistreamer"),
 	mBio(bio_in), mBio_flags(bio_flags_in), mRsSerialiser(rss), 
-	mPkt_wpending(NULL), mPkt_wpending_size(0),
+	mPkt_wpending(NULL), mPkt_wpending_size(0), mPkt_wpending_capacity(0),
+	mOutAllocations(0), mOutPktsAllocations(0),
 	mTotalRead(0), mTotalSent(0),
 	mCurrRead(0), mCurrSent(0),
 	mAvgReadCount(0), mAvgSentCount(0),
@@ -347,6 +350,7 @@ int	pqistreamer::status()
 void pqistreamer::locked_storeInOutputQueue(void *ptr,int,int)
 {
 	mOutPkts.push_back(ptr);
+	++mOutPktsAllocations ;
 }
 //
 /**************** HANDLE OUTGOING TRANSLATION + TRANSMISSION ******/
@@ -367,6 +371,7 @@ int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
     	if(ptr == NULL)
             return 0 ;
             
+	++mOutAllocations ;
 
 #ifdef DEBUG_PQISTREAMER
 	std::cerr << "pqistreamer::queue_outpqi() serializing packet with packet size : " << pktsize << std::endl;
@@ -377,6 +382,7 @@ int	pqistreamer::queue_outpqi_locked(RsItem *pqi,uint32_t& pktsize)
     	// is a full statistics chunk that can be used in the GUI
 
     	locked_addTrafficClue(pqi,pktsize,mCurrentStatsChunk_Out) ;
+	++mOutAllocations ;
 
         /*******************************************************************************************/
 
@@ -521,6 +527,7 @@ int	pqistreamer::handleoutgoing_locked()
 		    free(mPkt_wpending);
 		    mPkt_wpending = NULL;
 		    	mPkt_wpending_size = 0 ;
+		    	mPkt_wpending_capacity = 0 ;
 	    }
 
 	    return 0;
@@ -550,10 +557,8 @@ int	pqistreamer::handleoutgoing_locked()
             //	- grab as many packets as possible while below the optimal packet size, so as to allow some packing and decrease encryption padding overhead (suposeddly)
             //	- limit packets size to OPTIMAL_PACKET_SIZE when sending big packets so as to keep as much QoS as possible.
         
-	    if (!mPkt_wpending)
+	    if (mPkt_wpending_size == 0)
 	{
-		void *dta;
-		mPkt_wpending_size = 0 ;
 		int k=0;
 
         	// Checks for inserting a packet slicing probe. We do that to send the other peer the information that packet slicing can be used.
@@ -565,10 +570,13 @@ int	pqistreamer::handleoutgoing_locked()
 #ifdef DEBUG_PACKET_SLICING
                 	std::cerr << "(II) Inserting packet slicing probe in traffic" << std::endl;
 #endif
-                    
-                    	mPkt_wpending_size = 8 ;
-                    	mPkt_wpending = rs_malloc(8) ;
-                        memcpy(mPkt_wpending,PACKET_SLICING_PROBE_BYTES,8) ;
+                    	void *probe = locked_reserveOutputBuffer(0,8) ;
+
+                    	if(probe != NULL)
+                    	{
+				memcpy(probe,PACKET_SLICING_PROBE_BYTES,8) ;
+				mPkt_wpending_size = 8 ;
+                    	}
                         
                 	mLastSentPacketSlicingProbe = now ;
         	}
@@ -578,23 +586,25 @@ int	pqistreamer::handleoutgoing_locked()
 		bool slice_ends=true ;
 		uint32_t slice_packet_id=0 ;
 
+		// Slices are copied straight into the output buffer, right after some room for the partial packet header. Slices
+		// are grouped until they fill a record that fits a single TCP segment, so that each call to senddata() ends up
+		// in as few TLS records and IP packets as possible. When slicing is on, the last slice is cut to fit the record.
+
 		do
 		{
-            		int desired_packet_size = mAcceptsPacketSlicing?PQISTREAM_OPTIMAL_PACKET_SIZE:(getRsPktMaxSize());
+			uint32_t desired_packet_size = mAcceptsPacketSlicing?std::min(PQISTREAM_OPTIMAL_PACKET_SIZE,PQISTREAM_OUTPUT_RECORD_SIZE - mPkt_wpending_size - PQISTREAM_PARTIAL_PACKET_HEADER_SIZE):(getRsPktMaxSize());
                     
-			dta = locked_pop_out_data(desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id) ;
-
-			if(!dta)
+			if(!locked_pop_out_data(mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE,desired_packet_size,slice_size,slice_starts,slice_ends,slice_packet_id))
 				break ;
 
+			unsigned char *pkt = &((unsigned char*)mPkt_wpending)[mPkt_wpending_size] ;
+
 			if(slice_starts && slice_ends)	// good old method. Send the packet as is, since it's a full packet.
 			{
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending full slice, old style. Size=" << slice_size << std::endl;
 #endif
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size],dta,slice_size) ;
-				free(dta);
+				memmove(pkt,pkt+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE,slice_size) ;
 				mPkt_wpending_size += slice_size ;
 				++k ;
 			}
@@ -603,38 +613,32 @@ int	pqistreamer::handleoutgoing_locked()
 				if(slice_size > 0xffff || !mAcceptsPacketSlicing)
 				{
 					std::cerr << "(EE) protocol error in pqitreamer: slice size is too large and cannot be encoded." ;
-					free(mPkt_wpending) ;
 					mPkt_wpending_size = 0;
 					return -1 ;
 				}
 #ifdef DEBUG_PACKET_SLICING
 				std::cerr << "sending partial slice, packet ID=" << std::hex << slice_packet_id << std::dec << ", size=" << slice_size << std::endl;
 #endif
-
-				mPkt_wpending = realloc(mPkt_wpending,slice_size+mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE) ;
-				memcpy( &((char*)mPkt_wpending)[mPkt_wpending_size+PQISTREAM_PARTIAL_PACKET_HEADER_SIZE],dta,slice_size) ;
-				free(dta);
-
 				// New2: pp ff xxxxxxxx ssss  [data, sss bytes] => [flags 1B] [protocol version 1B] [2^32 packet count] [2^16 size]
 
 				uint8_t partial_flags = 0 ;
 				if(slice_starts) partial_flags |= PQISTREAM_SLICE_FLAG_STARTS  ;
 				if(slice_ends  ) partial_flags |= PQISTREAM_SLICE_FLAG_ENDS  ;
 
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x01] = partial_flags ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x06] = uint8_t(slice_size      >>  8) & 0xff ;
-				((char*)mPkt_wpending)[mPkt_wpending_size+0x07] = uint8_t(slice_size      >>  0) & 0xff ;
+				pkt[0x00] = PQISTREAM_SLICE_PROTOCOL_VERSION_ID_01 ;
+				pkt[0x01] = partial_flags ;
+				pkt[0x02] = uint8_t(slice_packet_id >> 24) & 0xff ;
+				pkt[0x03] = uint8_t(slice_packet_id >> 16) & 0xff ;
+				pkt[0x04] = uint8_t(slice_packet_id >>  8) & 0xff ;
+				pkt[0x05] = uint8_t(slice_packet_id >>  0) & 0xff ;	
+				pkt[0x06] = uint8_t(slice_size      >>  8) & 0xff ;
+				pkt[0x07] = uint8_t(slice_size      >>  0) & 0xff ;
 
 				mPkt_wpending_size += slice_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE;
 				++k ;
 			}
 		} 
-                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size < PQISTREAM_OPTIMAL_PACKET_SIZE && !DISABLE_PACKET_GROUPING) ;
+                 while(mPkt_wpending_size < (uint32_t)maxbytes && mPkt_wpending_size + PQISTREAM_PARTIAL_PACKET_HEADER_SIZE + PQISTREAM_MIN_SLICE_SIZE <= PQISTREAM_OUTPUT_RECORD_SIZE && !DISABLE_PACKET_GROUPING) ;
              
 #ifdef DEBUG_PQISTREAMER
 		if(k > 1)
@@ -642,7 +646,7 @@ int	pqistreamer::handleoutgoing_locked()
 #endif
 	}
         
-	    if (mPkt_wpending)
+	    if (mPkt_wpending_size > 0)
 	    {
 		    // write packet.
 #ifdef DEBUG_PQISTREAMER
@@ -680,9 +684,22 @@ int	pqistreamer::handleoutgoing_locked()
 
 		    sentbytes += mPkt_wpending_size;
             
-		    free(mPkt_wpending);
-		    mPkt_wpending = NULL;
-		    mPkt_wpending_size = 0 ;
+		    mPkt_wpending_size = 0 ;	// the buffer itself is kept for the next packet
+
+		    // but not at the size of an unusually large packet, which would otherwise stay allocated for the
+		    // whole connection.
+
+		    if(mPkt_wpending_capacity > PQISTREAM_OUTPUT_RECORD_SIZE + PQISTREAM_OPTIMAL_PACKET_SIZE)
+		    {
+			    void *mem = realloc(mPkt_wpending,PQISTREAM_OUTPUT_RECORD_SIZE + PQISTREAM_OPTIMAL_PACKET_SIZE) ;
+
+			    if(mem != NULL)
+			    {
+				    mPkt_wpending = mem ;
+				    mPkt_wpending_capacity = PQISTREAM_OUTPUT_RECORD_SIZE + PQISTREAM_OPTIMAL_PACKET_SIZE ;
+				    ++mOutAllocations ;
+			    }
+		    }
 
 		    sent = true;
 	    }
@@ -1301,6 +1318,7 @@ void pqistreamer::free_pend_locked()
 		mPkt_wpending = NULL;
 	}
 	mPkt_wpending_size = 0 ;
+	mPkt_wpending_capacity = 0 ;
 
 #ifdef DEBUG_PQISTREAMER
     if(!mPartialPackets.empty())
@@ -1342,6 +1360,18 @@ void    pqistreamer::getRates(RsBwRates &rates)
 	rates.mQueueOut = locked_out_queue_size();
 }
 
+uint64_t pqistreamer::getOutAllocations()
+{
+	RsStackMutex stack(mStreamerMtx); /**** LOCKED MUTEX ****/
+
+	return mOutAllocations + locked_out_queue_allocations() ;
+}
+
+uint64_t pqistreamer::locked_out_queue_allocations() const
+{
+	return mOutPktsAllocations ;
+}
+
 int pqistreamer::locked_out_queue_size() const
 {
 	// Warning: because out_pkt is a list, calling size
@@ -1383,25 +1413,55 @@ int pqistreamer::locked_gatherStatistics(std::list<RSTrafficClue>& out_lst,std::
     return 1 ;
 }
 
-void *pqistreamer::locked_pop_out_data(uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
+bool pqistreamer::locked_pop_out_data(uint32_t offset,uint32_t /*max_slice_size*/, uint32_t &size, bool &starts, bool &ends, uint32_t &packet_id)
 {
     size = 0 ;
     starts = true ;
     ends = true ;
     packet_id = 0 ;
     
-	void *res = NULL ;
+	if (mOutPkts.empty())
+		return false ;
 
-	if (!mOutPkts.empty())
-	{
-		res = *(mOutPkts.begin()); 
-		mOutPkts.pop_front();
+	// this class does not slice packets, so they always go as a whole.
+
+	void *pkt = mOutPkts.front() ;
+	size = getRsItemSize(pkt) ;
+
+	void *dst = locked_reserveOutputBuffer(offset,size) ;
+
+	if(dst == NULL)
+		return false ;
+
+	memcpy(dst,pkt,size) ;
+	free(pkt) ;
+	mOutPkts.pop_front();
 #ifdef DEBUG_TRANSFERS
-		std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt from mOutPkts queue";
-		std::cerr << std::endl;
+	std::cerr << "pqistreamer::locked_pop_out_data() getting next pkt from mOutPkts queue";
+	std::cerr << std::endl;
 #endif
+	return true ;
+}
+
+void *pqistreamer::locked_reserveOutputBuffer(uint32_t offset,uint32_t size)
+{
+	if(offset + size > mPkt_wpending_capacity)
+	{
+		// start with a full record, so that in the normal case this is the only allocation for the whole connection.
+
+		uint32_t new_capacity = std::max(offset + size, PQISTREAM_OUTPUT_RECORD_SIZE + PQISTREAM_OPTIMAL_PACKET_SIZE) ;
+		void *mem = realloc(mPkt_wpending,new_capacity) ;
+
+		if(mem == NULL)
+		{
+			std::cerr << "(EE) pqistreamer: cannot allocate " << new_capacity << " bytes for output buffer." << std::endl;
+			return NULL ;
+		}
+		mPkt_wpending = mem ;
+		mPkt_wpending_capacity = new_capacity ;
+		++mOutAllocations ;
 	}
-	return res ;
+	return &((unsigned char*)mPkt_wpending)[offset] ;
 }
 
     
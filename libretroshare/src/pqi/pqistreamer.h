@@ -74,6 +74,10 @@ class pqistreamer: public PQInterface
 		virtual void    getRates(RsBwRates &rates);
 		virtual int     getQueueSize(bool in); // extracting data.
 		virtual int     gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
+
+		// Number of memory allocations made to send items since the streamer was created: serialisation buffers,
+		// traffic statistics, output queue records and output buffer growth.
+		uint64_t getOutAllocations();
         
             	// mutex protected versions of RateInterface calls.
             	virtual void setRate(bool b,float f) ;
@@ -93,11 +97,18 @@ class pqistreamer: public PQInterface
 		//
 		virtual void locked_storeInOutputQueue(void *ptr, int size, int priority) ;
 		virtual int locked_out_queue_size() const ;
+		virtual uint64_t locked_out_queue_allocations() const ;
 		virtual void locked_clear_out_queue() ;
 		virtual int locked_compute_out_pkt_size() const ;
-		virtual void *locked_pop_out_data(uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
+		// Copies the next slice to send at the given offset of the output buffer, using locked_reserveOutputBuffer().
+		// Returns false when there is nothing to send.
+		virtual bool locked_pop_out_data(uint32_t offset,uint32_t max_slice_size,uint32_t& size,bool& starts,bool& ends,uint32_t& packet_id);
 		virtual int   locked_gatherStatistics(std::list<RSTrafficClue>& outqueue_stats,std::list<RSTrafficClue>& inqueue_stats); // extracting data.
 
+		// Makes sure that the output buffer can hold size bytes at offset, and returns a pointer to that place.
+		// The buffer is kept from one packet to the next, so this only allocates memory when it needs to grow.
+		void *locked_reserveOutputBuffer(uint32_t offset,uint32_t size) ;
+
         	void updateRates() ;
             	
 	protected:
@@ -131,8 +142,12 @@ class pqistreamer: public PQInterface
 		// RsSerialiser - determines which packets can be serialised.
 		RsSerialiser *mRsSerialiser;
 
-		void *mPkt_wpending; // storage for pending packet to write.
-        	uint32_t mPkt_wpending_size; // ... and its size.
+		void *mPkt_wpending; // storage for pending packet to write. Allocated once, and re-used for every packet.
+        	uint32_t mPkt_wpending_size; // ... and its size. 0 means nothing pending.
+		uint32_t mPkt_wpending_capacity; // allocated size of mPkt_wpending.
+
+		uint64_t mOutAllocations; // allocations made to send items, apart from the output queue. See getOutAllocations().
+		uint64_t mOutPktsAllocations; // allocations made by mOutPkts
 
         void allocate_rpend_locked(); // use these two functions to allocate/free the buffer below
         
@@ -112,6 +112,7 @@ extern RsServerConfig *rsConfig;
 
 // Must Match up with strings internal to Retroshare.
 #define RS_CONFIG_ADVANCED		0x0101
+#define RS_CONFIG_GXS_VALIDATION_THREADS	0x0102	/* threads checking GXS signatures, shared by all services */
 
 
 #define RS_OPMODE_FULL		0x0001
@@ -156,6 +156,10 @@ public:
     }
 
     virtual void linearize(LinearizedExpression& e) const ;
+
+    const Expression *leftExpression() const { return Lexp; }
+    const Expression *rightExpression() const { return Rexp; }
+    enum LogicalOperator logicalOperator() const { return Op; }
 private:
     Expression *Lexp;
     Expression *Rexp;
@@ -169,6 +173,9 @@ public:
     StringExpression(enum StringOperator op, std::list<std::string> &t, bool ic): Op(op),terms(t), IgnoreCase(ic){}
 
     virtual void linearize(LinearizedExpression& e) const ;
+
+    enum StringOperator stringOperator() const { return Op; }
+    const std::list<std::string>& stringTerms() const { return terms; }
 protected:
     bool evalStr(const std::string &str);
 
@@ -184,6 +191,10 @@ public:
     RelExpression(enum RelOperator op, T lv, T hv): Op(op), LowerValue(lv), HigherValue(hv) {}
 
     virtual void linearize(LinearizedExpression& e) const ;
+
+    enum RelOperator relOperator() const { return Op; }
+    T lowerValue() const { return LowerValue; }
+    T higherValue() const { return HigherValue; }
 protected:
     bool evalRel(T val);
 
@@ -201,10 +201,17 @@ class RsFiles
 		virtual bool setDestinationDirectory(const RsFileHash& hash,const std::string& new_path) = 0;
 		virtual bool setDestinationName(const RsFileHash& hash,const std::string& new_name) = 0;
 		virtual bool setChunkStrategy(const RsFileHash& hash,FileChunksInfo::ChunkStrategy) = 0;
+		/// Tells where a media player reads a file being downloaded, for the CHUNK_STRATEGY_STREAMING_RAREST strategy.
+		virtual bool setPlaybackCursor(const RsFileHash& hash,uint64_t offset) = 0;
 		virtual void setDefaultChunkStrategy(FileChunksInfo::ChunkStrategy) = 0;
 		virtual FileChunksInfo::ChunkStrategy defaultChunkStrategy() = 0;
 		virtual uint32_t freeDiskSpaceLimit() const =0;
 		virtual void setFreeDiskSpaceLimit(uint32_t size_in_mb) =0;
+		/// Read large shared files through a memory mapping when sending them to friends.
+		virtual void setMemoryMappedReads(bool b) =0;
+		virtual bool memoryMappedReads() =0;
+		/// Bytes sent to friends since startup, read from memory mapped files and through buffered reads.
+		virtual void getDiskReadStatistics(uint64_t& mapped_bytes, uint64_t& buffered_bytes) =0;
 		virtual bool FileControl(const RsFileHash& hash, uint32_t flags) = 0;
 		virtual bool FileClearCompleted() = 0;
 		virtual void setDefaultEncryptionPolicy(uint32_t policy)=0;	// RS_FILE_CTRL_ENCRYPTION_POLICY_STRICT/PERMISSIVE
@@ -307,6 +314,12 @@ class RsFiles
         virtual void setMaxShareDepth(int depth) =0;
         virtual int  maxShareDepth() const=0;
 
+        // Size of the pool of threads hashing shared files, and max number of files hashed at the same time on a single disk.
+        virtual void setMaxHashingThreads(uint32_t n) =0;
+        virtual uint32_t maxHashingThreads() =0;
+        virtual void setMaxHashingThreadsPerDevice(uint32_t n) =0;
+        virtual uint32_t maxHashingThreadsPerDevice() =0;
+
 		virtual bool	ignoreDuplicates() = 0;
 		virtual void 	setIgnoreDuplicates(bool ignore) = 0;
 
@@ -184,6 +184,12 @@ public:
     virtual void     setSyncPeriod(const RsGxsGroupId& grpId,uint32_t age_in_secs) = 0;
 
     virtual RsReputations::ReputationLevel minReputationForForwardingMessages(uint32_t group_sign_flags,uint32_t identity_flags)=0;
+
+    /*!
+     * @param stats filled with the state of the signature checking threads, and the number of msgs and groups
+     *              of this service that wait for validation
+     */
+    virtual void getValidationStatistics(RsGxsValidationStatistics& stats) = 0;
 };
 
 
@@ -241,6 +241,11 @@ public:
     {
         return mGxs->minReputationForForwardingMessages(group_sign_flags,identity_flags);
     }
+
+    void getValidationStatistics(RsGxsValidationStatistics& stats)
+    {
+        mGxs->getValidationStatistics(stats);
+    }
 private:
 
     RsGxsIface* mGxs;
@@ -184,6 +184,23 @@ public:
 	uint32_t mSizeStore;
 };
 
+/*!
+ * Signature checks of received msgs and groups. The threads are shared by all GXS services, the pending
+ * counts are those of the service that filled the structure.
+ */
+struct RsGxsValidationStatistics
+{
+	RsGxsValidationStatistics() : workers(0),queueDepth(0),jobsDone(0),jobsPerSecond(0.0f),pendingMsgs(0),pendingGrps(0) {}
+
+	uint32_t workers ;			// number of worker threads, shared by all GXS services
+	uint32_t queueDepth ;		// jobs waiting for a thread
+	uint64_t jobsDone ;			// jobs run since start
+	float    jobsPerSecond ;	// validation rate over the last measurement period
+
+	uint32_t pendingMsgs ;		// msgs of the service waiting for validation (e.g. for the author's key)
+	uint32_t pendingGrps ;		// same for groups
+};
+
 class UpdateItem
 {
 public:
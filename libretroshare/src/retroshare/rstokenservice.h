@@ -79,7 +79,7 @@ struct RsTokReqOptions
 {
 	RsTokReqOptions() : mOptions(0), mStatusFilter(0), mStatusMask(0),
 	    mMsgFlagMask(0), mMsgFlagFilter(0), mReqType(0), mSubscribeFilter(0),
-	    mSubscribeMask(0), mBefore(0), mAfter(0) {}
+	    mSubscribeMask(0), mBefore(0), mAfter(0), mPageOffset(0), mPageSize(0) {}
 
 	/**
 	 * Can be one or multiple RS_TOKREQOPT_*
@@ -106,11 +106,38 @@ struct RsTokReqOptions
 	// Time range... again applied after Options.
 	time_t   mBefore;
 	time_t   mAfter;
+
+	/**
+	 * Paging of the messages of whole groups (msg requests with no msg ids
+	 * given). When mPageSize is not 0, messages are sorted by publish time,
+	 * newest first, and only mPageSize of them starting at mPageOffset are
+	 * returned. The number of matching messages is given by
+	 * RsTokenService::getMsgTotalCounts().
+	 */
+	uint32_t mPageOffset;
+	uint32_t mPageSize;
 };
 
 std::ostream &operator<<(std::ostream &out, const RsGroupMetaData &meta);
 std::ostream &operator<<(std::ostream &out, const RsMsgMetaData &meta);
 
+/*!
+ * Receives the completion of GXS requests, as an alternative to polling requestStatus().
+ * requestCompleted() is called by the thread that processed the request, which can be
+ * any thread: implementations should only record the result and return quickly.
+ */
+class RsTokenObserver
+{
+public:
+    virtual ~RsTokenObserver() {}
+
+    /*!
+     * @param token the token of the request
+     * @param status GXS_REQUEST_V2_STATUS_COMPLETE or GXS_REQUEST_V2_STATUS_FAILED
+     */
+    virtual void requestCompleted(uint32_t token, uint32_t status) = 0;
+};
+
 /*!
  * A proxy class for requesting generic service data for GXS
  * This seperates the request mechanism from the actual retrieval of data
@@ -198,6 +225,26 @@ public:
      */
     virtual uint32_t requestStatus(const uint32_t token) = 0;
 
+    /*!
+     * Asks to be called back when the request completes or fails, instead of polling
+     * requestStatus(). If the request is already finished, the observer is called right away.
+     * Only one observer per token.
+     * @param token value of token to observe
+     * @param observer called once, when the request is finished
+     * @return false if the token is unknown or the service does not support callbacks
+     */
+    virtual bool observeRequest(const uint32_t /*token*/, RsTokenObserver* /*observer*/) { return false; }
+
+    /*!
+     * Number of messages of each group matching a message request, regardless of the page
+     * asked for in RsTokReqOptions. Can be called before or after retrieving the messages,
+     * as long as the request is not cleared.
+     * @param token value of token of a completed message request
+     * @param counts number of matching messages per group id
+     * @return false if the token is unknown or the request is not completed
+     */
+    virtual bool getMsgTotalCounts(const uint32_t /*token*/, std::map<RsGxsGroupId, uint32_t>& /*counts*/) { return false; }
+
     /*!
      * This request statistics on amount of data held
      * number of groups
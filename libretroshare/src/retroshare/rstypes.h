@@ -267,7 +267,8 @@ class FileChunksInfo
 {
 	public:
 		enum ChunkState { CHUNK_CHECKING=3, CHUNK_DONE=2, CHUNK_ACTIVE=1, CHUNK_OUTSTANDING=0 } ;
-		enum ChunkStrategy { CHUNK_STRATEGY_STREAMING, CHUNK_STRATEGY_RANDOM, CHUNK_STRATEGY_PROGRESSIVE } ;
+		enum ChunkStrategy { CHUNK_STRATEGY_STREAMING, CHUNK_STRATEGY_RANDOM, CHUNK_STRATEGY_PROGRESSIVE,
+		                     CHUNK_STRATEGY_RAREST_FIRST, CHUNK_STRATEGY_STREAMING_RAREST } ;
 
 		struct SliceInfo
 		{
@@ -276,6 +277,14 @@ class FileChunksInfo
 			RsPeerId peer_id ;
 		};
 
+		struct PeerTransferInfo
+		{
+			uint32_t rtt_ms ;				// smoothed round trip time of data requests, 0 if not measured yet
+			uint32_t in_flight_bytes ;		// data requested and not received yet
+			uint32_t window_bytes ;			// max data in flight, when requests are pipelined
+			uint32_t pending_requests ;	// number of slice requests waiting for data
+		};
+
 		uint64_t file_size ;					// real size of the file
 		uint32_t chunk_size ;				// size of chunks
 		uint32_t strategy ;
@@ -293,6 +302,10 @@ class FileChunksInfo
 		// The list of pending requests, chunk per chunk (by chunk id)
 		//
 		std::map<uint32_t, std::vector<SliceInfo> > pending_slices ;
+
+		// Request statistics of each source peer
+		//
+		std::map<RsPeerId, PeerTransferInfo> peer_transfer_info ;
 };
 
 class CompressedChunkMap
@@ -48,6 +48,12 @@ void RsFileTransferDataRequestItem::clear()
 	fileoffset = 0;
 	chunksize  = 0;
 }
+void RsFileTransferDataRequestsItem::clear()
+{
+	file.TlvClear();
+	fileoffsets.clear();
+	chunksizes.clear();
+}
 void RsFileTransferDataItem::clear()
 {
 	fd.TlvClear();
@@ -60,6 +66,13 @@ void RsFileTransferDataRequestItem::serial_process(RsGenericSerializer::Serializ
     RsTypeSerializer::serial_process<RsTlvItem>(j,ctx,file,      "file") ;
 }
 
+void RsFileTransferDataRequestsItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process<RsTlvItem>(j,ctx,file,       "file") ;
+    RsTypeSerializer::serial_process           (j,ctx,fileoffsets,"fileoffsets") ;
+    RsTypeSerializer::serial_process           (j,ctx,chunksizes, "chunksizes") ;
+}
+
 void RsFileTransferDataItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
     RsTypeSerializer::serial_process<RsTlvItem>(j,ctx,fd,"fd") ;
@@ -145,6 +158,7 @@ RsItem *RsFileTransferSerialiser::create_item(uint16_t service_type,uint8_t item
     switch(item_type)
     {
 	case RS_PKT_SUBTYPE_FT_DATA_REQUEST     	: return new RsFileTransferDataRequestItem();
+	case RS_PKT_SUBTYPE_FT_DATA_REQUESTS     	: return new RsFileTransferDataRequestsItem();
 	case RS_PKT_SUBTYPE_FT_DATA               	: return new RsFileTransferDataItem();
 	case RS_PKT_SUBTYPE_FT_CHUNK_MAP_REQUEST  	: return new RsFileTransferChunkMapRequestItem();
 	case RS_PKT_SUBTYPE_FT_CHUNK_MAP          	: return new RsFileTransferChunkMapItem();
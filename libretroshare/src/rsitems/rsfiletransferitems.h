@@ -46,6 +46,8 @@ const uint8_t RS_PKT_SUBTYPE_FT_CHUNK_CRC          = 0x09;
 const uint8_t RS_PKT_SUBTYPE_FT_CACHE_ITEM    = 0x0A;
 const uint8_t RS_PKT_SUBTYPE_FT_CACHE_REQUEST = 0x0B;
 
+const uint8_t RS_PKT_SUBTYPE_FT_DATA_REQUESTS      = 0x0C;
+
 //const uint8_t RS_PKT_SUBTYPE_FT_TRANSFER           = 0x03;
 //const uint8_t RS_PKT_SUBTYPE_FT_CRC32_MAP_REQUEST  = 0x06;
 //const uint8_t RS_PKT_SUBTYPE_FT_CRC32_MAP          = 0x07;
@@ -81,6 +83,28 @@ class RsFileTransferDataRequestItem: public RsFileTransferItem
 	RsTlvFileItem file;   /* file information */
 };
 
+// Several slices of the same file requested at once. Only sent to peers whose file transfer service
+// has minor version 1 or more.
+//
+class RsFileTransferDataRequestsItem: public RsFileTransferItem
+{
+	public:
+	RsFileTransferDataRequestsItem() :RsFileTransferItem(RS_PKT_SUBTYPE_FT_DATA_REQUESTS)
+	{ 
+		setPriorityLevel(QOS_PRIORITY_RS_FILE_REQUEST) ;
+	}
+	virtual ~RsFileTransferDataRequestsItem() {}
+	virtual void clear();
+
+    void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+	// Private data part.
+	//
+	RsTlvFileItem file;                 /* file information */
+	std::vector<uint64_t> fileoffsets;  /* start of each slice */
+	std::vector<uint32_t> chunksizes;   /* size of each slice */
+};
+
 /**************************************************************************/
 
 class RsFileTransferDataItem: public RsFileTransferItem
@@ -44,6 +44,7 @@ RsItem *RsGxsIdSerialiser::create_item(uint16_t service_id,uint8_t item_subtype)
     {
     case RS_PKT_SUBTYPE_GXSID_GROUP_ITEM     : return new RsGxsIdGroupItem ();
     case RS_PKT_SUBTYPE_GXSID_LOCAL_INFO_ITEM: return new RsGxsIdLocalInfoItem() ;
+    case RS_PKT_SUBTYPE_GXSID_PGP_INDEX_ITEM : return new RsGxsIdPgpIndexItem() ;
     default:
         return NULL ;
     }
@@ -52,6 +53,10 @@ void RsGxsIdLocalInfoItem::clear()
 {
     mTimeStamps.clear() ;
 }
+void RsGxsIdPgpIndexItem::clear()
+{
+    mIdsWaitingForPgpKey.clear() ;
+}
 void RsGxsIdGroupItem::clear()
 {
     mPgpIdHash.clear();
@@ -66,6 +71,11 @@ void RsGxsIdLocalInfoItem::serial_process(RsGenericSerializer::SerializeJob j,Rs
     RsTypeSerializer::serial_process(j,ctx,mContacts,"mContacts") ;
 }
 
+void RsGxsIdPgpIndexItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process(j,ctx,mIdsWaitingForPgpKey,"mIdsWaitingForPgpKey") ;
+}
+
 void RsGxsIdGroupItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
 {
     RsTypeSerializer::serial_process(j,ctx,mPgpIdHash,"mPgpIdHash") ;
@@ -40,6 +40,7 @@ const uint8_t RS_PKT_SUBTYPE_GXSID_GROUP_ITEM      = 0x02;
 const uint8_t RS_PKT_SUBTYPE_GXSID_OPINION_ITEM    = 0x03;
 const uint8_t RS_PKT_SUBTYPE_GXSID_COMMENT_ITEM    = 0x04;
 const uint8_t RS_PKT_SUBTYPE_GXSID_LOCAL_INFO_ITEM = 0x05;
+const uint8_t RS_PKT_SUBTYPE_GXSID_PGP_INDEX_ITEM  = 0x06;
 
 class RsGxsIdItem: public RsGxsGrpItem
 {
@@ -87,6 +88,24 @@ public:
     std::set<RsGxsId> mContacts ;
 };
 
+// Signed identities whose PGP signature was issued by a key that is not in our keyring. Saved so that these identities
+// are only checked again when the key shows up.
+
+class RsGxsIdPgpIndexItem : public RsGxsIdItem
+{
+
+public:
+
+    RsGxsIdPgpIndexItem():  RsGxsIdItem(RS_PKT_SUBTYPE_GXSID_PGP_INDEX_ITEM) {}
+    virtual ~RsGxsIdPgpIndexItem() {}
+
+    virtual void clear();
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+    std::map<RsGxsId,RsPgpId> mIdsWaitingForPgpKey ;
+};
+
 #if 0
 class RsGxsIdOpinionItem : public RsGxsMsgItem
 {
@@ -18,6 +18,11 @@ const uint8_t RsNxsSyncGrpItem::FLAG_USE_SYNC_HASH       = 0x0001;
 const uint8_t RsNxsSyncMsgItem::FLAG_USE_SYNC_HASH       = 0x0001;
 
 const uint8_t RsNxsSyncMsgReqItem::FLAG_USE_HASHED_GROUP_ID = 0x02;
+const uint8_t RsNxsSyncMsgReqItem::FLAG_SKETCH_CAPABLE      = 0x04;
+
+const uint8_t RsNxsSyncMsgSketchItem::FLAG_SKETCH          = 0x01;
+const uint8_t RsNxsSyncMsgSketchItem::FLAG_REQUEST_BUCKETS = 0x02;
+const uint8_t RsNxsSyncMsgSketchItem::FLAG_UP_TO_DATE      = 0x04;
 
 /** transaction state **/
 const uint16_t RsNxsTransacItem::FLAG_BEGIN_P1         = 0x0001;
@@ -49,6 +54,7 @@ RsItem *RsNxsSerialiser::create_item(uint16_t service_id,uint8_t item_subtype) c
         case RS_PKT_SUBTYPE_NXS_SYNC_GRP_ITEM:       return new RsNxsSyncGrpItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM:   return new RsNxsSyncMsgReqItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM:       return new RsNxsSyncMsgItem(SERVICE_TYPE) ;
+        case RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_ITEM:return new RsNxsSyncMsgSketchItem(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_GRP_ITEM:            return new RsNxsGrp(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_MSG_ITEM:            return new RsNxsMsg(SERVICE_TYPE) ;
         case RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM:        return new RsNxsTransacItem(SERVICE_TYPE) ;
@@ -70,6 +76,19 @@ void RsNxsSyncMsgItem::serial_process(RsGenericSerializer::SerializeJob j,RsGene
     RsTypeSerializer::serial_process          (j,ctx,authorId         ,"authorId") ;
 }
 
+void RsNxsSyncMsgSketchItem::serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx)
+{
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,transactionNumber,"transactionNumber") ;
+    RsTypeSerializer::serial_process<uint8_t> (j,ctx,flag             ,"flag") ;
+    RsTypeSerializer::serial_process          (j,ctx,grpId            ,"grpId") ;
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,createdSinceTS   ,"createdSinceTS") ;
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,updateTS         ,"updateTS") ;
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,messageCount     ,"messageCount") ;
+    RsTypeSerializer::serial_process<uint32_t>(j,ctx,numBuckets       ,"numBuckets") ;
+    RsTypeSerializer::serial_process          (j,ctx,bucketHashes     ,"bucketHashes") ;
+    RsTypeSerializer::serial_process          (j,ctx,buckets          ,"buckets") ;
+}
+
 void RsNxsMsg::serial_process( RsGenericSerializer::SerializeJob j,
                                RsGenericSerializer::SerializeContext& ctx )
 {
@@ -210,6 +229,18 @@ void RsNxsSyncMsgItem::clear()
     authorId.clear();
 }
 
+void RsNxsSyncMsgSketchItem::clear()
+{
+    flag = 0;
+    grpId.clear();
+    createdSinceTS = 0;
+    updateTS = 0;
+    messageCount = 0;
+    numBuckets = 0;
+    bucketHashes.clear();
+    buckets.clear();
+}
+
 void RsNxsTransacItem::clear(){
     transactFlag = 0;
     nItems = 0;
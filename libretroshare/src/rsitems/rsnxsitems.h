@@ -47,6 +47,7 @@ const uint8_t RS_PKT_SUBTYPE_NXS_GRP_ITEM             = 0x04;
 const uint8_t RS_PKT_SUBTYPE_NXS_ENCRYPTED_DATA_ITEM  = 0x05;
 const uint8_t RS_PKT_SUBTYPE_NXS_SESSION_KEY_ITEM     = 0x06;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_ITEM        = 0x08;
+const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_ITEM = 0x09;
 const uint8_t RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM    = 0x10;
 const uint8_t RS_PKT_SUBTYPE_NXS_MSG_ITEM             = 0x20;
 const uint8_t RS_PKT_SUBTYPE_NXS_TRANSAC_ITEM         = 0x40;
@@ -323,6 +324,7 @@ public:
     static const uint8_t FLAG_USE_SYNC_HASH;
 #endif
     static const uint8_t FLAG_USE_HASHED_GROUP_ID;
+    static const uint8_t FLAG_SKETCH_CAPABLE;	// the requesting peer accepts a RsNxsSyncMsgSketchItem instead of the list of msg ids
 
     RsNxsSyncMsgReqItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_REQ_ITEM) { clear(); }
 
@@ -361,6 +363,40 @@ public:
 
 };
 
+/*!
+ * Compact summary of the msg ids of a group, used to sync groups that contain many messages without sending the
+ * whole list of msg ids. Msg ids are spread into numBuckets buckets according to their first bytes, and each bucket
+ * is summarised by the XOR of the next 8 bytes of the ids it contains (see RsGxsMsgIdSketch).
+ *
+ * - FLAG_SKETCH is sent by the server, in place of the list of msg ids, to peers that announced FLAG_SKETCH_CAPABLE
+ *   in their RsNxsSyncMsgReqItem.
+ * - FLAG_REQUEST_BUCKETS is sent back by the client with the buckets that differ from its own. The server answers
+ *   with the usual msg list transaction, restricted to the msg ids of these buckets.
+ */
+class RsNxsSyncMsgSketchItem : public RsNxsItem
+{
+public:
+
+    static const uint8_t FLAG_SKETCH;
+    static const uint8_t FLAG_REQUEST_BUCKETS;
+    static const uint8_t FLAG_UP_TO_DATE;		// answer to FLAG_REQUEST_BUCKETS when the server has no msg id to send for these buckets
+
+    RsNxsSyncMsgSketchItem(uint16_t servtype) : RsNxsItem(servtype, RS_PKT_SUBTYPE_NXS_SYNC_MSG_SKETCH_ITEM) { clear(); }
+
+    virtual void clear();
+
+	virtual void serial_process(RsGenericSerializer::SerializeJob j,RsGenericSerializer::SerializeContext& ctx);
+
+    uint8_t flag;
+    RsGxsGroupId grpId;
+    uint32_t createdSinceTS;			// same as in the RsNxsSyncMsgReqItem the sketch answers to
+    uint32_t updateTS;					// server's msg update TS at the time the sketch was computed
+    uint32_t messageCount;				// number of msg ids summarised in the sketch
+    uint32_t numBuckets;				// always a power of 2
+    std::vector<uint64_t> bucketHashes;	// FLAG_SKETCH only: one hash per bucket
+    std::vector<uint32_t> buckets;		// FLAG_REQUEST_BUCKETS only: buckets for which the msg ids are needed
+};
+
 
 /*!
  * Used to respond to a RsGrpMsgsReq
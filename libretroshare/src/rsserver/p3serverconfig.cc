@@ -26,6 +26,7 @@
 #include <retroshare/rsturtle.h>
 #include "rsserver/p3serverconfig.h"
 #include "services/p3bwctrl.h"
+#include "gxs/rsgenexchange.h"
 
 #include "pqi/authgpg.h"
 #include "pqi/authssl.h"
@@ -39,6 +40,9 @@ static const std::string pqih_ftr("PQIH_FTR");
 
 #define MIN_MINIMAL_RATE	(5.0)
 
+#define RS_CONFIG_GXS_VALIDATION_THREADS_STRING	"GxsValidationThreads"
+#define MAX_GXS_VALIDATION_THREADS	32
+
 
 p3ServerConfig::p3ServerConfig(p3PeerMgr *peerMgr, p3LinkMgr *linkMgr, p3NetMgr *netMgr, pqihandler *pqih, p3GeneralConfig *genCfg)
 :configMtx("p3ServerConfig")
@@ -92,6 +96,16 @@ void p3ServerConfig::load_config()
 	/* enable operating mode */
 	uint32_t opMode = getOperatingMode();
 	switchToOperatingMode(opMode);
+
+	/* GXS signature checking threads. Without setting, the pool keeps its default. */
+	applyValidationThreadCount(mGeneralConfig->getSetting(RS_CONFIG_GXS_VALIDATION_THREADS_STRING));
+}
+
+void p3ServerConfig::applyValidationThreadCount(const std::string& opt)
+{
+	unsigned int n;
+	if (1 == sscanf(opt.c_str(), "%u", &n))
+		RsGenExchange::setValidationThreadCount(std::min(n, (unsigned int) MAX_GXS_VALIDATION_THREADS));
 }
 
 
@@ -106,6 +120,10 @@ bool p3ServerConfig::findConfigurationOption(uint32_t key, std::string &keystr)
 			keystr = RS_CONFIG_ADVANCED_STRING;
 			found = true;
 			break;
+		case RS_CONFIG_GXS_VALIDATION_THREADS:
+			keystr = RS_CONFIG_GXS_VALIDATION_THREADS_STRING;
+			found = true;
+			break;
 	}
 	return found;
 }
@@ -137,6 +155,10 @@ bool p3ServerConfig::setConfigurationOption(uint32_t key, const std::string &opt
 	}
 
 	mGeneralConfig->setSetting(strkey, opt);
+
+	if (key == RS_CONFIG_GXS_VALIDATION_THREADS)
+		applyValidationThreadCount(opt);
+
 	return true;
 }
 
@@ -104,6 +104,7 @@ virtual int GetCurrentDataRates( float &inKb, float &outKb );
 bool switchToOperatingMode(uint32_t opMode);
 
 bool findConfigurationOption(uint32_t key, std::string &keystr);
+void applyValidationThreadCount(const std::string& opt);
 
 	p3PeerMgr *mPeerMgr;
 	p3LinkMgr *mLinkMgr;
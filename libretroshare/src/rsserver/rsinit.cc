@@ -953,7 +953,7 @@ int RsServer::StartupRetroShare()
 	std::cerr << "setup classes / structures" << std::endl;
 
 	/* History Manager */
-	mHistoryMgr = new p3HistoryMgr();
+	mHistoryMgr = new p3HistoryMgr(RsDirUtil::makePath(rsAccounts->PathAccountDirectory(), "history"));
 	mPeerMgr = new p3PeerMgrIMPL( AuthSSL::getAuthSSL()->OwnId(),
 				AuthGPG::getAuthGPG()->getGPGOwnId(),
 				AuthGPG::getAuthGPG()->getGPGOwnName(),
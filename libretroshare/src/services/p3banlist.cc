@@ -791,6 +791,41 @@ bool p3BanList::saveList(bool &cleanup, std::list<RsItem*>& itemlist)
     return true ;
 }
 
+bool p3BanList::saveDeltaList(std::list<RsItem*>& itemlist)
+{
+    RsStackMutex stack(mBanMtx); /****** LOCKED MUTEX *******/
+
+    // loadList() replaces the list of a source by the last one it reads.
+
+    for(std::set<RsPeerId>::const_iterator sit(mChangedBanSources.begin());sit!=mChangedBanSources.end();++sit)
+    {
+        std::map<RsPeerId,BanList>::const_iterator it = mBanSources.find(*sit) ;
+
+        if(it == mBanSources.end())
+            continue ;
+
+        RsBanListConfigItem *item = new RsBanListConfigItem ;
+
+        item->type         = RSBANLIST_TYPE_PEERLIST ;
+        item->peerId       = it->second.mPeerId ;
+        item->update_time  = it->second.mLastUpdate ;
+        item->banned_peers.TlvClear() ;
+
+        for(std::map<sockaddr_storage,BanListPeer>::const_iterator it2 = it->second.mBanPeers.begin();it2!=it->second.mBanPeers.end();++it2)
+        {
+            RsTlvBanListEntry e ;
+            it2->second.toRsTlvBanListEntry(e) ;
+
+            item->banned_peers.mList.push_back(e) ;
+        }
+
+        itemlist.push_back(item) ;
+    }
+    mChangedBanSources.clear() ;
+
+    return true ;
+}
+
 bool p3BanList::loadList(std::list<RsItem*>& load)
 {
     RsStackMutex stack(mBanMtx); /****** LOCKED MUTEX *******/
@@ -963,7 +998,11 @@ bool p3BanList::addBanEntry(const RsPeerId &peerId, const struct sockaddr_storag
 	}
 
 	if (updated)
-		IndicateConfigChanged() ;
+	{
+		// ban lists from friends change often. Only the list of this source is saved.
+		mChangedBanSources.insert(peerId) ;
+		IndicateConfigDeltaChanged() ;
+	}
 
 	return updated;
 }
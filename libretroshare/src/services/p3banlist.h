@@ -30,6 +30,7 @@
 #include <string>
 #include <list>
 #include <map>
+#include <set>
 
 #include "rsitems/rsbanlistitems.h"
 #include "services/p3service.h"
@@ -92,6 +93,7 @@ public:
     virtual RsSerialiser *setupSerialiser();
     virtual bool saveList(bool &cleanup, std::list<RsItem *>& itemlist);
     virtual bool loadList(std::list<RsItem *>& load);
+    virtual bool saveDeltaList(std::list<RsItem *>& itemlist);
 
     /***** overloaded from p3Service *****/
     /*!
@@ -145,6 +147,7 @@ private:
     //p3NetMgr *mNetMgr;
     time_t mSentListTime;
     std::map<RsPeerId, BanList> mBanSources;
+    std::set<RsPeerId> mChangedBanSources;	// ban lists not saved yet, which don't need a full save
     std::map<struct sockaddr_storage, BanListPeer> mBanSet;
     std::map<struct sockaddr_storage, BanListPeer> mBanRanges;
     std::map<struct sockaddr_storage, BanListPeer> mWhiteListedRanges;
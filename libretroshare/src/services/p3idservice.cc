@@ -323,6 +323,13 @@ bool p3IdService::loadList(std::list<RsItem*>& items)
             mContacts = lii->mContacts ;
         }
 
+        RsGxsIdPgpIndexItem *pii = dynamic_cast<RsGxsIdPgpIndexItem*>(*it) ;
+
+        if(pii != NULL)
+        {
+            mIdsWaitingForPgpKey = pii->mIdsWaitingForPgpKey ;
+        }
+
 	    RsConfigKeyValueSet *vitem = dynamic_cast<RsConfigKeyValueSet *>(*it);
 
 	    if(vitem)
@@ -380,6 +387,11 @@ bool p3IdService::saveList(bool& cleanup,std::list<RsItem*>& items)
 
     items.push_back(item) ;
 
+    RsGxsIdPgpIndexItem *pitem = new RsGxsIdPgpIndexItem ;
+    pitem->mIdsWaitingForPgpKey = mIdsWaitingForPgpKey ;
+
+    items.push_back(pitem) ;
+
     RsConfigKeyValueSet *vitem = new RsConfigKeyValueSet ;
 	RsTlvKeyValue kv;
 
@@ -3347,11 +3359,15 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 	// We Will do this later!
 
 	std::vector<RsGxsIdGroup> groups;
-	bool groupsToProcess = false;
 	bool ok = getGroupData(token, groups);
 
 	if(ok)
 	{
+		// update PgpIdList first, so that ids waiting for a key that just arrived are processed now. Only new keys
+		// are looked at, so this is cheap.
+		getPgpIdList();
+
+		std::set<RsGxsId> realIds ;
 #ifdef DEBUG_IDS
 		std::cerr << "p3IdService::pgphash_request() Have " << groups.size() << " Groups";
 		std::cerr << std::endl;
@@ -3374,6 +3390,7 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 #endif // DEBUG_IDS
 				continue;
 			}
+			realIds.insert(RsGxsId(vit->mMeta.mGroupId)) ;
 
 			/* now we need to decode the Service String - see what is saved there */
 			SSGxsIdGroup ssdata;
@@ -3388,6 +3405,25 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 					continue;
 				}
 
+				/* ids signed by a key we do not have cannot be linked: wait for the key, which bypasses the attempt policy */
+				{
+					RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+
+					std::map<RsGxsId,RsPgpId>::const_iterator wit = mIdsWaitingForPgpKey.find(RsGxsId(vit->mMeta.mGroupId)) ;
+
+					if(wit != mIdsWaitingForPgpKey.end())
+					{
+						if(mPgpFingerprintMap.find(wit->second) == mPgpFingerprintMap.end())
+							continue ;
+
+#ifdef DEBUG_IDS
+						std::cerr << "p3IdService::pgphash_request() key " << wit->second << " arrived for Group: " << vit->mMeta.mGroupId << std::endl;
+#endif // DEBUG_IDS
+						mGroupsToProcess.push_back(*vit);
+						continue ;
+					}
+				}
+
 				/* Have a linear attempt policy -	
 				 * if zero checks - try now.
 				 * if 1 check, at least a day.
@@ -3425,8 +3461,27 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 
 			RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
 			mGroupsToProcess.push_back(*vit);
-			groupsToProcess = true;
 		}
+
+		// forget the waiting ids that have been deleted
+
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+		bool changed = false ;
+
+		for(std::map<RsGxsId,RsPgpId>::iterator it(mIdsWaitingForPgpKey.begin());it!=mIdsWaitingForPgpKey.end();)
+			if(realIds.find(it->first) == realIds.end())
+			{
+				std::map<RsGxsId,RsPgpId>::iterator tmp(it) ;
+				++tmp ;
+				mIdsWaitingForPgpKey.erase(it) ;
+				it = tmp ;
+				changed = true ;
+			}
+			else
+				++it ;
+
+		if(changed)
+			slowIndicateConfigChanged() ;
 	}
 	else
 	{
@@ -3434,12 +3489,6 @@ bool p3IdService::pgphash_handlerequest(uint32_t token)
 		std::cerr << std::endl;
 	}
 
-	if (groupsToProcess)
-	{
-		// update PgpIdList -> if there are groups to process.
-		getPgpIdList();
-	}
-
 	// Schedule Processing.
 	RsTickEvent::schedule_in(GXSID_EVENT_PGPHASH_PROC, PGPHASH_PROC_PERIOD);
 	return true;
@@ -3521,6 +3570,27 @@ bool p3IdService::pgphash_process()
 		ssdata.pgp.pgpId = pgpId;	// read from the signature, but not verified
 	}
 
+	{
+		/* keep track of the ids that wait for the issuer key of their signature */
+
+		RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
+		RsGxsId id(pg.mMeta.mGroupId);
+
+		bool waiting = !error && !ssdata.pgp.validatedSignature && !pgpId.isNull() && mPgpFingerprintMap.find(pgpId) == mPgpFingerprintMap.end();
+		std::map<RsGxsId,RsPgpId>::iterator wit = mIdsWaitingForPgpKey.find(id);
+
+		if(waiting && (wit == mIdsWaitingForPgpKey.end() || wit->second != pgpId))
+		{
+			mIdsWaitingForPgpKey[id] = pgpId;
+			slowIndicateConfigChanged();
+		}
+		else if(!waiting && wit != mIdsWaitingForPgpKey.end())
+		{
+			mIdsWaitingForPgpKey.erase(wit);
+			slowIndicateConfigChanged();
+		}
+	}
+
     if(!error)
     {
         // update IdScore too.
@@ -3589,8 +3659,26 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 
 	RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
 
-	std::map<RsPgpId, PGPFingerprintType>::iterator mit;
-	for(mit = mPgpFingerprintMap.begin(); mit != mPgpFingerprintMap.end(); ++mit)
+	// The signature names its issuer, so the only candidate key is a direct lookup. All keys are only tried when the
+	// signature cannot be parsed.
+
+	std::map<RsPgpId, PGPFingerprintType>::iterator mit, mend;
+
+	if(!pgpId.isNull())
+	{
+		mit = mPgpFingerprintMap.find(pgpId);
+		mend = mit;
+
+		if(mend != mPgpFingerprintMap.end())
+			++mend;
+	}
+	else
+	{
+		mit = mPgpFingerprintMap.begin();
+		mend = mPgpFingerprintMap.end();
+	}
+
+	for(; mit != mend; ++mit)
 	{
 		Sha1CheckSum hash;
         calcPGPHash(RsGxsId(grp.mMeta.mGroupId), mit->second, hash);
@@ -3645,7 +3733,7 @@ bool p3IdService::checkId(const RsGxsIdGroup &grp, RsPgpId &pgpId,bool& error)
 	}
 
 #ifdef DEBUG_IDS
-	std::cerr << "p3IdService::checkId() Checked " << mPgpFingerprintMap.size() << " Hashes without Match";
+	std::cerr << "p3IdService::checkId() No Match for issuer " << pgpId;
 	std::cerr << std::endl;
 #endif // DEBUG_IDS
 
@@ -3666,17 +3754,35 @@ void p3IdService::getPgpIdList()
 
 	RsStackMutex stack(mIdMtx); /********** STACK LOCKED MTX ******/
 
-	mPgpFingerprintMap.clear();
+	// Only the keys that are not indexed yet need their fingerprint. Keys that left the keyring are removed.
+
+	std::set<RsPgpId> current(list.begin(),list.end());
+
+	for(std::map<RsPgpId, PGPFingerprintType>::iterator mit(mPgpFingerprintMap.begin()); mit != mPgpFingerprintMap.end();)
+		if(current.find(mit->first) == current.end())
+		{
+			std::map<RsPgpId, PGPFingerprintType>::iterator tmp(mit);
+			++tmp;
+			mPgpFingerprintMap.erase(mit);
+			mit = tmp;
+		}
+		else
+			++mit;
 
  	std::list<RsPgpId>::iterator it;
 	for(it = list.begin(); it != list.end(); ++it)
 	{
+		if(mPgpFingerprintMap.find(*it) != mPgpFingerprintMap.end())
+			continue;
+
  		RsPgpId pgpId(*it);
 		PGPFingerprintType fp;
-		mPgpUtils->getKeyFingerprint(pgpId, fp);
+
+		if(!mPgpUtils->getKeyFingerprint(pgpId, fp))
+			continue;
 
 #ifdef DEBUG_IDS
-		std::cerr << "p3IdService::getPgpIdList() Id: " << pgpId.toStdString() << " => " << fp.toStdString();
+		std::cerr << "p3IdService::getPgpIdList() New Id: " << pgpId.toStdString() << " => " << fp.toStdString();
 		std::cerr << std::endl;
 #endif // DEBUG_IDS
 
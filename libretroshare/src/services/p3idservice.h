@@ -465,9 +465,15 @@ private:
 
 	/* MUTEX PROTECTED DATA (mIdMtx - maybe should use a 2nd?) */
 
+	// Fingerprints of all PGP keys in the keyring, indexed by PGP id. Updated incrementally by getPgpIdList(). An
+	// identity is linked by looking up the issuer of its signature in there, so that only one hash is computed per id.
 	std::map<RsPgpId, PGPFingerprintType> mPgpFingerprintMap;
 	std::list<RsGxsIdGroup> mGroupsToProcess;
 
+	// Signed identities whose issuer key is not in mPgpFingerprintMap. They are not checked again until the key
+	// shows up. Saved in config.
+	std::map<RsGxsId, RsPgpId> mIdsWaitingForPgpKey;
+
 	/************************************************************************
  * recogn processing.
  *
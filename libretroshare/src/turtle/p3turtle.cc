@@ -54,6 +54,7 @@
 #include "util/rsdebug.h"
 #include "util/rsprint.h"
 #include "util/rsrandom.h"
+#include "serialiser/rsbaseserial.h"
 #include "pqi/pqinetwork.h"
 
 #ifdef TUNNEL_STATISTICS
@@ -1093,7 +1094,9 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 		if(item->shouldStampTunnel())
 			tunnel.time_stamp = time(NULL) ;
 
-		tunnel.transfered_bytes += RsTurtleSerialiser().size(item);
+		uint32_t item_size = RsTurtleSerialiser().size(item);
+
+		tunnel.transfered_bytes += item_size ;
 
 		if(item->PeerId() == tunnel.local_dst)
 			item->setTravelingDirection(RsTurtleGenericTunnelItem::DIRECTION_CLIENT) ;
@@ -1119,7 +1122,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 #endif
 			item->PeerId(tunnel.local_src) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item) ;
+			_traffic_info_buffer.unknown_updn_Bps += item_size ;
 
 			// This has been disabled for compilation reasons. Not sure we actually need it.
 			//
@@ -1137,7 +1140,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 #endif
 			item->PeerId(tunnel.local_dst) ;
 
-			_traffic_info_buffer.unknown_updn_Bps += RsTurtleSerialiser().size(item);
+			_traffic_info_buffer.unknown_updn_Bps += item_size ;
 
 			sendItem(item) ;
 			return ;
@@ -1145,7 +1148,7 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 
         // item is for us. Use the locked region to record the data.
 
-        _traffic_info_buffer.data_dn_Bps += RsTurtleSerialiser().size(item);
+        _traffic_info_buffer.data_dn_Bps += item_size ;
     }
 
 	// The packet was not forwarded, so it is for us. Let's treat it.
@@ -1157,6 +1160,86 @@ void p3turtle::routeGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 	delete item ;
 }
 
+// All generic tunnel items are serialised with the tunnel id first, right after the packet header. This gives what the
+// router needs to know about them in order to forward them without deserialising.
+
+static bool rawTunnelItemInfo(uint8_t item_subtype,bool& stamp_tunnel,uint8_t& priority)
+{
+	switch(item_subtype)
+	{
+	case RS_TURTLE_SUBTYPE_FILE_REQUEST:      stamp_tunnel = false ; priority = QOS_PRIORITY_RS_TURTLE_FILE_REQUEST ;     return true ;
+	case RS_TURTLE_SUBTYPE_FILE_DATA:         stamp_tunnel = true  ; priority = QOS_PRIORITY_RS_TURTLE_FILE_DATA ;        return true ;
+	case RS_TURTLE_SUBTYPE_GENERIC_DATA:      stamp_tunnel = true  ; priority = QOS_PRIORITY_RS_TURTLE_FILE_REQUEST ;     return true ;
+	case RS_TURTLE_SUBTYPE_FILE_MAP:          stamp_tunnel = false ; priority = QOS_PRIORITY_RS_TURTLE_FILE_MAP ;         return true ;
+	case RS_TURTLE_SUBTYPE_FILE_MAP_REQUEST:  stamp_tunnel = false ; priority = QOS_PRIORITY_RS_TURTLE_FILE_MAP_REQUEST ; return true ;
+	case RS_TURTLE_SUBTYPE_CHUNK_CRC:         stamp_tunnel = true  ; priority = QOS_PRIORITY_RS_CHUNK_CRC ;               return true ;
+	case RS_TURTLE_SUBTYPE_CHUNK_CRC_REQUEST: stamp_tunnel = false ; priority = QOS_PRIORITY_RS_CHUNK_CRC_REQUEST ;       return true ;
+	default:
+		return false ;
+	}
+}
+
+bool p3turtle::recv(RsRawItem *item)
+{
+	if(routeRawTunnelItem(item))
+		return true ;
+
+	return p3Service::recv(item) ;
+}
+
+bool p3turtle::routeRawTunnelItem(RsRawItem *item)
+{
+	bool stamp_tunnel ;
+	uint8_t priority ;
+
+	if(getRsItemService(item->PacketId()) != RS_SERVICE_TYPE_TURTLE || !rawTunnelItemInfo(getRsItemSubType(item->PacketId()),stamp_tunnel,priority))
+		return false ;
+
+	uint32_t size = item->getRawLength() ;
+	uint32_t offset = 8 ;	// skip packet header
+	uint32_t tunnel_id = 0 ;
+
+	if(size < 12 || getRsItemSize(item->getRawData()) != size || !getRawUInt32(item->getRawData(),size,&offset,&tunnel_id))
+		return false ;
+
+	{
+		RsStackMutex stack(mTurtleMtx); /********** STACK LOCKED MTX ******/
+
+		if(!(_turtle_routing_enabled && _turtle_routing_session_enabled))
+			return false ;
+
+		std::map<TurtleTunnelId,TurtleTunnel>::iterator it(_local_tunnels.find(tunnel_id)) ;
+
+		if(it == _local_tunnels.end())
+			return false ;
+
+		TurtleTunnel& tunnel(it->second) ;
+
+		if(item->PeerId() == tunnel.local_dst && tunnel.local_src != _own_id)
+			item->PeerId(tunnel.local_src) ;
+		else if(item->PeerId() == tunnel.local_src && tunnel.local_dst != _own_id)
+			item->PeerId(tunnel.local_dst) ;
+		else
+			return false ;	// the item is for us, or does not match the tunnel. Both are handled by routeGenericTunnelItem().
+
+		if(stamp_tunnel)
+			tunnel.time_stamp = time(NULL) ;
+
+		tunnel.transfered_bytes += size ;
+		_traffic_info_buffer.unknown_updn_Bps += size ;
+	}
+
+#ifdef P3TURTLE_DEBUG
+	std::cerr << "p3turtle: forwarding raw tunnel item of size " << size << " for tunnel " << (void*)tunnel_id << " to peer " << item->PeerId() << std::endl;
+#endif
+	// Sent off-mutex, since the item goes down to the pqi layer.
+
+	item->setPriorityLevel(priority) ;
+	send(item) ;
+
+	return true ;
+}
+
 void p3turtle::handleRecvGenericTunnelItem(RsTurtleGenericTunnelItem *item)
 {
 #ifdef P3TURTLE_DEBUG
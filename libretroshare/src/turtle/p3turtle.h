@@ -297,6 +297,11 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 
 		virtual void getItemNames(std::map<uint8_t,std::string>& names) const;
 
+		/// Overloads p3FastService::recv(), so that tunnel items only relayed by this node are forwarded as
+		/// raw data, without being deserialised and serialised again.
+		///
+		virtual bool recv(RsRawItem *item) ;
+
 		/************* from p3Config *******************/
 		virtual RsSerialiser *setupSerialiser() ;
 		virtual bool saveList(bool& cleanup, std::list<RsItem*>&) ;
@@ -363,6 +368,10 @@ class p3turtle: public p3Service, public RsTurtle, public p3Config
 		/// Generic routing function for all tunnel packets that derive from RsTurtleGenericTunnelItem
 		void routeGenericTunnelItem(RsTurtleGenericTunnelItem *item) ;
 
+		/// Fast path of the above for tunnel packets that are only relayed by this node. Only the tunnel id is read
+		/// from the raw data. Returns false when the item is not a relayed tunnel item, and needs regular handling.
+		bool routeRawTunnelItem(RsRawItem *item) ;
+
 		/// specific routing functions for handling particular packets.
 		void handleRecvGenericTunnelItem(RsTurtleGenericTunnelItem *item);
 		bool getTunnelServiceInfo(TurtleTunnelId, RsPeerId& virtual_peer_id, RsFileHash& hash, RsTurtleClientService*&) ;
@@ -109,12 +109,15 @@ RetroDb::RetroDb(const std::string &dbPath, int flags, const std::string& key) :
 
 RetroDb::~RetroDb(){
 
+	clearStatementCache();
 	sqlite3_close(mDb);	// no-op if mDb is NULL (https://www.sqlite.org/c3ref/close.html)
 	mDb = NULL ;
 }
 
 void RetroDb::closeDb(){
 
+    clearStatementCache();
+
     int rc= sqlite3_close(mDb);
 	mDb = NULL ;
 
@@ -196,7 +199,8 @@ bool RetroDb::execSQL(const std::string &query){
 }
 
 RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
-                               const std::string& selection, const std::string& orderBy){
+                               const std::string& selection, const std::string& orderBy,
+                               uint32_t limit, uint32_t offset){
 
     if(tableName.empty() || columns.empty()){
         std::cerr << "RetroDb::sqlQuery(): No table or columns given" << std::endl;
@@ -227,9 +231,20 @@ RetroCursor* RetroDb::sqlQuery(const std::string& tableName, const std::list<std
 
     // add 'order by' clause if present
     if(!orderBy.empty())
-        sqlQuery += " ORDER BY " + orderBy + ";";
-    else
-        sqlQuery += ";";
+        sqlQuery += " ORDER BY " + orderBy;
+
+    // sqlite only accepts an offset after a limit, -1 being no limit
+    if(limit > 0 || offset > 0){
+        std::ostringstream ss;
+        ss << " LIMIT " << (limit > 0 ? (int64_t)limit : (int64_t)-1);
+
+        if(offset > 0)
+            ss << " OFFSET " << offset;
+
+        sqlQuery += ss.str();
+    }
+
+    sqlQuery += ";";
 
 #ifdef RETRODB_DEBUG
     std::cerr << "RetroDb::sqlQuery(): " << sqlQuery << std::endl;
@@ -275,7 +290,7 @@ bool RetroDb::sqlInsert(const std::string &table, const std::string& /* nullColu
     // complete insertion query
     std::string sqlQuery = "INSERT INTO " + qColumns + " " + qValues;
 
-    bool ok = execSQL_bind(sqlQuery, paramBindings);
+    bool ok = execSQL_bind(sqlQuery, paramBindings, true);
 
 #ifdef RETRODB_DEBUG
     std::cerr << "RetroDb::sqlInsert(): " << sqlQuery << std::endl;
@@ -315,7 +330,15 @@ bool RetroDb::rollbackTransaction()
     return execSQL("ROLLBACK;");
 }
 
-bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings){
+void RetroDb::clearStatementCache()
+{
+    for(std::map<std::string, sqlite3_stmt*>::iterator it = mStatementCache.begin(); it != mStatementCache.end(); ++it)
+        sqlite3_finalize(it->second);
+
+    mStatementCache.clear();
+}
+
+bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &paramBindings, bool cacheStatement){
 
     // prepare statement
     sqlite3_stmt* stm = NULL;
@@ -324,16 +347,33 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
     std::cerr << "Query: " << query << std::endl;
 #endif
 
-    int rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
+    std::map<std::string, sqlite3_stmt*>::iterator cit = mStatementCache.end();
+
+    if(cacheStatement)
+        cit = mStatementCache.find(query);
+
+    int rc = SQLITE_OK;
+
+    if(cit != mStatementCache.end())
+        stm = cit->second;
+    else
+        rc = sqlite3_prepare_v2(mDb, query.c_str(), query.length(), &stm, NULL);
 
     // check if there are any errors
     if(rc != SQLITE_OK){
         std::cerr << "RetroDb::execSQL_bind(): Error preparing statement\n";
         std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
                   << std::endl;
+
+        for(std::list<RetroBind*>::iterator lit = paramBindings.begin(); lit != paramBindings.end(); ++lit)
+            delete *lit;
+
         return false;
     }
 
+    if(cacheStatement && cit == mStatementCache.end())
+        mStatementCache[query] = stm;
+
     std::list<RetroBind*>::iterator lit = paramBindings.begin();
 
     for(; lit != paramBindings.end(); ++lit){
@@ -391,6 +431,14 @@ bool RetroDb::execSQL_bind(const std::string &query, std::list<RetroBind*> &para
         }
     }
 
+    if(cacheStatement)
+    {
+        // keep the statement for the next call, but release the bound values
+        sqlite3_reset(stm);
+        sqlite3_clear_bindings(stm);
+        return ok;
+    }
+
     // finalise statement or else db cannot be closed
     sqlite3_finalize(stm);
     return ok;
@@ -620,6 +668,46 @@ bool RetroDb::tableExists(const std::string &tableName)
     return result;
 }
 
+bool RetroDb::triggerExists(const std::string &triggerName)
+{
+    if (!isOpen()) {
+        return false;
+    }
+
+    std::string sqlQuery = "SELECT name FROM sqlite_master WHERE type='trigger' AND name=?;";
+
+    bool result = false;
+    sqlite3_stmt* stmt = NULL;
+
+    int rc = sqlite3_prepare_v2(mDb, sqlQuery.c_str(), sqlQuery.length(), &stmt, NULL);
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, triggerName.c_str(), triggerName.length(), SQLITE_TRANSIENT);
+
+        rc = sqlite3_step(stmt);
+        switch (rc) {
+        case SQLITE_ROW:
+            result = true;
+            break;
+        case SQLITE_DONE:
+            break;
+        default:
+            std::cerr << "RetroDb::triggerExists(): Error executing statement (code: " << rc << ")"
+                      << std::endl;
+            break;
+        }
+    } else {
+        std::cerr << "RetroDb::triggerExists(): Error preparing statement\n";
+        std::cerr << "Error code: " <<  sqlite3_errmsg(mDb)
+                  << std::endl;
+    }
+
+    if (stmt) {
+        sqlite3_finalize(stmt);
+    }
+
+    return result;
+}
+
 /********************** RetroCursor ************************/
 
 RetroCursor::RetroCursor(sqlite3_stmt *stmt)
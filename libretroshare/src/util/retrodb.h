@@ -147,11 +147,14 @@ public:
      *        an SQL WHERE clause (excluding the WHERE itself). Passing null will \n
      *        return all rows for the given table.
      * @param order the rows, formatted as an SQL ORDER BY clause (excluding the ORDER BY itself)
+     * @param limit maximum number of rows to return, 0 for all rows
+     * @param offset number of rows to skip at the beginning of the result set
      * @return cursor over result set, this allocated resource should be free'd after use \n
      *         column order is in list order.
      */
     RetroCursor* sqlQuery(const std::string& tableName, const std::list<std::string>& columns,
-                          const std::string& selection, const std::string& orderBy);
+                          const std::string& selection, const std::string& orderBy,
+                          uint32_t limit = 0, uint32_t offset = 0);
 
     /*!
      * delete row in an sql table
@@ -174,6 +177,13 @@ public:
      */
     bool tableExists(const std::string& tableName);
 
+    /*!
+     * Check if trigger exist in database
+     * @param triggerName trigger to check
+     * @return true/false
+     */
+    bool triggerExists(const std::string& triggerName);
+
 public:
 
     static const int OPEN_READONLY;
@@ -182,7 +192,16 @@ public:
 
 private:
 
-    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs);
+    /*!
+     * @param cacheStatement if true, the prepared statement is kept in mStatementCache and re-used the next time the
+     *                       same query is executed, instead of being compiled again
+     */
+    bool execSQL_bind(const std::string &query, std::list<RetroBind*>& blobs, bool cacheStatement = false);
+
+    /*!
+     * Finalises all cached statements. Must be called before closing the database.
+     */
+    void clearStatementCache();
 
     /*!
      * Build the "VALUE" part of an insertiong sql query
@@ -203,6 +222,10 @@ private:
 private:
 
     sqlite3* mDb;
+
+    // Prepared insertion statements, indexed by query. Insertions only differ by their bound values, so bulk inserts
+    // of rows with the same columns compile their statement only once.
+    std::map<std::string, sqlite3_stmt*> mStatementCache;
     const std::string mKey;
 };
 
@@ -1,4 +1,8 @@
 #include <iostream>
+#include <algorithm>
+#ifdef WINDOWS_SYS
+#include <malloc.h>
+#endif
 #include "smallobject.h"
 #include "util/rsthreads.h"
 #include "util/rsmemory.h"
@@ -6,11 +10,66 @@
 using namespace RsMemoryManagement ;
 
 RsMutex SmallObject::_mtx("SmallObject") ;
-SmallObjectAllocator SmallObject::_allocator(RsMemoryManagement::MAX_SMALL_OBJECT_SIZE) ;
+std::vector<SmallObjectAllocator*> SmallObject::_allocators ;
+std::vector<SmallObjectAllocator*> SmallObject::_unusedAllocators ;
+pthread_key_t SmallObject::_threadKey ;
+pthread_once_t SmallObject::_threadKeyOnce = PTHREAD_ONCE_INIT ;
+bool SmallObject::_active = true ;
+
+static void *alignedAlloc(size_t size,size_t alignment)
+{
+#ifdef WINDOWS_SYS
+	return _aligned_malloc(size,alignment) ;
+#else
+	void *p = NULL ;
+
+	if(posix_memalign(&p,alignment,size) != 0)
+		return NULL ;
+
+	return p ;
+#endif
+}
+
+static void alignedFree(void *p)
+{
+#ifdef WINDOWS_SYS
+	_aligned_free(p) ;
+#else
+	::free(p) ;
+#endif
+}
+
+size_t Chunk::regionSize(size_t blockSize)
+{
+	size_t size = 256 ;
+
+	while(size < CHUNK_HEADER_SIZE + blockSize*BLOCKS_PER_CHUNK)
+		size <<= 1 ;
+
+	return size ;
+}
 
-void Chunk::init(size_t blockSize,unsigned char blocks)
+Chunk *Chunk::chunkOfPointer(void *p,size_t blockSize)
 {
-	_data = new unsigned char[blockSize*blocks] ;
+	uintptr_t region = reinterpret_cast<uintptr_t>(p) & ~(uintptr_t)(regionSize(blockSize) - 1) ;
+
+	return *reinterpret_cast<Chunk**>(region) ;
+}
+
+void Chunk::init(FixedAllocator *owner,size_t blockSize,unsigned char blocks)
+{
+	_owner = owner ;
+	_region = static_cast<unsigned char*>(alignedAlloc(regionSize(blockSize),regionSize(blockSize))) ;
+
+	if(_region == NULL)
+	{
+		std::cerr << "RsMemoryManagement: ran out of memory !" << std::endl;
+		exit(-1) ;
+	}
+
+	*reinterpret_cast<Chunk**>(_region) = this ;
+
+	_data = _region + CHUNK_HEADER_SIZE ;
 	_firstAvailableBlock = 0 ;
 	_blocksAvailable = blocks ;
 
@@ -24,7 +83,8 @@ void Chunk::init(size_t blockSize,unsigned char blocks)
 
 void Chunk::free()
 {
-	delete[] _data ;
+	alignedFree(_region) ;
+	_region = NULL ;
 	_data = NULL ;
 }
 
@@ -42,7 +102,7 @@ void *Chunk::allocate(size_t blockSize)
 	// Always the case because the first available block is the first, so the next
 	// available block is given by *result.
 	//
-	_firstAvailableBlock = *result ; 
+	_firstAvailableBlock = *result ;
 	--_blocksAvailable ;
 
 	return result ;
@@ -55,14 +115,14 @@ void Chunk::deallocate(void *p,size_t blockSize)
 	unsigned char *toRelease = static_cast<unsigned char *>(p) ;
 
 	// alignment check
-	
+
 	assert( (toRelease - _data) % blockSize == 0 ) ;
 
 	*toRelease = _firstAvailableBlock ;
 	_firstAvailableBlock = static_cast<unsigned char>( (toRelease - _data)/blockSize) ;
 
 	// truncation check
-	
+
 	assert(_firstAvailableBlock == (toRelease - _data)/blockSize);
 
 	++_blocksAvailable ;
@@ -75,12 +135,13 @@ void Chunk::printStatistics(int blockSize) const
 	std::cerr << "      blocks             : " << (void*)_data << " to " << (void*)(_data+BLOCKS_PER_CHUNK*blockSize) << std::endl;
 }
 
-FixedAllocator::FixedAllocator(size_t bytes)
+FixedAllocator::FixedAllocator(size_t bytes,SmallObjectAllocator *parent)
+	: _remoteFrees(NULL),_allocations(0),_deallocations(0),_remoteDeallocations(0),_numChunks(0)
 {
 	_blockSize = bytes ;
 	_numBlocks = BLOCKS_PER_CHUNK ;
 	_allocChunk = -1 ;
-	_deallocChunk = -1 ;
+	_parent = parent ;
 }
 FixedAllocator::~FixedAllocator()
 {
@@ -93,6 +154,9 @@ FixedAllocator::~FixedAllocator()
 
 void *FixedAllocator::allocate()
 {
+	if(_remoteFrees.load(std::memory_order_relaxed) != NULL)
+		processRemoteDeallocations() ;
+
 	if(_allocChunk < 0 || _chunks[_allocChunk]->_blocksAvailable == 0)
 	{
 		// find availabel memory in this chunk
@@ -115,58 +179,95 @@ void *FixedAllocator::allocate()
 				std::cerr << "RsMemoryManagement: ran out of memory !" << std::endl;
 				exit(-1) ;
 			}
-			newChunk->init(_blockSize,_numBlocks) ;
+			newChunk->init(this,_blockSize,_numBlocks) ;
 			_chunks.push_back(newChunk) ;
+			_numChunks.store(_chunks.size(),std::memory_order_relaxed) ;
 
 			_allocChunk = _chunks.size()-1 ;
-			_deallocChunk = _chunks.size()-1 ;
 		}
 
 	}
 	assert(_chunks[_allocChunk] != NULL) ;
 	assert(_chunks[_allocChunk]->_blocksAvailable > 0) ;
 
+	_allocations.store(_allocations.load(std::memory_order_relaxed)+1,std::memory_order_relaxed) ;
+
 	return _chunks[_allocChunk]->allocate(_blockSize) ;
 }
 void FixedAllocator::deallocate(void *p)
 {
-	if(_deallocChunk < 0 || !chunkOwnsPointer(*_chunks[_deallocChunk],p))
-	{
-		// find the chunk that contains this pointer. Perform a linear search.
+	// The chunk is found directly from the block address, since chunk regions are aligned on their size.
 
-		_deallocChunk = -1 ;
+	Chunk *chunk = Chunk::chunkOfPointer(p,_blockSize) ;
 
-		for(uint32_t i=0;i<_chunks.size();++i)
-			if(chunkOwnsPointer(*_chunks[i],p))
-			{
-				_deallocChunk = i ;
-				break ;
-			}
-	}
-	assert(_chunks[_deallocChunk] != NULL) ;
+	assert(chunk->_owner == this) ;
+	assert(chunkOwnsPointer(*chunk,p)) ;
+
+	chunk->deallocate(p,_blockSize) ;
+
+	_deallocations.store(_deallocations.load(std::memory_order_relaxed)+1,std::memory_order_relaxed) ;
+
+	// Empty chunks are released, except the one currently used for allocation, which avoids allocating/releasing
+	// a chunk over and over when a single object is created and destroyed repeatedly.
+
+	if(chunk->_blocksAvailable == _numBlocks && !(_allocChunk >= 0 && _chunks[_allocChunk] == chunk))
+		releaseChunk(chunk) ;
+}
+
+void FixedAllocator::releaseChunk(Chunk *chunk)
+{
+	for(uint32_t i=0;i<_chunks.size();++i)
+		if(_chunks[i] == chunk)
+		{
+			chunk->free() ;
+			delete chunk ;
+
+			_chunks[i] = _chunks.back() ;
+			if(_allocChunk == ((int)_chunks.size())-1) _allocChunk = i ;
+			_chunks.pop_back();
+			_numChunks.store(_chunks.size(),std::memory_order_relaxed) ;
+			return ;
+		}
+
+	std::cerr << "RsMemoryManagement: cannot find chunk " << (void*)chunk << " to release. This is a bug." << std::endl;
+}
+
+void FixedAllocator::remoteDeallocate(void *p)
+{
+	// Lock-free push. The list is only emptied at once by the owner, so there is no ABA problem.
+
+	void *head = _remoteFrees.load(std::memory_order_relaxed) ;
 
-	_chunks[_deallocChunk]->deallocate(p,_blockSize) ;
+	do
+		*static_cast<void**>(p) = head ;
+	while(!_remoteFrees.compare_exchange_weak(head,p,std::memory_order_release,std::memory_order_relaxed)) ;
 
-	if(_chunks[_deallocChunk]->_blocksAvailable == BLOCKS_PER_CHUNK)
+	_remoteDeallocations.fetch_add(1,std::memory_order_relaxed) ;
+}
+
+void FixedAllocator::processRemoteDeallocations()
+{
+	void *p = _remoteFrees.exchange(NULL,std::memory_order_acquire) ;
+
+	while(p != NULL)
 	{
-		_chunks[_deallocChunk]->free() ;
-		delete _chunks[_deallocChunk] ;
-
-		_chunks[_deallocChunk] = _chunks.back() ;
-		if(_allocChunk == _deallocChunk) _allocChunk = -1 ;
-		if(_allocChunk == ((int)_chunks.size())-1) _allocChunk = _deallocChunk ;
-		_deallocChunk = -1 ;
-		_chunks.pop_back();
+		void *next = *static_cast<void**>(p) ;
+		deallocate(p) ;
+		p = next ;
 	}
 }
+
 uint32_t FixedAllocator::currentSize() const
 {
-    uint32_t res = 0 ;
-
-    for(uint32_t i=0;i<_chunks.size();++i)
-        res += (_numBlocks - _chunks[i]->_blocksAvailable) * _blockSize ;
-
-    return res ;
+    return (_allocations.load(std::memory_order_relaxed) - _deallocations.load(std::memory_order_relaxed)) * _blockSize ;
+}
+void FixedAllocator::getStatistics(SmallObjectStatistics& stats) const
+{
+	stats.block_size            = _blockSize ;
+	stats.allocations          += _allocations.load(std::memory_order_relaxed) ;
+	stats.deallocations        += _deallocations.load(std::memory_order_relaxed) ;
+	stats.remote_deallocations += _remoteDeallocations.load(std::memory_order_relaxed) ;
+	stats.chunks               += _numChunks.load(std::memory_order_relaxed) ;
 }
 void FixedAllocator::printStatistics() const
 {
@@ -180,86 +281,143 @@ void FixedAllocator::printStatistics() const
 SmallObjectAllocator::SmallObjectAllocator(size_t maxObjectSize)
 	: _maxObjectSize(maxObjectSize)
 {
-	RsStackMutex m(SmallObject::_mtx) ;
+	_pool.resize(sizeClass(maxObjectSize)+1,NULL) ;
 
-	_lastAlloc = NULL ;
-	_lastDealloc = NULL ;
-	_active = true ;
+	for(uint32_t i=1;i<_pool.size();++i)
+		_pool[i] = new FixedAllocator(i*SMALL_OBJECT_GRANULARITY,this) ;
 }
 
 SmallObjectAllocator::~SmallObjectAllocator()
 {
-	RsStackMutex m(SmallObject::_mtx) ;
-
-    	//std::cerr << __PRETTY_FUNCTION__ << " not deleting. Leaving it to the system." << std::endl;
-        
-	_active = false ;
-    
-    	uint32_t still_allocated = 0 ;
-        
-	for(std::map<int,FixedAllocator*>::const_iterator it(_pool.begin());it!=_pool.end();++it)
-        	still_allocated += it->second->currentSize() ;
-		//delete it->second ;
-    
-    	std::cerr << "Memory still in use at end of program: " << still_allocated << " bytes." << std::endl;
+	for(uint32_t i=0;i<_pool.size();++i)
+		delete _pool[i] ;
 }
 
 void *SmallObjectAllocator::allocate(size_t bytes)
 {
 	if(bytes > _maxObjectSize)
 		return rs_malloc(bytes) ;
-	else if(_lastAlloc != NULL && _lastAlloc->blockSize() == bytes)
-		return _lastAlloc->allocate() ;
 	else
-	{
-		std::map<int,FixedAllocator*>::iterator it(_pool.find(bytes)) ;
-
-		if(it == _pool.end())
-		{
-			_pool[bytes] = new FixedAllocator(bytes) ;
-			it = _pool.find(bytes) ;
-		}
-		_lastAlloc = it->second ;
-
-		return it->second->allocate() ;
-	}
+		return _pool[std::max(1u,sizeClass(bytes))]->allocate() ;
 }
 
 void SmallObjectAllocator::deallocate(void *p,size_t bytes)
 {
 	if(bytes > _maxObjectSize)
+	{
 		free(p) ;
-	else if(_lastDealloc != NULL && _lastDealloc->blockSize() == bytes)
-		_lastDealloc->deallocate(p) ;
+		return ;
+	}
+
+	// The block may have been allocated by another thread, in which case it goes back to that thread's allocator.
+
+	FixedAllocator *owner = Chunk::chunkOfPointer(p,std::max(1u,sizeClass(bytes))*SMALL_OBJECT_GRANULARITY)->_owner ;
+
+	if(owner->parent() == this)
+		owner->deallocate(p) ;
 	else
+		owner->remoteDeallocate(p) ;
+}
+
+uint32_t SmallObjectAllocator::currentSize() const
+{
+	uint32_t res = 0 ;
+
+	for(uint32_t i=1;i<_pool.size();++i)
+		res += _pool[i]->currentSize() ;
+
+	return res ;
+}
+
+void SmallObjectAllocator::getStatistics(std::vector<SmallObjectStatistics>& stats) const
+{
+	stats.resize(_pool.size()-1) ;
+
+	for(uint32_t i=1;i<_pool.size();++i)
+		_pool[i]->getStatistics(stats[i-1]) ;
+}
+
+void SmallObjectAllocator::printStatistics() const
+{
+	std::vector<SmallObjectStatistics> stats ;
+	getStatistics(stats) ;
+
+	std::cerr << "  Allocator " << (void*)this << ", " << currentSize() << " bytes in use" << std::endl;
+
+	for(uint32_t i=0;i<stats.size();++i)
+		if(stats[i].allocations > 0)
+			std::cerr << "    size " << stats[i].block_size << ": " << stats[i].allocations << " allocs, " << stats[i].deallocations
+			          << " deallocs (" << stats[i].remote_deallocations << " remote), " << stats[i].chunks << " chunks" << std::endl;
+}
+
+void SmallObject::createThreadKey()
+{
+	pthread_key_create(&_threadKey,&SmallObject::releaseThreadAllocator) ;
+}
+
+// Called when a thread terminates. The allocator is kept, since other threads may still use the memory it holds,
+// and will be handed to the next thread that needs one.
+
+void SmallObject::releaseThreadAllocator(void *allocator)
+{
+	RsStackMutex m(_mtx) ;
+
+	_unusedAllocators.push_back(static_cast<SmallObjectAllocator*>(allocator)) ;
+}
+
+SmallObjectAllocator *SmallObject::threadAllocator()
+{
+	pthread_once(&_threadKeyOnce,&SmallObject::createThreadKey) ;
+
+	SmallObjectAllocator *allocator = static_cast<SmallObjectAllocator*>(pthread_getspecific(_threadKey)) ;
+
+	if(allocator != NULL)
+		return allocator ;
+
 	{
-		std::map<int,FixedAllocator*>::iterator it(_pool.find(bytes)) ;
+		RsStackMutex m(_mtx) ;
 
-		if(it == _pool.end())
+		if(!_unusedAllocators.empty())
 		{
-			_pool[bytes] = new FixedAllocator(bytes) ;
-			it = _pool.find(bytes) ;
+			allocator = _unusedAllocators.back() ;
+			_unusedAllocators.pop_back() ;
+		}
+		else
+		{
+			allocator = new SmallObjectAllocator(RsMemoryManagement::MAX_SMALL_OBJECT_SIZE) ;
+			_allocators.push_back(allocator) ;
 		}
-		it->second->deallocate(p) ;
-		_lastDealloc = it->second ;
 	}
+
+	pthread_setspecific(_threadKey,allocator) ;
+	return allocator ;
 }
 
-void SmallObjectAllocator::printStatistics() const
-{
-	std::cerr << "RsMemoryManagement Statistics:" << std::endl;
-	std::cerr << "  Total Fixed-size allocators: " << _pool.size() << std::endl;
-	std::cerr << "Pool" << std::endl;
+// Deactivates the allocator at the end of the program, since objects may still be destroyed after the static
+// members above.
 
-	for(std::map<int,FixedAllocator*>::const_iterator it(_pool.begin());it!=_pool.end();++it)
+namespace RsMemoryManagement
+{
+	struct SmallObjectCleanup
 	{
-		std::cerr << "  Allocator for size " << it->first << " : " << std::endl;
-		std::cerr << "  Last Alloc: " << _lastAlloc << std::endl;
-		std::cerr << "  Last Dealloc: " << _lastDealloc << std::endl;
-		it->second->printStatistics() ;
-	}
+		~SmallObjectCleanup()
+		{
+			RsStackMutex m(SmallObject::_mtx) ;
+
+			SmallObject::_active = false ;
+
+			uint32_t still_allocated = 0 ;
+
+			for(uint32_t i=0;i<SmallObject::_allocators.size();++i)
+				still_allocated += SmallObject::_allocators[i]->currentSize() ;
+
+			std::cerr << "Memory still in use at end of program: " << still_allocated << " bytes." << std::endl;
+		}
+	};
 }
 
+static SmallObjectCleanup smallObjectCleanup ;
+
 void *SmallObject::operator new(size_t size)
 {
 #ifdef DEBUG_MEMORY
@@ -278,46 +436,52 @@ void *SmallObject::operator new(size_t size)
 		printStatistics() ;
 #endif
 
-	RsStackMutex m(_mtx) ;
-    
     	// This should normally not happen. But that prevents a crash when quitting, since we cannot prevent the constructor
     	// of an object to call operator new(), nor to handle the case where it returns NULL.
     	// The memory will therefore not be deleted if that happens. We thus print a warning.
-    
-    	if(_allocator._active)
-		return _allocator.allocate(size) ;
+
+    	if(_active)
+		return threadAllocator()->allocate(size) ;
 	else
         {
             std::cerr << "(EE) allocating " << size << " bytes of memory that cannot be deleted. This is a bug, except if it happens when closing Retroshare" << std::endl;
-	    return malloc(size) ;	
+	    return malloc(size) ;
         }
-        
-#ifdef DEBUG_MEMORY
-	std::cerr << "new RsItem: " << p << ", size=" << size << std::endl;
-#endif
 }
 
 void SmallObject::operator delete(void *p,size_t size)
 {
-	RsStackMutex m(_mtx) ;
-
-	if(!_allocator._active)
+	if(!_active)
 		return ;
 
-	_allocator.deallocate(p,size) ;
+	threadAllocator()->deallocate(p,size) ;
 #ifdef DEBUG_MEMORY
 	std::cerr << "del RsItem: " << p << ", size=" << size << std::endl;
 #endif
 }
 
-void SmallObject::printStatistics() 
+void SmallObject::getStatistics(std::vector<SmallObjectStatistics>& stats)
 {
 	RsStackMutex m(_mtx) ;
 
-	if(!_allocator._active)
+	stats.clear() ;
+
+	for(uint32_t i=0;i<_allocators.size();++i)
+		_allocators[i]->getStatistics(stats) ;
+}
+
+void SmallObject::printStatistics()
+{
+	RsStackMutex m(_mtx) ;
+
+	if(!_active)
 		return ;
 
-	_allocator.printStatistics() ;
+	std::cerr << "RsMemoryManagement Statistics:" << std::endl;
+	std::cerr << "  Thread allocators: " << _allocators.size() << " (" << _unusedAllocators.size() << " unused)" << std::endl;
+
+	for(uint32_t i=0;i<_allocators.size();++i)
+		_allocators[i]->printStatistics() ;
 }
 
 void RsMemoryManagement::printStatistics()
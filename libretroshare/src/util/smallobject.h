@@ -27,9 +27,12 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#include <pthread.h>
 
 #include <vector>
 #include <map>
+#include <atomic>
 
 #include <util/rsthreads.h>
 
@@ -38,14 +41,35 @@ namespace RsMemoryManagement
 	static const int MAX_SMALL_OBJECT_SIZE = 128 ;
 	static const unsigned char BLOCKS_PER_CHUNK = 255 ;
 
+	// Block sizes are rounded up to a multiple of this, which keeps blocks aligned and leaves room for the pointer
+	// used to chain blocks in the remote-free lists.
+
+	static const int SMALL_OBJECT_GRANULARITY = 8 ;
+
+	// Each chunk starts with a pointer to its Chunk structure, so that the chunk (and therefore the owning thread)
+	// of any block can be found by masking the block address.
+
+	static const int CHUNK_HEADER_SIZE = 16 ;
+
+	class FixedAllocator ;
+	class SmallObjectAllocator ;
+
 	struct Chunk
 	{
-		void init(size_t blockSize,unsigned char blocks);
+		void init(FixedAllocator *owner,size_t blockSize,unsigned char blocks);
 		void free() ;
 
 		void *allocate(size_t);
 		void deallocate(void *p,size_t blockSize);
 
+		// Size (and alignment) of the memory region of a chunk for the given block size.
+		static size_t regionSize(size_t blockSize) ;
+
+		// Retrieves the chunk a block belongs to, from the block address only.
+		static Chunk *chunkOfPointer(void *p,size_t blockSize) ;
+
+		FixedAllocator *_owner ;
+		unsigned char *_region ;
 		unsigned char *_data ;
 		unsigned char _firstAvailableBlock ;
 		unsigned char _blocksAvailable ;
@@ -53,31 +77,70 @@ namespace RsMemoryManagement
 		void printStatistics(int blockSize) const ;
 	};
 
+	/*!
+	 * Statistics of a given block size, summed over all threads.
+	 */
+	struct SmallObjectStatistics
+	{
+		SmallObjectStatistics() : block_size(0),allocations(0),deallocations(0),remote_deallocations(0),chunks(0) {}
+
+		uint32_t block_size ;
+		uint64_t allocations ;				// total number of blocks allocated
+		uint64_t deallocations ;			// total number of blocks released, including remote ones
+		uint64_t remote_deallocations ;		// blocks released by another thread than the one that allocated them
+		uint64_t chunks ;					// number of chunks currently in use
+
+		uint64_t bytesInUse() const { return (allocations - deallocations)*block_size ; }
+	};
+
+	/*!
+	 * Allocates blocks of a fixed size. All methods except remoteDeallocate() are only called by the thread that
+	 * owns the parent SmallObjectAllocator. Blocks released by other threads are pushed into a lock-free list, that
+	 * the owner collects on its next allocation.
+	 */
 	class FixedAllocator
 	{
 		public:
-			FixedAllocator(size_t bytes) ;
+			FixedAllocator(size_t bytes,SmallObjectAllocator *parent) ;
 			virtual ~FixedAllocator() ;
 
 			void *allocate();
 			void deallocate(void *p) ;
+			void remoteDeallocate(void *p) ;
+			void processRemoteDeallocations() ;
+
 			inline size_t blockSize() const { return _blockSize ; }
-			
-			inline bool chunkOwnsPointer(const Chunk& c,void *p) const 
-			{ 
-				return p >= c._data && (static_cast<unsigned char *>(p)-c._data)/_blockSize < _numBlocks ; 
+			inline SmallObjectAllocator *parent() const { return _parent ; }
+
+			inline bool chunkOwnsPointer(const Chunk& c,void *p) const
+			{
+				return p >= c._data && (static_cast<unsigned char *>(p)-c._data)/_blockSize < _numBlocks ;
 			}
 
             void printStatistics() const ;
+            void getStatistics(SmallObjectStatistics& stats) const ;
             uint32_t currentSize() const;
     private:
+			void releaseChunk(Chunk *c) ;
+
 			size_t _blockSize ;
 			unsigned char _numBlocks ;
 			std::vector<Chunk*> _chunks ;
 			int _allocChunk ;				// last chunk that provided allocation. -1 if not inited
-			int _deallocChunk ;			// last chunk that provided de-allocation. -1 if not inited
+			SmallObjectAllocator *_parent ;
+
+			std::atomic<void*> _remoteFrees ;	// blocks released by other threads, chained through their first bytes
+
+			std::atomic<uint64_t> _allocations ;
+			std::atomic<uint64_t> _deallocations ;
+			std::atomic<uint64_t> _remoteDeallocations ;
+			std::atomic<uint64_t> _numChunks ;
 	};
 
+	/*!
+	 * Per-thread allocator. Each thread that allocates small objects gets one, and returns it when it terminates, so
+	 * that it can be re-used by a new thread, along with the memory it still holds.
+	 */
 	class SmallObjectAllocator
 	{
 		public:
@@ -88,33 +151,43 @@ namespace RsMemoryManagement
 			void deallocate(void *p,size_t size) ;
 
 			void printStatistics() const ;
+			void getStatistics(std::vector<SmallObjectStatistics>& stats) const ;	// adds to existing values
+			uint32_t currentSize() const ;
 
-			bool _active ;
+			static uint32_t sizeClass(size_t size) { return (size + SMALL_OBJECT_GRANULARITY - 1)/SMALL_OBJECT_GRANULARITY ; }
 		private:
-			std::map<int,FixedAllocator*> _pool ;
-			FixedAllocator *_lastAlloc ;
-			FixedAllocator *_lastDealloc ;
+			std::vector<FixedAllocator*> _pool ;	// indexed by size class. Created at once, so that it can be read by other threads.
 			size_t _maxObjectSize ;
 	};
 
 	class SmallObject
 	{
-		public: 
+		public:
 			static void *operator new(size_t size) ;
 			static void operator delete(void *p,size_t size) ;
 
 			static void printStatistics() ;
+			static void getStatistics(std::vector<SmallObjectStatistics>& stats) ;
 
 			virtual ~SmallObject() {}
 
 		private:
-			static SmallObjectAllocator _allocator ;
-			static RsMutex _mtx;
+			static SmallObjectAllocator *threadAllocator() ;
+			static void createThreadKey() ;
+			static void releaseThreadAllocator(void *allocator) ;
+
+			static RsMutex _mtx;											// protects the lists below
+			static std::vector<SmallObjectAllocator*> _allocators ;		// all allocators ever created
+			static std::vector<SmallObjectAllocator*> _unusedAllocators ;	// allocators of terminated threads
+
+			static pthread_key_t _threadKey ;
+			static pthread_once_t _threadKeyOnce ;
+			static bool _active ;
 
 			friend class SmallObjectAllocator ;
+			friend struct SmallObjectCleanup ;
 	};
 
 	extern void printStatistics() ;
 }
 
-
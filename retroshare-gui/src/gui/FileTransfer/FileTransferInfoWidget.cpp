@@ -280,6 +280,8 @@ void FileTransferInfoWidget::draw(const FileInfo& nfo,const FileChunksInfo& info
 	 {
 		 case FileChunksInfo::CHUNK_STRATEGY_RANDOM:      painter->drawText(tab_size,y,"Random") ; break ;
 		 case FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE: painter->drawText(tab_size,y,"Progressive") ; break ;
+		 case FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST: painter->drawText(tab_size,y,"Rarest first") ; break ;
+		 case FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST: painter->drawText(tab_size,y,"Streaming/rarest first") ; break ;
 		 default:
 		 case FileChunksInfo::CHUNK_STRATEGY_STREAMING:   painter->drawText(tab_size,y,"Streaming") ; break ;
 	 }
@@ -44,6 +44,7 @@ TransferPage::TransferPage(QWidget * parent, Qt::WindowFlags flags)
     QObject::connect(ui._diskSpaceLimit_SB,SIGNAL(valueChanged(int)),this,SLOT(updateDiskSizeLimit(int))) ;
     QObject::connect(ui._max_tr_up_per_sec_SB, SIGNAL( valueChanged( int ) ), this, SLOT( updateMaxTRUpRate(int) ) );
 	QObject::connect(ui._filePermDirectDL_CB,SIGNAL(activated(int)),this,SLOT(updateFilePermDirectDL(int)));
+	QObject::connect(ui.memoryMappedReads_CB,SIGNAL(toggled(bool)),this,SLOT(updateMemoryMappedReads(bool)));
 
 	QObject::connect(ui.incomingButton, SIGNAL(clicked( bool ) ), this , SLOT( setIncomingDirectory() ) );
 	QObject::connect(ui.partialButton, SIGNAL(clicked( bool ) ), this , SLOT( setPartialsDirectory() ) );
@@ -139,6 +140,8 @@ void TransferPage::load()
     case FileChunksInfo::CHUNK_STRATEGY_STREAMING: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(0) ; break ;
     case FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(1) ; break ;
     case FileChunksInfo::CHUNK_STRATEGY_RANDOM: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(2) ; break ;
+    case FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(3) ; break ;
+    case FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST: whileBlocking(ui._defaultStrategy_CB)->setCurrentIndex(4) ; break ;
     }
 
     switch(rsFiles->defaultEncryptionPolicy())
@@ -158,6 +161,15 @@ void TransferPage::load()
 			default:                         whileBlocking(ui._filePermDirectDL_CB)->setCurrentIndex(2) ; break ;
 		}
 
+	whileBlocking(ui.memoryMappedReads_CB)->setChecked(rsFiles->memoryMappedReads()) ;
+
+	uint64_t mapped_bytes, buffered_bytes ;
+	rsFiles->getDiskReadStatistics(mapped_bytes,buffered_bytes) ;
+
+	ui.memoryMappedReads_CB->setToolTip(tr("Read large shared files through a memory mapping when sending them to friends.\n"
+	                                       "Sent since startup: %1 read through memory mapping, %2 through buffered reads.")
+	                                    .arg(misc::friendlyUnit(mapped_bytes)).arg(misc::friendlyUnit(buffered_bytes))) ;
+
 	std::list<std::string> suffixes, prefixes;
 	uint32_t ignore_flags ;
 
@@ -197,6 +209,12 @@ void TransferPage::updateDefaultStrategy(int i)
 
 		case 1: rsFiles->setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
 				  break ;
+
+		case 3: rsFiles->setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+				  break ;
+
+		case 4: rsFiles->setDefaultChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST) ;
+				  break ;
 		default: ;
 	}
 }
@@ -205,6 +223,10 @@ void TransferPage::updateDiskSizeLimit(int s)
 {
 	rsFiles->setFreeDiskSpaceLimit(s) ;
 }
+void TransferPage::updateMemoryMappedReads(bool b)
+{
+	rsFiles->setMemoryMappedReads(b) ;
+}
 void TransferPage::updateIgnoreDuplicates()
 {
 	rsFiles->setIgnoreDuplicates(ui.ignoreDuplicates_CB->isChecked());
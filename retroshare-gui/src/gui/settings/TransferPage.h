@@ -52,6 +52,7 @@ class TransferPage: public ConfigPage
 		void updateFilePermDirectDL(int);
 		void updateIgnoreLists();
 		void updateMaxShareDepth(int);
+		void updateMemoryMappedReads(bool);
 
 		void editDirectories() ;
 		void setIncomingDirectory();
@@ -208,6 +208,14 @@ void GxsTransportStatistics::updateContent()
 
     groupBox->setTitle(tr("Pending data items")+": " + QString::number(transinfo.outgoing_records.size()) );
 
+    // signature checks of received data, shared by all GXS services
+
+    RsGxsValidationStatistics vstats ;
+    rsGxsTrans->getValidationStatistics(vstats) ;
+
+    groupBox_2->setTitle(tr("Gxs Transport Groups:") + " " + tr("%1 signature check threads, %2 queued checks, %3 checks/s, %4 messages and %5 groups waiting for validation")
+                         .arg(vstats.workers).arg(vstats.queueDepth).arg(vstats.jobsPerSecond,0,'f',1).arg(vstats.pendingMsgs).arg(vstats.pendingGrps)) ;
+
     for(uint32_t i=0;i<transinfo.outgoing_records.size();++i)
     {
         const RsGxsTransOutgoingRecord& rec(transinfo.outgoing_records[i]) ;
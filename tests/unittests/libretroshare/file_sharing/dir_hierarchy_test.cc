@@ -0,0 +1,564 @@
+/*
+ * tests/unittests/libretroshare/file_sharing: dir_hierarchy_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// A file hierarchy saved in version 0003 must load back as it was, and so must a hierarchy saved in version 0002,
+// which is then saved in version 0003. Files with indices out of range are rejected. The file name index must return
+// every file whose name contains a search term.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "file_sharing/dir_hierarchy.h"
+#include "file_sharing/filelist_io.h"
+#include "serialiser/rsbaseserial.h"
+#include "util/rsdir.h"
+
+#include "libretroshare/pqi/testauthssl.h"
+
+#define DIR_HIERARCHY_TEST_DIR   "dir_hierarchy_test.tmp"
+#define DIR_HIERARCHY_TEST_FNAME DIR_HIERARCHY_TEST_DIR "/dirlist.bin"
+
+static const uint32_t DIR_HIERARCHY_TEST_NB_FILES = 50 ;
+static const time_t   DIR_HIERARCHY_TEST_MODTIME  = 1500000000 ;
+
+// Three directories of files, one of them with a sub-directory.
+
+static void buildHierarchy(InternalFileHierarchyStorage& h)
+{
+	std::set<std::string> subdirs ;
+	subdirs.insert("books") ;
+	subdirs.insert("movies") ;
+	subdirs.insert("music") ;
+
+	RsFileHash salt = RsFileHash::random() ;
+
+	h.updateSubDirectoryList(0,subdirs,salt) ;
+
+	std::set<std::string> subsubdirs ;
+	subsubdirs.insert("old movies") ;
+
+	h.updateSubDirectoryList(h.getSubDirIndex(0,1),subsubdirs,salt) ;
+
+	std::vector<DirectoryStorage::EntryIndex> dirs ;
+	dirs.push_back(h.getSubDirIndex(0,0)) ;
+	dirs.push_back(h.getSubDirIndex(0,1)) ;
+	dirs.push_back(h.getSubDirIndex(0,2)) ;
+	dirs.push_back(h.getSubDirIndex(dirs[1],0)) ;
+
+	for(uint32_t i=0;i<dirs.size();++i)
+	{
+		std::map<std::string,DirectoryStorage::FileTS> files,new_files ;
+
+		for(uint32_t j=0;j<DIR_HIERARCHY_TEST_NB_FILES;++j)
+		{
+			char tmp[50] ;
+			sprintf(tmp,"shared file %u_%02u.mkv",i,j) ;
+
+			files[tmp].size = 1000*(j+1) + i ;
+			files[tmp].modtime = DIR_HIERARCHY_TEST_MODTIME + 100*i + j ;
+		}
+		h.updateSubFilesList(dirs[i],files,new_files) ;
+
+		for(uint32_t j=0;h.getSubFileIndex(dirs[i],j) != DirectoryStorage::NO_INDEX;++j)
+			h.updateHash(h.getSubFileIndex(dirs[i],j),RsFileHash::random()) ;
+	}
+
+	bool unfinished_files_present = false ;
+	h.recursUpdateLastModfTime(0,unfinished_files_present) ;
+}
+
+// Loading keeps the indices of all nodes, so that both hierarchies can be compared node by node.
+
+static void checkSameHierarchy(InternalFileHierarchyStorage& h1,InternalFileHierarchyStorage& h2)
+{
+	ASSERT_EQ(h1.mNodes.size(),h2.mNodes.size()) ;
+
+	for(uint32_t i=0;i<h1.mNodes.size();++i)
+	{
+		ASSERT_EQ(h1.getType(i),h2.getType(i)) ;
+
+		if(h1.getType(i) == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+		{
+			const InternalFileHierarchyStorage::FileEntry *f1 = h1.getFileEntry(i), *f2 = h2.getFileEntry(i) ;
+
+			EXPECT_EQ(f1->file_name   ,f2->file_name   ) ;
+			EXPECT_EQ(f1->file_size   ,f2->file_size   ) ;
+			EXPECT_EQ(f1->file_hash   ,f2->file_hash   ) ;
+			EXPECT_EQ(f1->file_modtime,f2->file_modtime) ;
+			EXPECT_EQ(f1->parent_index,f2->parent_index) ;
+			EXPECT_EQ(f1->row         ,f2->row         ) ;
+		}
+		else if(h1.getType(i) == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
+		{
+			const InternalFileHierarchyStorage::DirEntry *d1 = h1.getDirEntry(i), *d2 = h2.getDirEntry(i) ;
+
+			EXPECT_EQ(d1->dir_name            ,d2->dir_name            ) ;
+			EXPECT_EQ(d1->dir_parent_path     ,d2->dir_parent_path     ) ;
+			EXPECT_EQ(d1->dir_hash            ,d2->dir_hash            ) ;
+			EXPECT_EQ(d1->dir_modtime         ,d2->dir_modtime         ) ;
+			EXPECT_EQ(d1->dir_update_time     ,d2->dir_update_time     ) ;
+			EXPECT_EQ(d1->dir_most_recent_time,d2->dir_most_recent_time) ;
+			EXPECT_EQ(d1->subdirs             ,d2->subdirs             ) ;
+			EXPECT_EQ(d1->subfiles            ,d2->subfiles            ) ;
+			EXPECT_EQ(d1->parent_index        ,d2->parent_index        ) ;
+			EXPECT_EQ(d1->row                 ,d2->row                 ) ;
+		}
+	}
+
+	SharedDirStats s1,s2 ;
+	h1.getStatistics(s1) ;
+	h2.getStatistics(s2) ;
+
+	EXPECT_EQ(s1.total_number_of_files,s2.total_number_of_files) ;
+	EXPECT_EQ(s1.total_shared_size    ,s2.total_shared_size    ) ;
+
+	// the file name index is loaded as well
+
+	std::list<std::string> terms ;
+	terms.push_back("2_07") ;
+
+	std::list<DirectoryStorage::EntryIndex> r1,r2 ;
+	h1.searchTerms(terms,r1) ;
+	h2.searchTerms(terms,r2) ;
+
+	EXPECT_EQ(1u,r2.size()) ;
+	EXPECT_EQ(r1,r2) ;
+}
+
+// Saves the hierarchy as versions 0002 did: one section per node, after the file name index.
+
+static bool saveVersion0002(InternalFileHierarchyStorage& h,const std::string& fname)
+{
+	unsigned char *buffer = NULL ;
+	uint32_t buffer_size = 0 ;
+	uint32_t buffer_offset = 0 ;
+
+	bool ok = FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,(uint32_t) FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0002)
+	       && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t) h.mNodes.size()) ;
+
+	FileNameIndex name_index ;
+
+	for(uint32_t i=0;i<h.mNodes.size();++i)
+		if(h.getType(i) == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+			name_index.addFile(i,h.getFileEntry(i)->file_name) ;
+
+	unsigned char *index_data = NULL ;
+	uint32_t index_size = 0 ;
+
+	ok = ok && name_index.serialise(index_data,index_size)
+	        && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX,index_data,index_size) ;
+	free(index_data) ;
+
+	for(uint32_t i=0;ok && i<h.mNodes.size();++i)
+	{
+		unsigned char *section = NULL ;
+		uint32_t section_size = 0 ;
+		uint32_t section_offset = 0 ;
+
+		if(h.getType(i) == InternalFileHierarchyStorage::FileStorageNode::TYPE_FILE)
+		{
+			const InternalFileHierarchyStorage::FileEntry *fe = h.getFileEntry(i) ;
+
+			ok = FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_PARENT_INDEX  ,(uint32_t)fe->parent_index)
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ROW           ,(uint32_t)fe->row         )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX   ,(uint32_t)i               )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_NAME     ,fe->file_name             )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SIZE     ,fe->file_size             )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SHA1_HASH,fe->file_hash             )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS      ,(uint32_t)fe->file_modtime)
+			  && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_FILE_ENTRY,section,section_offset) ;
+		}
+		else if(h.getType(i) == InternalFileHierarchyStorage::FileStorageNode::TYPE_DIR)
+		{
+			const InternalFileHierarchyStorage::DirEntry *de = h.getDirEntry(i) ;
+
+			ok = FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_PARENT_INDEX   ,(uint32_t)de->parent_index        )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ROW            ,(uint32_t)de->row                 )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_ENTRY_INDEX    ,(uint32_t)i                       )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_NAME      ,de->dir_name                      )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_DIR_HASH       ,de->dir_hash                      )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_FILE_SIZE      ,de->dir_parent_path               )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_MODIF_TS       ,(uint32_t)de->dir_modtime         )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_UPDATE_TS      ,(uint32_t)de->dir_update_time     )
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RECURS_MODIF_TS,(uint32_t)de->dir_most_recent_time)
+			  && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER     ,(uint32_t)de->subdirs.size()      ) ;
+
+			for(uint32_t j=0;ok && j<de->subdirs.size();++j)
+				ok = FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subdirs[j]) ;
+
+			ok = ok && FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subfiles.size()) ;
+
+			for(uint32_t j=0;ok && j<de->subfiles.size();++j)
+				ok = FileListIO::writeField(section,section_size,section_offset,FILE_LIST_IO_TAG_RAW_NUMBER,(uint32_t)de->subfiles[j]) ;
+
+			ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIR_ENTRY,section,section_offset) ;
+		}
+		free(section) ;
+	}
+
+	ok = ok && FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
+
+	free(buffer) ;
+	return ok ;
+}
+
+static bool readVersion(const std::string& fname,uint32_t& version)
+{
+	unsigned char *buffer = NULL ;
+	uint32_t buffer_size = 0 ;
+	uint32_t buffer_offset = 0 ;
+
+	if(!FileListIO::loadEncryptedDataFromFile(fname,buffer,buffer_size))
+		return false ;
+
+	bool ok = FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version) ;
+
+	free(buffer) ;
+	return ok ;
+}
+
+// Changes the node columns of a hierarchy saved in version 0003. The corruption function gets the node counts and the
+// offset of the node types column, which the other node columns follow. See InternalFileHierarchyStorage::writeNodeColumns().
+
+struct ColumnsLayout
+{
+	uint32_t n_nodes ;
+	uint32_t n_files ;
+	uint32_t n_dirs ;
+	uint32_t types_offset ;
+};
+
+typedef void (*ColumnsCorruption)(unsigned char *columns,uint32_t columns_size,const ColumnsLayout& layout) ;
+
+static bool corruptColumns(const std::string& fname,ColumnsCorruption corrupt)
+{
+	unsigned char *buffer = NULL ;
+	uint32_t buffer_size = 0 ;
+	uint32_t buffer_offset = 0 ;
+
+	if(!FileListIO::loadEncryptedDataFromFile(fname,buffer,buffer_size))
+		return false ;
+
+	uint32_t version = 0, n_nodes = 0 ;
+	ColumnsLayout layout ;
+	unsigned char *index_data = NULL, *columns = NULL ;
+	uint32_t index_size = 0, columns_size = 0 ;
+
+	bool ok = FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)
+	       && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_nodes)
+	       && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX,index_data,index_size)
+	       && FileListIO::readField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_NODE_COLUMNS,columns,columns_size) ;
+
+	free(buffer) ;
+	buffer = NULL ;
+	buffer_size = 0 ;
+	buffer_offset = 0 ;
+
+	uint32_t offset = 0, n_strings = 0, strings_size = 0 ;
+
+	ok = ok && getRawUInt32(columns,columns_size,&offset,&layout.n_nodes)
+	        && getRawUInt32(columns,columns_size,&offset,&n_strings)
+	        && getRawUInt32(columns,columns_size,&offset,&layout.n_files)
+	        && getRawUInt32(columns,columns_size,&offset,&layout.n_dirs) ;
+
+	for(uint32_t i=0;ok && i<n_strings;++i)
+	{
+		uint32_t s = 0 ;
+		ok = getRawUInt32(columns,columns_size,&offset,&s) ;
+		strings_size += s ;
+	}
+
+	layout.types_offset = offset + strings_size ;
+
+	if(ok)
+		corrupt(columns,columns_size,layout) ;
+
+	ok = ok && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_LOCAL_DIRECTORY_VERSION,version)
+	        && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_RAW_NUMBER,n_nodes)
+	        && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_FILE_NAME_INDEX,index_data,index_size)
+	        && FileListIO::writeField(buffer,buffer_size,buffer_offset,FILE_LIST_IO_TAG_NODE_COLUMNS,columns,columns_size)
+	        && FileListIO::saveEncryptedDataToFile(fname,buffer,buffer_offset) ;
+
+	free(index_data) ;
+	free(columns) ;
+	free(buffer) ;
+
+	return ok ;
+}
+
+static void setIndex(unsigned char *columns,uint32_t columns_size,uint32_t offset,uint32_t index)
+{
+	setRawUInt32(columns,columns_size,&offset,index) ;
+}
+
+static void parentOutOfRange(unsigned char *columns,uint32_t columns_size,const ColumnsLayout& l)
+{
+	setIndex(columns,columns_size,l.types_offset + l.n_nodes + 4*1,l.n_nodes) ;			// parent of node 1
+}
+static void rowOutOfRange(unsigned char *columns,uint32_t columns_size,const ColumnsLayout& l)
+{
+	setIndex(columns,columns_size,l.types_offset + 5*l.n_nodes + 4*1,l.n_nodes) ;		// row of node 1
+}
+static void childOutOfRange(unsigned char *columns,uint32_t columns_size,const ColumnsLayout& l)
+{
+	setIndex(columns,columns_size,l.types_offset + 13*l.n_nodes + 32*l.n_files + 44*l.n_dirs,l.n_nodes + 5) ;	// first child of the root
+}
+
+class DirHierarchyTest: public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		cleanDirectory() ;
+		mkdir(DIR_HIERARCHY_TEST_DIR,0700) ;
+
+		mPreviousAuthSSL = AuthSSL::getAuthSSL() ;
+		AuthSSL::setAuthSSL_debug(&mAuthSSL) ;
+	}
+	virtual void TearDown()
+	{
+		AuthSSL::setAuthSSL_debug(mPreviousAuthSSL) ;
+		cleanDirectory() ;
+	}
+
+	void cleanDirectory()
+	{
+		remove(DIR_HIERARCHY_TEST_FNAME) ;
+		remove(InternalFileHierarchyStorage::summaryFilename(DIR_HIERARCHY_TEST_FNAME).c_str()) ;
+		rmdir(DIR_HIERARCHY_TEST_DIR) ;
+	}
+
+	TestAuthSSL mAuthSSL ;
+	AuthSSL *mPreviousAuthSSL ;
+};
+
+TEST_F(DirHierarchyTest, SaveAndLoad)
+{
+	InternalFileHierarchyStorage h1 ;
+	buildHierarchy(h1) ;
+
+	ASSERT_TRUE(h1.save(DIR_HIERARCHY_TEST_FNAME)) ;
+
+	InternalFileHierarchyStorage h2 ;
+	ASSERT_TRUE(h2.load(DIR_HIERARCHY_TEST_FNAME)) ;
+
+	checkSameHierarchy(h1,h2) ;
+
+	// the summary gives the root TS and statistics without loading the hierarchy.
+
+	time_t root_TS = 0 ;
+	SharedDirStats stats ;
+	ASSERT_TRUE(InternalFileHierarchyStorage::loadSummary(DIR_HIERARCHY_TEST_FNAME,root_TS,stats)) ;
+
+	EXPECT_EQ(h1.getDirEntry(0)->dir_most_recent_time,root_TS) ;
+	EXPECT_EQ(4*DIR_HIERARCHY_TEST_NB_FILES,stats.total_number_of_files) ;
+
+	SharedDirStats stats1 ;
+	h1.getStatistics(stats1) ;
+	EXPECT_EQ(stats1.total_shared_size,stats.total_shared_size) ;
+}
+
+TEST_F(DirHierarchyTest, SummaryOfAnotherFile)
+{
+	InternalFileHierarchyStorage h1 ;
+	buildHierarchy(h1) ;
+	ASSERT_TRUE(h1.save(DIR_HIERARCHY_TEST_FNAME)) ;
+
+	std::string summary_name = InternalFileHierarchyStorage::summaryFilename(DIR_HIERARCHY_TEST_FNAME) ;
+	ASSERT_TRUE(RsDirUtil::renameFile(summary_name,summary_name + ".old")) ;
+
+	// the file list changes, but the summary is the one of the previous file list.
+
+	InternalFileHierarchyStorage h2 ;
+	ASSERT_TRUE(h2.save(DIR_HIERARCHY_TEST_FNAME)) ;
+	ASSERT_TRUE(RsDirUtil::renameFile(summary_name + ".old",summary_name)) ;
+
+	time_t root_TS = 0 ;
+	SharedDirStats stats ;
+	EXPECT_FALSE(InternalFileHierarchyStorage::loadSummary(DIR_HIERARCHY_TEST_FNAME,root_TS,stats)) ;
+
+	// no summary at all
+
+	remove(summary_name.c_str()) ;
+	EXPECT_FALSE(InternalFileHierarchyStorage::loadSummary(DIR_HIERARCHY_TEST_FNAME,root_TS,stats)) ;
+}
+
+TEST_F(DirHierarchyTest, UpgradeFromVersion0002)
+{
+	InternalFileHierarchyStorage h1 ;
+	buildHierarchy(h1) ;
+
+	ASSERT_TRUE(saveVersion0002(h1,DIR_HIERARCHY_TEST_FNAME)) ;
+
+	// older files have no summary, and are loaded as a whole.
+
+	time_t root_TS = 0 ;
+	SharedDirStats stats ;
+	EXPECT_FALSE(InternalFileHierarchyStorage::loadSummary(DIR_HIERARCHY_TEST_FNAME,root_TS,stats)) ;
+
+	InternalFileHierarchyStorage h2 ;
+	ASSERT_TRUE(h2.load(DIR_HIERARCHY_TEST_FNAME)) ;
+	checkSameHierarchy(h1,h2) ;
+
+	// saving again writes version 0003
+
+	ASSERT_TRUE(h2.save(DIR_HIERARCHY_TEST_FNAME)) ;
+
+	uint32_t version = 0 ;
+	ASSERT_TRUE(readVersion(DIR_HIERARCHY_TEST_FNAME,version)) ;
+	EXPECT_EQ(FILE_LIST_IO_LOCAL_DIRECTORY_STORAGE_VERSION_0003,version) ;
+
+	EXPECT_TRUE(InternalFileHierarchyStorage::loadSummary(DIR_HIERARCHY_TEST_FNAME,root_TS,stats)) ;
+	EXPECT_EQ(h1.getDirEntry(0)->dir_most_recent_time,root_TS) ;
+
+	InternalFileHierarchyStorage h3 ;
+	ASSERT_TRUE(h3.load(DIR_HIERARCHY_TEST_FNAME)) ;
+	checkSameHierarchy(h1,h3) ;
+}
+
+TEST_F(DirHierarchyTest, IndicesOutOfRange)
+{
+	ColumnsCorruption corruptions[3] = { parentOutOfRange, rowOutOfRange, childOutOfRange } ;
+
+	for(uint32_t i=0;i<3;++i)
+	{
+		SCOPED_TRACE(i) ;
+
+		InternalFileHierarchyStorage h1 ;
+		buildHierarchy(h1) ;
+		ASSERT_TRUE(h1.save(DIR_HIERARCHY_TEST_FNAME)) ;
+
+		InternalFileHierarchyStorage h2 ;
+		ASSERT_TRUE(h2.load(DIR_HIERARCHY_TEST_FNAME)) ;
+
+		ASSERT_TRUE(corruptColumns(DIR_HIERARCHY_TEST_FNAME,corruptions[i])) ;
+
+		// the file is rejected, and nothing of it is kept.
+
+		EXPECT_FALSE(h2.load(DIR_HIERARCHY_TEST_FNAME)) ;
+
+		SharedDirStats stats ;
+		h2.getStatistics(stats) ;
+
+		EXPECT_EQ(1u,h2.mNodes.size()) ;
+		EXPECT_EQ(0u,stats.total_number_of_files) ;
+		EXPECT_TRUE(h2.getDirEntry(0) != NULL) ;
+	}
+}
+
+TEST(libretroshare_file_sharing, FileNameIndexCandidates)
+{
+	static const char *names[] = { "The.Matrix.1999.mkv", "matrix_reloaded.avi", "Holiday Pictures 2017.zip",
+	                               "pictures-of-cats.tar.gz", "Symphony No.9 - Beethoven.flac", "beethoven sonatas.mp3",
+	                               "README", "readme.txt", "cat.jpg", "concatenate.c", "aaaaa-bbb.bin" } ;
+	static const uint32_t nb_names = sizeof(names)/sizeof(const char*) ;
+
+	static const char *terms[] = { "matrix", "atri", "The.Matrix", "trix.19", "Matrix.1999.mkv", "pictures of",
+	                               "cat", "readme", "no.9 - beet", "s.tar.gz", "sonatas.mp3", "9", "zzz", "x reloaded",
+	                               "aaaa", "ate", "c", "ym", "thov" } ;
+	static const uint32_t nb_terms = sizeof(terms)/sizeof(const char*) ;
+
+	FileNameIndex index ;
+
+	for(uint32_t i=0;i<nb_names;++i)
+		index.addFile(i,names[i]) ;
+
+	// the index loaded back must give the same results, with its trigrams rebuilt.
+
+	unsigned char *data = NULL ;
+	uint32_t size = 0 ;
+	ASSERT_TRUE(index.serialise(data,size)) ;
+
+	FileNameIndex loaded_index ;
+	ASSERT_TRUE(loaded_index.deserialise(data,size)) ;
+	free(data) ;
+
+	for(uint32_t t=0;t<nb_terms;++t)
+	{
+		SCOPED_TRACE(terms[t]) ;
+
+		std::vector<DirectoryStorage::EntryIndex> candidates ;
+		ASSERT_TRUE(index.findCandidates(terms[t],candidates)) ;
+
+		std::vector<DirectoryStorage::EntryIndex> loaded_candidates ;
+		ASSERT_TRUE(loaded_index.findCandidates(terms[t],loaded_candidates)) ;
+		EXPECT_EQ(candidates,loaded_candidates) ;
+
+		EXPECT_TRUE(std::is_sorted(candidates.begin(),candidates.end())) ;
+		EXPECT_TRUE(std::adjacent_find(candidates.begin(),candidates.end()) == candidates.end()) ;
+
+		std::string term(terms[t]) ;
+		std::transform(term.begin(),term.end(),term.begin(),::tolower) ;
+
+		for(uint32_t i=0;i<nb_names;++i)
+		{
+			std::string name(names[i]) ;
+			std::transform(name.begin(),name.end(),name.begin(),::tolower) ;
+
+			if(name.find(term) != std::string::npos)
+				EXPECT_TRUE(std::binary_search(candidates.begin(),candidates.end(),(DirectoryStorage::EntryIndex)i)) << names[i] ;
+		}
+	}
+
+	// whole words and prefixes only select the files that have them
+
+	std::vector<DirectoryStorage::EntryIndex> candidates ;
+
+	index.findCandidates("The.Matrix.1999.mkv",candidates) ;
+	EXPECT_EQ(2u,candidates.size()) ;	// the files with the word "matrix"
+
+	index.findCandidates("pictures of",candidates) ;
+	EXPECT_EQ(1u,candidates.size()) ;
+
+	index.findCandidates("zzz",candidates) ;
+	EXPECT_TRUE(candidates.empty()) ;
+
+	// only the words that have the trigrams of the term are checked
+
+	index.findCandidates("ate",candidates) ;
+	EXPECT_EQ(1u,candidates.size()) ;	// "concatenate"
+
+	EXPECT_FALSE(index.findCandidates(" - ",candidates)) ;
+
+	// removed files are not returned anymore
+
+	index.removeFile(0,names[0]) ;
+	index.findCandidates("matrix",candidates) ;
+
+	EXPECT_EQ(1u,candidates.size()) ;
+	EXPECT_EQ(1u,candidates[0]) ;
+
+	index.removeFile(10,names[10]) ;
+	index.findCandidates("aaa",candidates) ;
+	EXPECT_TRUE(candidates.empty()) ;
+
+	index.clear() ;
+	index.findCandidates("reload",candidates) ;
+	EXPECT_TRUE(candidates.empty()) ;
+}
@@ -0,0 +1,167 @@
+/*
+ * tests/unittests/libretroshare/file_sharing: dirsync_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// A directory sent in parts must give the same remote directory as the original one, and a directory that
+// changed a little since the last sync must take less data to send than the full directory.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include "file_sharing/directory_storage.h"
+#include "file_sharing/file_sharing_defaults.h"
+#include "serialiser/rstlvbinary.h"
+
+#define DIR_SYNC_TEST_LOCAL_NAME  "dirsync_test_local.tmp"
+#define DIR_SYNC_TEST_REMOTE_NAME "dirsync_test_remote.tmp"
+
+static const uint32_t DIR_SYNC_TEST_NB_FILES = 3000 ;
+static const time_t   DIR_SYNC_TEST_MODTIME  = 1500000000 ;
+
+static std::string fileName(uint32_t i)
+{
+	char tmp[50] ;
+	sprintf(tmp,"some_shared_file_%05u.mkv",i) ;
+	return std::string(tmp) ;
+}
+
+static void setFiles(LocalDirectoryStorage& local,DirectoryStorage::EntryIndex dir,const std::map<std::string,DirectoryStorage::FileTS>& files)
+{
+	std::map<std::string,DirectoryStorage::FileTS> new_files ;
+	local.updateSubFilesList(dir,files,new_files) ;
+
+	time_t most_recent = 0 ;
+
+	for(DirectoryStorage::FileIterator it(&local,dir);it;++it)
+	{
+		if(it.hash().isNull())	// new or modified file
+			local.updateHash(*it,RsFileHash::random(),true) ;
+
+		most_recent = std::max(most_recent,it.modtime()) ;
+	}
+	local.setDirectoryRecursModTime(dir,most_recent) ;
+}
+
+static uint32_t sendParts(LocalDirectoryStorage& local,DirectoryStorage::EntryIndex dir,RemoteDirectoryStorage& remote,time_t known_TS,uint32_t& nb_parts)
+{
+	std::list<RsTlvBinaryData> parts ;
+	uint32_t total_size = 0 ;
+
+	EXPECT_TRUE(local.serialiseDirEntryParts(dir,parts,RsPeerId::random(),known_TS)) ;
+
+	nb_parts = parts.size() ;
+
+	for(std::list<RsTlvBinaryData>::const_iterator it(parts.begin());it!=parts.end();)
+	{
+		EXPECT_GE(MAX_DIR_SYNC_RESPONSE_DATA_SIZE, it->bin_len) ;
+		total_size += it->bin_len ;
+
+		const RsTlvBinaryData& part(*it) ;
+		bool last = (++it == parts.end()) ;
+
+		EXPECT_TRUE(remote.deserialiseUpdateDirEntryPart(remote.root(),part,last)) ;
+	}
+	return total_size ;
+}
+
+static void checkSameFiles(LocalDirectoryStorage& local,DirectoryStorage::EntryIndex dir,RemoteDirectoryStorage& remote)
+{
+	std::map<std::string,std::pair<RsFileHash,time_t> > local_files,remote_files ;
+
+	for(DirectoryStorage::FileIterator it(&local,dir);it;++it)
+		local_files[it.name()] = std::make_pair(it.hash(),it.modtime()) ;
+
+	for(DirectoryStorage::FileIterator it(&remote,remote.root());it;++it)
+		remote_files[it.name()] = std::make_pair(it.hash(),it.modtime()) ;
+
+	EXPECT_EQ(local_files.size(), remote_files.size()) ;
+	EXPECT_TRUE(local_files == remote_files) ;
+}
+
+TEST(libretroshare_file_sharing, DirSyncInParts)
+{
+	remove(DIR_SYNC_TEST_LOCAL_NAME) ;
+	remove(DIR_SYNC_TEST_REMOTE_NAME) ;
+
+	LocalDirectoryStorage local(DIR_SYNC_TEST_LOCAL_NAME,RsPeerId::random()) ;
+	RemoteDirectoryStorage remote(RsPeerId::random(),DIR_SYNC_TEST_REMOTE_NAME) ;
+
+	std::set<std::string> subdirs ;
+	subdirs.insert("shared") ;
+	local.updateSubDirectoryList(local.root(),subdirs,RsFileHash::random()) ;
+
+	DirectoryStorage::EntryIndex dir = *DirectoryStorage::DirIterator(&local,local.root()) ;
+
+	std::map<std::string,DirectoryStorage::FileTS> files ;
+
+	for(uint32_t i=0;i<DIR_SYNC_TEST_NB_FILES;++i)
+	{
+		files[fileName(i)].size = 1000000 + i ;
+		files[fileName(i)].modtime = DIR_SYNC_TEST_MODTIME - i ;
+	}
+	setFiles(local,dir,files) ;
+
+	// first sync: the friend knows nothing.
+
+	uint32_t nb_parts ;
+	uint32_t full_size = sendParts(local,dir,remote,0,nb_parts) ;
+
+	EXPECT_LT(1u, nb_parts) ;
+	checkSameFiles(local,dir,remote) ;
+
+	time_t known_TS ;
+	EXPECT_TRUE(remote.getDirectoryRecursModTime(remote.root(),known_TS)) ;
+	EXPECT_EQ(DIR_SYNC_TEST_MODTIME, known_TS) ;
+
+	// some files change, one is removed and one is added.
+
+	files[fileName(10)].modtime = DIR_SYNC_TEST_MODTIME + 10 ;
+	files[fileName(20)].size = 12 ;
+	files[fileName(20)].modtime = DIR_SYNC_TEST_MODTIME + 20 ;
+	files.erase(fileName(30)) ;
+	files[fileName(DIR_SYNC_TEST_NB_FILES)].size = 12345 ;
+	files[fileName(DIR_SYNC_TEST_NB_FILES)].modtime = DIR_SYNC_TEST_MODTIME + 30 ;
+
+	setFiles(local,dir,files) ;
+
+	uint32_t delta_size = sendParts(local,dir,remote,known_TS,nb_parts) ;
+
+	std::cerr << "Directory of " << DIR_SYNC_TEST_NB_FILES << " files: " << full_size << " bytes for a full sync, " << delta_size << " bytes once known." << std::endl;
+
+	EXPECT_LT(2*delta_size, full_size) ;
+	checkSameFiles(local,dir,remote) ;
+
+	// a part that is not the expected one asks for the full directory again.
+
+	std::list<RsTlvBinaryData> parts ;
+	EXPECT_TRUE(local.serialiseDirEntryParts(dir,parts,RsPeerId::random(),0)) ;
+
+	EXPECT_FALSE(remote.deserialiseUpdateDirEntryPart(remote.root(),parts.back(),true)) ;
+	EXPECT_TRUE(remote.getDirectoryRecursModTime(remote.root(),known_TS)) ;
+	EXPECT_EQ(0, known_TS) ;
+
+	remove(DIR_SYNC_TEST_LOCAL_NAME) ;
+	remove(DIR_SYNC_TEST_REMOTE_NAME) ;
+}
@@ -0,0 +1,261 @@
+/*
+ * tests/unittests/libretroshare/ft: ftchunkmap_bench.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Simulates a swarm of friends downloading the same file from a single seed and from each other, and compares
+// how many rounds each chunk strategy needs to complete the download. In each round every peer uploads at most
+// SWARM_UPLOAD_SLOTS chunks, and every downloader asks for at most SWARM_DOWNLOAD_SLOTS chunks. Chunk maps are
+// exchanged between rounds.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "ft/ftchunkmap.h"
+
+static const uint32_t SWARM_NB_CHUNKS       =  200 ;
+static const uint32_t SWARM_NB_DOWNLOADERS  =   20 ;
+static const uint32_t SWARM_UPLOAD_SLOTS    =    1 ;
+static const uint32_t SWARM_DOWNLOAD_SLOTS  =    4 ;
+static const uint32_t SWARM_MAX_ROUNDS      = 5000 ;
+
+struct SwarmResult
+{
+	uint32_t average_rounds ;
+	uint32_t last_rounds ;
+};
+
+static SwarmResult simulateSwarm(FileChunksInfo::ChunkStrategy strategy)
+{
+	srand(0x2e8f4a1) ;
+
+	uint64_t file_size = SWARM_NB_CHUNKS * (uint64_t)ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE - 12345 ;
+
+	// peer 0 is the seed
+
+	std::vector<RsPeerId> ids ;
+	for(uint32_t i=0;i<=SWARM_NB_DOWNLOADERS;++i)
+		ids.push_back(RsPeerId::random()) ;
+
+	std::vector<ChunkMap*> maps(SWARM_NB_DOWNLOADERS+1,(ChunkMap*)NULL) ;
+	std::vector<uint32_t> completion_round(SWARM_NB_DOWNLOADERS+1,0) ;
+
+	CompressedChunkMap full_map ;
+	ChunkMap::buildPlainMap(file_size,full_map) ;
+
+	for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+	{
+		maps[i] = new ChunkMap(file_size,false) ;
+		maps[i]->setStrategy(strategy) ;
+		maps[i]->setPeerAvailabilityMap(ids[0],full_map) ;
+	}
+
+	uint32_t remaining = SWARM_NB_DOWNLOADERS ;
+	uint32_t round = 0 ;
+
+	for(;round < SWARM_MAX_ROUNDS && remaining > 0;++round)
+	{
+		// exchange chunk maps
+
+		std::vector<CompressedChunkMap> cmaps(SWARM_NB_DOWNLOADERS+1) ;
+
+		for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+			maps[i]->getAvailabilityMap(cmaps[i]) ;
+
+		for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+			for(uint32_t j=1;j<=SWARM_NB_DOWNLOADERS;++j)
+				if(i != j && completion_round[i] == 0)
+					maps[i]->setPeerAvailabilityMap(ids[j],cmaps[j]) ;
+
+		// ask for chunks
+
+		std::vector<uint32_t> upload_slots(SWARM_NB_DOWNLOADERS+1,SWARM_UPLOAD_SLOTS) ;
+		std::vector<std::pair<uint32_t,ftChunk::ChunkId> > transfers ;
+
+		std::vector<uint32_t> downloaders ;
+		for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+			if(completion_round[i] == 0)
+				downloaders.push_back(i) ;
+
+		std::random_shuffle(downloaders.begin(),downloaders.end()) ;
+
+		for(uint32_t d=0;d<downloaders.size();++d)
+		{
+			uint32_t i = downloaders[d] ;
+
+			std::vector<uint32_t> sources ;
+			for(uint32_t j=0;j<=SWARM_NB_DOWNLOADERS;++j)
+				if(j != i)
+					sources.push_back(j) ;
+
+			std::random_shuffle(sources.begin(),sources.end()) ;
+
+			uint32_t asked = 0 ;
+
+			for(uint32_t s=0;s<sources.size() && asked < SWARM_DOWNLOAD_SLOTS;++s)
+			{
+				if(upload_slots[sources[s]] == 0)
+					continue ;
+
+				ftChunk chunk ;
+				bool map_needed ;
+
+				if(maps[i]->getDataChunk(ids[sources[s]],ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,chunk,map_needed))
+				{
+					--upload_slots[sources[s]] ;
+					++asked ;
+					transfers.push_back(std::make_pair(i,chunk.id)) ;
+				}
+			}
+		}
+
+		// receive data
+
+		for(uint32_t t=0;t<transfers.size();++t)
+			maps[transfers[t].first]->dataReceived(transfers[t].second) ;
+
+		for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+		{
+			std::vector<uint32_t> to_check ;
+			maps[i]->getChunksToCheck(to_check) ;
+
+			for(uint32_t c=0;c<to_check.size();++c)
+				maps[i]->setChunkCheckingResult(to_check[c],true) ;
+
+			if(completion_round[i] == 0 && maps[i]->isComplete())
+			{
+				completion_round[i] = round+1 ;
+				--remaining ;
+			}
+		}
+	}
+
+	SwarmResult res ;
+	res.average_rounds = 0 ;
+	res.last_rounds = 0 ;
+
+	for(uint32_t i=1;i<=SWARM_NB_DOWNLOADERS;++i)
+	{
+		uint32_t r = (completion_round[i] > 0)? completion_round[i] : SWARM_MAX_ROUNDS ;
+
+		res.average_rounds += r ;
+		res.last_rounds = std::max(res.last_rounds,r) ;
+
+		delete maps[i] ;
+	}
+	res.average_rounds /= SWARM_NB_DOWNLOADERS ;
+
+	return res ;
+}
+
+TEST(libretroshare_ft, ChunkMapSwarmBench)
+{
+	static const FileChunksInfo::ChunkStrategy strategies[] = { FileChunksInfo::CHUNK_STRATEGY_STREAMING,
+	                                                             FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE,
+	                                                             FileChunksInfo::CHUNK_STRATEGY_RANDOM,
+	                                                             FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST,
+	                                                             FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST } ;
+	static const char *names[] = { "streaming", "progressive", "random", "rarest first", "streaming/rarest first" } ;
+
+	std::vector<SwarmResult> results ;
+
+	for(uint32_t s=0;s<5;++s)
+	{
+		results.push_back(simulateSwarm(strategies[s])) ;
+
+		std::cerr << "Swarm of " << SWARM_NB_DOWNLOADERS << " downloaders, " << SWARM_NB_CHUNKS << " chunks, strategy "
+		          << names[s] << ": average completion in " << results.back().average_rounds << " rounds, last one in "
+		          << results.back().last_rounds << " rounds." << std::endl;
+
+		EXPECT_LT(results.back().last_rounds, SWARM_MAX_ROUNDS) ;
+	}
+
+	// downloaders exchange more when they don't all want the same chunks.
+
+	EXPECT_LT(results[3].last_rounds, results[0].last_rounds) ;
+	EXPECT_LE(results[3].last_rounds, results[1].last_rounds) ;
+	EXPECT_LT(results[4].last_rounds, results[0].last_rounds) ;
+}
+
+TEST(libretroshare_ft, ChunkMapRarestFirst)
+{
+	uint64_t file_size = 64 * (uint64_t)ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+
+	ChunkMap map(file_size,false) ;
+	map.setStrategy(FileChunksInfo::CHUNK_STRATEGY_RAREST_FIRST) ;
+
+	RsPeerId seed = RsPeerId::random() ;
+	RsPeerId p1 = RsPeerId::random() ;
+	RsPeerId p2 = RsPeerId::random() ;
+
+	CompressedChunkMap full_map, map1(64,0), map2(64,0) ;
+	ChunkMap::buildPlainMap(file_size,full_map) ;
+
+	// p1 has chunks 0-31, p2 has chunks 16-47: chunks 48-63 are only available from the seed.
+
+	for(uint32_t i=0;i<32;++i)  map1.set(i) ;
+	for(uint32_t i=16;i<48;++i) map2.set(i) ;
+
+	map.setPeerAvailabilityMap(seed,full_map) ;
+	map.setPeerAvailabilityMap(p1,map1) ;
+	map.setPeerAvailabilityMap(p2,map2) ;
+
+	EXPECT_EQ(1u, map.getChunkAvailability(50)) ;
+	EXPECT_EQ(2u, map.getChunkAvailability(5)) ;
+	EXPECT_EQ(3u, map.getChunkAvailability(20)) ;
+
+	ftChunk chunk ;
+	bool map_needed ;
+
+	for(uint32_t i=0;i<16;++i)
+	{
+		ASSERT_TRUE(map.getDataChunk(seed,ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,chunk,map_needed)) ;
+		EXPECT_LE(48u, chunk.offset / ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE) ;
+	}
+
+	// what p1 has and p2 has not is now the rarest.
+
+	ASSERT_TRUE(map.getDataChunk(p1,ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,chunk,map_needed)) ;
+	EXPECT_GT(16u, chunk.offset / ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE) ;
+
+	// the counts follow sources leaving, and maps being updated.
+
+	map.removeFileSource(p2) ;
+	EXPECT_EQ(2u, map.getChunkAvailability(20)) ;
+	EXPECT_EQ(1u, map.getChunkAvailability(40)) ;
+
+	map.setPeerAvailabilityMap(p1,full_map) ;
+	EXPECT_EQ(2u, map.getChunkAvailability(40)) ;
+	EXPECT_EQ(2u, map.getChunkAvailability(5)) ;
+
+	// the playback cursor takes over rarity in streaming/rarest first mode.
+
+	map.setStrategy(FileChunksInfo::CHUNK_STRATEGY_STREAMING_RAREST) ;
+	map.setPlaybackCursor(30 * (uint64_t)ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE + 100) ;
+
+	ASSERT_TRUE(map.getDataChunk(p1,ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,chunk,map_needed)) ;
+	EXPECT_EQ(30u, chunk.offset / ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE) ;
+	ASSERT_TRUE(map.getDataChunk(p1,ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE,chunk,map_needed)) ;
+	EXPECT_EQ(31u, chunk.offset / ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE) ;
+}
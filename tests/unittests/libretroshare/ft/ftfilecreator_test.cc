@@ -0,0 +1,116 @@
+/*
+ * tests/unittests/libretroshare/ft: ftfilecreator_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Chunk sums and the file hash computed while the data is received must be the same as the ones computed
+// from the data itself, whatever the order the slices come in.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "ft/ftfilecreator.h"
+#include "util/rsdir.h"
+
+#define FILE_CREATOR_TEST_NAME "ftfilecreator_test.tmp"
+
+TEST(libretroshare_ft, FileCreatorChunkCheckSums)
+{
+	static const uint64_t csize = ChunkMap::CHUNKMAP_FIXED_CHUNK_SIZE ;
+	static const uint32_t slice_size = 10000 ;
+
+	uint64_t file_size = 3*csize + 12345 ;
+
+	remove(FILE_CREATOR_TEST_NAME) ;
+
+	unsigned char *file_data = new unsigned char[file_size] ;
+
+	for(uint64_t i=0;i<file_size;++i)
+		file_data[i] = rand() ;
+
+	RsFileHash file_hash = RsDirUtil::sha1sum(file_data,file_size) ;
+	RsPeerId peer_id = RsPeerId::random() ;
+
+	ftFileCreator *creator = new ftFileCreator(FILE_CREATOR_TEST_NAME,file_size,file_hash,true) ;
+	creator->setChunkStrategy(FileChunksInfo::CHUNK_STRATEGY_PROGRESSIVE) ;
+
+	uint64_t offset ;
+	uint32_t size ;
+	bool too_old ;
+	uint32_t n = 0 ;
+
+	while(creator->getMissingChunk(peer_id,slice_size,offset,size,too_old))
+	{
+		// every third slice of the second chunk comes in two parts, in the wrong order.
+
+		if(offset / csize == 1 && (n++ % 3) == 0 && size > 1)
+		{
+			uint32_t half = size/2 ;
+
+			EXPECT_TRUE(creator->addFileData(offset + half,size - half,file_data + offset + half)) ;
+			EXPECT_TRUE(creator->addFileData(offset,half,file_data + offset)) ;
+		}
+		else
+			EXPECT_TRUE(creator->addFileData(offset,size,file_data + offset)) ;
+	}
+
+	std::vector<uint32_t> chunks_to_check ;
+	creator->getChunksToCheck(chunks_to_check) ;
+
+	EXPECT_EQ(4u, chunks_to_check.size()) ;
+
+	for(uint32_t i=0;i<chunks_to_check.size();++i)
+	{
+		uint64_t chunk_start = chunks_to_check[i] * csize ;
+		Sha1CheckSum sum = RsDirUtil::sha1sum(file_data + chunk_start,std::min(csize,file_size - chunk_start)) ;
+		Sha1CheckSum cached ;
+
+		EXPECT_FALSE(creator->getChunkCheckSum(chunks_to_check[i],cached)) ;
+		EXPECT_TRUE(creator->verifyChunk(chunks_to_check[i],sum)) ;
+		EXPECT_TRUE(creator->getChunkCheckSum(chunks_to_check[i],cached)) ;
+		EXPECT_EQ(sum, cached) ;
+	}
+
+	EXPECT_TRUE(creator->finished()) ;
+
+	RsFileHash hash ;
+	EXPECT_TRUE(creator->hashReceivedData(hash)) ;
+	EXPECT_EQ(file_hash, hash) ;
+
+	// A chunk which check fails is forgotten, and so is the file hash of the data after it.
+
+	creator->forceCheck() ;
+	creator->getChunksToCheck(chunks_to_check) ;
+
+	Sha1CheckSum cached ;
+	EXPECT_FALSE(creator->getChunkCheckSum(0,cached)) ;
+	EXPECT_TRUE(creator->verifyChunk(0,Sha1CheckSum::random())) ;
+	EXPECT_FALSE(creator->getChunkCheckSum(0,cached)) ;
+	EXPECT_FALSE(creator->finished()) ;
+
+	delete creator ;
+	delete[] file_data ;
+
+	remove(FILE_CREATOR_TEST_NAME) ;
+}
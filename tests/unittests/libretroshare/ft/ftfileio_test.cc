@@ -0,0 +1,247 @@
+/*
+ * tests/unittests/libretroshare/ft: ftfileio_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Positional reads must return the data at the requested offset whatever the previous read was, and must stop
+// at the end of the file. Slices are written out of order, then read back at random offsets.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+#include <string.h>
+
+#include "ft/ftfileio.h"
+#include "ft/ftfileprovider.h"
+
+#define FILE_IO_TEST_NAME "ftfileio_test.tmp"
+
+static const uint64_t FILE_IO_TEST_SIZE       = 1024*1024 + 12345 ;
+static const uint32_t FILE_IO_TEST_SLICE_SIZE = 10000 ;
+static const uint32_t FILE_IO_TEST_NB_READS   = 500 ;
+
+static void writeTestFile(ftFileIO *io,const std::vector<unsigned char>& file_data)
+{
+	remove(FILE_IO_TEST_NAME) ;
+
+	ASSERT_TRUE(io->open(FILE_IO_TEST_NAME,ftFileIO::FT_FILE_IO_CREATE)) ;
+	ASSERT_TRUE(io->isOpen()) ;
+
+	// slices are written backwards, so that every write but the first one is before the previous one.
+
+	uint64_t nb_slices = (file_data.size() + FILE_IO_TEST_SLICE_SIZE - 1) / FILE_IO_TEST_SLICE_SIZE ;
+
+	for(uint64_t i=nb_slices;i>0;--i)
+	{
+		uint64_t offset = (i-1) * FILE_IO_TEST_SLICE_SIZE ;
+		uint32_t size = std::min((uint64_t)FILE_IO_TEST_SLICE_SIZE,file_data.size() - offset) ;
+
+		EXPECT_TRUE(io->writeAt(offset,&file_data[offset],size)) ;
+	}
+	io->close() ;
+	EXPECT_FALSE(io->isOpen()) ;
+}
+
+static void checkRandomReads(ftFileIO *io,const std::vector<unsigned char>& file_data)
+{
+	ASSERT_TRUE(io->open(FILE_IO_TEST_NAME,ftFileIO::FT_FILE_IO_READ_ONLY)) ;
+
+	std::vector<unsigned char> buf(FILE_IO_TEST_SLICE_SIZE) ;
+
+	for(uint32_t i=0;i<FILE_IO_TEST_NB_READS;++i)
+	{
+		uint64_t offset = ((uint64_t(rand()) << 16) ^ rand()) % file_data.size() ;
+		uint32_t size = 1 + rand() % FILE_IO_TEST_SLICE_SIZE ;
+		uint32_t expected_size = std::min((uint64_t)size,file_data.size() - offset) ;
+
+		ASSERT_EQ((int64_t)expected_size, io->readAt(offset,&buf[0],size)) ;
+		EXPECT_EQ(0, memcmp(&buf[0],&file_data[offset],expected_size)) ;
+	}
+
+	// reads that go past the end of the file are short, and reads after the end return nothing.
+
+	EXPECT_EQ(100, io->readAt(file_data.size() - 100,&buf[0],FILE_IO_TEST_SLICE_SIZE)) ;
+	EXPECT_EQ(0, memcmp(&buf[0],&file_data[file_data.size() - 100],100)) ;
+	EXPECT_EQ(0, io->readAt(file_data.size(),&buf[0],FILE_IO_TEST_SLICE_SIZE)) ;
+
+	// the first bytes, after reading the last ones
+
+	EXPECT_EQ(10, io->readAt(0,&buf[0],10)) ;
+	EXPECT_EQ(0, memcmp(&buf[0],&file_data[0],10)) ;
+
+	io->close() ;
+}
+
+static void checkFileIO(ftFileIO *io)
+{
+	std::vector<unsigned char> file_data(FILE_IO_TEST_SIZE) ;
+
+	for(uint64_t i=0;i<file_data.size();++i)
+		file_data[i] = rand() ;
+
+	writeTestFile(io,file_data) ;
+	checkRandomReads(io,file_data) ;
+
+	EXPECT_FALSE(io->isMapped()) ;	// the file is too small to be mapped
+
+	delete io ;
+	remove(FILE_IO_TEST_NAME) ;
+}
+
+TEST(libretroshare_ft, FileIOStdioReadAt)
+{
+	checkFileIO(new ftStdioFileIO) ;
+}
+
+TEST(libretroshare_ft, FileIODefaultReadAt)
+{
+	checkFileIO(ftFileIO::create()) ;
+	checkFileIO(ftFileIO::create(true)) ;
+}
+
+#ifndef WINDOWS_SYS
+TEST(libretroshare_ft, FileIOPosixReadAt)
+{
+	checkFileIO(new ftPosixFileIO) ;
+}
+
+TEST(libretroshare_ft, FileIOMappedReadAt)
+{
+	// Large enough to be mapped. The file is sparse: only a few regions hold data, the rest reads as zeros.
+
+	static const uint64_t mapped_size = 65*1024*1024 + 12345 ;
+	static const uint64_t region_offsets[] = { 0, 3*1024*1024 - 500, 40*1024*1024, mapped_size - 1000 } ;
+	static const uint32_t region_size = 1000 ;
+	static const uint32_t nb_regions = sizeof(region_offsets)/sizeof(uint64_t) ;
+
+	std::vector<unsigned char> regions(nb_regions * region_size) ;
+
+	for(uint32_t i=0;i<regions.size();++i)
+		regions[i] = 1 + rand() % 255 ;
+
+	remove(FILE_IO_TEST_NAME) ;
+
+	ftMappedFileIO io ;
+
+	ASSERT_TRUE(io.open(FILE_IO_TEST_NAME,ftFileIO::FT_FILE_IO_CREATE)) ;
+	EXPECT_FALSE(io.isMapped()) ;	// empty when opened
+
+	for(uint32_t i=nb_regions;i>0;--i)
+		EXPECT_TRUE(io.writeAt(region_offsets[i-1],&regions[(i-1)*region_size],region_size)) ;
+
+	io.close() ;
+
+	ASSERT_TRUE(io.open(FILE_IO_TEST_NAME,ftFileIO::FT_FILE_IO_READ_ONLY)) ;
+	EXPECT_TRUE(io.isMapped()) ;
+
+	std::vector<unsigned char> buf(FILE_IO_TEST_SLICE_SIZE) ;
+	std::vector<unsigned char> expected(FILE_IO_TEST_SLICE_SIZE) ;
+
+	for(uint32_t i=0;i<FILE_IO_TEST_NB_READS;++i)
+	{
+		// half of the reads start around a region, the others anywhere in the file.
+
+		uint64_t offset = ((uint64_t(rand()) << 16) ^ rand()) % mapped_size ;
+
+		if(i % 2)
+		{
+			uint64_t r = region_offsets[i/2 % nb_regions] + rand() % 2000 ;
+			offset = std::min(mapped_size - 1,(r > 1000)? r - 1000 : 0) ;
+		}
+
+		uint32_t size = 1 + rand() % FILE_IO_TEST_SLICE_SIZE ;
+		uint32_t expected_size = std::min((uint64_t)size,mapped_size - offset) ;
+
+		for(uint32_t j=0;j<expected_size;++j)
+		{
+			expected[j] = 0 ;
+
+			for(uint32_t k=0;k<nb_regions;++k)
+				if(offset + j >= region_offsets[k] && offset + j < region_offsets[k] + region_size)
+					expected[j] = regions[k*region_size + offset + j - region_offsets[k]] ;
+		}
+
+		ASSERT_EQ((int64_t)expected_size, io.readAt(offset,&buf[0],size)) ;
+		EXPECT_EQ(0, memcmp(&buf[0],&expected[0],expected_size)) ;
+	}
+
+	EXPECT_EQ(1000, io.readAt(mapped_size - 1000,&buf[0],FILE_IO_TEST_SLICE_SIZE)) ;
+	EXPECT_EQ(0, memcmp(&buf[0],&regions[(nb_regions-1)*region_size],1000)) ;
+	EXPECT_EQ(0, io.readAt(mapped_size,&buf[0],FILE_IO_TEST_SLICE_SIZE)) ;
+
+	io.close() ;
+	EXPECT_FALSE(io.isMapped()) ;
+
+	remove(FILE_IO_TEST_NAME) ;
+}
+#endif
+
+TEST(libretroshare_ft, FileProviderGetFileData)
+{
+	std::vector<unsigned char> file_data(FILE_IO_TEST_SIZE) ;
+
+	for(uint64_t i=0;i<file_data.size();++i)
+		file_data[i] = rand() ;
+
+	ftFileIO *io = ftFileIO::create() ;
+	writeTestFile(io,file_data) ;
+	delete io ;
+
+	ftFileProvider provider(FILE_IO_TEST_NAME,file_data.size(),RsFileHash::random()) ;
+	RsPeerId peer_id = RsPeerId::random() ;
+
+	std::vector<unsigned char> buf(FILE_IO_TEST_SLICE_SIZE) ;
+	uint64_t offset = 0 ;
+
+	for(uint32_t i=0;i<FILE_IO_TEST_NB_READS;++i)
+	{
+		// every other read continues the previous one, as for a peer that downloads the file in order.
+
+		uint32_t size = 1 + rand() % FILE_IO_TEST_SLICE_SIZE ;
+
+		if(i % 2 == 0 || offset >= file_data.size())
+			offset = ((uint64_t(rand()) << 16) ^ rand()) % file_data.size() ;
+
+		uint32_t chunk_size = size ;
+
+		ASSERT_TRUE(provider.getFileData(peer_id,offset,chunk_size,&buf[0])) ;
+		EXPECT_EQ(std::min((uint64_t)size,file_data.size() - offset), chunk_size) ;
+		EXPECT_EQ(0, memcmp(&buf[0],&file_data[offset],chunk_size)) ;
+
+		offset += chunk_size ;
+	}
+	EXPECT_TRUE(provider.fileOk()) ;
+
+	// slices past the end are cut, and slices after the end are refused.
+
+	uint32_t chunk_size = FILE_IO_TEST_SLICE_SIZE ;
+	EXPECT_TRUE(provider.getFileData(peer_id,file_data.size() - 10,chunk_size,&buf[0])) ;
+	EXPECT_EQ(10u, chunk_size) ;
+	EXPECT_EQ(0, memcmp(&buf[0],&file_data[file_data.size() - 10],10)) ;
+
+	chunk_size = FILE_IO_TEST_SLICE_SIZE ;
+	EXPECT_FALSE(provider.getFileData(peer_id,file_data.size(),chunk_size,&buf[0])) ;
+
+	remove(FILE_IO_TEST_NAME) ;
+}
@@ -0,0 +1,154 @@
+/*
+ * tests/unittests/libretroshare/ft: ftserver_encryption_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// File data items sent through encrypted tunnels must come out of decryption as they went in. The encryption key
+// of a file is derived once, and the counters show what encrypting and decrypting costs.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "ft/ftserver.h"
+#include "ft/ftturtlefiletransferitem.h"
+#include "turtle/rsturtleitem.h"
+
+static const uint32_t ENCRYPTION_TEST_NB_ITEMS  = 200 ;
+static const uint32_t ENCRYPTION_TEST_DATA_SIZE = 8192 ;	// same as the slices sent by ftServer::sendData()
+
+static RsTurtleGenericDataItem *encryptTestItem(ftServer& server,const RsFileHash& hash,unsigned char *data)
+{
+	RsTurtleFileDataItem item ;
+
+	item.chunk_offset = 0 ;
+	item.chunk_size = ENCRYPTION_TEST_DATA_SIZE ;
+	item.chunk_data = data ;
+
+	RsTurtleGenericDataItem *encrypted_item = NULL ;
+
+	if(!server.encryptItem(&item,hash,encrypted_item))
+		encrypted_item = NULL ;
+
+	item.chunk_data = NULL ;	// not ours
+	return encrypted_item ;
+}
+
+TEST(libretroshare_ft, ServerItemEncryption)
+{
+	ftServer server(NULL,NULL) ;
+	RsFileHash hash = RsFileHash::random() ;
+
+	unsigned char data[ENCRYPTION_TEST_DATA_SIZE] ;
+
+	for(uint32_t i=0;i<ENCRYPTION_TEST_DATA_SIZE;++i)
+		data[i] = rand() ;
+
+	for(uint32_t n=0;n<ENCRYPTION_TEST_NB_ITEMS;++n)
+	{
+		RsTurtleFileDataItem item ;
+
+		item.chunk_offset = n * (uint64_t)ENCRYPTION_TEST_DATA_SIZE ;
+		item.chunk_size = ENCRYPTION_TEST_DATA_SIZE ;
+		item.chunk_data = data ;
+
+		RsTurtleGenericDataItem *encrypted_item = NULL ;
+		bool ok = server.encryptItem(&item,hash,encrypted_item) ;
+
+		item.chunk_data = NULL ;
+
+		ASSERT_TRUE(ok) ;
+		ASSERT_TRUE(encrypted_item != NULL) ;
+
+		// the clear data must not show in the encrypted item
+
+		EXPECT_TRUE(encrypted_item->data_size > ENCRYPTION_TEST_DATA_SIZE) ;
+		uint8_t *edata = (uint8_t*)encrypted_item->data_bytes ;
+		EXPECT_TRUE(std::search(edata,edata + encrypted_item->data_size,data,data + 64) == edata + encrypted_item->data_size) ;
+
+		RsTurtleGenericTunnelItem *decrypted_item = NULL ;
+		ASSERT_TRUE(server.decryptItem(encrypted_item,hash,decrypted_item)) ;
+
+		RsTurtleFileDataItem *ditem = dynamic_cast<RsTurtleFileDataItem*>(decrypted_item) ;
+		ASSERT_TRUE(ditem != NULL) ;
+
+		EXPECT_EQ(n * (uint64_t)ENCRYPTION_TEST_DATA_SIZE, ditem->chunk_offset) ;
+		EXPECT_EQ(ENCRYPTION_TEST_DATA_SIZE, ditem->chunk_size) ;
+		EXPECT_EQ(0, memcmp(ditem->chunk_data,data,ENCRYPTION_TEST_DATA_SIZE)) ;
+
+		delete decrypted_item ;
+		delete encrypted_item ;
+	}
+
+	// items that are decrypted with the key of another file, or that have been tampered with, are refused. Items
+	// are decrypted in place, so each check needs its own item.
+
+	RsTurtleGenericDataItem *encrypted_item = encryptTestItem(server,hash,data) ;
+	ASSERT_TRUE(encrypted_item != NULL) ;
+
+	RsTurtleGenericTunnelItem *decrypted_item = NULL ;
+	EXPECT_FALSE(server.decryptItem(encrypted_item,RsFileHash::random(),decrypted_item)) ;
+	delete encrypted_item ;
+
+	encrypted_item = encryptTestItem(server,hash,data) ;
+	ASSERT_TRUE(encrypted_item != NULL) ;
+
+	((uint8_t*)encrypted_item->data_bytes)[encrypted_item->data_size/2] ^= 0x01 ;
+	EXPECT_FALSE(server.decryptItem(encrypted_item,hash,decrypted_item)) ;
+	delete encrypted_item ;
+
+	// the untampered item is accepted
+
+	encrypted_item = encryptTestItem(server,hash,data) ;
+	ASSERT_TRUE(encrypted_item != NULL) ;
+	EXPECT_TRUE(server.decryptItem(encrypted_item,hash,decrypted_item)) ;
+	delete decrypted_item ;
+	delete encrypted_item ;
+
+	ftEncryptionStatistics stats ;
+	server.getEncryptionStatistics(stats) ;
+
+	std::cerr << "Encrypted " << stats.encrypted_items << " items of " << ENCRYPTION_TEST_DATA_SIZE << " bytes: "
+	          << stats.encryption_cycles / (double)stats.encrypted_bytes << " cycles/byte to encrypt, "
+	          << stats.decryption_cycles / (double)std::max(stats.decrypted_bytes,(uint64_t)1) << " cycles/byte to decrypt, "
+	          << stats.allocations / (double)(stats.encrypted_items + stats.decrypted_items) << " allocations per item." << std::endl;
+
+	EXPECT_EQ(ENCRYPTION_TEST_NB_ITEMS+3, stats.encrypted_items) ;
+	EXPECT_EQ(ENCRYPTION_TEST_NB_ITEMS+1, stats.decrypted_items) ;
+	EXPECT_EQ(2u, stats.key_derivations) ;		// the file, and the wrong hash
+	EXPECT_EQ(2u, stats.contexts) ;
+
+	// each encrypted item is one item and its data, and so is each decrypted file data item.
+
+	EXPECT_EQ(2*(stats.encrypted_items + stats.decrypted_items), stats.allocations) ;
+
+	// keys that no virtual peer uses are forgotten after a while.
+
+	server.cleanEncryptionContexts(3600) ;
+	server.getEncryptionStatistics(stats) ;
+	EXPECT_EQ(2u, stats.contexts) ;
+
+	server.cleanEncryptionContexts(0) ;
+	server.getEncryptionStatistics(stats) ;
+	EXPECT_EQ(0u, stats.contexts) ;
+}
@@ -243,6 +243,26 @@ void init_item(RsNxsTransacItem &rstx,RsSerialType **ser)
 		*ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
 }
 
+void init_item(RsNxsSyncMsgSketchItem& rsks,RsSerialType **ser)
+{
+    rsks.clear();
+
+    rsks.flag = RsNxsSyncMsgSketchItem::FLAG_SKETCH;
+    rsks.createdSinceTS = rand()%24232;
+    rsks.updateTS = rand()%24232;
+    rsks.messageCount = rand()%33132;
+    rsks.numBuckets = 64;
+    init_random(rsks.grpId) ;
+
+    for(uint32_t i=0;i<rsks.numBuckets;++i)
+        rsks.bucketHashes.push_back((uint64_t(rand()) << 32) | rand()) ;
+
+    for(uint32_t i=0;i<8;++i)
+        rsks.buckets.push_back(rand()%rsks.numBuckets) ;
+
+    if(ser)
+        *ser = new RsNxsSerialiser(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+}
 
 bool operator==(const RsNxsSyncGrpReqItem& l, const RsNxsSyncGrpReqItem& r)
 {
@@ -287,6 +307,21 @@ bool operator==(const RsNxsSyncMsgItem& l, const RsNxsSyncMsgItem& r)
     return true;
 }
 
+bool operator==(const RsNxsSyncMsgSketchItem& l, const RsNxsSyncMsgSketchItem& r)
+{
+    if(l.flag != r.flag) return false;
+    if(l.grpId != r.grpId) return false;
+    if(l.createdSinceTS != r.createdSinceTS) return false;
+    if(l.updateTS != r.updateTS) return false;
+    if(l.messageCount != r.messageCount) return false;
+    if(l.numBuckets != r.numBuckets) return false;
+    if(l.bucketHashes != r.bucketHashes) return false;
+    if(l.buckets != r.buckets) return false;
+    if(l.transactionNumber != r.transactionNumber) return false;
+
+    return true;
+}
+
 bool operator==(const RsNxsTransacItem& l, const RsNxsTransacItem& r){
 
     if(l.transactFlag != r.transactFlag) return false;
@@ -14,6 +14,7 @@ bool operator==(const RsNxsSyncMsgItem& l, const RsNxsSyncMsgItem& r);
 bool operator==(const RsNxsSyncGrpItem& l, const RsNxsSyncGrpItem& r);
 bool operator==(const RsNxsSyncMsgItem& l, const RsNxsSyncMsgItem& r);
 bool operator==(const RsNxsTransacItem& l, const RsNxsTransacItem& r);
+bool operator==(const RsNxsSyncMsgSketchItem& l, const RsNxsSyncMsgSketchItem& r);
 
 //void init_item(RsNxsGrp& nxg);
 //void init_item(RsNxsMsg& nxm);
@@ -28,6 +29,7 @@ void init_item(RsNxsSyncMsgReqItem &rsgm,RsSerialType ** = NULL);
 void init_item(RsNxsSyncGrpItem& rsgl   ,RsSerialType ** = NULL);
 void init_item(RsNxsSyncMsgItem& rsgml  ,RsSerialType ** = NULL);
 void init_item(RsNxsTransacItem& rstx   ,RsSerialType ** = NULL);
+void init_item(RsNxsSyncMsgSketchItem& rsks,RsSerialType ** = NULL);
 
 template<typename T>
 void copy_all_but(T& ex, const std::list<T>& s, std::list<T>& d)
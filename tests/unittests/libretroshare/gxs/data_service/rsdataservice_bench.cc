@@ -0,0 +1,185 @@
+/*
+ * tests/unittests/libretroshare/gxs/data_service: rsdataservice_bench.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Measures how many messages per second RsDataService::storeMessage() ingests into an encrypted database, in the
+// way a large channel sync does: many messages for a few groups, stored in one call. Also measures
+// RsDataService::storeGroup() with more groups than fit in one batch.
+
+#include <gtest/gtest.h>
+#include <sys/time.h>
+
+#include <set>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsgds.h"
+#include "gxs/rsgxsutil.h"
+#include "gxs/rsdataservice.h"
+
+#define BENCH_DATA_BASE_NAME "msg_grp_Store_bench"
+#define BENCH_DATA_BASE_KEY  "bench_key"
+
+static const int BENCH_NUM_GROUPS = 4 ;
+static const int BENCH_NUM_MSGS   = 10000 ;
+static const int BENCH_NUM_GROUPS_INGEST = 1300 ;	// a bit more than two batches
+
+static double bench_getTime()
+{
+    struct timeval tv ;
+    gettimeofday(&tv,NULL) ;
+    return tv.tv_sec + tv.tv_usec/1000000.0 ;
+}
+
+TEST(libretroshare_gxs, RsDataServiceIngestBench)
+{
+    remove(BENCH_DATA_BASE_NAME) ;
+
+    RsDataService *store = new RsDataService(".", BENCH_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM, NULL, BENCH_DATA_BASE_KEY);
+
+    // groups first, so that the last post time of each group gets updated when messages are stored.
+
+    std::vector<RsGxsGroupId> grpIds ;
+    RsNxsGrpDataTemporaryList grps ;
+
+    for(int i=0;i<BENCH_NUM_GROUPS;++i)
+    {
+        RsNxsGrp *grp = new RsNxsGrp(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+        RsGxsGrpMetaData *grpMeta = new RsGxsGrpMetaData() ;
+
+        init_item(*grp) ;
+        init_item(grpMeta) ;
+
+        grp->grpId = RsGxsGroupId::random() ;	// init_item() leaves it null
+        grpMeta->mGroupId = grp->grpId ;
+        grp->metaData = grpMeta ;
+
+        grpIds.push_back(grp->grpId) ;
+        grps.push_back(grp) ;
+    }
+    store->storeGroup(grps) ;
+
+    RsNxsMsgDataTemporaryList msgs ;
+    std::map<RsGxsGroupId,uint32_t> lastRecvTs ;
+
+    for(int i=0;i<BENCH_NUM_MSGS;++i)
+    {
+        RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+        RsGxsMsgMetaData *msgMeta = new RsGxsMsgMetaData() ;
+
+        init_item(*msg) ;
+        init_item(msgMeta) ;
+
+        msgMeta->mMsgId = msg->msgId = RsGxsMessageId::random() ;
+        msgMeta->mGroupId = msg->grpId = grpIds[i % BENCH_NUM_GROUPS] ;
+        msgMeta->recvTS = 1000 + i ;
+        msg->metaData = msgMeta ;
+
+        lastRecvTs[msg->grpId] = msgMeta->recvTS ;
+        msgs.push_back(msg) ;
+    }
+
+    double start = bench_getTime() ;
+    EXPECT_TRUE(store->storeMessage(msgs)) ;
+    double elapsed = bench_getTime() - start ;
+
+    std::cerr << "RsDataService ingest: " << BENCH_NUM_MSGS << " messages in " << elapsed << " s, "
+              << BENCH_NUM_MSGS/std::max(elapsed,1e-6) << " msgs/s" << std::endl;
+
+    // all messages are there, and the last post time of the groups is the one of their last message.
+
+    uint32_t count = 0 ;
+
+    for(int i=0;i<BENCH_NUM_GROUPS;++i)
+    {
+        RsGxsMessageId::std_vector ids ;
+        store->retrieveMsgIds(grpIds[i],ids) ;
+        count += ids.size() ;
+    }
+    EXPECT_EQ((uint32_t)BENCH_NUM_MSGS, count) ;
+
+    RsGxsGrpMetaTemporaryMap grpMeta ;
+    store->retrieveGxsGrpMetaData(grpMeta) ;
+
+    for(int i=0;i<BENCH_NUM_GROUPS;++i)
+    {
+        ASSERT_TRUE(grpMeta.find(grpIds[i]) != grpMeta.end()) ;
+        EXPECT_EQ(lastRecvTs[grpIds[i]], grpMeta[grpIds[i]]->mLastPost) ;
+    }
+
+    store->resetDataStore() ;
+    delete store ;
+    remove(BENCH_DATA_BASE_NAME) ;
+}
+
+TEST(libretroshare_gxs, RsDataServiceGroupIngestBench)
+{
+    remove(BENCH_DATA_BASE_NAME) ;
+
+    RsDataService *store = new RsDataService(".", BENCH_DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM, NULL, BENCH_DATA_BASE_KEY);
+
+    std::set<RsGxsGroupId> grpIds ;
+    RsNxsGrpDataTemporaryList grps ;
+
+    // init_item() is not used for the groups: it fills them with RSA keys and random data, which takes much longer
+    // than storing them.
+
+    std::string grpData(1000,'g') ;
+
+    for(int i=0;i<BENCH_NUM_GROUPS_INGEST;++i)
+    {
+        RsNxsGrp *grp = new RsNxsGrp(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+        RsGxsGrpMetaData *grpMeta = new RsGxsGrpMetaData() ;
+
+        grp->grpId = RsGxsGroupId::random() ;
+        grp->grp.setBinData(grpData.data(),grpData.size()) ;
+
+        grpMeta->mGroupId = grp->grpId ;
+        grpMeta->mGroupName = "group" ;
+        grp->metaData = grpMeta ;
+
+        grpIds.insert(grp->grpId) ;
+        grps.push_back(grp) ;
+    }
+
+    double start = bench_getTime() ;
+    EXPECT_TRUE(store->storeGroup(grps)) ;
+    double elapsed = bench_getTime() - start ;
+
+    std::cerr << "RsDataService ingest: " << BENCH_NUM_GROUPS_INGEST << " groups in " << elapsed << " s, "
+              << BENCH_NUM_GROUPS_INGEST/std::max(elapsed,1e-6) << " groups/s" << std::endl;
+
+    // all batches made it to the database
+
+    RsGxsGrpMetaTemporaryMap grpMeta ;
+    store->retrieveGxsGrpMetaData(grpMeta) ;
+
+    EXPECT_EQ(grpIds.size(), grpMeta.size()) ;
+
+    for(std::set<RsGxsGroupId>::const_iterator it(grpIds.begin());it!=grpIds.end();++it)
+        EXPECT_TRUE(grpMeta.find(*it) != grpMeta.end()) ;
+
+    store->resetDataStore() ;
+    delete store ;
+    remove(BENCH_DATA_BASE_NAME) ;
+}
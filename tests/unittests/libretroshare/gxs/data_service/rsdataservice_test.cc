@@ -1,5 +1,6 @@
 
 #include <gtest/gtest.h>
+#include <algorithm>
 
 #include "libretroshare/serialiser/support.h"
 #include "libretroshare/gxs/common/data_support.h"
@@ -23,6 +24,8 @@ TEST(libretroshare_gxs, RsDataService)
 
     test_groupStoreAndRetrieve();
     test_messageStoresAndRetrieve();
+    test_metaDataCache();
+    test_msgMetaQuery();
 }
 
 
@@ -296,6 +299,217 @@ void test_messageStoresAndRetrieve()
 
 
 
+/*!
+ * Meta data is served from the cache on the second retrieval, updates are written
+ * through, and a small cache still returns complete results.
+ */
+void test_metaDataCache()
+{
+    setUp();
+
+    RsDataService *store = dynamic_cast<RsDataService*>(dStore);
+    ASSERT_TRUE(store != NULL);
+
+    RsGxsGroupId grpId = RsGxsGroupId::random();
+    RsNxsMsgDataTemporaryList msgs;
+    int nMsgs = 50 + rand()%50;
+
+    for(int i=0; i<nMsgs; i++)
+    {
+        RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+        RsGxsMsgMetaData *msgMeta = new RsGxsMsgMetaData();
+        init_item(*msg);
+        init_item(msgMeta);
+
+        msgMeta->mMsgId = msg->msgId;
+        msgMeta->mGroupId = msg->grpId = grpId;
+        msg->metaData = msgMeta;
+
+        msgs.push_back(msg);
+    }
+    dStore->storeMessage(msgs);
+
+    GxsMsgReq req;
+    req[grpId] = std::vector<RsGxsMessageId>();
+
+    {
+        t_RsGxsGenericDataTemporaryMapVector<RsGxsMsgMetaData> first, second;
+
+        dStore->retrieveGxsMsgMetaData(req, first);
+        dStore->retrieveGxsMsgMetaData(req, second);
+
+        EXPECT_EQ((size_t)nMsgs, first[grpId].size());
+        EXPECT_EQ((size_t)nMsgs, second[grpId].size());
+    }
+
+    RsDataServiceCacheStatistics stats;
+    store->getCacheStatistics(stats);
+
+    EXPECT_EQ((uint32_t)nMsgs, stats.msgEntries);
+    EXPECT_EQ((uint64_t)nMsgs, stats.msgHits);
+
+    // write-through of a status change
+
+    const RsGxsMessageId& msgId = msgs.front()->msgId;
+
+    MsgLocMetaData m;
+    m.msgId = std::make_pair(grpId, msgId);
+    m.val.put(RsGeneralDataService::MSG_META_STATUS, (int32_t)0x1234);
+    EXPECT_EQ(1, dStore->updateMessageMetaData(m));
+
+    {
+        GxsMsgReq one;
+        one[grpId].push_back(msgId);
+
+        t_RsGxsGenericDataTemporaryMapVector<RsGxsMsgMetaData> result;
+        dStore->retrieveGxsMsgMetaData(one, result);
+
+        ASSERT_EQ((size_t)1, result[grpId].size());
+        EXPECT_EQ((uint32_t)0x1234, result[grpId][0]->mMsgStatus);
+    }
+
+    // a cache too small for the group still gives all messages
+
+    store->setCacheSize(4096);
+
+    {
+        t_RsGxsGenericDataTemporaryMapVector<RsGxsMsgMetaData> result;
+        dStore->retrieveGxsMsgMetaData(req, result);
+
+        EXPECT_EQ((size_t)nMsgs, result[grpId].size());
+    }
+
+    store->getCacheStatistics(stats);
+    EXPECT_TRUE(stats.msgEvictions > 0);
+    EXPECT_TRUE(stats.msgSize + stats.grpSize <= 4096);
+
+    tearDown();
+}
+
+static uint32_t countMsgMetaQuery(const RsGxsGroupId& grpId, const RsGxsMsgMetaQuery& query, std::vector<RsGxsMessageId>& ids)
+{
+    std::vector<RsGxsMsgMetaData*> meta;
+    uint32_t total = 0;
+
+    dStore->retrieveGxsMsgMetaData(grpId, query, meta, total);
+
+    ids.clear();
+    time_t lastTs = 0;
+
+    for(uint32_t i=0; i<meta.size(); ++i)
+    {
+        // newest first
+        if(i > 0)
+        {
+            EXPECT_LE(meta[i]->mPublishTs, lastTs);
+        }
+
+        lastTs = meta[i]->mPublishTs;
+        ids.push_back(meta[i]->mMsgId);
+        delete meta[i];
+    }
+    return total;
+}
+
+/*!
+ * Filters, ordering and paging of msg meta data done by the database
+ */
+void test_msgMetaQuery()
+{
+    setUp();
+
+    RsGxsGroupId grpId = RsGxsGroupId::random();
+    RsNxsMsgDataTemporaryList msgs;
+    std::vector<RsGxsMessageId> heads, versions;
+
+    // 20 thread heads, every other one with a status bit, 5 new versions of the first heads, 10 replies to the first one
+
+    for(int i=0; i<35; i++)
+    {
+        RsNxsMsg *msg = new RsNxsMsg(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
+        RsGxsMsgMetaData *msgMeta = new RsGxsMsgMetaData();
+        init_item(*msg);
+        init_item(msgMeta);
+
+        msgMeta->mMsgId = msg->msgId;
+        msgMeta->mGroupId = msg->grpId = grpId;
+        msgMeta->mOrigMsgId = msg->msgId;
+        msgMeta->mParentId.clear();
+        msgMeta->mMsgStatus = 0;
+        msg->metaData = msgMeta;
+
+        if(i < 20)
+        {
+            msgMeta->mPublishTs = 1000 + i;
+            msgMeta->mMsgStatus = (i%2) ? 0x4 : 0;
+            heads.push_back(msg->msgId);
+        }
+        else if(i < 25)
+        {
+            msgMeta->mPublishTs = 2000 + i;
+            msgMeta->mOrigMsgId = heads[i-20];
+            versions.push_back(msg->msgId);
+        }
+        else
+        {
+            msgMeta->mPublishTs = 1500 + i;
+            msgMeta->mParentId = heads[0];
+        }
+
+        msgs.push_back(msg);
+    }
+    dStore->storeMessage(msgs);
+
+    std::vector<RsGxsMessageId> ids;
+
+    // pages
+
+    RsGxsMsgMetaQuery query;
+    query.mLimit = 10;
+
+    EXPECT_EQ((uint32_t)35, countMsgMetaQuery(grpId, query, ids));
+    ASSERT_EQ((size_t)10, ids.size());
+    EXPECT_EQ(versions.back(), ids.front());
+
+    query.mOffset = 30;
+
+    EXPECT_EQ((uint32_t)35, countMsgMetaQuery(grpId, query, ids));
+    EXPECT_EQ((size_t)5, ids.size());
+
+    // filters
+
+    query = RsGxsMsgMetaQuery();
+    query.mThreadHeadsOnly = true;
+    EXPECT_EQ((uint32_t)25, countMsgMetaQuery(grpId, query, ids));
+
+    query = RsGxsMsgMetaQuery();
+    query.mOrigMsgsOnly = true;
+    EXPECT_EQ((uint32_t)30, countMsgMetaQuery(grpId, query, ids));
+
+    query = RsGxsMsgMetaQuery();
+    query.mThreadHeadsOnly = true;
+    query.mLatestOnly = true;
+    EXPECT_EQ((uint32_t)20, countMsgMetaQuery(grpId, query, ids));
+
+    for(int i=0; i<5; i++)
+    {
+        EXPECT_TRUE(std::find(ids.begin(), ids.end(), heads[i]) == ids.end());
+        EXPECT_TRUE(std::find(ids.begin(), ids.end(), versions[i]) != ids.end());
+    }
+
+    query = RsGxsMsgMetaQuery();
+    query.mStatusMask = 0x4;
+    query.mStatusFilter = 0x4;
+    EXPECT_EQ((uint32_t)10, countMsgMetaQuery(grpId, query, ids));
+
+    query = RsGxsMsgMetaQuery();
+    query.mThreadHeadsOnly = true;
+    query.mAfter = 1500;
+    EXPECT_EQ((uint32_t)5, countMsgMetaQuery(grpId, query, ids));
+
+    tearDown();
+}
+
 void setUp(){
     dStore = new RsDataService(".", DATA_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM);
 }
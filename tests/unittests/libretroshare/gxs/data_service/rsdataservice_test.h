@@ -9,6 +9,10 @@ void test_messageStoresAndRetrieve();
 
 void test_groupStoreAndRetrieve();
 
+void test_metaDataCache();
+
+void test_msgMetaQuery();
+
 void test_storeAndDeleteGroup();
 void test_storeAndDeleteMessage();
 
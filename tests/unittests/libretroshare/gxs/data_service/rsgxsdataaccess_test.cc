@@ -0,0 +1,140 @@
+/*
+ * tests/unittests/libretroshare/gxs/data_service: rsgxsdataaccess_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Requests made to RsGxsDataAccess are processed by the request pool, and their observer is called back, without
+// anybody calling processRequests() or polling the request status.
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include "libretroshare/gxs/common/data_support.h"
+#include "gxs/rsdataservice.h"
+#include "gxs/rsgxsdataaccess.h"
+#include "gxs/rsgxsutil.h"
+
+#define DATA_ACCESS_BASE_NAME "data_access_test"
+
+class DataAccessProcessor: public RsGxsRequestProcessor
+{
+public:
+	DataAccessProcessor(RsGxsDataAccess *da) : mDataAccess(da) {}
+	virtual void processPendingRequests() { mDataAccess->processRequests() ; }
+
+private:
+	RsGxsDataAccess *mDataAccess ;
+};
+
+class TestTokenObserver: public RsTokenObserver
+{
+public:
+	TestTokenObserver() : mMtx("TestTokenObserver"), mToken(0), mStatus(0), mCalls(0) {}
+
+	virtual void requestCompleted(uint32_t token, uint32_t status)
+	{
+		RS_STACK_MUTEX(mMtx) ;
+		mToken = token ;
+		mStatus = status ;
+		++mCalls ;
+	}
+
+	uint32_t calls() { RS_STACK_MUTEX(mMtx) ; return mCalls ; }
+
+	RsMutex mMtx ;
+	uint32_t mToken ;
+	uint32_t mStatus ;
+	uint32_t mCalls ;
+};
+
+TEST(libretroshare_gxs, RsGxsDataAccessObserver)
+{
+	remove(DATA_ACCESS_BASE_NAME) ;
+
+	RsDataService *store = new RsDataService(".", DATA_ACCESS_BASE_NAME, RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM, NULL, "key") ;
+	RsGxsDataAccess *da = new RsGxsDataAccess(store) ;
+	DataAccessProcessor processor(da) ;
+
+	da->setRequestProcessor(&processor) ;
+
+	RsNxsGrpDataTemporaryList grps ;
+
+	for(int i=0;i<5;++i)
+	{
+		RsNxsGrp *grp = new RsNxsGrp(RS_SERVICE_TYPE_PLUGIN_SIMPLE_FORUM) ;
+		RsGxsGrpMetaData *grpMeta = new RsGxsGrpMetaData() ;
+
+		init_item(*grp) ;
+		init_item(grpMeta) ;
+
+		grpMeta->mGroupId = grp->grpId ;
+		grp->metaData = grpMeta ;
+		grps.push_back(grp) ;
+	}
+	store->storeGroup(grps) ;
+
+	RsTokReqOptions opts ;
+	opts.mReqType = GXS_REQUEST_TYPE_GROUP_IDS ;
+
+	uint32_t token = 0 ;
+	TestTokenObserver observer ;
+
+	EXPECT_TRUE(da->requestGroupInfo(token, 0, opts)) ;
+	EXPECT_TRUE(da->observeRequest(token, &observer)) ;
+
+	for(int i=0;i<2000 && observer.calls() == 0;++i)
+		usleep(1000) ;
+
+	EXPECT_EQ(1u, observer.calls()) ;
+	EXPECT_EQ(token, observer.mToken) ;
+	EXPECT_EQ((uint32_t)RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE, observer.mStatus) ;
+
+	std::list<RsGxsGroupId> grpIds ;
+	EXPECT_TRUE(da->getGroupList(token, grpIds)) ;
+	EXPECT_EQ(5u, grpIds.size()) ;
+
+	// observing a finished request calls back right away
+
+	uint32_t token2 = 0 ;
+	TestTokenObserver observer2 ;
+
+	da->requestGroupInfo(token2, 0, opts) ;
+
+	for(int i=0;i<2000 && da->requestStatus(token2) != RsTokenService::GXS_REQUEST_V2_STATUS_COMPLETE;++i)
+		usleep(1000) ;
+
+	EXPECT_TRUE(da->observeRequest(token2, &observer2)) ;
+	EXPECT_EQ(1u, observer2.calls()) ;
+
+	// unknown tokens cannot be observed
+
+	EXPECT_FALSE(da->observeRequest(token2 + 1000, &observer2)) ;
+
+	da->setRequestProcessor(NULL) ;
+	RsGxsRequestPool::instance().unregister(&processor) ;
+
+	delete da ;
+	store->resetDataStore() ;
+	delete store ;
+	remove(DATA_ACCESS_BASE_NAME) ;
+}
@@ -0,0 +1,91 @@
+/*
+ * tests/unittests/libretroshare/gxs/gen_exchange: rsgxsvalidationpool_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "gxs/rsgxsvalidationpool.h"
+
+class CountingValidationJob: public RsGxsValidationJob
+{
+public:
+	CountingValidationJob() : runs(0), sum(0) {}
+
+	virtual void run()
+	{
+		++runs ;
+
+		for(uint32_t i=0;i<20000;++i)
+			sum += i*i ;
+	}
+
+	uint32_t runs ;
+	uint64_t sum ;
+};
+
+static void runAndCheck(uint32_t nb_jobs)
+{
+	std::vector<CountingValidationJob> jobs(nb_jobs) ;
+	std::vector<RsGxsValidationJob*> pool_jobs ;
+
+	for(uint32_t i=0;i<nb_jobs;++i)
+		pool_jobs.push_back(&jobs[i]) ;
+
+	RsGxsValidationPool::instance().runJobs(pool_jobs) ;
+
+	// every job has been run exactly once when runJobs() returns
+
+	for(uint32_t i=0;i<nb_jobs;++i)
+	{
+		EXPECT_EQ(1u, jobs[i].runs) ;
+		EXPECT_EQ(jobs[0].sum, jobs[i].sum) ;
+	}
+}
+
+TEST(libretroshare_gxs, RsGxsValidationPool)
+{
+	RsGxsValidationPool& pool(RsGxsValidationPool::instance()) ;
+	uint32_t initial_workers = pool.workerCount() ;
+
+	pool.setWorkerCount(3) ;
+	EXPECT_EQ(3u, pool.workerCount()) ;
+	runAndCheck(500) ;
+
+	// with no worker, the calling thread does all the work
+
+	pool.setWorkerCount(0) ;
+	EXPECT_EQ(0u, pool.workerCount()) ;
+	runAndCheck(50) ;
+
+	runAndCheck(0) ;
+
+	RsGxsValidationStatistics stats ;
+	pool.getStatistics(stats) ;
+
+	EXPECT_EQ(0u, stats.workers) ;
+	EXPECT_EQ(0u, stats.queueDepth) ;
+	EXPECT_LE((uint64_t)550, stats.jobsDone) ;
+
+	pool.setWorkerCount(initial_workers) ;
+}
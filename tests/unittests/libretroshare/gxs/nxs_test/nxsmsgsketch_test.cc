@@ -0,0 +1,62 @@
+/*
+ * nxsmsgsketch_test.cc
+ *
+ * Checks that comparing RsGxsMsgIdSketch of two sets of msg ids finds the buckets
+ * of all ids that are not in both sets, and only a few others.
+ */
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <vector>
+
+#include "gxs/rsgxsnetutils.h"
+
+static const uint32_t SKETCH_TEST_NB_IDS    = 20000 ;
+static const uint32_t SKETCH_TEST_NB_MISSING = 10 ;
+
+TEST(libretroshare_gxs, gxs_msg_sketch)
+{
+	EXPECT_EQ(RsGxsMsgIdSketch::MIN_BUCKETS, RsGxsMsgIdSketch::numBucketsForSize(0)) ;
+	EXPECT_EQ(RsGxsMsgIdSketch::MAX_BUCKETS, RsGxsMsgIdSketch::numBucketsForSize(10000000)) ;
+	EXPECT_TRUE(RsGxsMsgIdSketch::isValidNumBuckets(RsGxsMsgIdSketch::numBucketsForSize(SKETCH_TEST_NB_IDS))) ;
+	EXPECT_FALSE(RsGxsMsgIdSketch::isValidNumBuckets(100)) ;
+	EXPECT_FALSE(RsGxsMsgIdSketch::isValidNumBuckets(2*RsGxsMsgIdSketch::MAX_BUCKETS)) ;
+
+	// the server has all ids, the client misses a few of them.
+
+	uint32_t num_buckets = RsGxsMsgIdSketch::numBucketsForSize(SKETCH_TEST_NB_IDS) ;
+
+	RsGxsMsgIdSketch server_sketch(num_buckets) ;
+	RsGxsMsgIdSketch client_sketch(num_buckets) ;
+
+	std::set<uint32_t> missing_buckets ;
+
+	for(uint32_t i=0;i<SKETCH_TEST_NB_IDS;++i)
+	{
+		RsGxsMessageId id = RsGxsMessageId::random() ;
+
+		server_sketch.add(id) ;
+
+		if(i % (SKETCH_TEST_NB_IDS/SKETCH_TEST_NB_MISSING) == 0)
+			missing_buckets.insert(RsGxsMsgIdSketch::bucketOf(id,num_buckets)) ;
+		else
+			client_sketch.add(id) ;
+	}
+
+	std::vector<uint32_t> buckets ;
+	client_sketch.differingBuckets(server_sketch.bucketHashes(),buckets) ;
+
+	EXPECT_EQ(missing_buckets,std::set<uint32_t>(buckets.begin(),buckets.end())) ;
+
+	// identical sets give identical sketches, whatever the order of insertion.
+
+	client_sketch.differingBuckets(client_sketch.bucketHashes(),buckets) ;
+	EXPECT_TRUE(buckets.empty()) ;
+
+	// sketches of different sizes cannot be compared.
+
+	RsGxsMsgIdSketch other_sketch(2*num_buckets) ;
+	other_sketch.differingBuckets(server_sketch.bucketHashes(),buckets) ;
+	EXPECT_TRUE(buckets.empty()) ;
+}
@@ -0,0 +1,357 @@
+/*
+ * tests/unittests/libretroshare/pqi: historystore_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Messages written to the history store must be read back the same after the store is opened again, and
+// removing messages or segments must only remove what was asked for.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <time.h>
+#include <utime.h>
+
+#include <set>
+
+#include "pqi/historystore.h"
+#include "rsitems/rshistoryitems.h"
+#include "util/folderiterator.h"
+#include "util/rsdir.h"
+#include "util/rsrandom.h"
+
+#define HISTORY_STORE_TEST_DIR "historystore_test.tmp"
+
+static const uint32_t HISTORY_STORE_TEST_NB_MESSAGES = 600 ;	// more than two segments of 256 messages
+
+class HistoryStoreTest: public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		cleanDirectory() ;
+		RSRandom::random_bytes(mKey,HistoryStore::KEY_SIZE) ;
+
+		mChatA = RsPeerId::random() ;
+		mChatB = RsPeerId::random() ;
+	}
+	virtual void TearDown()
+	{
+		cleanDirectory() ;
+	}
+
+	void cleanDirectory()
+	{
+		if(RsDirUtil::checkDirectory(HISTORY_STORE_TEST_DIR))
+		{
+			RsDirUtil::cleanupDirectory(HISTORY_STORE_TEST_DIR,std::set<std::string>()) ;
+			remove(HISTORY_STORE_TEST_DIR) ;
+		}
+	}
+
+	// opens the store again, as at the next start.
+	HistoryStore *openStore()
+	{
+		HistoryStore *store = new HistoryStore(HISTORY_STORE_TEST_DIR) ;
+		store->setKey(mKey) ;
+		return store ;
+	}
+
+	void addMessages(HistoryStore& store,const RsPeerId& chat_id,uint32_t first,uint32_t count)
+	{
+		for(uint32_t i=first;i<first+count;++i)
+		{
+			RsHistoryMsgItem item ;
+
+			item.chatPeerId = chat_id ;
+			item.incoming = (i % 2) ;
+			item.peerId = chat_id ;
+			item.peerName = "peer" ;
+			item.sendTime = i ;
+			item.recvTime = i ;
+			item.message = messageText(i) ;
+
+			ASSERT_TRUE(store.addMessage(&item)) ;
+			EXPECT_NE(0u,item.msgId) ;
+		}
+	}
+
+	static std::string messageText(uint32_t i)
+	{
+		char tmp[50] ;
+		sprintf(tmp,"message number %u",i) ;
+		return std::string(tmp) ;
+	}
+
+	// checks that the chat has messages first to first+count-1, in this order.
+	void checkMessages(HistoryStore& store,const RsPeerId& chat_id,uint32_t first,uint32_t count)
+	{
+		std::list<RsHistoryMsgItem*> items ;
+		EXPECT_TRUE(store.getMessages(chat_id,0,items)) ;
+		EXPECT_EQ(count,items.size()) ;
+
+		uint32_t i = first ;
+
+		for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it,++i)
+		{
+			EXPECT_EQ(chat_id,(*it)->chatPeerId) ;
+			EXPECT_EQ(i,(*it)->sendTime) ;
+			EXPECT_EQ(messageText(i),(*it)->message) ;
+			delete *it ;
+		}
+	}
+
+	static std::list<std::string> segmentFiles()
+	{
+		std::list<std::string> files ;
+
+		for(librs::util::FolderIterator it(HISTORY_STORE_TEST_DIR,false);it.isValid();it.next())
+			if(it.file_type() == librs::util::FolderIterator::TYPE_FILE)
+				files.push_back(it.file_fullpath()) ;
+
+		files.sort() ;
+		return files ;
+	}
+
+	uint8_t mKey[HistoryStore::KEY_SIZE] ;
+	RsPeerId mChatA ;
+	RsPeerId mChatB ;
+};
+
+TEST_F(HistoryStoreTest, AppendAndReload)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES) ;
+	addMessages(*store,mChatB,0,10) ;
+	checkMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES) ;
+	delete store ;
+
+	// segments are indexed again from the files.
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES) ;
+	checkMessages(*store,mChatB,0,10) ;
+
+	// only the tail is given when asked for
+
+	std::list<RsHistoryMsgItem*> items ;
+	EXPECT_TRUE(store->getMessages(mChatA,5,items)) ;
+	ASSERT_EQ(5u,items.size()) ;
+	EXPECT_EQ(HISTORY_STORE_TEST_NB_MESSAGES-5,items.front()->sendTime) ;
+
+	// and messages can be read by id
+
+	RsHistoryMsgItem *item = store->getMessage(items.back()->msgId) ;
+	ASSERT_TRUE(item != NULL) ;
+	EXPECT_EQ(messageText(HISTORY_STORE_TEST_NB_MESSAGES-1),item->message) ;
+	delete item ;
+
+	for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it)
+		delete *it ;
+
+	// appending after a reload goes on where the chat was.
+
+	addMessages(*store,mChatA,HISTORY_STORE_TEST_NB_MESSAGES,10) ;
+	delete store ;
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES+10) ;
+	delete store ;
+
+	// with another key, nothing can be found.
+
+	store = new HistoryStore(HISTORY_STORE_TEST_DIR) ;
+	uint8_t other_key[HistoryStore::KEY_SIZE] ;
+	RSRandom::random_bytes(other_key,HistoryStore::KEY_SIZE) ;
+	store->setKey(other_key) ;
+
+	checkMessages(*store,mChatA,0,0) ;
+	delete store ;
+}
+
+TEST_F(HistoryStoreTest, TruncatedRecord)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,10) ;
+	delete store ;
+
+	// a record partly written when the program stopped
+
+	std::list<std::string> files = segmentFiles() ;
+	ASSERT_EQ(1u,files.size()) ;
+
+	FILE *f = fopen(files.back().c_str(),"ab") ;
+	ASSERT_TRUE(f != NULL) ;
+	unsigned char partial[20] = { 0x00, 0x00, 0x01, 0x00 } ;
+	fwrite(partial,1,sizeof(partial),f) ;
+	fclose(f) ;
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,0,10) ;
+
+	// new records go where the partial one was.
+
+	addMessages(*store,mChatA,10,5) ;
+	delete store ;
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,0,15) ;
+	delete store ;
+}
+
+TEST_F(HistoryStoreTest, LimitMessages)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES) ;
+	addMessages(*store,mChatB,0,10) ;
+
+	// whole segments go, as long as at least the asked count remains.
+
+	EXPECT_TRUE(store->limitMessages(mChatA,100)) ;
+
+	std::list<RsHistoryMsgItem*> items ;
+	EXPECT_TRUE(store->getMessages(mChatA,0,items)) ;
+
+	uint32_t remaining = items.size() ;
+	EXPECT_LE(100u,remaining) ;
+	EXPECT_GT(HISTORY_STORE_TEST_NB_MESSAGES,remaining) ;
+
+	for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it)
+		delete *it ;
+
+	checkMessages(*store,mChatA,HISTORY_STORE_TEST_NB_MESSAGES-remaining,remaining) ;
+	EXPECT_FALSE(store->limitMessages(mChatA,remaining)) ;
+	delete store ;
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,HISTORY_STORE_TEST_NB_MESSAGES-remaining,remaining) ;
+	checkMessages(*store,mChatB,0,10) ;
+	delete store ;
+}
+
+TEST_F(HistoryStoreTest, RemoveMessages)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,10) ;
+
+	std::list<RsHistoryMsgItem*> items ;
+	EXPECT_TRUE(store->getMessages(mChatA,0,items)) ;
+	ASSERT_EQ(10u,items.size()) ;
+
+	// remove the odd messages
+
+	std::list<uint32_t> to_remove, removed ;
+	uint32_t i = 0 ;
+
+	for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it,++i)
+	{
+		if(i % 2)
+			to_remove.push_back((*it)->msgId) ;
+		delete *it ;
+	}
+	store->removeMessages(to_remove,removed) ;
+
+	removed.sort() ;
+	to_remove.sort() ;
+	EXPECT_EQ(to_remove,removed) ;
+
+	for(std::list<uint32_t>::const_iterator it(removed.begin());it!=removed.end();++it)
+		EXPECT_TRUE(store->getMessage(*it) == NULL) ;
+
+	delete store ;
+
+	store = openStore() ;
+	EXPECT_TRUE(store->getMessages(mChatA,0,items)) ;
+	ASSERT_EQ(5u,items.size()) ;
+
+	i = 0 ;
+	for(std::list<RsHistoryMsgItem*>::const_iterator it(items.begin());it!=items.end();++it,i+=2)
+	{
+		EXPECT_EQ(messageText(i),(*it)->message) ;
+		delete *it ;
+	}
+	delete store ;
+}
+
+TEST_F(HistoryStoreTest, RemoveOldSegments)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,HISTORY_STORE_TEST_NB_MESSAGES) ;
+	addMessages(*store,mChatB,0,10) ;
+	delete store ;
+
+	// make the first segment of chat A, and the only one of chat B, two days old. Segments of a chat are named
+	// after the same prefix, so the single file of chat B is the one with a prefix no other file has.
+
+	std::list<std::string> files = segmentFiles() ;
+	ASSERT_EQ(4u,files.size()) ;
+
+	std::map<std::string,std::list<std::string> > by_prefix ;
+
+	for(std::list<std::string>::const_iterator it(files.begin());it!=files.end();++it)
+		by_prefix[RsDirUtil::getTopDir(*it).substr(0,40)].push_back(*it) ;
+
+	ASSERT_EQ(2u,by_prefix.size()) ;
+
+	struct utimbuf old_time ;
+	old_time.actime = old_time.modtime = time(NULL) - 2*86400 ;
+
+	for(std::map<std::string,std::list<std::string> >::const_iterator it(by_prefix.begin());it!=by_prefix.end();++it)
+		EXPECT_EQ(0,utime(it->second.front().c_str(),&old_time)) ;
+
+	store = openStore() ;
+	EXPECT_TRUE(store->removeOldSegments(86400)) ;
+	EXPECT_FALSE(store->removeOldSegments(86400)) ;
+
+	checkMessages(*store,mChatA,256,HISTORY_STORE_TEST_NB_MESSAGES-256) ;
+	checkMessages(*store,mChatB,0,0) ;
+	delete store ;
+
+	EXPECT_EQ(2u,segmentFiles().size()) ;
+}
+
+TEST_F(HistoryStoreTest, RecordsBelongToTheirChat)
+{
+	HistoryStore *store = openStore() ;
+	addMessages(*store,mChatA,0,10) ;
+	delete store ;
+
+	std::string file_a = segmentFiles().front() ;
+
+	store = openStore() ;
+	addMessages(*store,mChatB,0,1) ;
+	delete store ;
+
+	std::list<std::string> files = segmentFiles() ;
+	files.remove(file_a) ;
+	ASSERT_EQ(1u,files.size()) ;
+
+	// records of chat A, put in the segment of chat B, do not authenticate.
+
+	ASSERT_TRUE(RsDirUtil::copyFile(file_a,files.front())) ;
+
+	store = openStore() ;
+	checkMessages(*store,mChatA,0,10) ;
+	checkMessages(*store,mChatB,0,0) ;
+	delete store ;
+}
@@ -0,0 +1,339 @@
+/*
+ * tests/unittests/libretroshare/pqi: p3cfgmgr_journal_test.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Changes saved in the journal of a config file must come back when the config is loaded again, on top of the
+// config file they were written against, and only on top of that one.
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <set>
+
+#include "pqi/p3cfgmgr.h"
+#include "util/rsdir.h"
+
+#include "testauthssl.h"
+
+#define CONFIG_JOURNAL_TEST_DIR "p3cfgmgr_journal_test.tmp"
+
+// gives access to what p3ConfigMgr normally calls.
+
+class JournalTestConfig: public p3GeneralConfig
+{
+public:
+	bool saveDelta() { return saveConfigurationDelta() ; }
+	uint32_t saveNeeded(time_t now, bool force) { return checkSaveNeeded(now,force) ; }
+	void changed() { IndicateConfigChanged() ; }
+};
+
+class ConfigJournalTest: public ::testing::Test
+{
+protected:
+	virtual void SetUp()
+	{
+		cleanDirectory() ;
+		mkdir(CONFIG_JOURNAL_TEST_DIR,0700) ;
+
+		mkdir(CONFIG_JOURNAL_TEST_DIR "/config",0700) ;
+
+		mPreviousAuthSSL = AuthSSL::getAuthSSL() ;
+		AuthSSL::setAuthSSL_debug(&mAuthSSL) ;
+	}
+	virtual void TearDown()
+	{
+		for(std::list<p3ConfigMgr*>::const_iterator it(mConfigMgrs.begin());it!=mConfigMgrs.end();++it)
+			delete *it ;
+
+		AuthSSL::setAuthSSL_debug(mPreviousAuthSSL) ;
+		cleanDirectory() ;
+	}
+
+	void cleanDirectory()
+	{
+		if(RsDirUtil::checkDirectory(CONFIG_JOURNAL_TEST_DIR "/config"))
+		{
+			RsDirUtil::cleanupDirectory(CONFIG_JOURNAL_TEST_DIR "/config",std::set<std::string>()) ;
+			rmdir(CONFIG_JOURNAL_TEST_DIR "/config") ;
+		}
+		rmdir(CONFIG_JOURNAL_TEST_DIR) ;
+	}
+
+	// a config for the file, as it is at each start. A config manager only takes one config per file.
+	JournalTestConfig *newConfig()
+	{
+		JournalTestConfig *config = new JournalTestConfig ;
+
+		mConfigMgrs.push_back(new p3ConfigMgr(CONFIG_JOURNAL_TEST_DIR)) ;
+		mConfigMgrs.back()->addConfiguration("journal_test.cfg",config) ;
+
+		config->saveNeeded(0,true) ;	// as p3ConfigMgr::loadConfig() does
+		return config ;
+	}
+	JournalTestConfig *loadConfig()
+	{
+		JournalTestConfig *config = newConfig() ;
+		RsFileHash hash ;
+		EXPECT_TRUE(config->loadConfiguration(hash)) ;
+		return config ;
+	}
+
+	static std::string configFile()  { return CONFIG_JOURNAL_TEST_DIR "/config/journal_test.cfg" ; }
+	static std::string journalFile() { return configFile() + ".jnl" ; }
+
+	static uint64_t journalSize()
+	{
+		uint64_t size = 0 ;
+		if(!RsDirUtil::checkFile(journalFile(),size))
+			return 0 ;
+		return size ;
+	}
+
+	TestAuthSSL mAuthSSL ;
+	AuthSSL *mPreviousAuthSSL ;
+	std::list<p3ConfigMgr*> mConfigMgrs ;
+};
+
+TEST_F(ConfigJournalTest, AppendAndReload)
+{
+	JournalTestConfig *config = newConfig() ;
+	config->setSetting("a","1") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+	EXPECT_EQ(0u,journalSize()) ;
+
+	config->setSetting("b","2") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+	uint64_t first_record = journalSize() ;
+	EXPECT_LT(0u,first_record) ;
+
+	config->setSetting("a","3") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+	EXPECT_LT(first_record,journalSize()) ;
+
+	// a delta does not rewrite the config file
+
+	JournalTestConfig *loaded = loadConfig() ;
+	EXPECT_EQ("3",loaded->getSetting("a")) ;
+	EXPECT_EQ("2",loaded->getSetting("b")) ;
+
+	// changes keep going to the journal after loading, and a full save merges it.
+
+	loaded->setSetting("c","4") ;
+	EXPECT_TRUE(loaded->saveDelta()) ;
+
+	JournalTestConfig *reloaded = loadConfig() ;
+	EXPECT_EQ("3",reloaded->getSetting("a")) ;
+	EXPECT_EQ("4",reloaded->getSetting("c")) ;
+
+	EXPECT_TRUE(reloaded->saveConfiguration()) ;
+	EXPECT_EQ(0u,journalSize()) ;
+
+	JournalTestConfig *merged = loadConfig() ;
+	EXPECT_EQ("3",merged->getSetting("a")) ;
+	EXPECT_EQ("2",merged->getSetting("b")) ;
+	EXPECT_EQ("4",merged->getSetting("c")) ;
+
+	// configs registered to the manager are not deleted by it.
+	delete config ;
+	delete loaded ;
+	delete reloaded ;
+	delete merged ;
+}
+
+TEST_F(ConfigJournalTest, TruncatedLastRecord)
+{
+	JournalTestConfig *config = newConfig() ;
+	config->setSetting("a","1") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+
+	config->setSetting("b","2") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+
+	config->setSetting("c","3") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+
+	// the program stopped while writing the last record
+
+	ASSERT_EQ(0,truncate(journalFile().c_str(),journalSize() - 5)) ;
+
+	JournalTestConfig *loaded = loadConfig() ;
+	EXPECT_EQ("1",loaded->getSetting("a")) ;
+	EXPECT_EQ("2",loaded->getSetting("b")) ;
+	EXPECT_EQ("",loaded->getSetting("c")) ;
+
+	// nothing is appended after a broken record: the next delta saves the whole config instead.
+
+	loaded->setSetting("d","4") ;
+	EXPECT_TRUE(loaded->saveDelta()) ;
+	EXPECT_EQ(0u,journalSize()) ;
+
+	JournalTestConfig *reloaded = loadConfig() ;
+	EXPECT_EQ("2",reloaded->getSetting("b")) ;
+	EXPECT_EQ("4",reloaded->getSetting("d")) ;
+
+	delete config ;
+	delete loaded ;
+	delete reloaded ;
+}
+
+TEST_F(ConfigJournalTest, RecordOfAnotherConfigFile)
+{
+	JournalTestConfig *config = newConfig() ;
+	config->setSetting("a","1") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+
+	config->setSetting("a","journal") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+	ASSERT_TRUE(RsDirUtil::copyFile(journalFile(),journalFile() + ".old")) ;
+
+	config->setSetting("a","full") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+	EXPECT_EQ(0u,journalSize()) ;
+
+	// a journal left behind by an interrupted save goes with the previous config file: it is skipped.
+
+	ASSERT_TRUE(RsDirUtil::renameFile(journalFile() + ".old",journalFile())) ;
+
+	JournalTestConfig *loaded = loadConfig() ;
+	EXPECT_EQ("full",loaded->getSetting("a")) ;
+
+	delete config ;
+	delete loaded ;
+}
+
+TEST_F(ConfigJournalTest, FailedSaveKeepsJournal)
+{
+	JournalTestConfig *config = newConfig() ;
+	config->setSetting("a","1") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+
+	config->setSetting("b","2") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+	uint64_t size = journalSize() ;
+
+	// the new config file cannot be written
+
+	mAuthSSL.mFailEncryption = true ;
+
+	config->setSetting("c","3") ;
+	config->saveNeeded(time(NULL),true) ;
+
+	EXPECT_FALSE(config->saveConfiguration()) ;
+	EXPECT_EQ(size,journalSize()) ;
+	EXPECT_FALSE(RsDirUtil::fileExists(configFile() + "_new")) ;
+
+	// and it is saved again later, as a whole since the change is not in the journal.
+
+	EXPECT_EQ(CONFIG_SAVE_FULL,config->saveNeeded(time(NULL),true)) ;
+
+	mAuthSSL.mFailEncryption = false ;
+
+	// records appended after the failed save still go with the config file in place.
+
+	config->setSetting("d","4") ;
+	EXPECT_TRUE(config->saveDelta()) ;
+
+	JournalTestConfig *loaded = loadConfig() ;
+	EXPECT_EQ("1",loaded->getSetting("a")) ;
+	EXPECT_EQ("2",loaded->getSetting("b")) ;
+	EXPECT_EQ("4",loaded->getSetting("d")) ;
+
+	EXPECT_TRUE(config->saveConfiguration()) ;
+	EXPECT_EQ(0u,journalSize()) ;
+
+	JournalTestConfig *reloaded = loadConfig() ;
+	EXPECT_EQ("3",reloaded->getSetting("c")) ;
+	EXPECT_EQ("4",reloaded->getSetting("d")) ;
+	delete reloaded ;
+
+	delete config ;
+	delete loaded ;
+}
+
+TEST_F(ConfigJournalTest, MergeThreshold)
+{
+	JournalTestConfig *config = newConfig() ;
+	config->setSetting("a","1") ;
+	EXPECT_TRUE(config->saveConfiguration()) ;
+
+	// the journal is merged into the config file once it is bigger than both 64KB and the config file.
+
+	std::string value(1000,'x') ;
+	uint64_t max_size = 0 ;
+	bool merged = false ;
+
+	for(uint32_t i=0;i<200 && !merged;++i)
+	{
+		value[i % value.length()] = 'y' ;
+		config->setSetting("big",value) ;
+		EXPECT_TRUE(config->saveDelta()) ;
+
+		merged = (journalSize() < max_size) ;
+		max_size = std::max(max_size,journalSize()) ;
+	}
+	EXPECT_TRUE(merged) ;
+	EXPECT_EQ(0u,journalSize()) ;
+	EXPECT_GE(64*1024u,max_size) ;
+	EXPECT_LT(64*1024u - 2*value.length(),max_size) ;
+
+	JournalTestConfig *loaded = loadConfig() ;
+	EXPECT_EQ(value,loaded->getSetting("big")) ;
+
+	delete config ;
+	delete loaded ;
+}
+
+TEST_F(ConfigJournalTest, SaveNeeded)
+{
+	JournalTestConfig *config = newConfig() ;
+	time_t now = time(NULL) ;
+
+	EXPECT_EQ(CONFIG_SAVE_NONE,config->saveNeeded(now,true)) ;
+
+	// changes are saved once no other change came for a few seconds...
+
+	config->setSetting("a","1") ;
+	EXPECT_EQ(CONFIG_SAVE_NONE,config->saveNeeded(now,false)) ;
+	EXPECT_EQ(CONFIG_SAVE_DELTA,config->saveNeeded(now + 10,false)) ;
+	EXPECT_EQ(CONFIG_SAVE_NONE,config->saveNeeded(now + 10,false)) ;
+
+	// ...or when asked to, and a full save is needed as soon as one change needs it.
+
+	config->setSetting("a","2") ;
+	config->changed() ;
+	config->setSetting("a","3") ;
+	EXPECT_EQ(CONFIG_SAVE_FULL,config->saveNeeded(now,true)) ;
+	EXPECT_EQ(CONFIG_SAVE_NONE,config->saveNeeded(now,true)) ;
+
+	// changes that keep coming are saved anyway after a while.
+
+	config->setSetting("a","4") ;
+	EXPECT_EQ(CONFIG_SAVE_NONE,config->saveNeeded(now + 2,false)) ;
+	EXPECT_EQ(CONFIG_SAVE_DELTA,config->saveNeeded(now + 60,false)) ;
+
+	delete config ;
+}
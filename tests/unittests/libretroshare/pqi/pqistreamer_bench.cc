@@ -0,0 +1,218 @@
+/*
+ * tests/unittests/libretroshare/pqi: pqistreamer_bench.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Measures the throughput of the QoS streamer, and the number of memory allocations and of writes to the
+// network layer it needs per item. The streamer writes into a memory pipe and reads its own output back, so
+// the items go through serialisation, slicing, grouping and deserialisation. Received items are handed to a
+// pqiloopback, the way pqiperson hands them to the services.
+
+#include <gtest/gtest.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "pqi/pqiloopback.h"
+#include "pqi/pqiqosstreamer.h"
+#include "rsitems/rsfiletransferitems.h"
+
+static const uint32_t STREAMER_BENCH_DATA_SIZE  = 10000 ;	// same as the slices requested by the file transfer
+static const uint32_t STREAMER_BENCH_BATCH_SIZE = 100 ;
+static const uint32_t STREAMER_BENCH_ROUNDS     = 50 ;
+
+// A BinInterface that reads back what has been written into it.
+
+class LoopbackBinInterface: public BinInterface
+{
+public:
+	LoopbackBinInterface() : mReadPos(0), mWrites(0)
+	{
+		mData.reserve(4*STREAMER_BENCH_BATCH_SIZE*STREAMER_BENCH_DATA_SIZE) ;
+	}
+
+	virtual int tick() { return 1 ; }
+
+	virtual int senddata(void *data, int len)
+	{
+		mData.insert(mData.end(),(unsigned char*)data,(unsigned char*)data + len) ;
+		++mWrites ;
+		return len ;
+	}
+	virtual int readdata(void *data, int len)
+	{
+		if(mReadPos + len > mData.size())
+			return 0 ;
+
+		memcpy(data,&mData[mReadPos],len) ;
+		mReadPos += len ;
+
+		if(mReadPos == mData.size())	// keeps the capacity
+		{
+			mData.clear() ;
+			mReadPos = 0 ;
+		}
+		return len ;
+	}
+
+	virtual int netstatus() { return 1 ; }
+	virtual int isactive() { return 1 ; }
+	virtual bool moretoread(uint32_t) { return mReadPos < mData.size() ; }
+	virtual bool cansend(uint32_t) { return true ; }
+	virtual int close() { return 1 ; }
+	virtual RsFileHash gethash() { return RsFileHash() ; }
+	virtual bool bandwidthLimited() { return false ; }
+
+	uint32_t writes() const { return mWrites ; }
+
+private:
+	std::vector<unsigned char> mData ;
+	uint32_t mReadPos ;
+	uint32_t mWrites ;
+};
+
+// gives access to the ticking functions, which are normally called by the streamer's thread.
+
+class BenchStreamer: public pqiQoSstreamer
+{
+public:
+	BenchStreamer(PQInterface *parent, RsSerialiser *rss, const RsPeerId& peerid, BinInterface *bio)
+	    : pqiQoSstreamer(parent,rss,peerid,bio,BIN_FLAGS_NO_CLOSE) {}
+
+	int send() { return tick_send(0) ; }
+	int recv() { return tick_recv(0) ; }
+};
+
+static double getCurrentTS()
+{
+	struct timeval tv ;
+	gettimeofday(&tv,NULL) ;
+	return tv.tv_sec + tv.tv_usec / 1000000.0 ;
+}
+
+static RsFileTransferDataItem *createDataItem(const RsFileHash& hash,uint64_t offset)
+{
+	RsFileTransferDataItem *item = new RsFileTransferDataItem ;
+
+	item->fd.file.hash = hash ;
+	item->fd.file.filesize = 1024*1024*1024 ;
+	item->fd.file_offset = offset ;
+	item->fd.binData.setBinData(NULL,0) ;
+	item->fd.binData.bin_data = rs_malloc(STREAMER_BENCH_DATA_SIZE) ;
+	item->fd.binData.bin_len = STREAMER_BENCH_DATA_SIZE ;
+	memset(item->fd.binData.bin_data,0x5a,STREAMER_BENCH_DATA_SIZE) ;
+
+	return item ;
+}
+
+TEST(libretroshare_pqi, StreamerThroughputBench)
+{
+	RsPeerId peer_id = RsPeerId::random() ;
+	RsFileHash hash = RsFileHash::random() ;
+
+	RsSerialiser *rss = new RsSerialiser ;
+	rss->addSerialType(new RsFileTransferSerialiser) ;
+
+	LoopbackBinInterface bio ;
+	pqiloopback loopback(peer_id) ;
+	BenchStreamer streamer(&loopback,rss,peer_id,&bio) ;
+
+	uint64_t bytes = 0 ;
+	uint64_t items = 0 ;
+	uint64_t allocations = 0 ;
+	uint32_t writes = 0 ;
+	double send_time = 0 ;
+	double start = getCurrentTS() ;
+
+	// round 0 gets the slicing probe back, which switches slicing on. It is not accounted for.
+
+	for(uint32_t round=0;round<=STREAMER_BENCH_ROUNDS;++round)
+	{
+		std::vector<RsItem*> batch ;
+
+		for(uint32_t i=0;i<STREAMER_BENCH_BATCH_SIZE;++i)
+			batch.push_back(createDataItem(hash,(round*STREAMER_BENCH_BATCH_SIZE + i)*(uint64_t)STREAMER_BENCH_DATA_SIZE)) ;
+
+		uint32_t writes_before = bio.writes() ;
+		uint64_t allocations_before = streamer.getOutAllocations() ;
+		double send_start = getCurrentTS() ;
+		for(uint32_t i=0;i<batch.size();++i)
+		{
+			uint32_t size ;
+			streamer.SendItem(batch[i],size) ;
+
+			if(round > 0)
+				bytes += size ;
+		}
+		while(streamer.getQueueSize(false) > 0)
+			streamer.send() ;
+
+		if(round == 0)
+			start = getCurrentTS() ;
+		else
+		{
+			send_time += getCurrentTS() - send_start ;
+			writes += bio.writes() - writes_before ;
+			allocations += streamer.getOutAllocations() - allocations_before ;
+			items += batch.size() ;
+		}
+
+		// read everything back, and check that items come out whole and in order.
+
+		while(bio.moretoread(0))
+			streamer.recv() ;
+
+		RsItem *item ;
+		uint32_t received = 0 ;
+
+		while(NULL != (item = streamer.GetItem()))
+			loopback.SendItem(item) ;
+
+		while(NULL != (item = loopback.GetItem()))
+		{
+			RsFileTransferDataItem *ditem = dynamic_cast<RsFileTransferDataItem*>(item) ;
+
+			EXPECT_TRUE(ditem != NULL) ;
+
+			if(ditem != NULL)
+			{
+				EXPECT_EQ((round*STREAMER_BENCH_BATCH_SIZE + received)*(uint64_t)STREAMER_BENCH_DATA_SIZE, ditem->fd.file_offset) ;
+				EXPECT_EQ(STREAMER_BENCH_DATA_SIZE, ditem->fd.binData.bin_len) ;
+			}
+			++received ;
+			delete item ;
+		}
+		EXPECT_EQ(STREAMER_BENCH_BATCH_SIZE, received) ;
+	}
+
+	double total_time = getCurrentTS() - start ;
+
+	std::cerr << "Streamed " << items << " items of " << STREAMER_BENCH_DATA_SIZE << " bytes: " << (uint64_t)(bytes / std::max(send_time,1e-6)) << " B/s sent, "
+	          << (uint64_t)(bytes / std::max(total_time,1e-6)) << " B/s sent and received, " << writes / (float)items << " writes per item, "
+	          << allocations / (float)items << " allocations per item sent." << std::endl;
+
+	// slices are grouped in records of about one TCP segment, and are copied straight into the output buffer.
+
+	EXPECT_LT(writes, items * (STREAMER_BENCH_DATA_SIZE / 1000)) ;
+	EXPECT_LT(allocations, items * 5) ;
+}
@@ -0,0 +1,96 @@
+/*
+ * tests/unittests/libretroshare/pqi: testauthssl.h
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#pragma once
+
+#include <stdlib.h>
+
+#include "pqi/authssl.h"
+#include "util/rsdir.h"
+
+// Stands for the SSL key of the node, for tests that save encrypted or signed files: "encrypts" by flipping bits, and
+// "signs" with a hash. Encryption can be made to fail, as when the disc is full. Install it with
+// AuthSSL::setAuthSSL_debug().
+
+class TestAuthSSL: public AuthSSL
+{
+public:
+	TestAuthSSL() : mFailEncryption(false), mOwnId(RsPeerId::random()) {}
+
+	virtual bool validateOwnCertificate(X509 *, EVP_PKEY *) { return true ; }
+	virtual bool active() { return true ; }
+	virtual int InitAuth(const char *, const char *, const char *, std::string) { return 1 ; }
+	virtual bool CloseAuth() { return true ; }
+
+	virtual const RsPeerId& OwnId() { return mOwnId ; }
+	virtual std::string getOwnLocation() { return std::string() ; }
+	virtual std::string SaveOwnCertificateToString() { return std::string() ; }
+
+	virtual bool SignData(std::string input, std::string &sign) { return SignData(input.c_str(),input.length(),sign) ; }
+	virtual bool SignData(const void *data, const uint32_t len, std::string &sign)
+	{
+		sign = "signed " + RsDirUtil::sha1sum((const unsigned char *)data,len).toStdString() ;
+		return true ;
+	}
+	virtual bool SignDataBin(std::string, unsigned char*, unsigned int*) { return false ; }
+	virtual bool SignDataBin(const void*, uint32_t, unsigned char*, unsigned int*) { return false ; }
+	virtual bool VerifyOwnSignBin(const void*, uint32_t, unsigned char*, unsigned int) { return false ; }
+	virtual bool VerifySignBin(const void *, const uint32_t, unsigned char *, unsigned int, const RsPeerId&) { return false ; }
+
+	virtual bool encrypt(void *&out, int &outlen, const void *in, int inlen, const RsPeerId&)
+	{
+		if(mFailEncryption)
+			return false ;
+
+		return flip(out,outlen,in,inlen) ;
+	}
+	virtual bool decrypt(void *&out, int &outlen, const void *in, int inlen) { return flip(out,outlen,in,inlen) ; }
+
+	virtual X509* SignX509ReqWithGPG(X509_REQ *, long) { return NULL ; }
+	virtual bool AuthX509WithGPG(X509 *, uint32_t&) { return false ; }
+	virtual int VerifyX509Callback(int, X509_STORE_CTX *) { return 0 ; }
+	virtual bool ValidateCertificate(X509 *, RsPeerId&) { return false ; }
+	virtual SSL_CTX *getCTX() { return NULL ; }
+	virtual void setCurrentConnectionAttemptInfo(const RsPgpId&, const RsPeerId&, const std::string&) {}
+	virtual void getCurrentConnectionAttemptInfo(RsPgpId&, RsPeerId&, std::string&) {}
+	virtual bool FailedCertificate(X509 *, const RsPgpId&, const RsPeerId&, const std::string&, const struct sockaddr_storage&, bool) { return false ; }
+	virtual bool CheckCertificate(const RsPeerId&, X509 *) { return false ; }
+
+	bool mFailEncryption ;
+
+private:
+	static bool flip(void *&out, int &outlen, const void *in, int inlen)
+	{
+		out = malloc(inlen > 0 ? inlen : 1) ;
+		outlen = inlen ;
+
+		for(int i=0;i<inlen;++i)
+			((unsigned char *)out)[i] = ((const unsigned char *)in)[i] ^ 0xa5 ;
+
+		return true ;
+	}
+
+	RsPeerId mOwnId ;
+};
@@ -0,0 +1,74 @@
+/*
+ * tests/unittests/libretroshare/serialiser: rsfiletransferitem_test.cc
+ *
+ * RetroShare Serialiser.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "rsitems/rsfiletransferitems.h"
+
+#include "support.h"
+
+void init_item(RsFileTransferDataRequestItem& item)
+{
+	init_item(item.file) ;
+	item.fileoffset = 0x25ea228437894379ull ;
+	item.chunksize = rand() ;
+}
+bool operator==(const RsFileTransferDataRequestItem& it1,const RsFileTransferDataRequestItem& it2)
+{
+	if(!(it1.file == it2.file)) return false ;
+	if(it1.fileoffset != it2.fileoffset) return false ;
+	if(it1.chunksize != it2.chunksize) return false ;
+	return true ;
+}
+void init_item(RsFileTransferDataRequestsItem& item)
+{
+	init_item(item.file) ;
+	item.fileoffsets.clear() ;
+	item.chunksizes.clear() ;
+
+	uint32_t n = 1 + rand()%40 ;
+
+	for(uint32_t i=0;i<n;++i)
+	{
+		item.fileoffsets.push_back(((uint64_t)rand() << 32) + rand()) ;
+		item.chunksizes.push_back(rand()) ;
+	}
+}
+bool operator==(const RsFileTransferDataRequestsItem& it1,const RsFileTransferDataRequestsItem& it2)
+{
+	if(!(it1.file == it2.file)) return false ;
+	if(it1.fileoffsets != it2.fileoffsets) return false ;
+	if(it1.chunksizes != it2.chunksizes) return false ;
+	return true ;
+}
+
+TEST(libretroshare_serialiser, RsFileTransferItem)
+{
+	for(uint32_t i=0;i<20;++i)
+	{
+		test_RsItem<RsFileTransferDataRequestItem  ,RsFileTransferSerialiser>();
+		test_RsItem<RsFileTransferDataRequestsItem ,RsFileTransferSerialiser>();
+	}
+}
@@ -43,12 +43,23 @@ void init_item(RsGxsIdGroupItem& item)
     item.mPgpIdSign = "hello";
 }
 
+bool operator==(const RsGxsIdPgpIndexItem& it1,const RsGxsIdPgpIndexItem& it2)
+{
+    return it1.mIdsWaitingForPgpKey == it2.mIdsWaitingForPgpKey ;
+}
+void init_item(RsGxsIdPgpIndexItem& item)
+{
+    for(uint32_t i=0;i<10;++i)
+        item.mIdsWaitingForPgpKey[RsGxsId::random()] = RsPgpId::random() ;
+}
+
 
 TEST(libretroshare_serialiser, RsGxsIdItem)
 {
 	for(uint32_t i=0;i<20;++i)
 	{
 		test_RsItem< RsGxsIdGroupItem,RsGxsIdSerialiser >();
+		test_RsItem< RsGxsIdPgpIndexItem,RsGxsIdSerialiser >();
 	}
 }
 
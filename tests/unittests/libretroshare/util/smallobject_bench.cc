@@ -0,0 +1,246 @@
+/*
+ * tests/unittests/libretroshare/util: smallobject_bench.cc
+ *
+ * RetroShare C++ Interface.
+ *
+ * Copyright 2018 by Retroshare Team.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License Version 2 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307
+ * USA.
+ *
+ * Please report all bugs and problems to "retroshare.project@gmail.com".
+ *
+ */
+
+// Micro-benchmark of the small object allocator. Compares, with N threads allocating and releasing objects of
+// various sizes:
+//    - the per-thread allocator used by SmallObject
+//    - a single SmallObjectAllocator protected by a global mutex, which is how SmallObject used to work
+//    - plain malloc/free
+//
+// Half of the objects are released by another thread than the one that allocated them, which is what happens to
+// RsItems that go from the pqi threads to the services.
+
+#include <gtest/gtest.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+#include <string.h>
+
+#include "util/smallobject.h"
+#include "util/rsthreads.h"
+
+using namespace RsMemoryManagement ;
+
+static const uint32_t SMALL_OBJECT_BENCH_MAX_THREADS = 8 ;
+static const uint32_t SMALL_OBJECT_BENCH_ITERATIONS  = 200000 ;	// allocations per thread
+
+// Objects allocated through the old scheme: one allocator, one mutex.
+
+static RsMutex globalMtx("smallobject_bench") ;
+static SmallObjectAllocator *globalAllocator = NULL ;
+
+class LockedObject
+{
+public:
+	static void *operator new(size_t size)        { RsStackMutex m(globalMtx) ; return globalAllocator->allocate(size) ; }
+	static void operator delete(void *p,size_t s) { RsStackMutex m(globalMtx) ; globalAllocator->deallocate(p,s) ; }
+	virtual ~LockedObject() {}
+};
+
+class MallocObject
+{
+public:
+	virtual ~MallocObject() {}
+};
+
+template<class B,int S> class TestObject: public B
+{
+public:
+	TestObject(uint32_t v) { memset(data,v,S) ; }
+	unsigned char data[S] ;
+};
+
+// Per-thread mailbox used to hand objects to another thread.
+
+template<class B> class Mailbox
+{
+public:
+	Mailbox() : mMtx("Mailbox") {}
+
+	void push(std::vector<B*>& objs) { RsStackMutex m(mMtx) ; mObjs.insert(mObjs.end(),objs.begin(),objs.end()) ; objs.clear() ; }
+	void pop(std::vector<B*>& objs)  { RsStackMutex m(mMtx) ; objs.swap(mObjs) ; }
+
+private:
+	RsMutex mMtx ;
+	std::vector<B*> mObjs ;
+};
+
+template<class B> class BenchThread: public RsSingleJobThread
+{
+public:
+	BenchThread(uint32_t id,uint32_t iterations,Mailbox<B> *own,Mailbox<B> *next)
+		: mId(id),mIterations(iterations),mOwn(own),mNext(next) {}
+
+	virtual void run()
+	{
+		static const uint32_t WINDOW = 64 ;
+
+		std::vector<B*> window(WINDOW,(B*)NULL) ;
+		std::vector<B*> outgoing ;
+		std::vector<B*> incoming ;
+
+		for(uint32_t i=0;i<mIterations;++i)
+		{
+			uint32_t slot = (i*7 + mId) % WINDOW ;
+
+			if(window[slot] != NULL)
+			{
+				if(i & 1)
+					outgoing.push_back(window[slot]) ;	// released by the next thread
+				else
+					delete window[slot] ;
+			}
+
+			switch(i % 3)
+			{
+			case 0: window[slot] = new TestObject<B,24>(i) ; break ;
+			case 1: window[slot] = new TestObject<B,56>(i) ; break ;
+			default:
+				window[slot] = new TestObject<B,112>(i) ; break ;
+			}
+
+			if(outgoing.size() >= 32)
+			{
+				mNext->push(outgoing) ;
+				mOwn->pop(incoming) ;
+
+				for(uint32_t j=0;j<incoming.size();++j)
+					delete incoming[j] ;
+				incoming.clear() ;
+			}
+		}
+		for(uint32_t i=0;i<WINDOW;++i)
+			delete window[i] ;
+
+		mNext->push(outgoing) ;
+	}
+
+private:
+	uint32_t mId ;
+	uint32_t mIterations ;
+	Mailbox<B> *mOwn ;
+	Mailbox<B> *mNext ;
+};
+
+static double getCurrentTS()
+{
+	struct timeval tv ;
+	gettimeofday(&tv,NULL) ;
+	return tv.tv_sec + tv.tv_usec / 1000000.0 ;
+}
+
+template<class B> double runBench(uint32_t nb_threads,uint32_t iterations)
+{
+	std::vector<Mailbox<B> > mailboxes(nb_threads) ;
+	std::vector<BenchThread<B>*> threads ;
+
+	for(uint32_t i=0;i<nb_threads;++i)
+		threads.push_back(new BenchThread<B>(i,iterations,&mailboxes[i],&mailboxes[(i+1)%nb_threads])) ;
+
+	double start = getCurrentTS() ;
+
+	for(uint32_t i=0;i<nb_threads;++i)
+		threads[i]->start("bench") ;
+
+	for(uint32_t i=0;i<nb_threads;++i)
+		while(threads[i]->isRunning())
+			usleep(1000) ;
+
+	double elapsed = getCurrentTS() - start ;
+
+	// release whatever is left in the mailboxes
+
+	for(uint32_t i=0;i<nb_threads;++i)
+	{
+		std::vector<B*> left ;
+		mailboxes[i].pop(left) ;
+
+		for(uint32_t j=0;j<left.size();++j)
+			delete left[j] ;
+
+		delete threads[i] ;
+	}
+	return elapsed ;
+}
+
+TEST(libretroshare_util, SmallObjectAllocatorBench)
+{
+	if(globalAllocator == NULL)
+		globalAllocator = new SmallObjectAllocator(MAX_SMALL_OBJECT_SIZE) ;
+
+	std::vector<SmallObjectStatistics> stats_before ;
+	SmallObject::getStatistics(stats_before) ;
+
+	uint64_t allocs_before = 0,remote_before = 0 ;
+
+	for(uint32_t i=0;i<stats_before.size();++i)
+	{
+		allocs_before += stats_before[i].allocations ;
+		remote_before += stats_before[i].remote_deallocations ;
+	}
+
+	// warm-up, so that the first timed run does not pay for page faults alone.
+
+	runBench<SmallObject>(1,SMALL_OBJECT_BENCH_ITERATIONS/10) ;
+	runBench<LockedObject>(1,SMALL_OBJECT_BENCH_ITERATIONS/10) ;
+	runBench<MallocObject>(1,SMALL_OBJECT_BENCH_ITERATIONS/10) ;
+
+	for(uint32_t n=1;n<=SMALL_OBJECT_BENCH_MAX_THREADS;n*=2)
+	{
+		double t_thread = runBench<SmallObject>(n,SMALL_OBJECT_BENCH_ITERATIONS) ;
+		double t_locked = runBench<LockedObject>(n,SMALL_OBJECT_BENCH_ITERATIONS) ;
+		double t_malloc = runBench<MallocObject>(n,SMALL_OBJECT_BENCH_ITERATIONS) ;
+
+		double total = (double)n*SMALL_OBJECT_BENCH_ITERATIONS ;
+
+		std::cerr << n << " threads: per-thread " << 1e9*t_thread/total << " ns/alloc, global mutex " << 1e9*t_locked/total
+		          << " ns/alloc, malloc " << 1e9*t_malloc/total << " ns/alloc" << std::endl;
+	}
+
+	std::vector<SmallObjectStatistics> stats ;
+	SmallObject::getStatistics(stats) ;
+
+	uint64_t allocs = 0,remote = 0 ;
+
+	for(uint32_t i=0;i<stats.size();++i)
+	{
+		if(stats[i].allocations > 0)
+			std::cerr << "  size class " << stats[i].block_size << ": " << stats[i].allocations << " allocs, " << stats[i].deallocations
+			          << " deallocs, " << stats[i].remote_deallocations << " remote, " << stats[i].chunks << " chunks" << std::endl;
+
+		EXPECT_LE(stats[i].deallocations, stats[i].allocations) ;
+
+		allocs += stats[i].allocations ;
+		remote += stats[i].remote_deallocations ;
+	}
+
+	// every SmallObject run allocates through the per-thread allocators, and runs with more than one thread
+	// hand half of their objects to another thread.
+
+	EXPECT_LT(allocs_before, allocs) ;
+	EXPECT_LT(remote_before, remote) ;
+}
@@ -281,6 +281,7 @@ HEADERS +=  libretroshare/serialiser/support.h \
 	libretroshare/serialiser/rstlvutil.h \
 
 SOURCES +=  libretroshare/serialiser/rsturtleitem_test.cc \
+		libretroshare/serialiser/rsfiletransferitem_test.cc \
 		libretroshare/serialiser/rsbaseitem_test.cc \
 		libretroshare/serialiser/rsgxsupdateitem_test.cc \
 		libretroshare/serialiser/rsmsgitem_test.cc \
@@ -326,6 +327,7 @@ SOURCES +=  libretroshare/gxs/nxs_test/nxsdummyservices.cc \
 	libretroshare/gxs/nxs_test/rsgxsnetservice_test.cc \
 	libretroshare/gxs/nxs_test/nxsmsgsync_test.cc \
 	libretroshare/gxs/nxs_test/nxsgrpsync_test.cc \ 
+	libretroshare/gxs/nxs_test/nxsmsgsketch_test.cc \
 	libretroshare/gxs/nxs_test/nxsgrpsyncdelayed.cc
 	
 HEADERS += libretroshare/gxs/gen_exchange/genexchangetester.h \
@@ -342,6 +344,7 @@ SOURCES += libretroshare/gxs/gen_exchange/gxspublishgrouptest.cc \
 	libretroshare/gxs/gen_exchange/gxspublishmsgtest.cc \
 	libretroshare/gxs/gen_exchange/rsdummyservices.cc \
 	libretroshare/gxs/gen_exchange/rsgenexchange_test.cc \
+	libretroshare/gxs/gen_exchange/rsgxsvalidationpool_test.cc \
 	libretroshare/gxs/gen_exchange/genexchangetester.cc \
 	libretroshare/gxs/gen_exchange/genexchangetestservice.cc \
 
@@ -353,8 +356,34 @@ HEADERS += libretroshare/gxs/data_service/rsdataservice_test.h \
 
 SOURCES += libretroshare/gxs/data_service/rsdataservice_test.cc \
 	libretroshare/gxs/data_service/rsgxsdata_test.cc \
+	libretroshare/gxs/data_service/rsdataservice_bench.cc \
+	libretroshare/gxs/data_service/rsgxsdataaccess_test.cc \
 
 
+################################## ft ######################################
+
+SOURCES += libretroshare/ft/ftchunkmap_bench.cc \
+	libretroshare/ft/ftfilecreator_test.cc \
+	libretroshare/ft/ftfileio_test.cc \
+	libretroshare/ft/ftserver_encryption_test.cc \
+
+############################## file_sharing ################################
+
+SOURCES += libretroshare/file_sharing/dirsync_test.cc \
+	libretroshare/file_sharing/dir_hierarchy_test.cc \
+
+################################## pqi #####################################
+
+HEADERS += libretroshare/pqi/testauthssl.h \
+
+SOURCES += libretroshare/pqi/pqistreamer_bench.cc \
+	libretroshare/pqi/historystore_test.cc \
+	libretroshare/pqi/p3cfgmgr_journal_test.cc \
+
+################################## util ####################################
+
+SOURCES += libretroshare/util/smallobject_bench.cc \
+
 ################################ dbase #####################################
 
 